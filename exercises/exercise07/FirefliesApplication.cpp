@@ -14,6 +14,7 @@ FirefliesApplication::FirefliesApplication()
     : Application(1024, 1024, "Fireflies demo")
     , m_renderMode(RenderMode::Deferred)
     , m_renderer(GetDevice())
+    , m_deferredRenderPass(nullptr)
     , m_mouseClicked(false)
     , m_ambientColor(0.0f)
     , m_lightColor(0.0f)
@@ -59,6 +60,9 @@ void FirefliesApplication::Render()
     // Clear color and depth
     GetDevice().Clear(true, Color(0.0f, 0.0f, 0.0f, 1.0f), true, 1.0f);
 
+    // Closest drawcalls first, so the depth test rejects the hidden pixels before they are lit
+    m_renderer.SortDrawcallCollection(0, Renderer::DrawcallSortMode::FrontToBack);
+
     m_renderer.Render();
 
     // Render the debug user interface
@@ -119,17 +123,22 @@ Renderer::UpdateLightsFunction FirefliesApplication::GetUpdateLightsFunction(std
 
 void FirefliesApplication::InitializeForwardMaterials()
 {
+    // With GL 4.3, all the lights are shaded in a single pass, reading them from the light clusters of the renderer
+    bool clustered = GetDevice().IsVersionSupported(4, 3);
+    const char* versionPath = clustered ? "shaders/version430.glsl" : "shaders/version330.glsl";
+
     // Load and build shader
     std::vector<const char*> vertexShaderPaths;
-    vertexShaderPaths.push_back("shaders/version330.glsl");
+    vertexShaderPaths.push_back(versionPath);
+    vertexShaderPaths.push_back("shaders/instancing.glsl");
     vertexShaderPaths.push_back("shaders/lit.vert");
     Shader vertexShader = ShaderLoader(Shader::VertexShader).Load(vertexShaderPaths);
 
     std::vector<const char*> fragmentShaderPaths;
-    fragmentShaderPaths.push_back("shaders/version330.glsl");
+    fragmentShaderPaths.push_back(versionPath);
     fragmentShaderPaths.push_back("shaders/utils.glsl");
     fragmentShaderPaths.push_back("shaders/blinn-phong.glsl");
-    fragmentShaderPaths.push_back("shaders/lighting.glsl");
+    fragmentShaderPaths.push_back(clustered ? "shaders/clustered-lighting.glsl" : "shaders/lighting.glsl");
     fragmentShaderPaths.push_back("shaders/lit.frag");
     Shader fragmentShader = ShaderLoader(Shader::FragmentShader).Load(fragmentShaderPaths);
 
@@ -164,6 +173,10 @@ void FirefliesApplication::InitializeForwardMaterials()
     filteredUniforms.insert("LightPosition");
     filteredUniforms.insert("LightDirection");
     filteredUniforms.insert("LightAttenuation");
+    filteredUniforms.insert("ClusterGridSize");
+    filteredUniforms.insert("ClusterDepthScaleBias");
+    filteredUniforms.insert("ClusterDepthPlane");
+    filteredUniforms.insert("ClusterViewProjMatrix");
 
     // Create reference material
     m_forwardMaterial = std::make_shared<Material>(shaderProgramPtr, filteredUniforms);
@@ -176,6 +189,7 @@ void FirefliesApplication::InitializeDeferredMaterials()
         // Load and build shader
         std::vector<const char*> vertexShaderPaths;
         vertexShaderPaths.push_back("shaders/version330.glsl");
+        vertexShaderPaths.push_back("shaders/instancing.glsl");
         vertexShaderPaths.push_back("shaders/gbuffer.vert");
         Shader vertexShader = ShaderLoader(Shader::VertexShader).Load(vertexShaderPaths);
 
@@ -193,10 +207,10 @@ void FirefliesApplication::InitializeDeferredMaterials()
 
         // Register shader with renderer
         m_renderer.RegisterShaderProgram(shaderProgramPtr,
-            [=](const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera& camera, bool cameraChanged)
+            [=](const ShaderProgram& shaderProgram, const Renderer::ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
             {
-                shaderProgram.SetUniform(worldViewMatrixLocation, camera.GetViewMatrix() * worldMatrix);
-                shaderProgram.SetUniform(worldViewProjMatrixLocation, camera.GetViewProjectionMatrix() * worldMatrix);
+                shaderProgram.SetUniform(worldViewMatrixLocation, transforms.worldViewMatrix);
+                shaderProgram.SetUniform(worldViewProjMatrixLocation, transforms.worldViewProjMatrix);
             },
             nullptr
         );
@@ -240,14 +254,14 @@ void FirefliesApplication::InitializeDeferredMaterials()
 
         // Register shader with renderer
         m_renderer.RegisterShaderProgram(shaderProgramPtr,
-            [=](const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera& camera, bool cameraChanged)
+            [=](const ShaderProgram& shaderProgram, const Renderer::ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
             {
                 if (cameraChanged)
                 {
                     shaderProgram.SetUniform(invViewMatrixLocation, glm::inverse(camera.GetViewMatrix()));
                     shaderProgram.SetUniform(invProjMatrixLocation, glm::inverse(camera.GetProjectionMatrix()));
                 }
-                shaderProgram.SetUniform(worldViewProjMatrixLocation, camera.GetViewProjectionMatrix() * worldMatrix);
+                shaderProgram.SetUniform(worldViewProjMatrixLocation, transforms.worldViewProjMatrix);
             },
             GetUpdateLightsFunction(shaderProgramPtr)
         );
@@ -305,14 +319,20 @@ void FirefliesApplication::InitializeRenderer()
     switch (m_renderMode)
     {
     case RenderMode::Forward:
-        m_renderer.AddRenderPass(std::make_unique<ForwardRenderPass>());
-        break;
+        {
+            // The instanced drawcalls are grouped in indirect drawcalls, if the device supports them
+            std::unique_ptr<ForwardRenderPass> forwardRenderPass(std::make_unique<ForwardRenderPass>());
+            forwardRenderPass->SetSubmissionMode(RenderPass::SubmissionMode::Indirect);
+            m_renderer.AddRenderPass(std::move(forwardRenderPass));
+            break;
+        }
     case RenderMode::Deferred:
         {
             // Set up deferred passes
             int width, height;
             GetMainWindow().GetDimensions(width, height);
             std::unique_ptr<GBufferRenderPass> gbufferRenderPass(std::make_unique<GBufferRenderPass>(width, height));
+            gbufferRenderPass->SetSubmissionMode(RenderPass::SubmissionMode::Indirect);
 
             // Set the g-buffer textures as properties of the deferred material
             m_deferredMaterial->SetUniformValue("DepthTexture", gbufferRenderPass->GetDepthTexture());
@@ -321,8 +341,12 @@ void FirefliesApplication::InitializeRenderer()
             m_deferredMaterial->SetUniformValue("OthersTexture", gbufferRenderPass->GetOthersTexture());
 
             // Add the render passes
+            // The lights are drawn in the default framebuffer, that gets a copy of the g-buffer depth for the light proxies
+            std::unique_ptr<DeferredRenderPass> deferredRenderPass(std::make_unique<DeferredRenderPass>(m_deferredMaterial));
+            deferredRenderPass->SetDepthFramebuffer(gbufferRenderPass->GetTargetFramebuffer());
             m_renderer.AddRenderPass(std::move(gbufferRenderPass));
-            m_renderer.AddRenderPass(std::make_unique<DeferredRenderPass>(m_deferredMaterial));
+            m_deferredRenderPass = deferredRenderPass.get();
+            m_renderer.AddRenderPass(std::move(deferredRenderPass));
             break;
         }
     }
@@ -338,6 +362,24 @@ void FirefliesApplication::RenderGUI()
     ImGui::ColorEdit3("Light color", &m_lightColor[0]);
     ImGui::DragFloat("Light intensity", &m_lightIntensity, 0.05f, 0.0f, 100.0f);
     ImGui::Checkbox("Use random color", &m_useRandomColor);
+    ImGui::Separator();
+    bool instancing = m_renderer.IsInstancingEnabled();
+    if (ImGui::Checkbox("Use instancing", &instancing))
+    {
+        m_renderer.SetInstancingEnabled(instancing);
+    }
+    if (m_deferredRenderPass)
+    {
+        ImGui::Separator();
+        int lightVolumeMode = static_cast<int>(m_deferredRenderPass->GetLightVolumeMode());
+        if (ImGui::Combo("Light volumes", &lightVolumeMode, "Fullscreen\0Scissor\0Proxy\0"))
+        {
+            m_deferredRenderPass->SetLightVolumeMode(static_cast<DeferredRenderPass::LightVolumeMode>(lightVolumeMode));
+        }
+        const DeferredRenderPass::Stats& stats = m_deferredRenderPass->GetStats();
+        ImGui::Text("Fullscreen %u, scissor %u, proxy %u, culled %u", stats.fullscreenCount, stats.scissorCount, stats.proxyCount, stats.culledCount);
+        ImGui::Text("Shaded pixels: %.1f M", stats.shadedPixelCount / 1000000.0);
+    }
 
     m_imGui.EndFrame();
 }
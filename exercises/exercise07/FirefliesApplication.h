@@ -11,6 +11,7 @@
 
 class Texture2DObject;
 class Light;
+class DeferredRenderPass;
 
 class FirefliesApplication : public Application
 {
@@ -86,4 +87,7 @@ private:
 
     // Renderer
     Renderer m_renderer;
+
+    // Deferred lighting pass, owned by the renderer. nullptr in forward mode
+    DeferredRenderPass* m_deferredRenderPass;
 };
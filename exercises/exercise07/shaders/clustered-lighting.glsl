@@ -0,0 +1,95 @@
+// Lights of the frame, and the light lists of the clusters, filled by the renderer
+struct LightData
+{
+	vec4 Color;
+	vec4 Position;
+	vec4 Direction;
+	vec4 Attenuation;
+};
+
+layout (std430, binding = 1) readonly buffer LightBuffer { LightData Lights[]; };
+layout (std430, binding = 2) readonly buffer ClusterBuffer { uvec2 Clusters[]; };
+layout (std430, binding = 3) readonly buffer LightIndexBuffer { uint LightIndices[]; };
+
+uniform uvec3 ClusterGridSize;
+uniform vec2 ClusterDepthScaleBias;
+uniform vec4 ClusterDepthPlane;
+uniform mat4 ClusterViewProjMatrix;
+
+// Find the cluster that contains the position: tile from the screen position, slice from the log of the view depth
+uint ComputeClusterIndex(vec3 position)
+{
+	vec4 clipPosition = ClusterViewProjMatrix * vec4(position, 1);
+	vec2 screenPosition = clamp(clipPosition.xy / clipPosition.w * 0.5f + 0.5f, 0.0f, 1.0f);
+	uvec2 tile = min(uvec2(screenPosition * vec2(ClusterGridSize.xy)), ClusterGridSize.xy - 1u);
+
+	float depth = dot(ClusterDepthPlane, vec4(position, 1));
+	float slice = log(max(depth, 1e-6f)) * ClusterDepthScaleBias.x + ClusterDepthScaleBias.y;
+	uint sliceIndex = uint(clamp(slice, 0.0f, float(ClusterGridSize.z - 1u)));
+
+	return (sliceIndex * ClusterGridSize.y + tile.y) * ClusterGridSize.x + tile.x;
+}
+
+float ComputeDistanceAttenuation(LightData light, vec3 position)
+{
+	// Compute distance attenuation, reading the range from Attenuation.x (fade start) and Attenuation.y (fade end)
+	return smoothstep(light.Attenuation.y, light.Attenuation.x, distance(position, light.Position.xyz));
+}
+
+float ComputeAngularAttenuation(LightData light, vec3 lightDir)
+{
+	float angle = acos(dot(light.Direction.xyz, lightDir));
+	vec2 attAngle = light.Attenuation.zw;
+	return smoothstep(attAngle.y, attAngle.x, angle);
+}
+
+float ComputeAttenuation(LightData light, vec3 position, vec3 lightDir)
+{
+	float attenuation = 1.0f;
+	if (light.Attenuation.y > 0)
+	{
+		attenuation *= ComputeDistanceAttenuation(light, position);
+	}
+	if (light.Attenuation.w > 0)
+	{
+		attenuation *= ComputeAngularAttenuation(light, lightDir);
+	}
+	return attenuation;
+}
+
+vec3 ComputeLightDirection(LightData light, vec3 position)
+{
+	return light.Attenuation.y >= 0 ? GetDirection(position, light.Position.xyz) : light.Direction.xyz;
+}
+
+vec3 ComputeLight(LightData light, SurfaceData data, vec3 viewDir, vec3 position)
+{
+	vec3 lightDir = ComputeLightDirection(light, position);
+
+	vec3 lighting = vec3(0);
+	lighting += ComputeDiffuseLighting(data, lightDir);
+	lighting += ComputeSpecularLighting(data, lightDir, viewDir);
+
+	float attenuation = ComputeAttenuation(light, position, lightDir);
+	return lighting * light.Color.rgb * attenuation;
+}
+
+// Same as ComputeLighting in lighting.glsl, adding all the lights of the cluster in a single pass
+vec3 ComputeLighting(vec3 position, SurfaceData data, vec3 viewDir, bool indirect)
+{
+	vec3 light = vec3(0);
+	
+	if (indirect)
+	{
+		light += ComputeDiffuseIndirectLighting(data);
+		light += ComputeSpecularIndirectLighting(data, viewDir);
+	}
+
+	uvec2 cluster = Clusters[ComputeClusterIndex(position)];
+	for (uint i = 0u; i < cluster.y; ++i)
+	{
+		light += ComputeLight(Lights[LightIndices[cluster.x + i]], data, viewDir, position);
+	}
+
+	return light;
+}
@@ -2,6 +2,9 @@
 layout (location = 0) in vec3 VertexPosition;
 layout (location = 1) in vec3 VertexNormal;
 layout (location = 2) in vec2 VertexTexCoord;
+#ifdef INSTANCING
+layout (location = 12) in mat4 InstanceWorldMatrix;
+#endif
 
 //Outputs
 out vec3 ViewNormal;
@@ -13,12 +16,21 @@ uniform mat4 WorldViewProjMatrix;
 
 void main()
 {
+#ifdef INSTANCING
+	// World matrix is identity when instanced, the world matrix of each instance comes as an attribute
+	mat4 worldViewMatrix = WorldViewMatrix * InstanceWorldMatrix;
+	mat4 worldViewProjMatrix = WorldViewProjMatrix * InstanceWorldMatrix;
+#else
+	mat4 worldViewMatrix = WorldViewMatrix;
+	mat4 worldViewProjMatrix = WorldViewProjMatrix;
+#endif
+
 	// normal in view space (for lighting computation)
-	ViewNormal = normalize((WorldViewMatrix * vec4(VertexNormal, 0.0)).xyz);
+	ViewNormal = normalize((worldViewMatrix * vec4(VertexNormal, 0.0)).xyz);
 
 	// texture coordinates
 	TexCoord = VertexTexCoord;
 
 	// final vertex position (for opengl rendering, not for lighting)
-	gl_Position = WorldViewProjMatrix * vec4(VertexPosition, 1.0);
+	gl_Position = worldViewProjMatrix * vec4(VertexPosition, 1.0);
 }
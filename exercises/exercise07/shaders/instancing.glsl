@@ -0,0 +1,2 @@
+// Enables reading the world matrix from the instance attributes
+#define INSTANCING
@@ -2,6 +2,9 @@
 layout (location = 0) in vec3 VertexPosition;
 layout (location = 1) in vec3 VertexNormal;
 layout (location = 2) in vec2 VertexTexCoord;
+#ifdef INSTANCING
+layout (location = 12) in mat4 InstanceWorldMatrix;
+#endif
 
 //Outputs
 out vec3 WorldPosition;
@@ -14,11 +17,18 @@ uniform mat4 ViewProjMatrix;
 
 void main()
 {
+#ifdef INSTANCING
+	// WorldMatrix is identity when instanced, the world matrix of each instance comes as an attribute
+	mat4 worldMatrix = WorldMatrix * InstanceWorldMatrix;
+#else
+	mat4 worldMatrix = WorldMatrix;
+#endif
+
 	// vertex position in world space (for lighting computation)
-	WorldPosition = (WorldMatrix * vec4(VertexPosition, 1.0)).xyz;
+	WorldPosition = (worldMatrix * vec4(VertexPosition, 1.0)).xyz;
 
 	// normal in world space (for lighting computation)
-	WorldNormal = normalize((WorldMatrix * vec4(VertexNormal, 0.0)).xyz);
+	WorldNormal = normalize((worldMatrix * vec4(VertexNormal, 0.0)).xyz);
 
 	// texture coordinates
 	TexCoord = VertexTexCoord;
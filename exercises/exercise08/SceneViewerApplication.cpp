@@ -25,6 +25,7 @@
 
 SceneViewerApplication::SceneViewerApplication()
     : Application(1024, 1024, "Scene Viewer demo")
+    , m_imGuiSceneVisitor(m_imGui, "Scene")
     , m_renderer(GetDevice())
 {
 }
@@ -50,9 +51,10 @@ void SceneViewerApplication::Update()
     // Update camera controller
     m_cameraController.Update(GetMainWindow(), GetDeltaTime());
 
-    // Add the scene nodes to the renderer
+    // Add the scene nodes in the views to the renderer, found with the bounds of the moved nodes
+    m_scene.UpdateBounds();
     RendererSceneVisitor rendererSceneVisitor(m_renderer);
-    m_scene.AcceptVisitor(rendererSceneVisitor);
+    rendererSceneVisitor.VisitScene(m_scene);
 }
 
 void SceneViewerApplication::Render()
@@ -61,6 +63,9 @@ void SceneViewerApplication::Render()
 
     GetDevice().Clear(true, Color(0.0f, 0.0f, 0.0f, 1.0f), true, 1.0f);
 
+    // Closest drawcalls first, so the depth test rejects the hidden pixels before they are lit
+    m_renderer.SortDrawcallCollection(0, Renderer::DrawcallSortMode::FrontToBack);
+
     // Render the scene
     m_renderer.Render();
 
@@ -215,6 +220,9 @@ void SceneViewerApplication::InitializeModels()
 
 void SceneViewerApplication::InitializeRenderer()
 {
+    // The scene updates its transforms in the threads of the renderer
+    m_scene.SetWorkerPool(&m_renderer.GetWorkerPool());
+
     m_renderer.AddRenderPass(std::make_unique<ForwardRenderPass>());
     m_renderer.AddRenderPass(std::make_unique<SkyboxRenderPass>(m_skyboxTexture));
 }
@@ -223,9 +231,8 @@ void SceneViewerApplication::RenderGUI()
 {
     m_imGui.BeginFrame();
 
-    // Draw GUI for scene nodes, using the visitor pattern
-    ImGuiSceneVisitor imGuiVisitor(m_imGui, "Scene");
-    m_scene.AcceptVisitor(imGuiVisitor);
+    // Draw GUI for scene nodes. Nodes are only visited again when the scene changes
+    m_imGuiSceneVisitor.Draw(m_scene);
 
     // Draw GUI for camera controller
     m_cameraController.DrawGUI(m_imGui);
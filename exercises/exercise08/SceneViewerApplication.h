@@ -6,6 +6,7 @@
 #include <ituGL/renderer/Renderer.h>
 #include <ituGL/camera/CameraController.h>
 #include <ituGL/utils/DearImGui.h>
+#include <ituGL/scene/ImGuiSceneVisitor.h>
 
 class TextureCubemapObject;
 class Material;
@@ -34,6 +35,9 @@ private:
     // Helper object for debug GUI
     DearImGui m_imGui;
 
+    // Inspector of the scene nodes, kept between frames
+    ImGuiSceneVisitor m_imGuiSceneVisitor;
+
     // Camera controller
     CameraController m_cameraController;
 
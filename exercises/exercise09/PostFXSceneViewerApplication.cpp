@@ -15,11 +15,14 @@
 #include <ituGL/shader/Material.h>
 #include <ituGL/geometry/Model.h>
 #include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/Transform.h>
 
 #include <ituGL/renderer/SkyboxRenderPass.h>
 #include <ituGL/renderer/GBufferRenderPass.h>
 #include <ituGL/renderer/DeferredRenderPass.h>
 #include <ituGL/renderer/PostFXRenderPass.h>
+#include <ituGL/renderer/ShadowRenderPass.h>
+#include <ituGL/renderer/WeightedBlendedRenderPass.h>
 #include <ituGL/scene/RendererSceneVisitor.h>
 
 #include <ituGL/scene/ImGuiSceneVisitor.h>
@@ -27,8 +30,9 @@
 
 PostFXSceneViewerApplication::PostFXSceneViewerApplication()
     : Application(1024, 1024, "Post FX Scene Viewer demo")
+    , m_imGuiSceneVisitor(m_imGui, "Scene")
     , m_renderer(GetDevice())
-    , m_sceneFramebuffer(std::make_shared<FramebufferObject>())
+    , m_shadowRenderPass(nullptr)
     , m_exposure(1.0f)
     , m_contrast(1.0f)
     , m_hueShift(0.0f)
@@ -61,9 +65,11 @@ void PostFXSceneViewerApplication::Update()
     // Update camera controller
     m_cameraController.Update(GetMainWindow(), GetDeltaTime());
 
-    // Add the scene nodes to the renderer
+    // Add the scene nodes in the views to the renderer, found with the bounds of the moved nodes
+    m_scene.UpdateBounds();
     RendererSceneVisitor rendererSceneVisitor(m_renderer);
-    m_scene.AcceptVisitor(rendererSceneVisitor);
+    rendererSceneVisitor.SetShadowRenderPass(m_shadowRenderPass);
+    rendererSceneVisitor.VisitScene(m_scene);
 }
 
 void PostFXSceneViewerApplication::Render()
@@ -72,6 +78,10 @@ void PostFXSceneViewerApplication::Render()
 
     GetDevice().Clear(true, Color(0.0f, 0.0f, 0.0f, 1.0f), true, 1.0f);
 
+    // Closest opaque drawcalls first, so the depth test rejects the hidden pixels of the g-buffer
+    // The transparent collection is order independent, it is not sorted
+    m_renderer.SortDrawcallCollection(0, Renderer::DrawcallSortMode::FrontToBack);
+
     // Render the scene
     m_renderer.Render();
 
@@ -144,10 +154,10 @@ void PostFXSceneViewerApplication::InitializeMaterials()
 
         // Register shader with renderer
         m_renderer.RegisterShaderProgram(shaderProgramPtr,
-            [=](const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera& camera, bool cameraChanged)
+            [=](const ShaderProgram& shaderProgram, const Renderer::ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
             {
-                shaderProgram.SetUniform(worldViewMatrixLocation, camera.GetViewMatrix() * worldMatrix);
-                shaderProgram.SetUniform(worldViewProjMatrixLocation, camera.GetViewProjectionMatrix() * worldMatrix);
+                shaderProgram.SetUniform(worldViewMatrixLocation, transforms.worldViewMatrix);
+                shaderProgram.SetUniform(worldViewProjMatrixLocation, transforms.worldViewProjMatrix);
             },
             nullptr
         );
@@ -162,6 +172,50 @@ void PostFXSceneViewerApplication::InitializeMaterials()
         m_defaultMaterial->SetUniformValue("Color", glm::vec3(1.0f));
     }
 
+    // Transparent material, for weighted blended transparency
+    {
+        // Load and build shader
+        std::vector<const char*> vertexShaderPaths;
+        vertexShaderPaths.push_back("shaders/version330.glsl");
+        vertexShaderPaths.push_back("shaders/default.vert");
+        Shader vertexShader = ShaderLoader(Shader::VertexShader).Load(vertexShaderPaths);
+
+        std::vector<const char*> fragmentShaderPaths;
+        fragmentShaderPaths.push_back("shaders/version330.glsl");
+        fragmentShaderPaths.push_back("shaders/transparent.frag");
+        Shader fragmentShader = ShaderLoader(Shader::FragmentShader).Load(fragmentShaderPaths);
+
+        std::shared_ptr<ShaderProgram> shaderProgramPtr = std::make_shared<ShaderProgram>();
+        shaderProgramPtr->Build(vertexShader, fragmentShader);
+
+        // Get transform related uniform locations
+        ShaderProgram::Location worldViewMatrixLocation = shaderProgramPtr->GetUniformLocation("WorldViewMatrix");
+        ShaderProgram::Location worldViewProjMatrixLocation = shaderProgramPtr->GetUniformLocation("WorldViewProjMatrix");
+
+        // Register shader with renderer
+        m_renderer.RegisterShaderProgram(shaderProgramPtr,
+            [=](const ShaderProgram& shaderProgram, const Renderer::ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
+            {
+                shaderProgram.SetUniform(worldViewMatrixLocation, transforms.worldViewMatrix);
+                shaderProgram.SetUniform(worldViewProjMatrixLocation, transforms.worldViewProjMatrix);
+            },
+            nullptr
+        );
+
+        // Filter out uniforms that are not material properties
+        ShaderUniformCollection::NameSet filteredUniforms;
+        filteredUniforms.insert("WorldViewMatrix");
+        filteredUniforms.insert("WorldViewProjMatrix");
+
+        // Create material. The blending marks it as transparent, the weighted blended pass sets its own blend states
+        m_transparentMaterial = std::make_shared<Material>(shaderProgramPtr, filteredUniforms);
+        m_transparentMaterial->SetUniformValue("Color", glm::vec3(1.0f));
+        m_transparentMaterial->SetUniformValue("Alpha", 0.3f);
+        m_transparentMaterial->SetBlendEquation(Material::BlendEquation::Add);
+        m_transparentMaterial->SetBlendParams(Material::BlendParam::SourceAlpha, Material::BlendParam::OneMinusSourceAlpha);
+        m_transparentMaterial->SetDepthWrite(false);
+    }
+
     // Deferred material
     {
         std::vector<const char*> vertexShaderPaths;
@@ -190,6 +244,9 @@ void PostFXSceneViewerApplication::InitializeMaterials()
         filteredUniforms.insert("LightPosition");
         filteredUniforms.insert("LightDirection");
         filteredUniforms.insert("LightAttenuation");
+        filteredUniforms.insert("LightShadowCount");
+        filteredUniforms.insert("LightShadowMatrices");
+        filteredUniforms.insert("LightShadowRects");
 
         // Get transform related uniform locations
         ShaderProgram::Location invViewMatrixLocation = shaderProgramPtr->GetUniformLocation("InvViewMatrix");
@@ -198,14 +255,14 @@ void PostFXSceneViewerApplication::InitializeMaterials()
 
         // Register shader with renderer
         m_renderer.RegisterShaderProgram(shaderProgramPtr,
-            [=](const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera& camera, bool cameraChanged)
+            [=](const ShaderProgram& shaderProgram, const Renderer::ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
             {
                 if (cameraChanged)
                 {
                     shaderProgram.SetUniform(invViewMatrixLocation, glm::inverse(camera.GetViewMatrix()));
                     shaderProgram.SetUniform(invProjMatrixLocation, glm::inverse(camera.GetProjectionMatrix()));
                 }
-                shaderProgram.SetUniform(worldViewProjMatrixLocation, camera.GetViewProjectionMatrix() * worldMatrix);
+                shaderProgram.SetUniform(worldViewProjMatrixLocation, transforms.worldViewProjMatrix);
             },
             m_renderer.GetDefaultUpdateLightsFunction(*shaderProgramPtr)
         );
@@ -252,101 +309,157 @@ void PostFXSceneViewerApplication::InitializeModels()
 
     // Load models
     std::shared_ptr<Model> cannonModel = loader.LoadShared("models/cannon/cannon.obj");
-    m_scene.AddSceneNode(std::make_shared<SceneModel>("cannon", cannonModel));
-}
-
-void PostFXSceneViewerApplication::InitializeFramebuffers()
-{
-    int width, height;
-    GetMainWindow().GetDimensions(width, height);
-
-    // Scene Texture
-    m_sceneTexture = std::make_shared<Texture2DObject>();
-    m_sceneTexture->Bind();
-    m_sceneTexture->SetImage(0, width, height, TextureObject::FormatRGBA, TextureObject::InternalFormat::InternalFormatRGBA16F);
-    m_sceneTexture->SetParameter(TextureObject::ParameterEnum::MinFilter, GL_LINEAR);
-    m_sceneTexture->SetParameter(TextureObject::ParameterEnum::MagFilter, GL_LINEAR);
-    Texture2DObject::Unbind();
-
-    // Scene framebuffer
-    m_sceneFramebuffer->Bind();
-    m_sceneFramebuffer->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::Depth, *m_depthTexture);
-    m_sceneFramebuffer->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::Color0, *m_sceneTexture);
-    m_sceneFramebuffer->SetDrawBuffers(std::array<FramebufferObject::Attachment, 1>({ FramebufferObject::Attachment::Color0 }));
-    FramebufferObject::Unbind();
-
-    // Add temp textures and frame buffers
-    for (int i = 0; i < m_tempFramebuffers.size(); ++i)
+    std::shared_ptr<SceneModel> cannonNode = std::make_shared<SceneModel>("cannon", cannonModel);
+
+    // The cannon doesn't move, its shadows are cached
+    cannonNode->SetStatic(true);
+    m_scene.AddSceneNode(cannonNode);
+
+    // Transparent copies of the cannon, overlapping each other, so their order changes with the view
+    ModelLoader transparentLoader(m_transparentMaterial);
+    transparentLoader.SetCreateMaterials(true);
+    transparentLoader.GetTexture2DLoader().SetFlipVertical(true);
+    transparentLoader.SetMaterialAttribute(VertexAttribute::Semantic::Position, "VertexPosition");
+    transparentLoader.SetMaterialAttribute(VertexAttribute::Semantic::Normal, "VertexNormal");
+    transparentLoader.SetMaterialAttribute(VertexAttribute::Semantic::Tangent, "VertexTangent");
+    transparentLoader.SetMaterialAttribute(VertexAttribute::Semantic::Bitangent, "VertexBitangent");
+    transparentLoader.SetMaterialAttribute(VertexAttribute::Semantic::TexCoord0, "VertexTexCoord");
+    transparentLoader.SetMaterialProperty(ModelLoader::MaterialProperty::DiffuseColor, "Color");
+    transparentLoader.SetMaterialProperty(ModelLoader::MaterialProperty::DiffuseTexture, "ColorTexture");
+
+    std::shared_ptr<Model> transparentCannonModel = transparentLoader.LoadShared("models/cannon/cannon.obj");
+    for (int i = 1; i <= 3; ++i)
     {
-        m_tempTextures[i] = std::make_shared<Texture2DObject>();
-        m_tempTextures[i]->Bind();
-        m_tempTextures[i]->SetImage(0, width, height, TextureObject::FormatRGBA, TextureObject::InternalFormat::InternalFormatRGBA16F);
-        m_tempTextures[i]->SetParameter(TextureObject::ParameterEnum::WrapS, GL_CLAMP_TO_EDGE);
-        m_tempTextures[i]->SetParameter(TextureObject::ParameterEnum::WrapT, GL_CLAMP_TO_EDGE);
-        m_tempTextures[i]->SetParameter(TextureObject::ParameterEnum::MinFilter, GL_LINEAR);
-        m_tempTextures[i]->SetParameter(TextureObject::ParameterEnum::MagFilter, GL_LINEAR);
-
-        m_tempFramebuffers[i] = std::make_shared<FramebufferObject>();
-        m_tempFramebuffers[i]->Bind();
-        m_tempFramebuffers[i]->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::Color0, *m_tempTextures[i]);
-        m_tempFramebuffers[i]->SetDrawBuffers(std::array<FramebufferObject::Attachment, 1>({ FramebufferObject::Attachment::Color0 }));
+        std::shared_ptr<SceneModel> transparentCannonNode = std::make_shared<SceneModel>("transparent cannon", transparentCannonModel);
+        transparentCannonNode->GetTransform()->SetTranslation(glm::vec3(0.5f * i, 0.0f, 0.5f * i));
+        m_scene.AddSceneNode(transparentCannonNode);
     }
-    Texture2DObject::Unbind();
-    FramebufferObject::Unbind();
 }
 
 void PostFXSceneViewerApplication::InitializeRenderer()
 {
+    // The scene updates its transforms in the threads of the renderer
+    m_scene.SetWorkerPool(&m_renderer.GetWorkerPool());
+
     int width, height;
     GetMainWindow().GetDimensions(width, height);
 
-    // Set up deferred passes
+    // Render targets are declared in the render graph, that creates the textures and framebuffers
+    // The depth has a stencil for the light volumes of the deferred pass
+    RenderGraph::TextureDesc depthDesc = { width, height, TextureObject::FormatDepthStencil, TextureObject::InternalFormatDepth24Stencil8 };
+    RenderGraph::TextureDesc colorDesc = { width, height, TextureObject::FormatRGBA, TextureObject::InternalFormatSRGBA8 };
+    RenderGraph::TextureDesc normalDesc = { width, height, TextureObject::FormatRG, TextureObject::InternalFormatRG16F };
+    RenderGraph::TextureDesc hdrDesc = { width, height, TextureObject::FormatRGBA, TextureObject::InternalFormatRGBA16F, GL_LINEAR };
+    RenderGraph::TextureDesc coverageDesc = { width, height, TextureObject::FormatR, TextureObject::InternalFormatR8 };
+
+    RenderGraph::ResourceId depthTexture = m_renderGraph.CreateTexture("Depth", depthDesc);
+    RenderGraph::ResourceId albedoTexture = m_renderGraph.CreateTexture("Albedo", colorDesc);
+    RenderGraph::ResourceId normalTexture = m_renderGraph.CreateTexture("Normal", normalDesc);
+    RenderGraph::ResourceId othersTexture = m_renderGraph.CreateTexture("Others", colorDesc);
+    RenderGraph::ResourceId sceneTexture = m_renderGraph.CreateTexture("Scene", hdrDesc);
+    RenderGraph::ResourceId bloomTexture = m_renderGraph.CreateTexture("Bloom", hdrDesc);
+    // The accumulation uses the HDR description, so its texture object can be reused by the bloom after the composite
+    RenderGraph::ResourceId accumulationTexture = m_renderGraph.CreateTexture("Accumulation", hdrDesc);
+    RenderGraph::ResourceId coverageTexture = m_renderGraph.CreateTexture("Coverage", coverageDesc);
+
+    // Post FX materials read their source texture, that is known after the graph is compiled
+    std::vector<std::pair<std::shared_ptr<Material>, RenderGraph::ResourceId>> sourceTextures;
+
+    // Shadow pass, rendered before the lighting. It writes its own atlas, so the graph keeps it
     {
-        std::unique_ptr<GBufferRenderPass> gbufferRenderPass(std::make_unique<GBufferRenderPass>(width, height));
-
-        // Set the g-buffer textures as properties of the deferred material
-        m_deferredMaterial->SetUniformValue("DepthTexture", gbufferRenderPass->GetDepthTexture());
-        m_deferredMaterial->SetUniformValue("AlbedoTexture", gbufferRenderPass->GetAlbedoTexture());
-        m_deferredMaterial->SetUniformValue("NormalTexture", gbufferRenderPass->GetNormalTexture());
-        m_deferredMaterial->SetUniformValue("OthersTexture", gbufferRenderPass->GetOthersTexture());
-
-        // Get the depth texture from the gbuffer pass - This could be reworked
-        m_depthTexture = gbufferRenderPass->GetDepthTexture();
-
-        // Add the render passes
-        m_renderer.AddRenderPass(std::move(gbufferRenderPass));
-        m_renderer.AddRenderPass(std::make_unique<DeferredRenderPass>(m_deferredMaterial, m_sceneFramebuffer));
+        std::unique_ptr<ShadowRenderPass> shadowRenderPass = std::make_unique<ShadowRenderPass>();
+        m_shadowRenderPass = shadowRenderPass.get();
+        m_renderGraph.AddPass(std::move(shadowRenderPass));
+
+        // Lights of the deferred material also set their shadow tiles
+        std::shared_ptr<const ShaderProgram> shaderProgram = m_deferredMaterial->GetShaderProgram();
+        m_renderer.RegisterShaderProgram(shaderProgram, nullptr,
+            m_shadowRenderPass->GetUpdateLightsFunction(*shaderProgram, m_renderer.GetDefaultUpdateLightsFunction(*shaderProgram)));
+        m_deferredMaterial->SetUniformValue("ShadowAtlas", m_shadowRenderPass->GetAtlasTexture());
     }
 
-    // Initialize the framebuffers and the textures they use
-    InitializeFramebuffers();
+    // Opaque drawcalls go to the g-buffer, blended ones to the transparent collection. Its order doesn't matter, so it is not sorted
+    m_renderer.SetDrawcallCollectionSupportedFunction(0, [](const Renderer::DrawcallInfo& drawcallInfo) { return !drawcallInfo.GetMaterial().HasBlend(); });
+    unsigned int transparentCollection = m_renderer.AddDrawcallCollection([](const Renderer::DrawcallInfo& drawcallInfo) { return drawcallInfo.GetMaterial().HasBlend(); });
+    m_renderer.SetDrawcallCollectionOrderIndependent(transparentCollection, true);
 
-    // Skybox pass
-    m_renderer.AddRenderPass(std::make_unique<SkyboxRenderPass>(m_skyboxTexture));
-
-    // Create a copy pass from m_sceneTexture to the first temporary texture
-    std::shared_ptr<Material> copyMaterial = CreatePostFXMaterial("shaders/postfx/copy.frag", m_sceneTexture);
-    m_renderer.AddRenderPass(std::make_unique<PostFXRenderPass>(copyMaterial, m_tempFramebuffers[0]));
+    // Set up deferred passes
+    {
+        unsigned int gbufferPass = m_renderGraph.AddPass(std::make_unique<GBufferRenderPass>(nullptr));
+        m_renderGraph.AddWrite(gbufferPass, depthTexture, FramebufferObject::Attachment::DepthStencil);
+        m_renderGraph.AddWrite(gbufferPass, albedoTexture, FramebufferObject::Attachment::Color0);
+        m_renderGraph.AddWrite(gbufferPass, normalTexture, FramebufferObject::Attachment::Color1);
+        m_renderGraph.AddWrite(gbufferPass, othersTexture, FramebufferObject::Attachment::Color2);
+
+        unsigned int deferredPass = m_renderGraph.AddPass(std::make_unique<DeferredRenderPass>(m_deferredMaterial));
+        m_renderGraph.AddRead(deferredPass, depthTexture);
+        m_renderGraph.AddRead(deferredPass, albedoTexture);
+        m_renderGraph.AddRead(deferredPass, normalTexture);
+        m_renderGraph.AddRead(deferredPass, othersTexture);
+        m_renderGraph.AddWrite(deferredPass, sceneTexture, FramebufferObject::Attachment::Color0);
+        // The light volumes are tested against the depth, and marked in the stencil. The depth is not written
+        m_renderGraph.AddWrite(deferredPass, depthTexture, FramebufferObject::Attachment::DepthStencil, true);
+    }
 
-    // Replace the copy pass with a new bloom pass
-    m_bloomMaterial = CreatePostFXMaterial("shaders/postfx/bloom.frag", m_sceneTexture);
+    // Skybox pass, drawn over the lit scene using the g-buffer depth
+    unsigned int skyboxPass = m_renderGraph.AddPass(std::make_unique<SkyboxRenderPass>(m_skyboxTexture));
+    m_renderGraph.AddWrite(skyboxPass, depthTexture, FramebufferObject::Attachment::DepthStencil, true);
+    m_renderGraph.AddWrite(skyboxPass, sceneTexture, FramebufferObject::Attachment::Color0, true);
+
+    // Transparent objects, accumulated in any order. They are tested against the g-buffer depth, that is kept but not written
+    unsigned int transparentPass = m_renderGraph.AddPass(std::make_unique<WeightedBlendedRenderPass>(transparentCollection));
+    m_renderGraph.AddWrite(transparentPass, accumulationTexture, FramebufferObject::Attachment::Color0);
+    m_renderGraph.AddWrite(transparentPass, coverageTexture, FramebufferObject::Attachment::Color1);
+    m_renderGraph.AddWrite(transparentPass, depthTexture, FramebufferObject::Attachment::DepthStencil, true);
+
+    // Composite the transparent objects over the lit scene, with their coverage as alpha
+    std::shared_ptr<Material> transparentCompositeMaterial = CreatePostFXMaterial("shaders/postfx/weighted-blended.frag");
+    transparentCompositeMaterial->SetBlendEquation(Material::BlendEquation::Add);
+    transparentCompositeMaterial->SetBlendParams(Material::BlendParam::SourceAlpha, Material::BlendParam::OneMinusSourceAlpha, Material::BlendParam::Zero, Material::BlendParam::One);
+    unsigned int transparentCompositePass = m_renderGraph.AddPass(std::make_unique<PostFXRenderPass>(transparentCompositeMaterial));
+    m_renderGraph.AddRead(transparentCompositePass, accumulationTexture);
+    m_renderGraph.AddRead(transparentCompositePass, coverageTexture);
+    m_renderGraph.AddWrite(transparentCompositePass, sceneTexture, FramebufferObject::Attachment::Color0, true);
+
+    // Create a copy pass from the scene texture to the bloom texture
+    std::shared_ptr<Material> copyMaterial = CreatePostFXMaterial("shaders/postfx/copy.frag");
+    unsigned int copyPass = m_renderGraph.AddPass(std::make_unique<PostFXRenderPass>(copyMaterial));
+    m_renderGraph.AddRead(copyPass, sceneTexture);
+    m_renderGraph.AddWrite(copyPass, bloomTexture, FramebufferObject::Attachment::Color0);
+    sourceTextures.emplace_back(copyMaterial, sceneTexture);
+
+    // Replace the copy pass with a new bloom pass. The graph culls the copy pass, its result is never read
+    m_bloomMaterial = CreatePostFXMaterial("shaders/postfx/bloom.frag");
     m_bloomMaterial->SetUniformValue("Range", glm::vec2(2.0f, 3.0f));
     m_bloomMaterial->SetUniformValue("Intensity", 1.0f);
-    m_renderer.AddRenderPass(std::make_unique<PostFXRenderPass>(m_bloomMaterial, m_tempFramebuffers[0]));
+    unsigned int bloomPass = m_renderGraph.AddPass(std::make_unique<PostFXRenderPass>(m_bloomMaterial));
+    m_renderGraph.AddRead(bloomPass, sceneTexture);
+    m_renderGraph.AddWrite(bloomPass, bloomTexture, FramebufferObject::Attachment::Color0);
+    sourceTextures.emplace_back(m_bloomMaterial, sceneTexture);
 
-    // Add blur passes
-    std::shared_ptr<Material> blurHorizontalMaterial = CreatePostFXMaterial("shaders/postfx/blur.frag", m_tempTextures[0]);
+    // Add blur passes. Each one writes a new texture, and the graph alternates two textures for all of them
+    std::shared_ptr<Material> blurHorizontalMaterial = CreatePostFXMaterial("shaders/postfx/blur.frag");
     blurHorizontalMaterial->SetUniformValue("Scale", glm::vec2(1.0f / width, 0.0f));
-    std::shared_ptr<Material> blurVerticalMaterial = CreatePostFXMaterial("shaders/postfx/blur.frag", m_tempTextures[1]);
+    std::shared_ptr<Material> blurVerticalMaterial = CreatePostFXMaterial("shaders/postfx/blur.frag");
     blurVerticalMaterial->SetUniformValue("Scale", glm::vec2(0.0f, 1.0f / height));
+    RenderGraph::ResourceId blurTexture = bloomTexture;
     for (int i = 0; i < m_blurIterations; ++i)
     {
-        m_renderer.AddRenderPass(std::make_unique<PostFXRenderPass>(blurHorizontalMaterial, m_tempFramebuffers[1]));
-        m_renderer.AddRenderPass(std::make_unique<PostFXRenderPass>(blurVerticalMaterial, m_tempFramebuffers[0]));
+        for (const std::shared_ptr<Material>& blurMaterial : { blurHorizontalMaterial, blurVerticalMaterial })
+        {
+            // Each pass needs its own material, to read its own source texture
+            std::shared_ptr<Material> material = std::make_shared<Material>(*blurMaterial);
+            RenderGraph::ResourceId targetTexture = m_renderGraph.CreateTexture("Blur", hdrDesc);
+            unsigned int blurPass = m_renderGraph.AddPass(std::make_unique<PostFXRenderPass>(material));
+            m_renderGraph.AddRead(blurPass, blurTexture);
+            m_renderGraph.AddWrite(blurPass, targetTexture, FramebufferObject::Attachment::Color0);
+            sourceTextures.emplace_back(material, blurTexture);
+            blurTexture = targetTexture;
+        }
     }
 
     // Final pass
-    m_composeMaterial = CreatePostFXMaterial("shaders/postfx/compose.frag", m_sceneTexture);
+    m_composeMaterial = CreatePostFXMaterial("shaders/postfx/compose.frag");
 
     // Set exposure uniform default value
     m_composeMaterial->SetUniformValue("Exposure", m_exposure);
@@ -357,10 +470,30 @@ void PostFXSceneViewerApplication::InitializeRenderer()
     m_composeMaterial->SetUniformValue("Saturation", m_saturation);
     m_composeMaterial->SetUniformValue("ColorFilter", m_colorFilter);
 
-    // Set the bloom texture uniform
-    m_composeMaterial->SetUniformValue("BloomTexture", m_tempTextures[0]);
+    unsigned int composePass = m_renderGraph.AddPass(std::make_unique<PostFXRenderPass>(m_composeMaterial, m_renderer.GetDefaultFramebuffer()));
+    m_renderGraph.AddRead(composePass, sceneTexture);
+    m_renderGraph.AddRead(composePass, blurTexture);
+    sourceTextures.emplace_back(m_composeMaterial, sceneTexture);
+
+    // Create the textures and add the passes to the renderer
+    m_renderGraph.Compile(m_renderer);
+
+    // Set the g-buffer textures as properties of the deferred material
+    m_deferredMaterial->SetUniformValue("DepthTexture", m_renderGraph.GetTexture(depthTexture));
+    m_deferredMaterial->SetUniformValue("AlbedoTexture", m_renderGraph.GetTexture(albedoTexture));
+    m_deferredMaterial->SetUniformValue("NormalTexture", m_renderGraph.GetTexture(normalTexture));
+    m_deferredMaterial->SetUniformValue("OthersTexture", m_renderGraph.GetTexture(othersTexture));
+    transparentCompositeMaterial->SetUniformValue("AccumulationTexture", m_renderGraph.GetTexture(accumulationTexture));
+    transparentCompositeMaterial->SetUniformValue("CoverageTexture", m_renderGraph.GetTexture(coverageTexture));
+
+    // Set the source textures of the post FX materials
+    for (const auto& [material, texture] : sourceTextures)
+    {
+        material->SetUniformValue("SourceTexture", m_renderGraph.GetTexture(texture));
+    }
 
-    m_renderer.AddRenderPass(std::make_unique<PostFXRenderPass>(m_composeMaterial, m_renderer.GetDefaultFramebuffer()));
+    // Set the bloom texture uniform
+    m_composeMaterial->SetUniformValue("BloomTexture", m_renderGraph.GetTexture(blurTexture));
 }
 
 std::shared_ptr<Material> PostFXSceneViewerApplication::CreatePostFXMaterial(const char* fragmentShaderPath, std::shared_ptr<Texture2DObject> sourceTexture)
@@ -410,9 +543,8 @@ void PostFXSceneViewerApplication::RenderGUI()
 {
     m_imGui.BeginFrame();
 
-    // Draw GUI for scene nodes, using the visitor pattern
-    ImGuiSceneVisitor imGuiVisitor(m_imGui, "Scene");
-    m_scene.AcceptVisitor(imGuiVisitor);
+    // Draw GUI for scene nodes. Nodes are only visited again when the scene changes
+    m_imGuiSceneVisitor.Draw(m_scene);
 
     // Draw GUI for camera controller
     m_cameraController.DrawGUI(m_imGui);
@@ -456,6 +588,48 @@ void PostFXSceneViewerApplication::RenderGUI()
                 m_bloomMaterial->SetUniformValue("Intensity", m_bloomIntensity);
             }
         }
+
+        ImGui::Separator();
+
+        // Render targets created by the render graph
+        const RenderGraph::Stats& renderGraphStats = m_renderGraph.GetStats();
+        const float megabyte = 1024.0f * 1024.0f;
+        ImGui::Text("Passes: %u (%u culled)", renderGraphStats.passCount, renderGraphStats.culledPassCount);
+        ImGui::Text("Render targets: %u in %u textures", renderGraphStats.textureCount, renderGraphStats.physicalTextureCount);
+        ImGui::Text("Render target memory: %.1f MB (%.1f MB without aliasing)",
+            renderGraphStats.aliasedMemory / megabyte, renderGraphStats.unaliasedMemory / megabyte);
+    }
+
+    if (auto window = m_imGui.UseWindow("Shadows"))
+    {
+        if (m_shadowRenderPass)
+        {
+            float shadowDistance = m_shadowRenderPass->GetShadowDistance();
+            if (ImGui::DragFloat("Shadow Distance", &shadowDistance, 0.5f, 1.0f, 1000.0f))
+            {
+                m_shadowRenderPass->SetShadowDistance(shadowDistance);
+            }
+            float splitLambda = m_shadowRenderPass->GetCascadeSplitLambda();
+            if (ImGui::SliderFloat("Cascade Split", &splitLambda, 0.0f, 1.0f))
+            {
+                m_shadowRenderPass->SetCascadeSplitLambda(splitLambda);
+            }
+            glm::vec2 depthBias = m_shadowRenderPass->GetDepthBias();
+            if (ImGui::DragFloat2("Depth Bias", &depthBias[0], 0.1f, 0.0f, 16.0f))
+            {
+                m_shadowRenderPass->SetDepthBias(depthBias);
+            }
+
+            ImGui::Separator();
+
+            // Cache of the static casters in the last frame
+            const ShadowRenderPass::Stats& shadowStats = m_shadowRenderPass->GetStats();
+            ImGui::Text("Tiles: %u (%u lights dropped)", shadowStats.tileCount, shadowStats.droppedLightCount);
+            ImGui::Text("Static tiles: %u rendered, %u cached", shadowStats.staticRenderedTileCount, shadowStats.staticCachedTileCount);
+            ImGui::Text("Drawcalls: %u static, %u dynamic, %u saved",
+                shadowStats.staticDrawcallCount, shadowStats.dynamicDrawcallCount, shadowStats.savedDrawcallCount);
+            ImGui::Text("Static CPU time: %.3f ms (%.3f ms saved)", shadowStats.staticRenderTime, shadowStats.savedTime);
+        }
     }
 
     m_imGui.EndFrame();
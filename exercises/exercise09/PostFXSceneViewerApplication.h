@@ -3,15 +3,16 @@
 #include <ituGL/application/Application.h>
 
 #include <ituGL/scene/Scene.h>
-#include <ituGL/texture/FramebufferObject.h>
 #include <ituGL/renderer/Renderer.h>
+#include <ituGL/renderer/RenderGraph.h>
 #include <ituGL/camera/CameraController.h>
 #include <ituGL/utils/DearImGui.h>
-#include <array>
+#include <ituGL/scene/ImGuiSceneVisitor.h>
 
 class Texture2DObject;
 class TextureCubemapObject;
 class Material;
+class ShadowRenderPass;
 
 class PostFXSceneViewerApplication : public Application
 {
@@ -29,7 +30,6 @@ private:
     void InitializeLights();
     void InitializeMaterials();
     void InitializeModels();
-    void InitializeFramebuffers();
     void InitializeRenderer();
 
     std::shared_ptr<Material> CreatePostFXMaterial(const char* fragmentShaderPath, std::shared_ptr<Texture2DObject> sourceTexture = nullptr);
@@ -42,6 +42,9 @@ private:
     // Helper object for debug GUI
     DearImGui m_imGui;
 
+    // Inspector of the scene nodes, kept between frames
+    ImGuiSceneVisitor m_imGuiSceneVisitor;
+
     // Camera controller
     CameraController m_cameraController;
 
@@ -51,22 +54,22 @@ private:
     // Renderer
     Renderer m_renderer;
 
+    // Render graph that creates the render targets of the passes
+    RenderGraph m_renderGraph;
+
+    // Shadow atlas pass, owned by the renderer
+    ShadowRenderPass* m_shadowRenderPass;
+
     // Skybox texture
     std::shared_ptr<TextureCubemapObject> m_skyboxTexture;
 
     // Materials
     std::shared_ptr<Material> m_defaultMaterial;
+    std::shared_ptr<Material> m_transparentMaterial;
     std::shared_ptr<Material> m_deferredMaterial;
     std::shared_ptr<Material> m_composeMaterial;
     std::shared_ptr<Material> m_bloomMaterial;
 
-    // Framebuffers
-    std::shared_ptr<FramebufferObject> m_sceneFramebuffer;
-    std::shared_ptr<Texture2DObject> m_depthTexture;
-    std::shared_ptr<Texture2DObject> m_sceneTexture;
-    std::array<std::shared_ptr<FramebufferObject>, 2> m_tempFramebuffers;
-    std::array<std::shared_ptr<Texture2DObject>, 2> m_tempTextures;
-
     // Configuration values
     float m_exposure;
     float m_contrast;
@@ -5,6 +5,12 @@ uniform vec3 LightPosition;
 uniform vec3 LightDirection;
 uniform vec4 LightAttenuation;
 
+// Tiles of the light in the shadow atlas, one per cascade. Lights without shadows have no tiles
+uniform sampler2DShadow ShadowAtlas;
+uniform int LightShadowCount;
+uniform mat4 LightShadowMatrices[4];
+uniform vec4 LightShadowRects[4];
+
 float ComputeDistanceAttenuation(vec3 position)
 {
 	// Compute distance attenuation, reading the range from LightAttenuation.x (fade start) and LightAttenuation.y (fade end)
@@ -32,6 +38,36 @@ float ComputeAttenuation(vec3 position, vec3 lightDir)
 	return attenuation;
 }
 
+float ComputeShadow(vec3 position)
+{
+	// The first tile that contains the position is the most detailed one
+	for (int i = 0; i < LightShadowCount; ++i)
+	{
+		vec4 shadowCoord = LightShadowMatrices[i] * vec4(position, 1);
+		vec3 coord = shadowCoord.xyz / shadowCoord.w;
+		if (all(greaterThan(coord, vec3(0))) && all(lessThan(coord, vec3(1))))
+		{
+			// 3x3 PCF, clamped so the samples don't read the neighbour tiles
+			vec4 rect = LightShadowRects[i];
+			vec2 texelSize = 1.0f / vec2(textureSize(ShadowAtlas, 0));
+			vec2 minTexCoord = rect.xy + 0.5f * texelSize;
+			vec2 maxTexCoord = rect.xy + rect.zw - 0.5f * texelSize;
+			vec2 texCoord = rect.xy + coord.xy * rect.zw;
+			float shadow = 0.0f;
+			for (int y = -1; y <= 1; ++y)
+			{
+				for (int x = -1; x <= 1; ++x)
+				{
+					vec2 sampleTexCoord = clamp(texCoord + vec2(x, y) * texelSize, minTexCoord, maxTexCoord);
+					shadow += textureLod(ShadowAtlas, vec3(sampleTexCoord, coord.z), 0);
+				}
+			}
+			return shadow / 9.0f;
+		}
+	}
+	return 1.0f;
+}
+
 vec3 ComputeLightDirection(vec3 position)
 {
 	return LightAttenuation.y >= 0 ? GetDirection(position, LightPosition) : -LightDirection;
@@ -45,7 +81,7 @@ vec3 ComputeLight(SurfaceData data, vec3 viewDir, vec3 position)
 	vec3 specular = ComputeSpecularLighting(data, lightDir, viewDir);
 	vec3 light = CombineLighting(diffuse, specular, data, lightDir, viewDir);
 
-	float attenuation = ComputeAttenuation(position, lightDir);
+	float attenuation = ComputeAttenuation(position, lightDir) * ComputeShadow(position);
 	return light * LightColor * attenuation;
 }
 
@@ -0,0 +1,23 @@
+//Inputs
+in vec2 TexCoord;
+
+//Outputs
+out vec4 FragColor;
+
+//Uniforms
+uniform sampler2D AccumulationTexture;
+uniform sampler2D CoverageTexture;
+
+void main()
+{
+	// Pixels without transparent layers keep the opaque color
+	float coverage = texture(CoverageTexture, TexCoord).r;
+	if (coverage <= 0.0f)
+		discard;
+
+	// Weighted average of the premultiplied colors of all the layers
+	vec4 accumulation = texture(AccumulationTexture, TexCoord);
+	vec3 color = accumulation.rgb / max(accumulation.a, 0.00001f);
+
+	FragColor = vec4(color, coverage);
+}
@@ -0,0 +1,33 @@
+//Inputs
+in vec3 ViewNormal;
+in vec3 ViewTangent;
+in vec3 ViewBitangent;
+in vec2 TexCoord;
+
+//Outputs, for weighted blended transparency
+layout (location = 0) out vec4 FragAccumulation;
+layout (location = 1) out vec4 FragCoverage;
+
+//Uniforms
+uniform vec3 Color;
+uniform float Alpha;
+uniform sampler2D ColorTexture;
+
+// Weight of the layer, larger for closer and more opaque layers (McGuire and Bavoil, equation 10)
+float ComputeTransparencyWeight(float alpha, float depth)
+{
+	float weight = pow(min(1.0f, alpha * 10.0f) + 0.01f, 3.0f) * 1e8f * pow(1.0f - depth * 0.9f, 3.0f);
+	return clamp(weight, 1e-2f, 3e3f);
+}
+
+void main()
+{
+	// Unlit, with the faces seen at grazing angles more opaque
+	vec3 viewNormal = normalize(ViewNormal);
+	float alpha = clamp(Alpha + (1.0f - Alpha) * pow(1.0f - abs(viewNormal.z), 5.0f), 0.0f, 1.0f);
+	vec3 color = Color * texture(ColorTexture, TexCoord).rgb;
+
+	float weight = ComputeTransparencyWeight(alpha, gl_FragCoord.z);
+	FragAccumulation = vec4(color * alpha, alpha) * weight;
+	FragCoverage = vec4(alpha);
+}
@@ -13,6 +13,10 @@ public:
         ArrayBuffer = GL_ARRAY_BUFFER,
         // Element Buffer Object
         ElementArrayBuffer = GL_ELEMENT_ARRAY_BUFFER,
+        // Shader Storage Buffer Object (GL 4.3)
+        ShaderStorageBuffer = GL_SHADER_STORAGE_BUFFER,
+        // Draw Indirect Buffer (GL 4.0)
+        DrawIndirectBuffer = GL_DRAW_INDIRECT_BUFFER,
         // TODO: There are more types, add them when they are supported
     };
 
@@ -58,6 +62,10 @@ public:
     // Modify the contents of the buffer, starting at offset
     void UpdateData(std::span<const std::byte> data, size_t offset = 0);
 
+    // Bind the buffer to an indexed binding point of the target, for example a shader storage block binding
+    // The buffer doesn't need to be of the same target, the same data can be read in different ways
+    void BindBase(Target target, GLuint index) const;
+
 protected:
     // Bind the specific target. Used by the Bind() method in derived classes
     void Bind(Target target) const;
@@ -2,14 +2,26 @@
 
 #include <ituGL/core/Color.h>
 #include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <unordered_map>
+#include <array>
 
 class Window;
 struct GLFWwindow;
 
 // Class that represent the device where we run OpenGL
 // Implemented as a Singleton pattern, as there can only be one
+// It keeps a copy of the pipeline state, so calls that would not change the state don't reach the driver
 class DeviceGL
 {
+public:
+    // Number of state calls sent to the driver and filtered by the state cache
+    struct StateStats
+    {
+        unsigned int issuedCalls = 0;
+        unsigned int filteredCalls = 0;
+    };
+
 public:
     DeviceGL();
     ~DeviceGL();
@@ -23,11 +35,25 @@ public:
     // Check if device is initialized
     inline bool IsReady() const { return m_contextLoaded; }
 
+    // Check if the context supports, at least, the OpenGL version
+    bool IsVersionSupported(int major, int minor) const;
+
     // Set the window that OpenGL will use for rendering
     void SetCurrentWindow(Window &window);
 
+    // Read the version of the current context. SetCurrentWindow calls it, contexts made current without a window need it
+    void UpdateVersion();
+
     // Set the dimensions of the viewport
     void SetViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    // Get the dimensions of the current viewport
+    void GetViewport(GLint& x, GLint& y, GLsizei& width, GLsizei& height) const;
+
+    // Set the rectangle of the scissor test, enabled with GL_SCISSOR_TEST
+    void SetScissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    // Set the faces removed by GL_CULL_FACE: GL_FRONT, GL_BACK or GL_FRONT_AND_BACK
+    void SetCullFace(GLenum face);
 
     // Poll the events in the window event queue
     void PollEvents();
@@ -52,10 +78,116 @@ public:
     // enable / disable v-sync
     void SetVSyncEnabled(bool enabled);
 
+    // Set the test function for depth
+    void SetDepthFunction(GLenum function);
+    // Set if depth test writes to the depth buffer
+    void SetDepthWrite(bool depthWrite);
+    // Set if the color buffers are written, all the channels at once
+    void SetColorWrite(bool colorWrite);
+    // Set the depth offset of the polygons, enabled with GL_POLYGON_OFFSET_FILL
+    void SetPolygonOffset(GLfloat factor, GLfloat units);
+
+    // Set the stencil test function. Face can be GL_FRONT, GL_BACK or GL_FRONT_AND_BACK
+    void SetStencilFunction(GLenum face, GLenum function, GLint refValue, GLuint mask);
+    // Set the stencil operations. Face can be GL_FRONT, GL_BACK or GL_FRONT_AND_BACK
+    void SetStencilOperations(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+
+    // Set the blend equation for color and alpha
+    void SetBlendEquation(GLenum equationColor, GLenum equationAlpha);
+    // Set the blend parameters for color and alpha
+    void SetBlendFunction(GLenum sourceColor, GLenum destColor, GLenum sourceAlpha, GLenum destAlpha);
+    // Set the blend parameters of one draw buffer (GL 4.0). The cached parameters of all the buffers are unknown after it
+    void SetBlendFunction(GLuint drawBuffer, GLenum sourceColor, GLenum destColor, GLenum sourceAlpha, GLenum destAlpha);
+    // Set the blend color used by constant color and constant alpha parameters
+    void SetBlendColor(const Color& color);
+
+    // Set the shader program in use
+    void UseProgram(GLuint program);
+    // Bind the vertex array object
+    void BindVertexArray(GLuint vertexArray);
+    // Bind a buffer to the target
+    void BindBuffer(GLenum target, GLuint buffer);
+    // Bind a buffer to an indexed binding point of the target. It also binds the generic target
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    // Bind a framebuffer to the target (GL_FRAMEBUFFER binds both draw and read)
+    void BindFramebuffer(GLenum target, GLuint framebuffer);
+    // Set the texture unit affected by BindTexture
+    void SetActiveTexture(GLint textureUnit);
+    inline GLint GetActiveTexture() const { return m_activeTexture; }
+    // Bind a texture to the target in the active texture unit
+    void BindTexture(GLenum target, GLuint texture);
+
+    // Deleted objects are unbound by OpenGL, and their handles can be reused. Called when deleting them
+    void ForgetProgram(GLuint program);
+    void ForgetVertexArray(GLuint vertexArray);
+    void ForgetBuffer(GLuint buffer);
+    void ForgetFramebuffer(GLuint framebuffer);
+    void ForgetTexture(GLuint texture);
+
+    // Mark all the cached state as unknown, so the next calls are sent to the driver
+    // Required if OpenGL state is changed directly, without using the device
+    void InvalidateState();
+
+    // Get the state call counters of the last completed frame
+    inline const StateStats& GetStateStats() const { return m_lastFrameStateStats; }
+
+    // Complete the current frame, storing and resetting the per-frame counters
+    void EndFrame();
+
+private:
+    // Store the value if it changed and count the call. Returns true if the call has to be sent to the driver
+    template<typename T>
+    bool UpdateState(T& state, const T& value);
+
+    // Index of the targets that are cached. -1 if not cached
+    static int GetBufferTargetIndex(GLenum target);
+    static int GetTextureTargetIndex(GLenum target);
+
+    // Value used for the state that is not known
+    static const GLuint UnknownState = ~0u;
+
+    // Number of texture units that are cached
+    static const int CachedTextureUnits = 32;
+
 private:
     // Has a context been loaded? We use the context of the current window
     bool m_contextLoaded;
 
+    // Version of the context
+    GLint m_majorVersion;
+    GLint m_minorVersion;
+
+    // Cached state of the features, queried from OpenGL the first time if needed
+    mutable std::unordered_map<GLenum, bool> m_features;
+
+    // Depth state
+    GLenum m_depthFunction;
+    GLuint m_depthWrite;
+
+    // Color write mask, the same for all the channels
+    GLuint m_colorWrite;
+
+    // Stencil state for front and back faces: function, ref value, mask, stencil fail, depth fail, depth pass
+    std::array<std::array<GLuint, 6>, 2> m_stencilState;
+
+    // Blend state
+    std::array<GLenum, 2> m_blendEquations;
+    std::array<GLenum, 4> m_blendParams;
+    glm::vec4 m_blendColor;
+
+    // Bound objects
+    GLuint m_program;
+    GLuint m_vertexArray;
+    std::array<GLuint, 4> m_buffers;
+    GLuint m_drawFramebuffer;
+    GLuint m_readFramebuffer;
+    GLint m_activeTexture;
+    std::array<std::array<GLuint, 4>, CachedTextureUnits> m_textures;
+
+    // State call counters
+    StateStats m_frameStateStats;
+    StateStats m_lastFrameStateStats;
+
 private:
     // Singleton instance
     static DeviceGL* m_instance;
@@ -63,3 +195,16 @@ private:
     // Callback called when the framebuffer changes size
     static void FrameBufferResized(GLFWwindow* window, GLsizei width, GLsizei height);
 };
+
+template<typename T>
+bool DeviceGL::UpdateState(T& state, const T& value)
+{
+    if (state == value)
+    {
+        m_frameStateStats.filteredCalls++;
+        return false;
+    }
+    state = value;
+    m_frameStateStats.issuedCalls++;
+    return true;
+}
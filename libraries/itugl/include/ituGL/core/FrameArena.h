@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <type_traits>
+#include <cstddef>
+
+// Linear allocator for data that only lives for a frame
+// Allocations just move a pointer forward, and all of them are released together when the frame begins again
+// It keeps two frames, so the data of the previous frame is still valid while the next one is built
+// Not thread-safe
+class FrameArena
+{
+public:
+    // Memory usage, to size the arena for a scene
+    struct Stats
+    {
+        // Bytes allocated in the current frame
+        size_t usedBytes = 0;
+        // Maximum bytes allocated in a single frame
+        size_t highWaterMark = 0;
+        // Bytes reserved for the current frame
+        size_t capacity = 0;
+        // Number of blocks requested to the heap. It stops growing once the capacity is enough
+        unsigned int heapAllocations = 0;
+    };
+
+public:
+    FrameArena(size_t capacity = DefaultCapacity);
+
+    // Allocate memory for the current frame. It is valid until this frame begins again, two frames later
+    void* Allocate(size_t size, size_t alignment);
+
+    // Switch to the other frame, releasing everything that was allocated there
+    void BeginFrame();
+
+    // Make sure each frame has, at least, this capacity. Applied when each frame begins
+    void Reserve(size_t capacity);
+
+    const Stats& GetStats() const { return m_stats; }
+
+public:
+    static const size_t DefaultCapacity = 1 << 20;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    struct Frame
+    {
+        // Blocks after the first one are only created when the frame runs out of memory
+        std::vector<Block> blocks;
+        size_t offset = 0;
+        size_t usedBytes = 0;
+    };
+
+    // Add a block of at least size bytes at the end of the frame
+    void AddBlock(Frame& frame, size_t size);
+
+private:
+    Frame m_frames[2];
+    unsigned int m_currentFrame;
+    size_t m_reservedCapacity;
+
+    Stats m_stats;
+};
+
+// Allocator for standard containers, using the FrameArena
+// Memory is never freed individually, so containers must be recreated after the frame begins
+template<typename T>
+class FrameAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    FrameAllocator(FrameArena& arena) : m_arena(&arena) {}
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : m_arena(&other.GetArena()) {}
+
+    FrameArena& GetArena() const { return *m_arena; }
+
+    T* allocate(size_t count) { return static_cast<T*>(m_arena->Allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator == (const FrameAllocator<U>& other) const { return m_arena == &other.GetArena(); }
+
+private:
+    FrameArena* m_arena;
+};
+
+// Containers allocated in the FrameArena
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+template<typename K, typename V, typename H = std::hash<K>>
+using FrameUnorderedMap = std::unordered_map<K, V, H, std::equal_to<K>, FrameAllocator<std::pair<const K, V>>>;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+// Threads that run the ranges of parallel jobs
+// The threads are created the first time a job needs them, and then they wait for the next jobs,
+// so running a job doesn't create threads or allocate memory. Jobs must be started from a single thread
+class WorkerPool
+{
+public:
+    // Function called for each range, with the context of the job
+    using RangeFunction = void(*)(void* context, size_t threadIndex, size_t begin, size_t end);
+
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator = (const WorkerPool&) = delete;
+
+    // Threads created so far, without the calling thread
+    size_t GetWorkerCount() const { return m_workers.size(); }
+
+    // Split itemCount items in contiguous ranges, one per thread, and wait until all of them are done
+    // The calling thread takes the first range, the workers take the others
+    template<typename TFunction>
+    void Run(size_t itemCount, size_t threadCount, TFunction&& function);
+    void Run(size_t itemCount, size_t threadCount, RangeFunction function, void* context);
+
+private:
+    // Wait for the jobs after the generation, and run their ranges
+    void WorkerMain(std::stop_token stopToken, size_t threadIndex, uint64_t generation);
+
+    // Run the range of a thread in the current job
+    void RunRange(size_t threadIndex) const;
+
+private:
+    std::vector<std::jthread> m_workers;
+
+    std::mutex m_mutex;
+    // Signaled when a job starts, and when the workers have to stop
+    std::condition_variable_any m_startCondition;
+    // Signaled when the last worker finishes its range
+    std::condition_variable m_doneCondition;
+
+    // Current job. The generation changes with each job, so each worker runs it once
+    uint64_t m_generation;
+    size_t m_itemCount;
+    size_t m_threadCount;
+    RangeFunction m_function;
+    void* m_context;
+    // Workers that have not finished their range yet
+    size_t m_pendingCount;
+};
+
+template<typename TFunction>
+void WorkerPool::Run(size_t itemCount, size_t threadCount, TFunction&& function)
+{
+    // The function is called through a plain function pointer, without copying it
+    using Function = std::remove_reference_t<TFunction>;
+    Run(itemCount, threadCount, [](void* context, size_t threadIndex, size_t begin, size_t end)
+        {
+            (*static_cast<Function*>(context))(threadIndex, begin, end);
+        }, const_cast<void*>(static_cast<const void*>(&function)));
+}
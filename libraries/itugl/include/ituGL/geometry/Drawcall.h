@@ -23,17 +23,48 @@ public:
         Patches = GL_PATCHES
     };
 
+    // Parameters of a drawcall stored in a DrawIndirectBufferObject
+    // Same size for arrays and elements, so both can be stored in the same buffer
+    struct IndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        // For arrays, this is the base instance, and the last value is not used
+        GLuint baseVertex;
+        GLuint baseInstance;
+    };
+
 public:
     Drawcall();
     Drawcall(Primitive primitive, GLsizei count, GLint first = 0);
     Drawcall(Primitive primitive, GLsizei count, Data::Type eboType, GLint first = 0);
 
     // Check if the drawcall is valid
-    inline bool IsValid() const { return m_primitive != Primitive::Invalid && m_count > 0; }
+    inline bool IsValid() const { return m_primitive != Primitive::Invalid && m_count > 0 && m_instanceCount > 0; }
+
+    inline Primitive GetPrimitive() const { return m_primitive; }
+    inline GLint GetFirst() const { return m_first; }
+    inline GLsizei GetCount() const { return m_count; }
+    inline Data::Type GetEBOType() const { return m_eboType; }
+
+    // Number of instances rendered. If more than 1, the instanced version of the drawcall is used
+    inline GLsizei GetInstanceCount() const { return m_instanceCount; }
+    void SetInstanceCount(GLsizei instanceCount);
+
+    // Number of triangles rendered by each instance. 0 for points, lines and patches
+    GLsizei GetTriangleCount() const;
 
     // Execute the drawcall
     void Draw() const;
 
+    // Get the parameters of the drawcall to be executed indirectly, with the given base instance
+    IndirectCommand GetIndirectCommand(GLuint baseInstance) const;
+
+    // Execute commandCount drawcalls stored in the bound DrawIndirectBufferObject, starting at commandOffset
+    // All of them share the same primitive and EBO type (GL 4.3)
+    static void DrawIndirect(Primitive primitive, Data::Type eboType, GLsizei commandCount, GLsizei commandOffset = 0);
+
 private:
     // Type of primitive to be rendered
     Primitive m_primitive;
@@ -46,4 +77,7 @@ private:
 
     // Data type of the elements in the EBO (int, uint, short, byte, etc.). A value of None means no EBO
     Data::Type m_eboType;
+
+    // Number of instances that we want to render
+    GLsizei m_instanceCount;
 };
@@ -6,6 +6,7 @@
 #include <ituGL/geometry/VertexAttribute.h>
 #include <ituGL/geometry/Drawcall.h>
 #include <ituGL/shader/ShaderProgram.h>
+#include <glm/vec3.hpp>
 #include <vector>
 #include <unordered_map>
 
@@ -116,6 +117,14 @@ public:
     // Draws a submesh
     void DrawSubmesh(int submeshIndex) const;
 
+    // Local bounds of the vertex positions. Meshes without bounds can't be culled
+    inline bool HasBounds() const { return m_boundsMin.x <= m_boundsMax.x; }
+    inline const glm::vec3& GetBoundsMin() const { return m_boundsMin; }
+    inline const glm::vec3& GetBoundsMax() const { return m_boundsMax; }
+
+    // Grow the local bounds to contain the box from min to max
+    void AddBounds(const glm::vec3& min, const glm::vec3& max);
+
 private:
 
     // Helper structure that contains a drawcall and its VAO to be bound
@@ -151,6 +160,10 @@ private:
 
     // Submeshes contained in this mesh
     std::vector<Submesh> m_submeshes;
+
+    // Local bounds of all the submeshes. Empty (min > max) until some bounds are added
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
 };
 
 template<typename T>
@@ -19,6 +19,21 @@ public:
 
     void SetMesh(std::shared_ptr<Mesh> mesh);
 
+    // Meshes with less detail, used when the model is small on screen. LOD 0 is the mesh of the model
+    // The LOD is used when the screen size, the fraction of the viewport height covered by the bounds, is below screenSize
+    // Screen sizes must decrease with each LOD. All the LODs use the same materials, so they must have the same submeshes
+    // Returns the index of the new LOD
+    unsigned int AddLod(std::shared_ptr<Mesh> mesh, float screenSize);
+    void ClearLods();
+
+    inline unsigned int GetLodCount() const { return static_cast<unsigned int>(m_lods.size()) + 1; }
+    const Mesh& GetLodMesh(unsigned int lod) const;
+    float GetLodScreenSize(unsigned int lod) const;
+
+    // Get the LOD for the screen size. The thresholds are moved away from currentLod by hysteresis (a fraction of them),
+    // so the LOD only changes when the size changes enough, and objects near a threshold don't switch every frame
+    unsigned int SelectLod(float screenSize, unsigned int currentLod = 0, float hysteresis = 0.0f) const;
+
     unsigned int GetMaterialCount();
 
     Material& GetMaterial(unsigned int index);
@@ -36,10 +51,21 @@ public:
     // Draw all the submeshes of the mesh, each one with a material on the list
     void Draw();
 
+public:
+    static const unsigned int MaxLodCount = 8;
+
 private:
     // Pointer to the model Mesh
     std::shared_ptr<Mesh> m_mesh;
 
+    // Additional LODs, from LOD 1
+    struct Lod
+    {
+        std::shared_ptr<Mesh> mesh;
+        float screenSize;
+    };
+    std::vector<Lod> m_lods;
+
     // List of material pointers, one for each submesh
     std::vector<std::shared_ptr<Material>> m_materials;
 };
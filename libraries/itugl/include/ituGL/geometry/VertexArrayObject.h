@@ -25,7 +25,13 @@ public:
     // Sets what VertexAttribute is assigned to location, and how to access the data:
     // offset: where to start looking in the buffer
     // stride: how far each element is from the previous one. Default value 0 will use the attribute size
-    void SetAttribute(GLuint location, const VertexAttribute& attribute, GLint offset, GLsizei stride = 0);
+    void SetAttribute(GLuint location, const VertexAttribute& attribute, GLint offset, GLsizei stride = 0) const;
+
+    // Disables the VertexAttribute in location, so it reads a constant value instead of the buffer
+    void DisableAttribute(GLuint location) const;
+
+    // Sets how often the attribute in location advances: 0 for every vertex, N for every N instances
+    void SetAttributeDivisor(GLuint location, GLuint divisor) const;
 
 #ifndef NDEBUG
     // Check if there is any VertexArrayObject currently bound
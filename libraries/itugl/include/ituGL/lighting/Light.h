@@ -3,6 +3,8 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+class SphereBounds;
+
 class Light
 {
 public:
@@ -29,6 +31,9 @@ public:
 
     virtual glm::vec4 GetAttenuation() const;
 
+    // Sphere that contains all the points reached by the light. Returns false for lights without range, that reach everything
+    virtual bool GetInfluenceBounds(SphereBounds& bounds) const;
+
     glm::vec3 GetColor() const;
     void SetColor(const glm::vec3& color);
 
@@ -16,6 +16,8 @@ public:
 
     glm::vec4 GetAttenuation() const override;
 
+    bool GetInfluenceBounds(SphereBounds& bounds) const override;
+
     glm::vec2 GetDistanceAttenuation() const;
     void SetDistanceAttenuation(glm::vec2 attenuation);
 
@@ -20,6 +20,8 @@ public:
 
     glm::vec4 GetAttenuation() const override;
 
+    bool GetInfluenceBounds(SphereBounds& bounds) const override;
+
     float GetAngle() const;
     void SetAngle(float angle);
 
@@ -4,21 +4,95 @@
 
 #include <ituGL/shader/ShaderProgram.h>
 #include <ituGL/geometry/Mesh.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 #include <memory>
+#include <cstdint>
 
 class Texture2DObject;
 class Material;
+class Light;
+class Camera;
 
+// Adds the lighting of each light to the pixels of the g-buffer
+// The material gets the screen position from gl_FragCoord, so the lights can be drawn with any geometry
+// Proxies need the g-buffer depth in the depth-stencil of the target framebuffer, that is read but not written.
+// The target can share the depth-stencil attachment of the g-buffer, or get a copy of it with SetDepthFramebuffer.
+// With another depth, the proxies mark the wrong pixels, and with a cleared depth they shade none
 class DeferredRenderPass: public RenderPass
 {
+public:
+    // How the lights with a range, like point and spot lights, are drawn
+    // Directional lights, and the first pass with the indirect lighting, always use a fullscreen triangle
+    enum class LightVolumeMode
+    {
+        // Fullscreen triangle
+        Fullscreen,
+        // Fullscreen triangle, with the scissor test limited to the screen rectangle of the light
+        Scissor,
+        // Sphere or cone around the light, marking the pixels inside it in the stencil, then shading them with its back faces
+        // Lights smaller than MinProxyPixelCount on screen use Scissor
+        Proxy,
+    };
+
+    // Lights drawn in the last Render
+    struct Stats
+    {
+        unsigned int fullscreenCount = 0;
+        unsigned int scissorCount = 0;
+        unsigned int proxyCount = 0;
+        // Lights outside of the screen, not drawn
+        unsigned int culledCount = 0;
+        // Pixels covered by the fullscreen triangles and the screen rectangles of the lights
+        // Upper bound of the shaded pixels, proxies only shade the pixels inside their volume
+        uint64_t shadedPixelCount = 0;
+    };
+
 public:
     DeferredRenderPass(std::shared_ptr<Material> material, std::shared_ptr<const FramebufferObject> targetFramebuffer = nullptr);
 
+    LightVolumeMode GetLightVolumeMode() const { return m_lightVolumeMode; }
+    void SetLightVolumeMode(LightVolumeMode lightVolumeMode) { m_lightVolumeMode = lightVolumeMode; }
+
+    // The proxy mesh costs more vertices than the fullscreen triangle, so it only pays off for lights big enough on screen
+    unsigned int GetMinProxyPixelCount() const { return m_minProxyPixelCount; }
+    void SetMinProxyPixelCount(unsigned int minProxyPixelCount) { m_minProxyPixelCount = minProxyPixelCount; }
+
+    // Framebuffer with the g-buffer depth, copied to the depth of the target before the lights are drawn
+    // Both depth-stencil formats must be the same. Not needed if the target already has the g-buffer depth
+    std::shared_ptr<const FramebufferObject> GetDepthFramebuffer() const { return m_depthFramebuffer; }
+    void SetDepthFramebuffer(std::shared_ptr<const FramebufferObject> depthFramebuffer) { m_depthFramebuffer = depthFramebuffer; }
+
+    const Stats& GetStats() const { return m_stats; }
+
     void Render() override;
 
+    // Screen rectangle (x, y, width, height) in pixels that contains the sphere, in view space
+    // Returns false if the sphere is outside of the screen
+    static bool ComputeScissorRect(const glm::vec3& viewCenter, float radius, const glm::mat4& projMatrix,
+        const glm::ivec4& viewport, glm::ivec4& rect);
+
 private:
     void InitializeMeshes();
 
+    // Draw a light with a range, using its proxy mesh or its scissor rectangle
+    void DrawLightVolume(const Light& light, const Camera& camera, const glm::ivec4& viewport, const glm::mat4& fullscreenMatrix);
+
+    // World matrix of the proxy mesh of the light, and the mesh to use
+    const Mesh& GetProxyMesh(const Light& light, glm::mat4& worldMatrix) const;
+
 private:
     std::shared_ptr<Material> m_material;
+
+    std::shared_ptr<const FramebufferObject> m_depthFramebuffer;
+
+    LightVolumeMode m_lightVolumeMode;
+    unsigned int m_minProxyPixelCount;
+
+    // Unit sphere and unit cone, with the apex in the origin and the base in z = 1. Both contain the exact shape
+    Mesh m_sphereMesh;
+    Mesh m_coneMesh;
+
+    Stats m_stats;
 };
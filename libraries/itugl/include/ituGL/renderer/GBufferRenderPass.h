@@ -8,6 +8,8 @@ class GBufferRenderPass : public RenderPass
 {
 public:
     GBufferRenderPass(int width, int height, int drawcallCollectionIndex = 0);
+    // Render to an existing framebuffer, for example one assigned by a RenderGraph. The texture getters return nullptr
+    GBufferRenderPass(std::shared_ptr<const FramebufferObject> targetFramebuffer, int drawcallCollectionIndex = 0);
 
     void Render() override;
 
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+class Light;
+class WorkerPool;
+
+// Assigns lights to the clusters of a froxel grid: the view frustum split in tiles on screen, and in exponential slices in depth
+// Lights with a range are tested as spheres against the view space bounds of the clusters, 4 lights at a time with SIMD
+// Lights without range, like directional lights, are added to all the clusters
+// It only runs on the CPU, so it doesn't need a GL context
+class LightClusterGrid
+{
+public:
+    // Range of the light index list with the lights of a cluster
+    struct Cluster
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+public:
+    LightClusterGrid(unsigned int tileCountX = 16, unsigned int tileCountY = 9, unsigned int sliceCount = 24);
+
+    // Number of tiles in X and Y, and number of depth slices
+    inline const glm::uvec3& GetGridSize() const { return m_gridSize; }
+    void SetGridSize(const glm::uvec3& gridSize);
+
+    inline unsigned int GetClusterCount() const { return m_gridSize.x * m_gridSize.y * m_gridSize.z; }
+
+    // Clusters are stored by slice, then by row of tiles. Tile (0, 0) is in the bottom left corner of the screen
+    inline unsigned int GetClusterIndex(unsigned int tileX, unsigned int tileY, unsigned int slice) const
+    {
+        return (slice * m_gridSize.y + tileY) * m_gridSize.x + tileX;
+    }
+
+    // Pool that runs the slices of Build in parallel. Without a pool, Build runs in the calling thread
+    inline WorkerPool* GetWorkerPool() const { return m_workerPool; }
+    inline void SetWorkerPool(WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+    // Maximum number of threads of the pool used by Build. 0 uses all the hardware threads
+    inline unsigned int GetThreadCount() const { return m_threadCount; }
+    inline void SetThreadCount(unsigned int threadCount) { m_threadCount = threadCount; }
+
+    // Build the light lists of all the clusters for the view. The bounds of the clusters are only computed again if the projection changes
+    void Build(std::span<const Light* const> lights, const glm::mat4& viewMatrix, const glm::mat4& projMatrix);
+
+    // Slice of the grid is log(depth) * scale + bias, where depth is the view depth, between the near and far planes
+    inline const glm::vec2& GetDepthSliceScaleBias() const { return m_depthSliceScaleBias; }
+
+    // Slice that contains the view depth, clamped to the grid
+    unsigned int GetSlice(float depth) const;
+
+    // Light lists of the last Build, indexed by GetClusterIndex
+    inline std::span<const Cluster> GetClusters() const { return m_clusters; }
+
+    // Indices in the lights passed to Build, referenced by the clusters
+    inline std::span<const uint32_t> GetLightIndices() const { return m_lightIndices; }
+
+private:
+    // Lights with range that overlap the depth of a slice, in view space. One array per component, padded to a multiple of 4
+    struct SliceLights
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radiusSquared;
+        std::vector<uint32_t> lightIndices;
+
+        void Clear();
+        void Add(const glm::vec3& center, float radius, uint32_t lightIndex);
+        void Pad();
+    };
+
+    // View space bounds of a cluster
+    struct ClusterBounds
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    // Compute the depth slicing and the bounds of the clusters for the projection
+    void UpdateClusterBounds(const glm::mat4& projMatrix);
+
+    // Fill the clusters of the slices, appending their lights to lightIndices. Offsets start at 0
+    void AssignSlices(unsigned int sliceBegin, unsigned int sliceEnd, std::vector<uint32_t>& lightIndices);
+
+private:
+    glm::uvec3 m_gridSize;
+
+    WorkerPool* m_workerPool;
+    unsigned int m_threadCount;
+
+    // Projection used to compute the cluster bounds, and its near and far view depths
+    glm::mat4 m_projMatrix;
+    bool m_boundsDirty;
+    float m_nearDepth;
+    float m_farDepth;
+    glm::vec2 m_depthSliceScaleBias;
+
+    std::vector<ClusterBounds> m_clusterBounds;
+
+    // Lights of the current Build
+    std::vector<SliceLights> m_sliceLights;
+    std::vector<uint32_t> m_globalLightIndices;
+
+    std::vector<Cluster> m_clusters;
+    std::vector<uint32_t> m_lightIndices;
+
+    // Light indices of each thread, concatenated at the end of Build. Reused between builds
+    std::vector<std::vector<uint32_t>> m_threadLightIndices;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+class Light;
+class WorkerPool;
+
+// Finds the lights that reach each object, comparing the influence bounds of the lights with the world bounds of the objects
+// Light spheres are tested against the object boxes 4 lights at a time with SIMD, then spot lights are tested with their cone
+// Lights without range, like directional lights, reach all the objects
+// It only runs on the CPU, so it doesn't need a GL context
+class ObjectLightAssignment
+{
+public:
+    // Range of the light list with the lights of an object
+    struct LightRange
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // No limit in the number of lights per object
+    static const unsigned int Unlimited = ~0u;
+
+public:
+    ObjectLightAssignment();
+
+    // Maximum number of lights per object. Lights without range are kept first,
+    // then the lights with range that are brighter and closer to the object
+    inline unsigned int GetMaxLightCount() const { return m_maxLightCount; }
+    inline void SetMaxLightCount(unsigned int maxLightCount) { m_maxLightCount = maxLightCount; }
+
+    // Pool that runs the object ranges of Build in parallel. Without a pool, Build runs in the calling thread
+    inline WorkerPool* GetWorkerPool() const { return m_workerPool; }
+    inline void SetWorkerPool(WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+    // Maximum number of threads of the pool used by Build. 0 uses all the hardware threads
+    inline unsigned int GetThreadCount() const { return m_threadCount; }
+    inline void SetThreadCount(unsigned int threadCount) { m_threadCount = threadCount; }
+
+    // Assign the lights to the objects, given by the corners of their world space boxes
+    // Objects without bounds can use infinite corners, and get all the lights
+    void Build(std::span<const Light* const> lights, std::span<const glm::vec3> boundsMin, std::span<const glm::vec3> boundsMax);
+
+    inline unsigned int GetObjectCount() const { return static_cast<unsigned int>(m_objectLightRanges.size()); }
+
+    // Lights that reach the object in the last Build
+    std::span<const Light* const> GetObjectLights(unsigned int objectIndex) const;
+
+    // Lights in the list of at least one object in the last Build, in the order they were passed
+    inline std::span<const Light* const> GetAffectingLights() const { return m_affectingLights; }
+
+private:
+    // Cone of a spot light, opening from the apex along the axis
+    struct Cone
+    {
+        glm::vec3 apex;
+        glm::vec3 axis;
+        float range;
+        float cosAngle;
+        float sinAngle;
+    };
+
+    // Light with range reaching an object, with its priority when the list is too long
+    struct Candidate
+    {
+        uint32_t rangeLightIndex;
+        float priority;
+    };
+
+    // Assign the lights to a range of objects, with the offsets of their lists starting at 0
+    void AssignObjects(size_t objectBegin, size_t objectEnd, std::span<const glm::vec3> boundsMin, std::span<const glm::vec3> boundsMax,
+        std::vector<const Light*>& objectLights, std::vector<uint8_t>& lightsReached);
+
+private:
+    unsigned int m_maxLightCount;
+    WorkerPool* m_workerPool;
+    unsigned int m_threadCount;
+
+    // Lights of the current Build
+    std::span<const Light* const> m_lights;
+    std::vector<uint32_t> m_globalLightIndices;
+
+    // Influence spheres of the lights with range, one array per component, padded to a multiple of 4
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_radiusSquared;
+    std::vector<uint32_t> m_rangeLightIndices;
+    // Position and brightness of the lights with range, to prioritize them
+    std::vector<glm::vec3> m_rangeLightPositions;
+    std::vector<float> m_rangeLightBrightness;
+    // Index in m_cones of each light with range, or NoCone
+    std::vector<uint32_t> m_rangeLightCones;
+    std::vector<Cone> m_cones;
+
+    std::vector<LightRange> m_objectLightRanges;
+    std::vector<const Light*> m_objectLights;
+    std::vector<const Light*> m_affectingLights;
+
+    // Light lists and reached lights of each thread, merged at the end of Build. Reused between builds
+    std::vector<std::vector<const Light*>> m_threadObjectLights;
+    std::vector<std::vector<uint8_t>> m_threadLightsReached;
+};
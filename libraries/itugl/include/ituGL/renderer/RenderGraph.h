@@ -0,0 +1,125 @@
+#pragma once
+
+#include <ituGL/texture/TextureObject.h>
+#include <ituGL/texture/FramebufferObject.h>
+#include <vector>
+#include <memory>
+#include <string>
+
+class Renderer;
+class RenderPass;
+class Texture2DObject;
+
+// Builds the render passes of a frame from the textures they read and write
+// Passes that don't contribute to the output are culled, and transient textures share the same
+// texture object when their lifetimes don't overlap. Framebuffers are created for each pass
+class RenderGraph
+{
+public:
+    using ResourceId = unsigned int;
+    static const ResourceId InvalidResource = ~0u;
+
+    // Textures can share the same texture object only if their descriptions are equal
+    struct TextureDesc
+    {
+        int width;
+        int height;
+        TextureObject::Format format;
+        TextureObject::InternalFormat internalFormat;
+        GLint filter = GL_NEAREST;
+        GLint wrap = GL_CLAMP_TO_EDGE;
+
+        bool operator == (const TextureDesc& other) const = default;
+    };
+
+    // Result of the last Compile
+    struct Stats
+    {
+        unsigned int passCount = 0;
+        unsigned int culledPassCount = 0;
+        unsigned int textureCount = 0;
+        unsigned int physicalTextureCount = 0;
+        // Memory of the textures if each of them had its own texture object
+        size_t unaliasedMemory = 0;
+        // Memory of the texture objects that were created
+        size_t aliasedMemory = 0;
+    };
+
+public:
+    RenderGraph();
+    ~RenderGraph();
+
+    // Declare a transient texture. The texture object is assigned when the graph is compiled
+    ResourceId CreateTexture(const char* name, const TextureDesc& desc);
+    const char* GetTextureName(ResourceId texture) const;
+
+    // Add a pass. Passes without writes render to their own target framebuffer, and they are always kept
+    unsigned int AddPass(std::unique_ptr<RenderPass> renderPass);
+
+    // The pass samples the texture
+    void AddRead(unsigned int passIndex, ResourceId texture);
+    // The pass renders to the texture. If keepContents is false, the previous contents are discarded
+    void AddWrite(unsigned int passIndex, ResourceId texture, FramebufferObject::Attachment attachment, bool keepContents = false);
+
+    // Cull the passes, assign the texture objects, create the framebuffers, and add the passes to the renderer
+    // The graph can only be compiled once, the passes are moved to the renderer
+    void Compile(Renderer& renderer);
+
+    // Texture object assigned to a texture, available after Compile
+    std::shared_ptr<Texture2DObject> GetTexture(ResourceId texture) const;
+
+    const Stats& GetStats() const { return m_stats; }
+
+    // Approximate size in bytes of a texture with this description
+    static size_t GetMemorySize(const TextureDesc& desc);
+
+private:
+    struct Texture
+    {
+        std::string name;
+        TextureDesc desc;
+        // Index in m_physicalTextures, assigned by Compile
+        unsigned int physicalIndex;
+    };
+
+    struct Write
+    {
+        ResourceId texture;
+        FramebufferObject::Attachment attachment;
+        bool keepContents;
+    };
+
+    struct Pass
+    {
+        std::unique_ptr<RenderPass> renderPass;
+        std::vector<ResourceId> reads;
+        std::vector<Write> writes;
+        bool culled;
+    };
+
+    struct PhysicalTexture
+    {
+        TextureDesc desc;
+        std::shared_ptr<Texture2DObject> texture;
+        // Last pass that uses the texture object, it can be reused after it
+        unsigned int lastPassIndex;
+    };
+
+    // Mark the passes that contribute to the output, starting from the passes that are always kept
+    void CullPasses();
+
+    // Assign texture objects to the textures, reusing the ones that are free
+    void AssignPhysicalTextures();
+
+    // Create the framebuffer of a pass with the texture objects of its writes
+    std::shared_ptr<FramebufferObject> CreateFramebuffer(const Pass& pass) const;
+
+private:
+    std::vector<Texture> m_textures;
+    std::vector<Pass> m_passes;
+    std::vector<PhysicalTexture> m_physicalTextures;
+
+    bool m_compiled;
+
+    Stats m_stats;
+};
@@ -7,11 +7,30 @@ class FramebufferObject;
 
 class RenderPass
 {
+public:
+    // How the pass submits its drawcalls
+    enum class SubmissionMode
+    {
+        // One drawcall at a time, with its own uniforms
+        Direct,
+        // Per-object data in a shader storage buffer, and one indirect multi-drawcall per state bucket (GL 4.3)
+        // Drawcalls that can't be submitted this way use the direct path
+        Indirect
+    };
+
 public:
     RenderPass(std::shared_ptr<const FramebufferObject> targetFramebuffer = nullptr);
     virtual ~RenderPass();
 
     std::shared_ptr<const FramebufferObject> GetTargetFramebuffer() const;
+    void SetTargetFramebuffer(std::shared_ptr<const FramebufferObject> targetFramebuffer);
+
+    SubmissionMode GetSubmissionMode() const;
+    void SetSubmissionMode(SubmissionMode submissionMode);
+
+    // View of the renderer used as current camera while the pass renders. Its drawcall collections should use the same view
+    unsigned int GetViewIndex() const;
+    void SetViewIndex(unsigned int viewIndex);
 
     virtual void Render() = 0;
 
@@ -19,6 +38,9 @@ protected:
     Renderer& GetRenderer();
     const Renderer& GetRenderer() const;
 
+    // Check if the pass uses indirect submission, and the device supports it
+    bool IsIndirectSubmission() const;
+
 protected:
     std::shared_ptr<const FramebufferObject> m_targetFramebuffer;
 
@@ -28,4 +50,8 @@ private:
 
 private:
     Renderer* m_renderer;
+
+    SubmissionMode m_submissionMode;
+
+    unsigned int m_viewIndex;
 };
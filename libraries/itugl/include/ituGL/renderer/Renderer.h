@@ -1,16 +1,27 @@
 #pragma once
 
 #include <ituGL/core/DeviceGL.h>
+#include <ituGL/core/FrameArena.h>
+#include <ituGL/core/WorkerPool.h>
 #include <ituGL/renderer/RenderPass.h>
+#include <ituGL/renderer/LightClusterGrid.h>
+#include <ituGL/renderer/ObjectLightAssignment.h>
 #include <ituGL/geometry/Drawcall.h>
 #include <ituGL/geometry/Mesh.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/VertexBufferObject.h>
+#include <ituGL/geometry/DrawIndirectBufferObject.h>
 #include <ituGL/shader/Material.h>
+#include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 #include <vector>
 #include <unordered_map>
 #include <memory>
 #include <span>
+#include <array>
 #include <functional>
+#include <type_traits>
+#include <cstdint>
 
 class Camera;
 class Light;
@@ -24,6 +35,17 @@ class FramebufferObject;
 class Renderer
 {
 public:
+    // Predefined orderings that can be encoded in the drawcall sort key
+    enum class DrawcallSortMode
+    {
+        // Layer, then closest first, then state. For opaque geometry
+        FrontToBack,
+        // Layer, then farthest first, then state. For transparent geometry
+        BackToFront,
+        // Layer, then shader program, material and VAO, then closest first. Minimizes state changes
+        StateMinimizing
+    };
+
     class DrawcallInfo
     {
     public:
@@ -34,50 +56,206 @@ public:
         const VertexArrayObject& GetVAO() const { return m_vao; }
         const Drawcall& GetDrawcall() const { return m_drawcall; }
 
+        // Packed key used to sort the drawcalls. Built once per frame, before sorting
+        uint64_t GetSortKey() const { return m_sortKey; }
+        void SetSortKey(uint64_t sortKey) { m_sortKey = sortKey; }
+
+        // Instanced drawcalls read their world matrices from the instance buffer, starting at the first instance
+        bool IsInstanced() const { return m_firstInstance != NoInstance; }
+        unsigned int GetFirstInstance() const { return m_firstInstance; }
+        void SetInstances(unsigned int firstInstance, GLsizei instanceCount);
+
     private:
+        static const unsigned int NoInstance = ~0u;
+
         std::reference_wrapper<const Material> m_material;
         unsigned int m_worldMatrixIndex;
         std::reference_wrapper<const VertexArrayObject> m_vao;
-        std::reference_wrapper<const Drawcall> m_drawcall;
+        // Copy of the drawcall, so it can store its own instance count
+        Drawcall m_drawcall;
+        uint64_t m_sortKey;
+        unsigned int m_firstInstance;
+    };
+
+    // Bit mask of the views where an object is visible, bit i for view i
+    using ViewMask = uint32_t;
+    static const unsigned int MaxViewCount = 32;
+    static const ViewMask AllViews = ~0u;
+
+    // Objects rendered in a view. Static objects don't move, like the static nodes of a scene
+    enum class ViewObjects
+    {
+        All,
+        Static,
+        Dynamic
+    };
+
+    // Objects and triangles added in a frame for each model LOD. Each object is counted once, even if it is in several views
+    struct LodStats
+    {
+        std::array<unsigned int, Model::MaxLodCount> objectCounts = {};
+        std::array<uint64_t, Model::MaxLodCount> triangleCounts = {};
+
+        LodStats& operator += (const LodStats& other);
     };
 
     using DrawcallSupportedFunction = std::function<bool(const DrawcallInfo& drawcallInfo)>;
     class DrawcallCollection
     {
     public:
-        DrawcallCollection(const DrawcallSupportedFunction &isSupported = nullptr);
+        DrawcallCollection(FrameArena& frameArena, const DrawcallSupportedFunction &isSupported = nullptr, unsigned int viewIndex = 0);
 
         bool IsSupported(const DrawcallInfo& drawcallInfo) const;
         void SetSupportedFunction(const DrawcallSupportedFunction& isSupported);
 
+        // Only objects visible in this view add their drawcalls to the collection
+        unsigned int GetViewIndex() const { return m_viewIndex; }
+        void SetViewIndex(unsigned int viewIndex) { m_viewIndex = viewIndex; }
+        bool IsInView(ViewMask viewMask) const { return (viewMask >> m_viewIndex) & 1; }
+
+        // Rendered with order independent blending, so blended drawcalls are batched like opaque ones
+        bool IsOrderIndependent() const { return m_orderIndependent; }
+        void SetOrderIndependent(bool orderIndependent) { m_orderIndependent = orderIndependent; }
+
         std::span<DrawcallInfo> GetDrawcalls() { return m_drawcallInfos; }
         std::span<const DrawcallInfo> GetDrawcalls() const { return m_drawcallInfos; }
 
         void AddDrawcall(const DrawcallInfo& drawcallInfo);
+        // Add drawcalls that were already checked with IsSupported
+        void AddSupportedDrawcalls(std::span<const DrawcallInfo> drawcallInfos);
         void Clear();
 
+        // Remove all the drawcalls after the first count
+        void Truncate(unsigned int count);
+
+        // Sort the drawcalls by their sort key, using a LSD radix sort
+        // Temporary buffers are kept between frames, so it does not allocate once they are big enough
+        void SortByKey();
+
+    private:
+        // Key and original position of a drawcall, sorted instead of the full DrawcallInfo
+        struct SortEntry
+        {
+            uint64_t key;
+            unsigned int index;
+        };
+
     private:
         DrawcallSupportedFunction m_isSupported;
-        std::vector<DrawcallInfo> m_drawcallInfos;
+        unsigned int m_viewIndex;
+        bool m_orderIndependent;
+        FrameVector<DrawcallInfo> m_drawcallInfos;
+
+        // Buffers reused by SortByKey
+        std::vector<SortEntry> m_sortEntries;
+        std::vector<SortEntry> m_sortEntriesScratch;
+        FrameVector<DrawcallInfo> m_sortedDrawcallInfos;
+    };
+
+    // Group of drawcalls with the same material, VAO, primitive and EBO type
+    // They are submitted with a single indirect drawcall, reading the commands built by BuildIndirectBuckets
+    // Passes issue each bucket at the position of its first drawcall, so the buckets keep the sort order
+    class IndirectBucket
+    {
+    public:
+        IndirectBucket(const DrawcallInfo& drawcallInfo, unsigned int firstDrawcallIndex);
+
+        const Material& GetMaterial() const { return m_material; }
+        const VertexArrayObject& GetVAO() const { return m_vao; }
+        Drawcall::Primitive GetPrimitive() const { return m_primitive; }
+        Data::Type GetEBOType() const { return m_eboType; }
+        // Position in the collection of the first drawcall in the bucket
+        unsigned int GetFirstDrawcallIndex() const { return m_firstDrawcallIndex; }
+        unsigned int GetFirstCommand() const { return m_firstCommand; }
+        unsigned int GetCommandCount() const { return m_commandCount; }
+
+    private:
+        friend class Renderer;
+
+        std::reference_wrapper<const Material> m_material;
+        std::reference_wrapper<const VertexArrayObject> m_vao;
+        Drawcall::Primitive m_primitive;
+        Data::Type m_eboType;
+        unsigned int m_firstDrawcallIndex;
+        unsigned int m_firstCommand;
+        unsigned int m_commandCount;
     };
 
     using DrawcallSortFunction = std::function<bool(const DrawcallInfo&, const DrawcallInfo&)>;
 
+    // Transforms of an object with the current camera. Precomputed for all the objects before the passes render
+    struct ObjectTransforms
+    {
+        const glm::mat4& worldMatrix;
+        const glm::mat4& worldViewMatrix;
+        const glm::mat4& worldViewProjMatrix;
+        // Inverse transpose of the upper 3x3 of the world view matrix, to transform normals to view space
+        const glm::mat3& normalMatrix;
+    };
+
     using UpdateTransformsFunction = std::function<void(const ShaderProgram&, const glm::mat4&, const Camera&, bool)>;
+    using UpdateObjectTransformsFunction = std::function<void(const ShaderProgram&, const ObjectTransforms&, const Camera&, bool)>;
     using UpdateLightsFunction = std::function<bool(const ShaderProgram&, std::span<const Light* const>, unsigned int&)>;
 
+public:
+    // First of the 4 consecutive attribute locations where instanced shaders read their world matrix
+    // Shaders opt in by declaring "layout (location = 12) in mat4 InstanceWorldMatrix;" in the vertex shader
+    // For instanced drawcalls, the world matrix passed to the UpdateTransformsFunction is identity,
+    // so the shader has to apply InstanceWorldMatrix after any transform that includes it
+    static const GLuint InstanceWorldMatrixLocation = 12;
+
+    // Binding of the shader storage block with the data of all the objects, for indirect submission:
+    // struct ObjectData { mat4 WorldMatrix; };
+    // layout (std430, binding = 0) readonly buffer ObjectBuffer { ObjectData Objects[]; };
+    // Each instance can be found in Objects[gl_BaseInstance + gl_InstanceID]
+    // The same data is also provided in InstanceWorldMatrix, so instanced shaders work without changes
+    static const GLuint ObjectBufferBinding = 0;
+
+    // Bindings of the shader storage blocks for clustered lighting (GL 4.3):
+    // struct LightData { vec4 Color; vec4 Position; vec4 Direction; vec4 Attenuation; };
+    // layout (std430, binding = 1) readonly buffer LightBuffer { LightData Lights[]; };
+    // layout (std430, binding = 2) readonly buffer ClusterBuffer { uvec2 Clusters[]; }; // offset and count in LightIndices
+    // layout (std430, binding = 3) readonly buffer LightIndexBuffer { uint LightIndices[]; };
+    // Shaders opt in by declaring the uniforms "uvec3 ClusterGridSize", "vec2 ClusterDepthScaleBias",
+    // "vec4 ClusterDepthPlane" and "mat4 ClusterViewProjMatrix". See LightClusterGrid for how they map a position to a cluster
+    static const GLuint LightBufferBinding = 1;
+    static const GLuint ClusterBufferBinding = 2;
+    static const GLuint LightIndexBufferBinding = 3;
+
 public:
     Renderer(DeviceGL& device);
 
     const DeviceGL& GetDevice() const { return m_device; }
     DeviceGL& GetDevice() { return m_device; }
 
+    // Arena for the data that only lives during a frame. The data of the previous frame stays valid until the next Render
+    FrameArena& GetFrameArena() { return m_frameArena; }
+    const FrameArena::Stats& GetFrameArenaStats() const { return m_frameArena.GetStats(); }
+
     int AddRenderPass(std::unique_ptr<RenderPass> renderPass);
 
+    // The current camera is the main view (view 0), or the view of the pass that is rendering
     bool HasCamera() const;
     const Camera& GetCurrentCamera() const;
     void SetCurrentCamera(const Camera& camera);
 
+    // Views rendered in this frame, like shadow cascades, cubemap faces or split screen. View 0 is the main camera
+    // Views must be added before the models, so the scene is traversed once and each model is culled for all of them
+    // They are cleared after Render, like the models and lights
+    unsigned int AddView(const Camera& camera, ViewObjects objects = ViewObjects::All);
+    unsigned int GetViewCount() const { return static_cast<unsigned int>(m_views.size()); }
+    const Camera& GetViewCamera(unsigned int viewIndex) const;
+    unsigned int GetCurrentViewIndex() const { return m_currentViewIndex; }
+
+    // Views that render static objects, and views that render dynamic objects
+    // The renderer doesn't know which objects are static, the code adding the models applies these to their view masks
+    ViewMask GetStaticViewMask() const { return m_staticViewMask; }
+    ViewMask GetDynamicViewMask() const { return m_dynamicViewMask; }
+
+    // Make the view current, computing the transforms of the objects visible in it if they are not computed yet
+    // Passes that render several views switch between them, and then call InvalidateDrawcallState
+    void SetCurrentView(unsigned int viewIndex);
+
     std::shared_ptr<const FramebufferObject> GetDefaultFramebuffer() const;
     std::shared_ptr<const FramebufferObject> GetCurrentFramebuffer() const;
     void SetCurrentFramebuffer(std::shared_ptr<const FramebufferObject> framebuffer);
@@ -85,13 +263,51 @@ public:
     std::span<const Light* const> GetLights() const;
     void AddLight(const Light& light);
 
+    // Per-object light lists, built once per frame before the passes render
+    // Each object only gets the lights with influence bounds that reach the world bounds of its mesh
+    bool IsObjectLightAssignmentEnabled() const { return m_objectLightAssignmentEnabled; }
+    void SetObjectLightAssignmentEnabled(bool enabled) { m_objectLightAssignmentEnabled = enabled; }
+    ObjectLightAssignment& GetObjectLightAssignment() { return m_objectLightAssignment; }
+    const ObjectLightAssignment& GetObjectLightAssignment() const { return m_objectLightAssignment; }
+
+    // Lights that can reach the drawcall. Instanced drawcalls get the lights that reach any object
+    // All the lights if the assignment is disabled
+    std::span<const Light* const> GetDrawcallLights(const DrawcallInfo& drawcallInfo) const;
+    // Lights in the list of at least one object. All the lights if the assignment is disabled
+    std::span<const Light* const> GetAffectingLights() const;
+
     std::span<const DrawcallInfo> GetDrawcalls(unsigned int collectionIndex) const;
-    void AddModel(const Model& model, const glm::mat4& worldMatrix);
 
-    unsigned int AddDrawcallCollection(const DrawcallSupportedFunction &drawcallSupportedFunction);
+    // The drawcalls of the model are added to the collections of the views in the mask
+    // The world matrix is stored once, and shared by all the views. The submeshes come from the mesh of the LOD
+    void AddModel(const Model& model, const glm::mat4& worldMatrix, ViewMask viewMask = AllViews, unsigned int lod = 0);
+
+    // Add many models at once, same result as calling AddModel for each of them in order
+    // Models are split across worker threads, so the supported functions of the collections must be thread-safe
+    // If viewMasks is empty, the models are added to all the views. If lods is empty, LOD 0 is used
+    void AddModels(std::span<const Model* const> models, std::span<const glm::mat4> worldMatrices,
+        std::span<const ViewMask> viewMasks = {}, std::span<const unsigned int> lods = {});
+
+    // LOD stats of the last rendered frame
+    const LodStats& GetLodStats() const { return m_lastLodStats; }
+
+    // Maximum number of threads used by AddModels. 0 uses all the hardware threads
+    unsigned int GetWorkerThreadCount() const { return m_workerThreadCount; }
+    void SetWorkerThreadCount(unsigned int workerThreadCount) { m_workerThreadCount = workerThreadCount; }
+
+    // Threads of the parallel jobs of the frame, that other systems can share. Jobs must be started from the rendering thread
+    WorkerPool& GetWorkerPool() { return m_workerPool; }
+
+    unsigned int AddDrawcallCollection(const DrawcallSupportedFunction &drawcallSupportedFunction, unsigned int viewIndex = 0);
     void SetDrawcallCollectionSupportedFunction(unsigned int index, const DrawcallSupportedFunction& drawcallSupportedFunction);
+    // Views can change every frame, set it before adding the models
+    void SetDrawcallCollectionViewIndex(unsigned int index, unsigned int viewIndex);
+    // Blended drawcalls of the collection don't need to keep their order, like with weighted blended transparency
+    bool IsDrawcallCollectionOrderIndependent(unsigned int index) const { return m_drawcallCollections[index].IsOrderIndependent(); }
+    void SetDrawcallCollectionOrderIndependent(unsigned int index, bool orderIndependent);
 
     void SortDrawcallCollection(unsigned int index, const DrawcallSortFunction& drawcallSortFunction);
+    void SortDrawcallCollection(unsigned int index, DrawcallSortMode sortMode);
     bool IsBackToFront(const DrawcallInfo& a, const DrawcallInfo& b) const;
     bool IsFrontToBack(const DrawcallInfo& a, const DrawcallInfo& b) const;
 
@@ -101,45 +317,341 @@ public:
         const UpdateTransformsFunction& updateTransformFunction,
         const UpdateLightsFunction& updateLightsFunction);
 
-    void UpdateTransforms(std::shared_ptr<const ShaderProgram> shaderProgramPtr, const glm::mat4& worldMatrix, bool cameraChanged = true) const;
-    void UpdateTransforms(std::shared_ptr<const ShaderProgram> shaderProgramPtr, unsigned int worldMatrixIndex, bool cameraChanged = true) const;
+    // Same as above, but the binders are stored with their own type and called without going through std::function
+    // Binders have the signatures of UpdateTransformsFunction or UpdateObjectTransformsFunction, and UpdateLightsFunction
+    // Transform binders that take ObjectTransforms get the precomputed matrices. Use nullptr to skip a binder
+    template<typename TTransformBinder, typename TLightBinder>
+    void RegisterShaderProgram(std::shared_ptr<const ShaderProgram> shaderProgramPtr,
+        TTransformBinder transformBinder, TLightBinder lightBinder);
+
+    void UpdateTransforms(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, const glm::mat4& worldMatrix, bool cameraChanged = true) const;
+
+    void UpdateTransforms(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, unsigned int worldMatrixIndex, bool cameraChanged = true) const;
+
+    // Drawcalls with the same material, VAO and submesh are merged into instanced drawcalls, if their shader supports it
+    // If disabled, drawcalls with those shaders are still rendered with their own single instance
+    bool IsInstancingEnabled() const { return m_instancingEnabled; }
+    void SetInstancingEnabled(bool enabled) { m_instancingEnabled = enabled; }
+    bool IsInstancingSupported(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr) const;
 
     UpdateLightsFunction GetDefaultUpdateLightsFunction(const ShaderProgram& shaderProgram);
-    bool UpdateLights(std::shared_ptr<const ShaderProgram> shaderProgramPtr, std::span<const Light* const> lights, unsigned int& lightIndex) const;
 
+    // Clustered lighting (GL 4.3). Shaders that support it shade all the lights in a single pass
+    bool IsClusteredLightingSupported(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr) const;
+    // Upload the lights, once per frame, and the light clusters of the current view, once per view. Then bind the buffers
+    void PrepareClusteredLights();
+    // Set the cluster uniforms of the shader program, if it supports clustered lighting. Call it after PrepareDrawcall
+    bool UpdateClusteredLights(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr);
+    LightClusterGrid& GetLightClusterGrid() { return m_lightClusterGrid; }
+    const LightClusterGrid& GetLightClusterGrid() const { return m_lightClusterGrid; }
+    bool UpdateLights(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, std::span<const Light* const> lights, unsigned int& lightIndex) const;
+
+    // Set up the material, transforms and VAO of the drawcall
+    // State shared with the previous drawcall in the same pass is not applied again
     void PrepareDrawcall(const DrawcallInfo& drawcallInfo, Material::OverrideFlags materialOverride = Material::NoOverride);
 
+    // Indirect submission (GL 4.3). Only drawcalls with instancing support can be submitted indirectly,
+    // and blended ones only if their order doesn't matter
+    bool IsIndirectSupported(const DrawcallInfo& drawcallInfo, bool orderIndependent = false) const;
+    // Group the drawcalls of the collection by state, and upload their indirect commands
+    // The buckets are sorted by their first drawcall
+    std::span<const IndirectBucket> BuildIndirectBuckets(unsigned int collectionIndex);
+    // Set up the material, transforms, VAO and buffers of the bucket. Same as PrepareDrawcall, for indirect submission
+    void PrepareIndirectBucket(const IndirectBucket& bucket, Material::OverrideFlags materialOverride = Material::NoOverride);
+    // Submit all the drawcalls in the bucket
+    void DrawIndirectBucket(const IndirectBucket& bucket) const;
+
+    // Forget the state applied by PrepareDrawcall, so the next drawcall sets everything again
+    // Passes must call it after changing shader programs, uniforms or VAOs directly
+    void InvalidateDrawcallState();
+
     void SetLightingRenderStates(bool firstPass);
 
     void Render();
 
 private:
+    // Binders of a registered shader program, stored in a flat vector indexed by the program registration id
+    // Binders are type-erased: each one is called through a function pointer instantiated for its type
+    // Every update is still an indirect call. It saves the std::function wrapper, and the hash lookups of the old maps
+    struct ShaderProgramRegistration
+    {
+        using UpdateTransformsCall = void(*)(const void*, const ShaderProgram&, const ObjectTransforms&, const Camera&, bool);
+        using UpdateLightsCall = bool(*)(const void*, const ShaderProgram&, std::span<const Light* const>, unsigned int&);
+
+        std::shared_ptr<const ShaderProgram> shaderProgram;
+        std::shared_ptr<const void> transformBinder;
+        UpdateTransformsCall updateTransforms = nullptr;
+        std::shared_ptr<const void> lightBinder;
+        UpdateLightsCall updateLights = nullptr;
+        // The shader reads the world matrix from the instance attributes
+        bool instanced = false;
+
+        // The shader reads the lights from the cluster buffers
+        bool clustered = false;
+        ShaderProgram::Location clusterGridSizeLocation = -1;
+        ShaderProgram::Location clusterDepthScaleBiasLocation = -1;
+        ShaderProgram::Location clusterDepthPlaneLocation = -1;
+        ShaderProgram::Location clusterViewProjMatrixLocation = -1;
+        // Clusters used the last time the uniforms were set
+        unsigned int clusterVersion = 0;
+
+        inline void UpdateTransforms(const ObjectTransforms& transforms, const Camera& camera, bool cameraChanged) const
+        {
+            if (updateTransforms)
+                updateTransforms(transformBinder.get(), *shaderProgram, transforms, camera, cameraChanged);
+        }
+
+        inline bool UpdateLights(std::span<const Light* const> lights, unsigned int& lightIndex) const
+        {
+            return updateLights && updateLights(lightBinder.get(), *shaderProgram, lights, lightIndex);
+        }
+
+        template<typename TBinder>
+        void SetTransformBinder(TBinder binder);
+        template<typename TBinder>
+        void SetLightBinder(TBinder binder);
+    };
+
+    // Get the registration of the shader program, adding it if it is not registered yet
+    ShaderProgramRegistration& AddShaderProgramRegistration(std::shared_ptr<const ShaderProgram> shaderProgramPtr);
+    // Get the registration of the shader program, or nullptr if it is not registered
+    const ShaderProgramRegistration* FindShaderProgramRegistration(const ShaderProgram& shaderProgram) const;
+
     void Reset();
 
     void InitializeFullscreenMesh();
 
     const glm::mat4& GetWorldMatrix(const DrawcallInfo& drawcallInfo) const;
 
+    // Precomputed transforms of a world matrix, including InstancedWorldMatrixIndex
+    ObjectTransforms GetObjectTransforms(unsigned int worldMatrixIndex) const;
+
+    // Compute the transforms of the world matrices visible in the current view, in parallel for large counts
+    void PrecomputeTransforms();
+
+    // Number of threads to use for itemCount items, limited by the worker thread count
+    size_t GetParallelThreadCount(size_t itemCount, size_t minItemsPerThread) const;
+    // Split itemCount items in contiguous ranges, one per thread. The calling thread takes the first range
+    // The function is called as function(threadIndex, begin, end) by the threads of the worker pool
+    template<typename TFunction>
+    void RunParallel(size_t itemCount, size_t threadCount, TFunction&& function) { m_workerPool.Run(itemCount, threadCount, function); }
+
+    // Add the drawcalls of the models to the collections of their views, storing them in the drawcalls and stats of a worker
+    void AddModelDrawcalls(std::span<const Model* const> models, std::span<const ViewMask> viewMasks, std::span<const unsigned int> lods,
+        unsigned int firstWorldMatrixIndex, std::vector<std::vector<DrawcallInfo>>& workerDrawcalls, LodStats& workerLodStats) const;
+
+    // Merge the instanced drawcalls of the collection, adding their world matrices to the instance data
+    void BuildInstances(DrawcallCollection& collection);
+
+    // Apply the material, transforms and VAO, skipping what was already applied
+    // If the VAO is instanced, the instance attributes point to the object data, starting at firstInstance
+    void PrepareState(const Material& material, Material::OverrideFlags materialOverride,
+        unsigned int worldMatrixIndex, const VertexArrayObject& vao, bool instanced, unsigned int firstInstance);
+
+    // Point the instance attributes of the VAO to the object data, starting at firstInstance
+    void SetupInstanceAttributes(const VertexArrayObject& vao, unsigned int firstInstance);
+
+    // Disable the instance attributes of the VAO, so drawcalls that are not instanced don't read the object data
+    static void DisableInstanceAttributes(const VertexArrayObject& vao);
+
+    // Disable the instance attributes of all the VAOs that have them enabled. Called after each pass
+    void ResetInstanceAttributes();
+
+    // Build the sort keys of all the drawcalls in the collection, using the camera of its view
+    void UpdateSortKeys(DrawcallCollection& collection, DrawcallSortMode sortMode) const;
+
+    // Pack the lights of the frame in the light buffer
+    void UploadLightData();
+
+    // Compute the world bounds of the objects, and build their light lists
+    void AssignObjectLights();
+
 private:
     DeviceGL& m_device;
 
+    // Per-frame containers are allocated here, and recreated in Reset
+    FrameArena m_frameArena;
+
     const Camera *m_currentCamera;
 
+    // Cameras of the views, the first one is the main camera
+    FrameVector<const Camera*> m_views;
+    unsigned int m_currentViewIndex;
+    ViewMask m_staticViewMask;
+    ViewMask m_dynamicViewMask;
+    // View of the precomputed transforms, InvalidViewIndex if they are not computed
+    unsigned int m_transformsViewIndex;
+
     std::shared_ptr<const Material> m_currentMaterial;
 
+    // State applied by the last PrepareDrawcall
+    const Material* m_currentDrawcallMaterial;
+    Material::OverrideFlags m_currentMaterialOverride;
+    bool m_renderStatesDirty;
+    const ShaderProgram* m_currentTransformsProgram;
+    const ShaderProgramRegistration* m_currentShaderProgramRegistration;
+    unsigned int m_currentWorldMatrixIndex;
+    const VertexArrayObject* m_currentVAO;
+
+    // VAOs with the instance attributes enabled in the current pass, and the first instance they point to
+    std::unordered_map<const VertexArrayObject*, unsigned int> m_instanceAttributeVAOs;
+
     std::shared_ptr<const FramebufferObject> m_defaultFramebuffer;
     std::shared_ptr<const FramebufferObject> m_currentFramebuffer;
 
-    std::vector<const Light*> m_lights;
+    FrameVector<const Light*> m_lights;
 
-    std::vector<glm::mat4> m_worldMatrices;
+    FrameVector<glm::mat4> m_worldMatrices;
+    // Views where each world matrix is visible
+    FrameVector<ViewMask> m_worldMatrixViewMasks;
+    // Mesh drawn with each world matrix, for its bounds
+    FrameVector<const Mesh*> m_worldMatrixMeshes;
+
+    // Transforms of each world matrix with the current view, built by PrecomputeTransforms
+    FrameVector<glm::mat4> m_worldViewMatrices;
+    FrameVector<glm::mat4> m_worldViewProjMatrices;
+    FrameVector<glm::mat3> m_normalMatrices;
+    // Transforms of the identity world matrix, for instanced drawcalls
+    glm::mat4 m_viewProjMatrix;
+    glm::mat3 m_viewNormalMatrix;
 
     std::vector<DrawcallCollection> m_drawcallCollections;
 
-    std::unordered_map<std::shared_ptr<const ShaderProgram>, UpdateTransformsFunction> m_updateTransformsFunctions;
-    std::unordered_map<std::shared_ptr<const ShaderProgram>, UpdateLightsFunction> m_updateLightsFunctions;
+    // Parallel AddModels
+    unsigned int m_workerThreadCount;
+    // Threads of RunParallel, kept between frames
+    WorkerPool m_workerPool;
+    // Drawcalls added by each worker, one list per collection. Reused between frames
+    std::vector<std::vector<std::vector<DrawcallInfo>>> m_workerDrawcalls;
+    std::vector<LodStats> m_workerLodStats;
+
+    // LOD stats of the frame being built, and of the last rendered frame
+    LodStats m_lodStats;
+    LodStats m_lastLodStats;
+
+    std::vector<ShaderProgramRegistration> m_shaderProgramRegistrations;
+
+    // Instancing
+    // Per-object data, read as instance attributes and as a shader storage buffer with std430 layout
+    struct ObjectData
+    {
+        glm::mat4 worldMatrix;
+    };
+    struct InstanceBatchKey
+    {
+        const Material* material;
+        const VertexArrayObject* vao;
+        Drawcall::Primitive primitive;
+        GLint first;
+        GLsizei count;
+        Data::Type eboType;
+
+        bool operator == (const InstanceBatchKey& other) const = default;
+    };
+    struct InstanceBatchKeyHash
+    {
+        size_t operator()(const InstanceBatchKey& key) const;
+    };
+    struct InstanceBatch
+    {
+        unsigned int firstInstance;
+        unsigned int instanceCount;
+        // Position of the merged drawcall in the collection
+        unsigned int drawcallIndex;
+    };
+
+    bool m_instancingEnabled;
+    FrameVector<ObjectData> m_objectData;
+    // Contains m_objectData. Used as vertex buffer for the instance attributes, and as shader storage buffer
+    VertexBufferObject m_objectBuffer;
+
+    // Buffers reused by BuildInstances
+    FrameUnorderedMap<InstanceBatchKey, unsigned int, InstanceBatchKeyHash> m_instanceBatchIndices;
+    std::vector<InstanceBatch> m_instanceBatches;
+    std::vector<unsigned int> m_drawcallInstanceBatches;
+
+    // Indirect submission
+    std::vector<IndirectBucket> m_indirectBuckets;
+    std::vector<Drawcall::IndirectCommand> m_indirectCommands;
+    DrawIndirectBufferObject m_indirectBuffer;
+
+    // Buffers reused by BuildIndirectBuckets
+    FrameUnorderedMap<InstanceBatchKey, unsigned int, InstanceBatchKeyHash> m_indirectBucketIndices;
+    std::vector<unsigned int> m_drawcallIndirectBuckets;
+
+    // Per-object lights
+    bool m_objectLightAssignmentEnabled;
+    bool m_objectLightsAssigned;
+    ObjectLightAssignment m_objectLightAssignment;
+    // World bounds of each world matrix, with the bounds of its mesh
+    FrameVector<glm::vec3> m_worldBoundsMin;
+    FrameVector<glm::vec3> m_worldBoundsMax;
+
+    // Clustered lighting
+    // Light data with std430 layout
+    struct LightData
+    {
+        glm::vec4 color;
+        glm::vec4 position;
+        glm::vec4 direction;
+        glm::vec4 attenuation;
+    };
+
+    LightClusterGrid m_lightClusterGrid;
+    FrameVector<LightData> m_lightData;
+    bool m_lightDataUploaded;
+    // View of the clusters in the buffers, InvalidViewIndex if they are not built
+    unsigned int m_clusterViewIndex;
+    // Incremented each time the clusters are built, so the shader programs know when to update their uniforms
+    unsigned int m_clusterVersion;
+    VertexBufferObject m_lightBuffer;
+    VertexBufferObject m_clusterBuffer;
+    VertexBufferObject m_lightIndexBuffer;
 
     Mesh m_fullscreenMesh;
 
     std::vector<std::unique_ptr<RenderPass>> m_passes;
 };
+
+template<typename TTransformBinder, typename TLightBinder>
+void Renderer::RegisterShaderProgram(std::shared_ptr<const ShaderProgram> shaderProgramPtr,
+    TTransformBinder transformBinder, TLightBinder lightBinder)
+{
+    ShaderProgramRegistration& registration = AddShaderProgramRegistration(shaderProgramPtr);
+    if constexpr (!std::is_null_pointer_v<TTransformBinder>)
+    {
+        registration.SetTransformBinder(std::move(transformBinder));
+    }
+    if constexpr (!std::is_null_pointer_v<TLightBinder>)
+    {
+        registration.SetLightBinder(std::move(lightBinder));
+    }
+}
+
+template<typename TBinder>
+void Renderer::ShaderProgramRegistration::SetTransformBinder(TBinder binder)
+{
+    transformBinder = std::make_shared<const TBinder>(std::move(binder));
+    updateTransforms = [](const void* binder, const ShaderProgram& shaderProgram, const ObjectTransforms& transforms, const Camera& camera, bool cameraChanged)
+    {
+        const TBinder& transformBinder = *static_cast<const TBinder*>(binder);
+        if constexpr (std::is_invocable_v<const TBinder&, const ShaderProgram&, const ObjectTransforms&, const Camera&, bool>)
+        {
+            transformBinder(shaderProgram, transforms, camera, cameraChanged);
+        }
+        else
+        {
+            transformBinder(shaderProgram, transforms.worldMatrix, camera, cameraChanged);
+        }
+    };
+}
+
+template<typename TBinder>
+void Renderer::ShaderProgramRegistration::SetLightBinder(TBinder binder)
+{
+    lightBinder = std::make_shared<const TBinder>(std::move(binder));
+    updateLights = [](const void* binder, const ShaderProgram& shaderProgram, std::span<const Light* const> lights, unsigned int& lightIndex) -> bool
+    {
+        return (*static_cast<const TBinder*>(binder))(shaderProgram, lights, lightIndex);
+    };
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <ituGL/renderer/RenderPass.h>
+#include <ituGL/renderer/Renderer.h>
+#include <ituGL/camera/Camera.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <array>
+#include <span>
+#include <cstdint>
+
+class Light;
+class Model;
+class Material;
+class ShaderProgram;
+class Texture2DObject;
+
+// Shadow maps of the lights, rendered in square tiles of a single depth atlas
+// Each cascade of a directional light and each spot light gets a tile, sized by its importance on the screen of the main view
+// Each tile adds two renderer views: one for the static objects and one for the dynamic objects
+// The depth of the static objects is cached in a second atlas, and only rendered again when the light, the tile or its static objects change
+// Every frame the cached depth is copied to the atlas, and the dynamic objects are rendered on top
+// Point lights don't cast shadows
+class ShadowRenderPass : public RenderPass
+{
+public:
+    static const unsigned int MaxCascadeCount = 4;
+    // Each tile uses two views, and view 0 is the main camera
+    static const unsigned int MaxTileCount = (Renderer::MaxViewCount - 1) / 2;
+
+    // Shadow of a light in the current frame, with one tile per cascade
+    struct LightShadow
+    {
+        unsigned int tileCount;
+        // From world space to the [0, 1] coordinates and the depth of each tile
+        std::array<glm::mat4, MaxCascadeCount> matrices;
+        // Offset and scale of each tile, in texture coordinates of the atlas
+        std::array<glm::vec4, MaxCascadeCount> rects;
+    };
+
+    struct Stats
+    {
+        unsigned int tileCount = 0;
+        // Lights that need shadows but got no tile, because the atlas or the views are full
+        unsigned int droppedLightCount = 0;
+        // Tiles where the static objects were rendered again, and tiles that reused the cached depth
+        unsigned int staticRenderedTileCount = 0;
+        unsigned int staticCachedTileCount = 0;
+        unsigned int staticDrawcallCount = 0;
+        unsigned int dynamicDrawcallCount = 0;
+        // Drawcalls and CPU time of the static objects of the cached tiles, the last time they were rendered
+        unsigned int savedDrawcallCount = 0;
+        float savedTime = 0.0f;
+        // CPU time submitting the static objects this frame, in milliseconds
+        float staticRenderTime = 0.0f;
+    };
+
+public:
+    ShadowRenderPass(int atlasSize = 4096);
+
+    // Depth atlas with all the tiles, set to compare in the shaders with sampler2DShadow
+    std::shared_ptr<Texture2DObject> GetAtlasTexture() const { return m_atlasTexture; }
+    inline int GetAtlasSize() const { return m_atlasSize; }
+
+    // Tile sizes are powers of two between these values
+    inline int GetMaxTileSize() const { return m_maxTileSize; }
+    void SetMaxTileSize(int maxTileSize);
+    inline int GetMinTileSize() const { return m_minTileSize; }
+    void SetMinTileSize(int minTileSize);
+
+    // Cascades of the directional lights, split between the near plane of the main view and the shadow distance
+    inline unsigned int GetCascadeCount() const { return m_cascadeCount; }
+    void SetCascadeCount(unsigned int cascadeCount);
+    inline float GetShadowDistance() const { return m_shadowDistance; }
+    inline void SetShadowDistance(float shadowDistance) { m_shadowDistance = shadowDistance; }
+    // Blend between uniform (0) and logarithmic (1) splits
+    inline float GetCascadeSplitLambda() const { return m_cascadeSplitLambda; }
+    inline void SetCascadeSplitLambda(float cascadeSplitLambda) { m_cascadeSplitLambda = cascadeSplitLambda; }
+    // Distance towards the light added to the cascades, for the casters between the light and the view
+    inline float GetCasterDistance() const { return m_casterDistance; }
+    inline void SetCasterDistance(float casterDistance) { m_casterDistance = casterDistance; }
+
+    // Polygon offset factor and units applied to the casters
+    inline const glm::vec2& GetDepthBias() const { return m_depthBias; }
+    inline void SetDepthBias(const glm::vec2& depthBias) { m_depthBias = depthBias; }
+
+    // Allocate the tiles for the lights of the renderer and add their views
+    // Call it after adding the main camera and the lights, and before adding the models
+    void AddViews();
+
+    // Compare the static objects of each tile with the ones in its cached depth, and decide which tiles render them again
+    // The masks must only have static views in the static objects. Returns the static views that are cached,
+    // the models don't need to be added to them. Call it after AddViews, with the models before adding them
+    Renderer::ViewMask UpdateStaticCache(std::span<const Model* const> models, std::span<const glm::mat4> worldMatrices,
+        std::span<const Renderer::ViewMask> viewMasks, std::span<const unsigned int> lods);
+
+    // Shadow of the light in this frame, nullptr if it has no tiles
+    const LightShadow* GetLightShadow(const Light& light) const;
+
+    // Light binder that calls updateLights, and then sets the shadow of the light in "LightShadowCount" (int),
+    // "LightShadowMatrices" (mat4[MaxCascadeCount]) and "LightShadowRects" (vec4[MaxCascadeCount])
+    Renderer::UpdateLightsFunction GetUpdateLightsFunction(const ShaderProgram& shaderProgram, const Renderer::UpdateLightsFunction& updateLights) const;
+
+    // Stats of the last rendered frame
+    const Stats& GetStats() const { return m_stats; }
+
+    void Render() override;
+
+    // Pack square tiles with power of two sizes, sorted from the largest to the smallest
+    // Tiles follow a Z-order curve of cells of minTileSize, so each one is aligned to its size. Returns false if they don't fit
+    static bool PackTiles(std::span<const int> sizes, int atlasSize, int minTileSize, std::span<glm::ivec2> positions);
+
+    // Split depths of the cascades between near and far. Depths has cascadeCount + 1 values
+    static void ComputeCascadeSplits(float near, float far, float lambda, std::span<float> depths);
+
+    // Orthographic camera of the light that contains the part of the view between two depths, and the casters in front of it
+    // The bounds are snapped to a grid of about 1/16 of their size, so small camera moves keep the same projection
+    static void FitCascade(const Camera& camera, float nearDepth, float farDepth, const glm::vec3& lightDirection,
+        float casterDistance, Camera& cascadeCamera);
+
+private:
+    // Tile of a light, with the state of its cached static depth
+    struct Tile
+    {
+        const Light* light;
+        unsigned int cascade;
+        float importance;
+        // Size before rounding to a power of two, to change the size with some margin
+        float wantedSize;
+        int size;
+        glm::ivec2 position;
+        glm::mat4 viewProjMatrix;
+
+        // Hash of the static objects in the cached depth, and if the cache can be used
+        uint64_t staticHash;
+        bool staticValid;
+        // Cost of rendering the static objects, the last time they were rendered
+        unsigned int staticDrawcallCount;
+        float staticRenderTime;
+
+        // Views and drawcall collections of this frame
+        unsigned int staticViewIndex;
+        unsigned int dynamicViewIndex;
+    };
+
+    // Create the drawcall collections of the tiles, the first time the views are added
+    void InitializeCollections(unsigned int tileCount);
+
+    // Shadow casters are opaque and write depth
+    static bool IsShadowCaster(const Material& material);
+
+    // Render the drawcalls of a collection, returns the number of drawcalls
+    unsigned int RenderCollection(unsigned int collectionIndex);
+
+    // Find the tile of the same light and cascade in the previous frame
+    const Tile* FindPreviousTile(const Light* light, unsigned int cascade) const;
+
+private:
+    int m_atlasSize;
+    int m_maxTileSize;
+    int m_minTileSize;
+
+    unsigned int m_cascadeCount;
+    float m_shadowDistance;
+    float m_cascadeSplitLambda;
+    float m_casterDistance;
+
+    glm::vec2 m_depthBias;
+
+    std::shared_ptr<Texture2DObject> m_atlasTexture;
+    std::shared_ptr<Texture2DObject> m_staticTexture;
+    std::shared_ptr<FramebufferObject> m_staticFramebuffer;
+
+    // Tiles of the current frame, and of the previous one
+    std::vector<Tile> m_tiles;
+    std::vector<Tile> m_previousTiles;
+    std::array<Camera, MaxTileCount> m_tileCameras;
+
+    // Shadows of the lights in the current frame
+    std::vector<std::pair<const Light*, LightShadow>> m_lightShadows;
+
+    // Static and dynamic collections of each tile. Only the ones of the tiles in this frame accept drawcalls
+    std::vector<unsigned int> m_staticCollections;
+    std::vector<unsigned int> m_dynamicCollections;
+    unsigned int m_activeTileCount;
+    // If UpdateStaticCache was called this frame, otherwise all the static objects are rendered again
+    bool m_staticCacheUpdated;
+
+    Stats m_stats;
+    unsigned int m_droppedLightCount;
+};
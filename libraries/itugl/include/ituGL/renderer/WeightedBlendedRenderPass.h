@@ -0,0 +1,24 @@
+#pragma once
+
+#include <ituGL/renderer/RenderPass.h>
+
+#include <memory>
+
+class FramebufferObject;
+
+// Order independent transparency with weighted blended accumulation (GL 4.0, for the blend parameters of each draw buffer)
+// The drawcalls of the collection are rendered in any order, testing against the opaque depth without writing it
+// Their shaders write the weighted premultiplied color and weight to location 0, and the alpha to location 1
+// The target framebuffer needs the accumulation in Color0 (RGBA16F), the coverage in Color1 (R8) and the opaque depth,
+// for example from a render graph. A fullscreen pass then composites the weighted average color over the scene, with the coverage as alpha
+// The collection should be order independent (Renderer::SetDrawcallCollectionOrderIndependent) and doesn't need sorting
+class WeightedBlendedRenderPass : public RenderPass
+{
+public:
+    WeightedBlendedRenderPass(int drawcallCollectionIndex, std::shared_ptr<const FramebufferObject> targetFramebuffer = nullptr);
+
+    void Render() override;
+
+private:
+    int m_drawcallCollectionIndex;
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <ituGL/scene/Bounds.h>
+#include <glm/vec3.hpp>
+#include <vector>
+#include <span>
+#include <utility>
+#include <bit>
+#include <cstdint>
+#include <cassert>
+
+// Tree of AABBs over a set of items, to find the items in a region without testing all of them
+// The tree is built with the surface area heuristic (SAH), and it can be refit when the items move
+// Nodes are stored in a flat array, with the two children of a node next to each other
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy();
+
+    // Build the tree. The item with index i has bounds[i]
+    void Build(std::span<const AabbBounds> bounds);
+
+    // Update the bounds of the items, keeping the same tree. Must have the same items as the last Build
+    void Refit(std::span<const AabbBounds> bounds);
+
+    inline unsigned int GetItemCount() const { return static_cast<unsigned int>(m_itemIndices.size()); }
+    inline unsigned int GetNodeCount() const { return static_cast<unsigned int>(m_nodes.size()); }
+
+    // SAH cost of the tree relative to its root. It grows when the tree is refit with items that moved far
+    inline float GetCost() const { return m_cost; }
+
+    // Call function(itemIndex) for each item that intersects the bounds
+    template<typename TFunction>
+    void Query(const FrustumBounds& frustum, TFunction function) const;
+    template<typename TFunction>
+    void Query(const AabbBounds& bounds, TFunction function) const;
+    template<typename TFunction>
+    void Query(const SphereBounds& sphere, TFunction function) const;
+
+    // Call function(itemIndex, frustumMask) once for each item that intersects any of the frustums, up to 32
+    // Bit i of the mask is set if the item intersects frustum i. Each node is only tested against the frustums of its parent
+    template<typename TFunction>
+    void Query(std::span<const FrustumBounds> frustums, TFunction function) const;
+
+    // Call function(itemIndex, distance) for each item with bounds hit by the ray, at distance along the direction
+    // The function returns the new maximum distance, so the closest hit can be found by returning the distance
+    template<typename TFunction>
+    void RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TFunction function) const;
+
+public:
+    static const unsigned int MaxLeafItemCount = 4;
+
+private:
+    struct Node
+    {
+        glm::vec3 boundsMin;
+        // Leaf: first item in m_itemIndices. Internal: index of the first child
+        unsigned int first;
+        glm::vec3 boundsMax;
+        // Leaf: number of items. Internal: 0
+        unsigned int count;
+    };
+
+    // Bounds of an item, stored in the same order as m_itemIndices
+    struct ItemBounds
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    // Item data used while building
+    struct BuildItem
+    {
+        ItemBounds bounds;
+        glm::vec3 centroid;
+        unsigned int index;
+    };
+
+    // Split the node in two children, recursively, if it reduces the SAH cost
+    void Subdivide(unsigned int nodeIndex, std::vector<BuildItem>& items);
+
+    // SAH cost of all the nodes, divided by the area of the root
+    float ComputeCost() const;
+
+    // Depth-first traversal. nodeTest(min, max) decides if a node or item is visited
+    template<typename TNodeTest, typename TFunction>
+    void Traverse(TNodeTest nodeTest, TFunction function) const;
+
+    static float GetArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+private:
+    std::vector<Node> m_nodes;
+
+    // Items sorted by leaf, each leaf references a range
+    std::vector<unsigned int> m_itemIndices;
+    std::vector<ItemBounds> m_itemBounds;
+
+    float m_cost;
+};
+
+template<typename TNodeTest, typename TFunction>
+void BoundingVolumeHierarchy::Traverse(TNodeTest nodeTest, TFunction function) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    // The stack only holds the pending siblings, so it grows with the depth of the tree
+    std::vector<unsigned int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!nodeTest(node.boundsMin, node.boundsMax))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                const ItemBounds& itemBounds = m_itemBounds[i];
+                if (nodeTest(itemBounds.boundsMin, itemBounds.boundsMax))
+                {
+                    function(m_itemIndices[i]);
+                }
+            }
+        }
+        else
+        {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+}
+
+template<typename TFunction>
+void BoundingVolumeHierarchy::Query(const FrustumBounds& frustum, TFunction function) const
+{
+    Traverse([&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) { return frustum.IntersectsBox(boundsMin, boundsMax); }, function);
+}
+
+template<typename TFunction>
+void BoundingVolumeHierarchy::Query(const AabbBounds& bounds, TFunction function) const
+{
+    Traverse([&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) { return bounds.IntersectsBox(boundsMin, boundsMax); }, function);
+}
+
+template<typename TFunction>
+void BoundingVolumeHierarchy::Query(const SphereBounds& sphere, TFunction function) const
+{
+    Traverse([&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) { return sphere.IntersectsBox(boundsMin, boundsMax); }, function);
+}
+
+template<typename TFunction>
+void BoundingVolumeHierarchy::Query(std::span<const FrustumBounds> frustums, TFunction function) const
+{
+    assert(frustums.size() <= 32);
+    if (m_nodes.empty() || frustums.empty())
+    {
+        return;
+    }
+
+    // Mask of the frustums in frustumMask that intersect the box
+    auto testFrustums = [&](uint32_t frustumMask, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        uint32_t intersectMask = 0;
+        for (uint32_t bits = frustumMask; bits != 0; bits &= bits - 1)
+        {
+            unsigned int frustumIndex = std::countr_zero(bits);
+            if (frustums[frustumIndex].IntersectsBox(boundsMin, boundsMax))
+            {
+                intersectMask |= 1u << frustumIndex;
+            }
+        }
+        return intersectMask;
+    };
+
+    // Each pending node keeps the mask of the frustums that intersect its parent
+    std::vector<std::pair<unsigned int, uint32_t>> stack;
+    stack.reserve(64);
+    stack.emplace_back(0, frustums.size() < 32 ? (1u << frustums.size()) - 1 : ~0u);
+    while (!stack.empty())
+    {
+        auto [nodeIndex, parentMask] = stack.back();
+        stack.pop_back();
+        const Node& node = m_nodes[nodeIndex];
+        uint32_t nodeMask = testFrustums(parentMask, node.boundsMin, node.boundsMax);
+        if (nodeMask == 0)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                const ItemBounds& itemBounds = m_itemBounds[i];
+                uint32_t itemMask = testFrustums(nodeMask, itemBounds.boundsMin, itemBounds.boundsMax);
+                if (itemMask != 0)
+                {
+                    function(m_itemIndices[i], itemMask);
+                }
+            }
+        }
+        else
+        {
+            stack.emplace_back(node.first + 1, nodeMask);
+            stack.emplace_back(node.first, nodeMask);
+        }
+    }
+}
+
+template<typename TFunction>
+void BoundingVolumeHierarchy::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TFunction function) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    // Visit the closest child first, so the maximum distance shrinks sooner
+    std::vector<unsigned int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, node.boundsMin, node.boundsMax) < 0.0f)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                const ItemBounds& itemBounds = m_itemBounds[i];
+                float distance = AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, itemBounds.boundsMin, itemBounds.boundsMax);
+                if (distance >= 0.0f)
+                {
+                    maxDistance = function(m_itemIndices[i], distance);
+                }
+            }
+        }
+        else
+        {
+            const Node& child0 = m_nodes[node.first];
+            const Node& child1 = m_nodes[node.first + 1];
+            float distance0 = AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, child0.boundsMin, child0.boundsMax);
+            float distance1 = AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, child1.boundsMin, child1.boundsMax);
+            bool firstCloser = distance0 >= 0.0f && (distance1 < 0.0f || distance0 <= distance1);
+            stack.push_back(firstCloser ? node.first + 1 : node.first);
+            stack.push_back(firstCloser ? node.first : node.first + 1);
+        }
+    }
+}
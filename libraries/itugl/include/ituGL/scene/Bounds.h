@@ -1,7 +1,14 @@
 #pragma once
 
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
 
 class Bounds
 {
@@ -48,6 +55,9 @@ public:
     inline float GetRadius() const { return m_radius; }
     inline void SetRadius(float radius) { m_radius = radius; }
 
+    // Test against a box given by its corners, used by the spatial structures
+    inline bool IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
 private:
     float m_radius;
 };
@@ -66,6 +76,15 @@ public:
     glm::vec3 GetMin() const { return m_center - m_size; }
     glm::vec3 GetMax() const { return m_center + m_size; }
 
+    // Smallest AABB that contains these bounds after being transformed by the matrix
+    AabbBounds GetTransformed(const glm::mat4& matrix) const;
+
+    // Test against a box given by its corners, used by the spatial structures
+    inline bool IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+    // Distance along the ray where it enters the box, or a negative value if it misses it before maxDistance
+    static inline float RayIntersection(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
 private:
     glm::vec3 m_size;
 };
@@ -103,28 +122,104 @@ private:
     glm::vec3 m_size;
 };
 
-class FrustumBounds : public RotatedBounds
+class FrustumBounds : public Bounds
 {
 public:
-    FrustumBounds(const glm::vec3& center, const glm::vec3& size);
+    enum class Plane
+    {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        Count
+    };
+
+public:
+    // Extract the planes from a view-projection matrix, for example Camera::GetViewProjectionMatrix
+    FrustumBounds(const glm::mat4& viewProjMatrix);
 
     inline Type GetType() const override { return Type::Frustum; }
 
+    // Plane as (normal, distance), with the normal pointing inside the frustum
+    inline const glm::vec4& GetPlane(Plane plane) const { return m_planes[static_cast<int>(plane)]; }
+
+    // Corners in world space, the corners of the clip space cube with x in bit 0, y in bit 1 and z in bit 2
+    static const int CornerCount = 8;
+    inline const glm::vec3& GetCorner(int index) const { assert(index >= 0 && index < CornerCount); return m_corners[index]; }
+
+    // Test against a box given by its corners, used by the spatial structures
+    inline bool IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
 private:
+    glm::vec4 m_planes[static_cast<int>(Plane::Count)];
+    glm::vec3 m_corners[CornerCount];
 };
 
 
+bool SphereBounds::IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+    glm::vec3 offset = glm::clamp(m_center, boxMin, boxMax) - m_center;
+    return glm::dot(offset, offset) <= m_radius * m_radius;
+}
+
+bool AabbBounds::IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+    glm::vec3 boundsMin = GetMin();
+    glm::vec3 boundsMax = GetMax();
+    return boundsMin.x <= boxMax.x && boxMin.x <= boundsMax.x
+        && boundsMin.y <= boxMax.y && boxMin.y <= boundsMax.y
+        && boundsMin.z <= boxMax.z && boxMin.z <= boundsMax.z;
+}
+
+float AabbBounds::RayIntersection(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    // Slab test: the ray is inside the box between the last entry and the first exit of the 3 pairs of planes
+    glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return entry <= exit ? entry : -1.0f;
+}
+
+bool FrustumBounds::IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+    glm::vec3 center = 0.5f * (boxMax + boxMin);
+    glm::vec3 size = 0.5f * (boxMax - boxMin);
+    for (const glm::vec4& plane : m_planes)
+    {
+        glm::vec3 normal(plane);
+        if (glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), size))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 template<typename T>
 bool Bounds::Intersects(const T& other) const
 {
-    Bounds::Intersects(this, other);
+    return Bounds::Intersects(*this, other);
 }
 
 template<typename TA, typename TB>
 bool Bounds::Intersects(const TA& boundsA, const TB& boundsB)
 {
-    assert(boundsA.GetType() < boundsB.GetType());
-    return Bounds::Intersects(boundsB, boundsA);
+    // Each pair of types is implemented once, swapping the same types would call this again forever
+    if constexpr (std::is_same_v<TA, TB>)
+    {
+        static_assert(!std::is_same_v<TA, TB>, "Intersects is not implemented for these bounds");
+        return false;
+    }
+    else
+    {
+        assert(boundsA.GetType() <= boundsB.GetType());
+        return Bounds::Intersects(boundsB, boundsA);
+    }
 }
 
 template<typename TA>
@@ -144,6 +239,8 @@ bool Bounds::Intersects(const Bounds& boundsA, const TB& boundsB)
         return Bounds::Intersects(static_cast<const AabbBounds&>(boundsA), boundsB);
     case Type::Box:
         return Bounds::Intersects(static_cast<const BoxBounds&>(boundsA), boundsB);
+    case Type::Frustum:
+        return Bounds::Intersects(static_cast<const FrustumBounds&>(boundsA), boundsB);
     default:
         assert(false);
         return false;
@@ -168,8 +265,8 @@ template<>
 bool Bounds::Intersects(const FrustumBounds& boundsA, const AabbBounds& boundsB);
 template<>
 bool Bounds::Intersects(const FrustumBounds& boundsA, const BoxBounds& boundsB);
-//template<>
-//bool Bounds::Intersects(const FrustumBounds& boundsA, const FrustumBounds& boundsB);
+template<>
+bool Bounds::Intersects(const FrustumBounds& boundsA, const FrustumBounds& boundsB);
 
 
 
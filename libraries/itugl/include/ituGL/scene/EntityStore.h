@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+
+class SceneNode;
+class Transform;
+class Model;
+class Light;
+class Camera;
+
+// Handle to an entity in an EntityStore
+// The generation changes every time an index is reused, so handles to destroyed entities stay invalid
+struct Entity
+{
+    unsigned int index = InvalidIndex;
+    unsigned int generation = 0;
+
+    inline bool IsNull() const { return index == InvalidIndex; }
+
+    inline bool operator == (const Entity& other) const { return index == other.index && generation == other.generation; }
+    inline bool operator != (const Entity& other) const { return !(*this == other); }
+
+    static const unsigned int InvalidIndex = ~0u;
+};
+
+// Compact storage of the scene data, made of entities with components
+// Entities with the same set of components (archetype) are kept in one table, with a dense array per component
+// Iterating the entities that have some components only reads the arrays of the matching tables, without virtual calls
+class EntityStore
+{
+public:
+    enum class Component
+    {
+        Node,
+        Transform,
+        Model,
+        Light,
+        Camera,
+
+        Count
+    };
+
+public:
+    EntityStore();
+
+    // Add an entity without components
+    Entity Create();
+
+    // Remove the entity, its components and its name
+    void Destroy(Entity entity);
+
+    bool IsValid(Entity entity) const;
+
+    inline unsigned int GetEntityCount() const { return static_cast<unsigned int>(m_records.size() - m_freeIndices.size()); }
+
+    bool HasComponent(Entity entity, Component component) const;
+
+    // Setting a component to nullptr removes it from the entity
+    std::shared_ptr<SceneNode> GetNode(Entity entity) const;
+    void SetNode(Entity entity, std::shared_ptr<SceneNode> node);
+
+    std::shared_ptr<Transform> GetTransform(Entity entity) const;
+    void SetTransform(Entity entity, std::shared_ptr<Transform> transform);
+
+    std::shared_ptr<Model> GetModel(Entity entity) const;
+    void SetModel(Entity entity, std::shared_ptr<Model> model);
+
+    std::shared_ptr<Light> GetLight(Entity entity) const;
+    void SetLight(Entity entity, std::shared_ptr<Light> light);
+
+    std::shared_ptr<Camera> GetCamera(Entity entity) const;
+    void SetCamera(Entity entity, std::shared_ptr<Camera> camera);
+
+    // Optional index to find entities by name. Names must be unique, an empty name removes the entity from the index
+    void SetName(Entity entity, const std::string& name);
+    Entity FindEntity(const std::string& name) const;
+
+    // Call function(entity, node) for each entity with a scene node
+    template<typename TFunction>
+    void ForEachNode(TFunction function) const;
+
+    // Call function(entity, model, transform) for each entity with a model and a transform
+    template<typename TFunction>
+    void ForEachModel(TFunction function) const;
+
+    // Call function(entity, light, transform) for each entity with a light and a transform
+    template<typename TFunction>
+    void ForEachLight(TFunction function) const;
+
+    // Call function(entity, camera, transform) for each entity with a camera and a transform
+    template<typename TFunction>
+    void ForEachCamera(TFunction function) const;
+
+private:
+    // Entities with the same components. Only the arrays of those components are used
+    struct Table
+    {
+        std::vector<Entity> entities;
+        std::vector<std::shared_ptr<SceneNode>> nodes;
+        std::vector<std::shared_ptr<Transform>> transforms;
+        std::vector<std::shared_ptr<Model>> models;
+        std::vector<std::shared_ptr<Light>> lights;
+        std::vector<std::shared_ptr<Camera>> cameras;
+    };
+
+    struct EntityRecord
+    {
+        // Components of the entity, also the index of its table
+        unsigned int mask;
+        // Position in the table
+        unsigned int row;
+        unsigned int generation;
+        // Key in the name index, nullptr if the entity has no name
+        const std::string* name;
+    };
+
+    static inline unsigned int GetComponentMask(Component component) { return 1u << static_cast<unsigned int>(component); }
+
+    // Move the entity to the table of the new mask, keeping the components that are in both
+    void MoveEntity(Entity entity, unsigned int newMask);
+
+    // Remove the row, moving the last row of the table to its place
+    void RemoveRow(unsigned int mask, unsigned int row);
+
+    template<typename T>
+    std::shared_ptr<T> GetComponent(Entity entity, Component component, std::vector<std::shared_ptr<T>> Table::* column) const;
+    template<typename T>
+    void SetComponent(Entity entity, Component component, std::vector<std::shared_ptr<T>> Table::* column, std::shared_ptr<T> value);
+
+    // Call function(entity, value, transform) for each entity with the component and a transform
+    template<typename T, typename TFunction>
+    void ForEachWithTransform(Component component, std::vector<std::shared_ptr<T>> Table::* column, TFunction function) const;
+
+private:
+    // Indexed by mask, there is a table for each combination of components
+    std::vector<Table> m_tables;
+
+    // Indexed by the entity index
+    std::vector<EntityRecord> m_records;
+    std::vector<unsigned int> m_freeIndices;
+
+    std::unordered_map<std::string, Entity> m_nameIndex;
+};
+
+template<typename TFunction>
+void EntityStore::ForEachNode(TFunction function) const
+{
+    unsigned int componentMask = GetComponentMask(Component::Node);
+    for (unsigned int mask = 0; mask < m_tables.size(); ++mask)
+    {
+        if ((mask & componentMask) == componentMask)
+        {
+            const Table& table = m_tables[mask];
+            for (unsigned int row = 0; row < table.entities.size(); ++row)
+            {
+                function(table.entities[row], *table.nodes[row]);
+            }
+        }
+    }
+}
+
+template<typename T, typename TFunction>
+void EntityStore::ForEachWithTransform(Component component, std::vector<std::shared_ptr<T>> Table::* column, TFunction function) const
+{
+    unsigned int componentMask = GetComponentMask(component) | GetComponentMask(Component::Transform);
+    for (unsigned int mask = 0; mask < m_tables.size(); ++mask)
+    {
+        if ((mask & componentMask) == componentMask)
+        {
+            const Table& table = m_tables[mask];
+            const std::vector<std::shared_ptr<T>>& values = table.*column;
+            for (unsigned int row = 0; row < table.entities.size(); ++row)
+            {
+                function(table.entities[row], *values[row], *table.transforms[row]);
+            }
+        }
+    }
+}
+
+template<typename TFunction>
+void EntityStore::ForEachModel(TFunction function) const
+{
+    ForEachWithTransform(Component::Model, &Table::models, function);
+}
+
+template<typename TFunction>
+void EntityStore::ForEachLight(TFunction function) const
+{
+    ForEachWithTransform(Component::Light, &Table::lights, function);
+}
+
+template<typename TFunction>
+void EntityStore::ForEachCamera(TFunction function) const
+{
+    ForEachWithTransform(Component::Camera, &Table::cameras, function);
+}
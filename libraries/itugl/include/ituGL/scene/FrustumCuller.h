@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ituGL/scene/Bounds.h>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Tests many AABBs against a frustum in a single pass
+// The bounds are stored as a structure of arrays, so several of them are tested at the same time with SIMD
+class FrustumCuller
+{
+public:
+    FrustumCuller();
+
+    // Remove all the bounds
+    void Clear();
+
+    // Reserve memory for this number of bounds
+    void Reserve(unsigned int count);
+
+    // Add the bounds to be tested. Returns the index used by Cull
+    unsigned int AddBounds(const AabbBounds& bounds);
+
+    inline unsigned int GetBoundsCount() const { return static_cast<unsigned int>(m_centerX.size()); }
+
+    // Append to visibleIndices the indices of the bounds that intersect the frustum, in increasing order
+    // Same test as Bounds::Intersects between a FrustumBounds and an AabbBounds
+    void Cull(const FrustumBounds& frustum, std::vector<unsigned int>& visibleIndices) const;
+
+    // Test all the bounds against several frustums, up to 32, reading each bounds once
+    // viewMasks gets one mask per bounds, with bit i set if the bounds intersect frustum i
+    void CullViews(std::span<const FrustumBounds> frustums, std::vector<uint32_t>& viewMasks) const;
+
+private:
+    // Center and half size of the bounds, one array per component
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_sizeX;
+    std::vector<float> m_sizeY;
+    std::vector<float> m_sizeZ;
+};
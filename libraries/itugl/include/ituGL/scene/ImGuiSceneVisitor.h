@@ -2,18 +2,33 @@
 
 #include <ituGL/scene/SceneVisitor.h>
 #include <string>
+#include <vector>
 
 class DearImGui;
+class Scene;
+class SceneNode;
 class SceneCamera;
 class SceneLight;
 class SceneModel;
 class Transform;
 
+// Inspector window with the nodes of a scene
+// Nodes are kept in an index, and the list only builds the rows that are visible, so its cost doesn't depend on the scene size
+// The properties of a node are only built when it is selected
 class ImGuiSceneVisitor : public SceneVisitor
 {
 public:
     ImGuiSceneVisitor(DearImGui& imGui, const char *windowName);
 
+    // Draw the window. The scene is only visited again if nodes were added or removed since the last call
+    // Keep the visitor between frames to keep the index, the selection and the filter
+    void Draw(Scene& scene);
+
+    // Visiting the scene directly rebuilds the index, and draws the window when the visit ends
+    void BeginVisit() override;
+    void EndVisit() override;
+
+    // Nodes visited outside of a scene visit are drawn directly, with their properties
     void VisitCamera(SceneCamera& sceneCamera) override;
 
     void VisitLight(SceneLight& sceneLight) override;
@@ -21,9 +36,68 @@ public:
     void VisitModel(SceneModel& sceneModel) override;
 
 private:
-    void VisitTransform(Transform& transform);
+    enum class NodeType
+    {
+        Camera,
+        Light,
+        Model,
+    };
+
+    struct NodeEntry
+    {
+        SceneNode* node;
+        NodeType type;
+    };
+
+    // Lowercase name of a node and its position in the node index
+    struct NameEntry
+    {
+        std::string name;
+        unsigned int entryIndex;
+    };
+
+    void AddNode(SceneNode& node, NodeType type);
+
+    void DrawWindow();
+    void DrawFilter();
+    void DrawNodeList();
+
+    // Sort the names of the nodes, if they changed since the last time
+    void BuildNameIndex();
+    // Find the range of names that start with the filter text
+    void UpdateFilterRange();
+
+    void DrawNode(SceneNode& node, NodeType type);
+    void DrawCamera(SceneCamera& sceneCamera);
+    void DrawLight(SceneLight& sceneLight);
+    void DrawModel(SceneModel& sceneModel);
+    void DrawTransform(Transform& transform);
 
 private:
     DearImGui& m_imGui;
     std::string m_windowName;
+
+    // Scene of the index, and its node version when the index was built
+    const Scene* m_scene;
+    unsigned int m_sceneNodeVersion;
+
+    bool m_visitingScene;
+    // Set by Draw, that draws the window itself after the visit
+    bool m_drawOnEndVisit;
+
+    // Nodes in visit order
+    std::vector<NodeEntry> m_nodes;
+
+    // Names sorted, built when filtering for the first time after the nodes change
+    std::vector<NameEntry> m_names;
+    bool m_namesDirty;
+
+    char m_filter[64];
+    // Range of m_names that matches the filter
+    unsigned int m_filterBegin;
+    unsigned int m_filterEnd;
+
+    // Selected node, nullptr if none
+    SceneNode* m_selectedNode;
+    NodeType m_selectedType;
 };
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <ituGL/scene/Bounds.h>
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <span>
+
+class WorkerPool;
+
+// Simplified geometry of a model, used to hide other models in the OcclusionCuller
+// It must be inside the model it represents, or it could hide objects that are visible
+// It must also be convex. Concave models can use several occluders
+struct OccluderMesh
+{
+    std::vector<glm::vec3> vertices;
+    // 3 indices per triangle
+    std::vector<unsigned int> indices;
+
+    // Box from min to max, for example for buildings and walls
+    static OccluderMesh CreateBox(const glm::vec3& min, const glm::vec3& max);
+};
+
+// Culls the objects that are hidden behind occluders, on the CPU
+// Occluders are rasterized in a low resolution depth buffer, split in tiles that are drawn in parallel
+// Pixels are only written when their 4 corners are covered by the same occluder, with the farthest depth of the corners.
+// The occluders are convex, so the whole pixel is behind that depth, and an object is never culled where it could be visible
+// Objects are then tested with their AABB against a hierarchy of that depth buffer
+// It doesn't use OpenGL, so it can run without a window
+class OcclusionCuller
+{
+public:
+    // Counters and timings (in milliseconds) of the last frame
+    struct Stats
+    {
+        unsigned int occluderCount = 0;
+        unsigned int triangleCount = 0;
+        unsigned int testedCount = 0;
+        unsigned int culledCount = 0;
+
+        // Transform the occluders and set up the triangles
+        float setupTime = 0.0f;
+        // Rasterize the triangles in the depth buffer
+        float rasterizeTime = 0.0f;
+        // Build the depth hierarchy
+        float hierarchyTime = 0.0f;
+        // Test the bounds
+        float testTime = 0.0f;
+    };
+
+public:
+    // Width must be a multiple of TileWidth, and height of TileHeight
+    OcclusionCuller(int width = DefaultWidth, int height = DefaultHeight);
+
+    inline int GetWidth() const { return m_width; }
+    inline int GetHeight() const { return m_height; }
+
+    // Pool that rasterizes the rows of tiles in parallel. Without a pool, they are rasterized in the calling thread
+    inline WorkerPool* GetWorkerPool() const { return m_workerPool; }
+    inline void SetWorkerPool(WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+    // Maximum number of threads of the pool used to rasterize. 0 uses all the hardware threads
+    inline unsigned int GetThreadCount() const { return m_threadCount; }
+    inline void SetThreadCount(unsigned int threadCount) { m_threadCount = threadCount; }
+
+    // Clear the occluders and the depth buffer, and set the view of the frame
+    void BeginFrame(const glm::mat4& viewProjMatrix);
+
+    // The occluder must stay valid until RenderOccluders is called
+    void AddOccluder(const OccluderMesh& occluder, const glm::mat4& worldMatrix);
+
+    // Rasterize the occluders and build the depth hierarchy
+    void RenderOccluders();
+
+    // True if the bounds can be visible. Bounds crossing the near plane or outside of the screen are always visible
+    bool IsVisible(const AabbBounds& bounds) const;
+
+    // Append to visibleIndices the indices of the bounds that are visible, in increasing order. Updates the stats
+    void Cull(std::span<const AabbBounds> bounds, std::vector<unsigned int>& visibleIndices);
+
+    // Depth of the farthest occluder in the pixel, from 0 (near) to 1 (far)
+    inline float GetDepth(int x, int y) const { return m_depthLevels[0][y * m_width + x]; }
+
+    inline const Stats& GetStats() const { return m_stats; }
+
+public:
+    static const int DefaultWidth = 256;
+    static const int DefaultHeight = 128;
+
+    static const int TileWidth = 64;
+    static const int TileHeight = 16;
+
+private:
+    struct Occluder
+    {
+        const OccluderMesh* mesh;
+        glm::mat4 worldMatrix;
+    };
+
+    // Triangle in screen space, ready to be rasterized
+    struct Triangle
+    {
+        // Edge functions, A * x + B * y + C, positive inside the triangle
+        glm::vec3 edgeA;
+        glm::vec3 edgeB;
+        glm::vec3 edgeC;
+
+        // Depth plane, A * x + B * y + C
+        glm::vec3 depth;
+
+        // Bounds of the pixel corners, inclusive
+        int minX, minY, maxX, maxY;
+    };
+
+    // Triangles of an occluder in m_triangles, and the bounds of their pixel corners
+    struct OccluderTriangles
+    {
+        unsigned int firstTriangle;
+        unsigned int triangleCount;
+        int minX, minY, maxX, maxY;
+    };
+
+    // Transform the occluders to screen space and fill m_triangles
+    void SetupTriangles();
+
+    // Rasterize the occluders that overlap the tile, writing the pixels they cover completely
+    void RasterizeTile(int tileX, int tileY);
+
+    // Each level keeps the farthest depth of 2x2 pixels of the previous one
+    void BuildDepthHierarchy();
+
+    unsigned int GetRasterizeThreadCount(unsigned int tileRowCount) const;
+
+private:
+    int m_width;
+    int m_height;
+
+    WorkerPool* m_workerPool;
+    unsigned int m_threadCount;
+
+    glm::mat4 m_viewProjMatrix;
+
+    std::vector<Occluder> m_occluders;
+    std::vector<Triangle> m_triangles;
+    std::vector<OccluderTriangles> m_occluderTriangles;
+
+    // Level 0 is the depth buffer, each next level has half the resolution
+    std::vector<std::vector<float>> m_depthLevels;
+
+    Stats m_stats;
+};
@@ -1,24 +1,113 @@
 #pragma once
 
 #include <ituGL/scene/SceneVisitor.h>
+#include <ituGL/scene/FrustumCuller.h>
+#include <glm/mat4x4.hpp>
+#include <vector>
 
 class Renderer;
+class Scene;
 class SceneCamera;
 class SceneLight;
 class SceneModel;
 class Transform;
+class Model;
+class OcclusionCuller;
+class ShadowRenderPass;
+struct OccluderMesh;
 
+// Adds the cameras, lights and models of a scene to the renderer
+// The first camera is the main view, other cameras are added as extra views (split screen)
+// Models are culled against the frustums of all the renderer views when the visit ends, in a single pass over their bounds
+// Each model is added once, with the mask of the views where it is visible
+// The LOD of each visible model is selected in the same pass, from its size on the screen of the main view
+// With a shadow pass, its views are added before the culling, and static models are skipped in the tiles with cached depth
+// VisitScene culls with the hierarchy and the grid of the scene instead, so the models outside of the views are never visited
 class RendererSceneVisitor : public SceneVisitor
 {
 public:
     RendererSceneVisitor(Renderer& renderer);
 
+    void BeginVisit() override;
+    void EndVisit() override;
+
     void VisitCamera(SceneCamera& sceneCamera) override;
 
     void VisitLight(SceneLight& sceneLight) override;
 
     void VisitModel(SceneModel& sceneModel) override;
 
+    // Visit the nodes without bounds of the scene, like the cameras and lights, and then only the models in the frustums of the views
+    // The models are found with a single query of the scene for all the views. Call Scene::UpdateBounds first if dynamic nodes moved
+    void VisitScene(Scene& scene);
+
+    inline bool GetFrustumCulling() const { return m_frustumCulling; }
+    inline void SetFrustumCulling(bool frustumCulling) { m_frustumCulling = frustumCulling; }
+
+    // If disabled, models are always rendered with LOD 0
+    inline bool GetLodSelection() const { return m_lodSelection; }
+    inline void SetLodSelection(bool lodSelection) { m_lodSelection = lodSelection; }
+
+    // Fraction of the LOD screen sizes that the size has to pass before changing the LOD of a model
+    inline float GetLodHysteresis() const { return m_lodHysteresis; }
+    inline void SetLodHysteresis(float lodHysteresis) { m_lodHysteresis = lodHysteresis; }
+
+    // If set, models hidden by the occluders of other models are culled too, after the frustum culling. Only for the main view
+    // The culler rasterizes the occluders in the worker pool of the renderer
+    inline OcclusionCuller* GetOcclusionCuller() const { return m_occlusionCuller; }
+    void SetOcclusionCuller(OcclusionCuller* occlusionCuller);
+
+    // If set, the shadow views are added when the visit ends, and static nodes are only added to the static shadow views
+    inline ShadowRenderPass* GetShadowRenderPass() const { return m_shadowRenderPass; }
+    inline void SetShadowRenderPass(ShadowRenderPass* shadowRenderPass) { m_shadowRenderPass = shadowRenderPass; }
+
+    // Number of models in the last visit that were outside of the frustums of all the views. With VisitScene, the ones not found by the query
+    inline unsigned int GetCulledModelCount() const { return m_culledModelCount; }
+
+    // Number of models in the last visit that were hidden by occluders in the main view
+    inline unsigned int GetOccludedModelCount() const { return m_occludedModelCount; }
+
+private:
+    // Fill m_frustums with the frustums of the renderer views
+    void UpdateViewFrustums();
+
+    // Keep only the models in the indices, in the same order
+    void KeepModels(const std::vector<unsigned int>& indices);
+
+    // Draw the occluders of the models in the main view, and remove the main view from the hidden ones
+    void CullOccludedModels(const glm::mat4& viewProjMatrix);
 private:
     Renderer& m_renderer;
+
+    bool m_frustumCulling;
+
+    bool m_lodSelection;
+    float m_lodHysteresis;
+
+    OcclusionCuller* m_occlusionCuller;
+
+    ShadowRenderPass* m_shadowRenderPass;
+
+    // Models are only collected between BeginVisit and EndVisit
+    bool m_visitingScene;
+
+    // Models were found by the query of VisitScene, with the mask of the views they intersect in m_visitViewMask
+    bool m_sceneCulled;
+    uint32_t m_visitViewMask;
+
+    // Frustums of the renderer views, kept to reuse the memory
+    std::vector<FrustumBounds> m_frustums;
+
+    // Models waiting for the culling, with their scene nodes, world matrices, occluders, bounds and LODs
+    std::vector<SceneModel*> m_sceneModels;
+    std::vector<const Model*> m_models;
+    std::vector<glm::mat4> m_worldMatrices;
+    std::vector<const OccluderMesh*> m_occluders;
+    std::vector<AabbBounds> m_bounds;
+    std::vector<uint32_t> m_viewMasks;
+    std::vector<unsigned int> m_lods;
+    FrustumCuller m_frustumCuller;
+
+    unsigned int m_culledModelCount;
+    unsigned int m_occludedModelCount;
 };
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <ituGL/scene/Bounds.h>
+#include <ituGL/scene/EntityStore.h>
+#include <ituGL/scene/BoundingVolumeHierarchy.h>
+#include <ituGL/scene/SpatialHashGrid.h>
+#include <ituGL/scene/TransformHierarchy.h>
 #include <unordered_map>
+#include <vector>
 #include <string>
 #include <memory>
+#include <span>
 
 class SceneNode;
 class SceneVisitor;
+class WorkerPool;
 
 class Scene
 {
@@ -23,6 +31,140 @@ public:
     void AcceptVisitor(SceneVisitor& visitor);
     void AcceptVisitor(SceneVisitor& visitor) const;
 
+    // Changes every time a node is added or removed, to know when data collected from the nodes is outdated
+    inline unsigned int GetNodeVersion() const { return m_nodeVersion; }
+
+    // Transforms of the nodes in the scene. Adding a node moves the tree of its transform here
+    inline const std::shared_ptr<TransformHierarchy>& GetTransformHierarchy() const { return m_transformHierarchy; }
+
+    // Pool used by the large updates of the scene, like the world matrices and the grid. Without a pool, they run in the calling thread
+    void SetWorkerPool(WorkerPool* workerPool);
+
+    // Storage of the nodes and their components, for typed iteration without visitors
+    inline EntityStore& GetEntityStore() { return m_entities; }
+    inline const EntityStore& GetEntityStore() const { return m_entities; }
+
+    // Update the grid with the new bounds of the dynamic nodes. Call it after moving them, before the spatial queries
+    void UpdateBounds();
+
+    // Visit the nodes with bounds that intersect the frustum, and all the nodes without bounds, like cameras and lights
+    void AcceptVisitor(SceneVisitor& visitor, const FrustumBounds& frustum);
+
+    // Visit the nodes with bounds that intersect the bounds
+    void AcceptVisitor(SceneVisitor& visitor, const AabbBounds& bounds);
+    void AcceptVisitor(SceneVisitor& visitor, const SphereBounds& bounds);
+
+    // Number of nodes with bounds, in the hierarchy and the grid
+    unsigned int GetBoundedNodeCount() const;
+
+    // Call function(node) for each node without bounds, like cameras and lights
+    template<typename TFunction>
+    void ForEachUnboundedNode(TFunction function);
+
+    // Call function(node, frustumMask) once for each node with bounds that intersects any of the frustums, up to 32
+    // Bit i of the mask is set if the node intersects frustum i. The hierarchy is traversed once for all the frustums
+    template<typename TFunction>
+    void QueryNodes(std::span<const FrustumBounds> frustums, TFunction function);
+
+    // Find the closest node with bounds hit by the ray, and the distance to its bounds. Returns nullptr if there is none
+    std::shared_ptr<SceneNode> RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance);
+
 private:
-    std::unordered_map<std::string, std::shared_ptr<SceneNode>> m_nodes;
+    // Static nodes with bounds, in a BVH
+    struct Hierarchy
+    {
+        BoundingVolumeHierarchy bvh;
+        std::vector<std::shared_ptr<SceneNode>> nodes;
+        std::vector<AabbBounds> bounds;
+        // Nodes were added or removed, the BVH must be built again
+        bool dirty = false;
+    };
+
+    // Dynamic nodes with bounds, in a grid that can be updated every frame
+    struct Grid
+    {
+        SpatialHashGrid grid;
+        // Indexed by the handle in the grid, nullptr for free handles
+        std::vector<std::shared_ptr<SceneNode>> nodes;
+        std::unordered_map<const SceneNode*, SpatialHashGrid::Handle> handles;
+        // Arrays for the batched update, kept to reuse the memory
+        std::vector<SpatialHashGrid::Handle> updateHandles;
+        std::vector<AabbBounds> updateBounds;
+        // Frustum masks of the query with several frustums, indexed by handle, and the handles found
+        std::vector<uint32_t> queryMasks;
+        std::vector<SpatialHashGrid::Handle> queryHandles;
+    };
+
+    void AddToHierarchy(std::shared_ptr<SceneNode> node);
+    void RemoveFromHierarchy(const std::shared_ptr<SceneNode>& node);
+
+    // Collect the bounds of the nodes and build the BVH
+    static void BuildHierarchy(Hierarchy& hierarchy);
+
+    // Build the static hierarchy if it has changed nodes
+    void BuildDirtyHierarchies();
+
+    // Call function(node) for each node in the hierarchy and the grid that passes the query
+    template<typename TBounds, typename TFunction>
+    void QueryHierarchies(const TBounds& bounds, TFunction function);
+
+private:
+    // Shared with the transforms, so it lives as long as the last of them
+    std::shared_ptr<TransformHierarchy> m_transformHierarchy;
+
+    // Each node is an entity, found by name with the name index
+    EntityStore m_entities;
+
+    Hierarchy m_staticHierarchy;
+    Grid m_dynamicGrid;
+
+    // Nodes that can't be in the hierarchy or the grid
+    std::vector<std::shared_ptr<SceneNode>> m_unboundedNodes;
+
+    unsigned int m_nodeVersion;
 };
+
+template<typename TBounds, typename TFunction>
+void Scene::QueryHierarchies(const TBounds& bounds, TFunction function)
+{
+    BuildDirtyHierarchies();
+    m_staticHierarchy.bvh.Query(bounds, [&](unsigned int index) { function(*m_staticHierarchy.nodes[index]); });
+    m_dynamicGrid.grid.Query(bounds, [&](SpatialHashGrid::Handle handle) { function(*m_dynamicGrid.nodes[handle]); });
+}
+
+template<typename TFunction>
+void Scene::ForEachUnboundedNode(TFunction function)
+{
+    for (auto& node : m_unboundedNodes)
+    {
+        function(*node);
+    }
+}
+
+template<typename TFunction>
+void Scene::QueryNodes(std::span<const FrustumBounds> frustums, TFunction function)
+{
+    BuildDirtyHierarchies();
+    m_staticHierarchy.bvh.Query(frustums, [&](unsigned int index, uint32_t frustumMask) { function(*m_staticHierarchy.nodes[index], frustumMask); });
+
+    // The grid is queried once per frustum, so the masks of each node are merged before calling the function
+    Grid& grid = m_dynamicGrid;
+    grid.queryMasks.resize(grid.nodes.size(), 0);
+    grid.queryHandles.clear();
+    for (unsigned int frustumIndex = 0; frustumIndex < frustums.size(); ++frustumIndex)
+    {
+        grid.grid.Query(frustums[frustumIndex], [&](SpatialHashGrid::Handle handle)
+            {
+                if (grid.queryMasks[handle] == 0)
+                {
+                    grid.queryHandles.push_back(handle);
+                }
+                grid.queryMasks[handle] |= 1u << frustumIndex;
+            });
+    }
+    for (SpatialHashGrid::Handle handle : grid.queryHandles)
+    {
+        function(*grid.nodes[handle], grid.queryMasks[handle]);
+        grid.queryMasks[handle] = 0;
+    }
+}
@@ -4,6 +4,8 @@
 //#include <ituGL/renderer/Renderable.h>
 
 class Model;
+class Mesh;
+struct OccluderMesh;
 
 class SceneModel : public SceneNode//, public Renderable
 {
@@ -14,6 +16,14 @@ public:
     std::shared_ptr<Model> GetModel() const;
     void SetModel(std::shared_ptr<Model> model);
 
+    // Simplified geometry used to hide other models in the OcclusionCuller. Models without it don't hide anything
+    std::shared_ptr<const OccluderMesh> GetOccluder() const;
+    void SetOccluder(std::shared_ptr<const OccluderMesh> occluder);
+
+    // LOD of the model selected the last time it was rendered, kept to apply hysteresis in the next selection
+    inline unsigned int GetLod() const { return m_lod; }
+    inline void SetLod(unsigned int lod) { m_lod = lod; }
+
     //glm::mat4 GetWorldMatrix() const override;
     //int GetDrawcallCount() const override;
     //const Drawcall& GetDrawcall(int index, const VertexArrayObject*& vao, const Material*& material) const override;
@@ -22,9 +32,20 @@ public:
     AabbBounds GetAabbBounds() const override;
     BoxBounds GetBoxBounds() const override;
 
+    // Only models with mesh bounds are in the scene hierarchy
+    bool HasBounds() const override;
+
     void AcceptVisitor(SceneVisitor& visitor) override;
     void AcceptVisitor(SceneVisitor& visitor) const override;
 
+private:
+    // AABB of the mesh in local space
+    static AabbBounds GetLocalBounds(const Mesh& mesh);
+
 private:
     std::shared_ptr<Model> m_model;
+
+    std::shared_ptr<const OccluderMesh> m_occluder;
+
+    unsigned int m_lod;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ituGL/scene/Bounds.h>
+#include <ituGL/scene/EntityStore.h>
 #include <string>
 #include <memory>
 
@@ -19,6 +20,9 @@ public:
     const std::string& GetName() const;
     void Rename(const std::string& name);
 
+    // Entity of the node in the EntityStore of its scene. Null if it is not in a scene
+    inline Entity GetEntity() const { return m_entity; }
+
     std::shared_ptr<Transform> GetTransform();
     std::shared_ptr<const Transform> GetTransform() const;
     void SetTransform(std::shared_ptr<Transform> transform);
@@ -27,16 +31,29 @@ public:
     virtual AabbBounds GetAabbBounds() const;
     virtual BoxBounds GetBoxBounds() const;
 
+    // Nodes with bounds are added to the scene hierarchy, so they can be found by spatial queries
+    virtual bool HasBounds() const;
+
+    // Static nodes are not expected to move, their bounds are only updated when the scene hierarchy is rebuilt
+    // Must be set before adding the node to the scene
+    inline bool IsStatic() const { return m_static; }
+    void SetStatic(bool isStatic);
+
     virtual void AcceptVisitor(SceneVisitor& visitor);
     virtual void AcceptVisitor(SceneVisitor& visitor) const;
 
+protected:
+    Scene* GetOwnerScene() const;
+
 private:
     friend class Scene;
 
-    Scene* GetOwnerScene() const;
     void SetOwnerScene(Scene* scene);
 
     Scene* m_scene;
+    Entity m_entity;
+
+    bool m_static;
 
 protected:
     std::string m_name;
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <span>
+#include <memory>
+#include <cstdint>
+
+class Scene;
+class Model;
+
+// Binary file with the nodes of a scene: hierarchy, transforms, lights, cameras, model references and material values
+// The file is a header followed by arrays of fixed size records, so it can be mapped in memory and used in place
+// Meshes, textures and shaders are not in the file, models are referenced by name and provided by the application
+class SceneSnapshot
+{
+public:
+    // Returns the name used to reference the model in the file. Empty to save the node without model
+    using ModelNameFunction = std::function<std::string(const Model& model)>;
+
+    // Returns the model for a reference name, when instantiating the scene. nullptr to create the node without model
+    using ModelFunction = std::function<std::shared_ptr<Model>(std::string_view name)>;
+
+    enum class NodeType : uint32_t
+    {
+        Node,
+        Model,
+        Light,
+        Camera,
+    };
+
+    // Offset and number of elements of a range in one of the arrays
+    struct Range
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+
+        // Ranges of the arrays in the file, offsets in bytes from the start of the file
+        Range nodes;
+        Range models;
+        Range materials;
+        Range lights;
+        Range cameras;
+        Range intValues;
+        Range uintValues;
+        Range floatValues;
+        Range doubleValues;
+        Range strings;
+    };
+
+    struct NodeRecord
+    {
+        // Range in the strings array
+        Range name;
+        // Index of the node with the parent transform, -1 if it has no parent
+        int32_t parent;
+        NodeType type;
+        // Index in the array of models, lights or cameras, depending on the type
+        uint32_t dataIndex;
+        uint32_t isStatic;
+        glm::vec3 translation;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+        uint32_t padding;
+    };
+
+    struct ModelRecord
+    {
+        // Range in the strings array
+        Range reference;
+        // Range in the array of materials
+        Range materials;
+    };
+
+    // Values of the data uniforms of one material, as ranges of the value arrays
+    struct MaterialRecord
+    {
+        Range intValues;
+        Range uintValues;
+        Range floatValues;
+        Range doubleValues;
+    };
+
+    struct LightRecord
+    {
+        // Light::Type
+        uint32_t type;
+        glm::vec3 color;
+        float intensity;
+        glm::vec3 position;
+        glm::vec3 direction;
+        float angle;
+        glm::vec2 distanceAttenuation;
+        glm::vec2 angleAttenuation;
+    };
+
+    struct CameraRecord
+    {
+        glm::mat4 viewMatrix;
+        glm::mat4 projectionMatrix;
+    };
+
+public:
+    SceneSnapshot();
+    ~SceneSnapshot();
+
+    // Not copyable, it owns the mapping of the file
+    SceneSnapshot(const SceneSnapshot&) = delete;
+    SceneSnapshot& operator = (const SceneSnapshot&) = delete;
+
+    // Write all the nodes of the scene to the file. Returns false if the file can't be written
+    static bool Save(const Scene& scene, const char* path, const ModelNameFunction& getModelName);
+
+    // Map the file in memory. Returns false if it can't be opened, or if it has a different version
+    bool Load(const char* path);
+    void Unload();
+
+    inline bool IsLoaded() const { return m_data != nullptr; }
+
+    // Arrays of the loaded file, pointing to the mapped memory
+    inline std::span<const NodeRecord> GetNodes() const { return GetArray<NodeRecord>(GetHeader().nodes); }
+    inline std::span<const ModelRecord> GetModels() const { return GetArray<ModelRecord>(GetHeader().models); }
+    inline std::span<const MaterialRecord> GetMaterials() const { return GetArray<MaterialRecord>(GetHeader().materials); }
+    inline std::span<const LightRecord> GetLights() const { return GetArray<LightRecord>(GetHeader().lights); }
+    inline std::span<const CameraRecord> GetCameras() const { return GetArray<CameraRecord>(GetHeader().cameras); }
+
+    // Text of a range in the strings array
+    std::string_view GetString(const Range& range) const;
+
+    // Add the nodes of the loaded file to the scene, and restore the material values of their models
+    void Instantiate(Scene& scene, const ModelFunction& getModel) const;
+
+public:
+    static const uint32_t Version = 1;
+
+private:
+    inline const Header& GetHeader() const { return *reinterpret_cast<const Header*>(m_data); }
+
+    template<typename T>
+    std::span<const T> GetArray(const Range& range) const
+    {
+        return std::span<const T>(reinterpret_cast<const T*>(m_data + range.offset), range.count);
+    }
+
+    // Check that the header is valid and all the arrays are inside the file
+    bool Validate() const;
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+};
@@ -8,6 +8,10 @@ class Renderable;
 class SceneVisitor
 {
 public:
+    // Called by the Scene before and after visiting all its nodes
+    virtual void BeginVisit();
+    virtual void EndVisit();
+
     virtual void VisitCamera(SceneCamera& sceneCamera);
     virtual void VisitCamera(const SceneCamera& sceneCamera);
 
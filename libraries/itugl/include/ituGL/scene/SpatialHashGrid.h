@@ -0,0 +1,216 @@
+#pragma once
+
+#include <ituGL/scene/Bounds.h>
+#include <glm/vec3.hpp>
+#include <unordered_map>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+class WorkerPool;
+
+// Uniform grid of cells stored in a hash map, for items that move every frame
+// Each item is in the cell that contains its center, so inserting, moving and removing don't depend on the item count
+// Cells are loose: queries are expanded by the largest item half size, so items should be smaller than a cell
+class SpatialHashGrid
+{
+public:
+    using Handle = unsigned int;
+    static const Handle InvalidHandle = ~0u;
+
+public:
+    SpatialHashGrid(float cellSize = DefaultCellSize);
+
+    inline float GetCellSize() const { return m_cellSize; }
+
+    // Pool that runs large batched moves in parallel. Without a pool, they run in the calling thread
+    inline WorkerPool* GetWorkerPool() const { return m_workerPool; }
+    inline void SetWorkerPool(WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+    // Maximum number of threads of the pool used by the batched Move. 0 uses all the hardware threads
+    inline unsigned int GetThreadCount() const { return m_threadCount; }
+    inline void SetThreadCount(unsigned int threadCount) { m_threadCount = threadCount; }
+
+    // Add an item and return its handle. Handles of removed items are reused
+    Handle Insert(const AabbBounds& bounds);
+
+    void Remove(Handle handle);
+
+    // Update the bounds of an item
+    void Move(Handle handle, const AabbBounds& bounds);
+
+    // Update the bounds of many items, in parallel if there are enough. handles[i] gets bounds[i], and the handles must be different
+    void Move(std::span<const Handle> handles, std::span<const AabbBounds> bounds);
+
+    // Remove all the items
+    void Clear();
+
+    inline unsigned int GetItemCount() const { return static_cast<unsigned int>(m_items.size() - m_freeHandles.size()); }
+    inline unsigned int GetCellCount() const { return static_cast<unsigned int>(m_cells.size()); }
+
+    // Call function(handle) for each item that intersects the bounds
+    template<typename TFunction>
+    void Query(const FrustumBounds& frustum, TFunction function) const;
+    template<typename TFunction>
+    void Query(const AabbBounds& bounds, TFunction function) const;
+    template<typename TFunction>
+    void Query(const SphereBounds& sphere, TFunction function) const;
+
+    // Call function(handle, distance) for each item with bounds hit by the ray, at distance along the direction
+    // The function returns the new maximum distance, so the closest hit can be found by returning the distance
+    template<typename TFunction>
+    void RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TFunction function) const;
+
+public:
+    static constexpr float DefaultCellSize = 4.0f;
+
+private:
+    using CellKey = uint64_t;
+
+    struct Item
+    {
+        glm::vec3 boundsMin;
+        // Position of the item in the list of its cell
+        unsigned int cellSlot;
+        glm::vec3 boundsMax;
+        bool valid;
+        CellKey cellKey;
+    };
+
+    struct Cell
+    {
+        glm::ivec3 coordinates;
+        std::vector<Handle> handles;
+    };
+
+    CellKey GetCellKey(const glm::ivec3& coordinates) const;
+    glm::ivec3 GetCellCoordinates(const glm::vec3& position) const;
+
+    void AddToCell(Handle handle, const glm::ivec3& coordinates);
+    void RemoveFromCell(Handle handle);
+
+    unsigned int GetMoveThreadCount(unsigned int itemCount) const;
+
+    // Visit the items that pass test(min, max), skipping the cells whose loose bounds fail it
+    // If the query has bounds, only the cells in its range are looked up, when there are fewer of them than occupied cells
+    template<typename TTest, typename TFunction>
+    void Traverse(const glm::vec3* queryMin, const glm::vec3* queryMax, TTest test, TFunction function) const;
+
+private:
+    float m_cellSize;
+
+    WorkerPool* m_workerPool;
+    unsigned int m_threadCount;
+
+    // Items of each thread of the batched Move that changed cell, and the largest half size. Reused between moves
+    std::vector<std::vector<unsigned int>> m_threadCellChanges;
+    std::vector<float> m_threadMaxHalfSizes;
+
+    std::vector<Item> m_items;
+    std::vector<Handle> m_freeHandles;
+
+    std::unordered_map<CellKey, Cell> m_cells;
+
+    // Largest half size of any item inserted since the last Clear
+    float m_maxHalfSize;
+};
+
+template<typename TTest, typename TFunction>
+void SpatialHashGrid::Traverse(const glm::vec3* queryMin, const glm::vec3* queryMax, TTest test, TFunction function) const
+{
+    auto visitCell = [&](const Cell& cell)
+    {
+        glm::vec3 cellMin = glm::vec3(cell.coordinates) * m_cellSize - m_maxHalfSize;
+        glm::vec3 cellMax = glm::vec3(cell.coordinates + 1) * m_cellSize + m_maxHalfSize;
+        if (test(cellMin, cellMax))
+        {
+            for (Handle handle : cell.handles)
+            {
+                const Item& item = m_items[handle];
+                if (test(item.boundsMin, item.boundsMax))
+                {
+                    function(handle);
+                }
+            }
+        }
+    };
+
+    if (queryMin && queryMax)
+    {
+        // Cells that can contain items overlapping the query
+        glm::ivec3 minCoordinates = GetCellCoordinates(*queryMin - m_maxHalfSize);
+        glm::ivec3 maxCoordinates = GetCellCoordinates(*queryMax + m_maxHalfSize);
+        glm::vec3 cellRange = glm::vec3(maxCoordinates - minCoordinates + 1);
+        if (cellRange.x * cellRange.y * cellRange.z < static_cast<float>(m_cells.size()))
+        {
+            for (int z = minCoordinates.z; z <= maxCoordinates.z; ++z)
+            {
+                for (int y = minCoordinates.y; y <= maxCoordinates.y; ++y)
+                {
+                    for (int x = minCoordinates.x; x <= maxCoordinates.x; ++x)
+                    {
+                        auto it = m_cells.find(GetCellKey(glm::ivec3(x, y, z)));
+                        if (it != m_cells.end())
+                        {
+                            visitCell(it->second);
+                        }
+                    }
+                }
+            }
+            return;
+        }
+    }
+
+    for (const auto& pair : m_cells)
+    {
+        visitCell(pair.second);
+    }
+}
+
+template<typename TFunction>
+void SpatialHashGrid::Query(const FrustumBounds& frustum, TFunction function) const
+{
+    // The frustum can be unbounded, so all the occupied cells are tested
+    Traverse(nullptr, nullptr, [&](const glm::vec3& boxMin, const glm::vec3& boxMax) { return frustum.IntersectsBox(boxMin, boxMax); }, function);
+}
+
+template<typename TFunction>
+void SpatialHashGrid::Query(const AabbBounds& bounds, TFunction function) const
+{
+    glm::vec3 queryMin = bounds.GetMin();
+    glm::vec3 queryMax = bounds.GetMax();
+    Traverse(&queryMin, &queryMax, [&](const glm::vec3& boxMin, const glm::vec3& boxMax) { return bounds.IntersectsBox(boxMin, boxMax); }, function);
+}
+
+template<typename TFunction>
+void SpatialHashGrid::Query(const SphereBounds& sphere, TFunction function) const
+{
+    glm::vec3 queryMin = sphere.GetCenter() - sphere.GetRadius();
+    glm::vec3 queryMax = sphere.GetCenter() + sphere.GetRadius();
+    Traverse(&queryMin, &queryMax, [&](const glm::vec3& boxMin, const glm::vec3& boxMax) { return sphere.IntersectsBox(boxMin, boxMax); }, function);
+}
+
+template<typename TFunction>
+void SpatialHashGrid::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TFunction function) const
+{
+    glm::vec3 inverseDirection = 1.0f / direction;
+    for (const auto& pair : m_cells)
+    {
+        const Cell& cell = pair.second;
+        glm::vec3 cellMin = glm::vec3(cell.coordinates) * m_cellSize - m_maxHalfSize;
+        glm::vec3 cellMax = glm::vec3(cell.coordinates + 1) * m_cellSize + m_maxHalfSize;
+        if (AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, cellMin, cellMax) < 0.0f)
+        {
+            continue;
+        }
+        for (Handle handle : cell.handles)
+        {
+            const Item& item = m_items[handle];
+            float distance = AabbBounds::RayIntersection(origin, inverseDirection, maxDistance, item.boundsMin, item.boundsMax);
+            if (distance >= 0.0f)
+            {
+                maxDistance = function(handle, distance);
+            }
+        }
+    }
+}
@@ -1,25 +1,44 @@
 #pragma once
 
+#include <ituGL/scene/TransformHierarchy.h>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <memory>
+#include <vector>
 
+// Handle to a transform stored in a TransformHierarchy
+// A transform and its parents and children are always in the same hierarchy, that they keep alive
 class Transform
 {
 public:
+    // Create the transform in a new hierarchy of its own. Adding its node to a scene moves it to the hierarchy of the scene
     Transform();
+    Transform(std::shared_ptr<TransformHierarchy> hierarchy);
+    ~Transform();
 
-    inline glm::vec3 GetTranslation() const { return m_translation; }
-    inline void SetTranslation(const glm::vec3& translation) { m_translation = translation; m_dirty = true; }
+    // Not copyable, each transform owns its entry in the hierarchy
+    Transform(const Transform&) = delete;
+    Transform& operator = (const Transform&) = delete;
 
-    inline glm::vec3 GetRotation() const { return m_rotation; }
-    inline void SetRotation(const glm::vec3& rotation) { m_rotation = rotation; m_dirty = true; }
+    inline const std::shared_ptr<TransformHierarchy>& GetHierarchy() const { return m_hierarchy; }
 
-    inline glm::vec3 GetScale() const { return m_scale; }
-    inline void SetScale(const glm::vec3& scale) { m_scale = scale; m_dirty = true; }
+    // Move the whole tree of the transform, from its root, to the hierarchy. Ids of the moved transforms change
+    void SetHierarchy(std::shared_ptr<TransformHierarchy> hierarchy);
+
+    inline TransformHierarchy::Id GetId() const { return m_id; }
+
+    inline glm::vec3 GetTranslation() const { return m_hierarchy->GetTranslation(m_id); }
+    inline void SetTranslation(const glm::vec3& translation) { m_hierarchy->SetTranslation(m_id, translation); }
+
+    inline glm::vec3 GetRotation() const { return m_hierarchy->GetRotation(m_id); }
+    inline void SetRotation(const glm::vec3& rotation) { m_hierarchy->SetRotation(m_id, rotation); }
+
+    inline glm::vec3 GetScale() const { return m_hierarchy->GetScale(m_id); }
+    inline void SetScale(const glm::vec3& scale) { m_hierarchy->SetScale(m_id, scale); }
 
     inline std::shared_ptr<Transform> GetParent() const { return m_parent; }
-    inline void SetParent(std::shared_ptr<Transform> parent) { m_parent = parent; m_dirty = true; }
+    // If the parent is in another hierarchy, the transform and its descendants move to it
+    void SetParent(std::shared_ptr<Transform> parent);
 
     glm::mat4 GetTranslationMatrix() const;
     glm::mat4 GetRotationMatrix() const;
@@ -27,16 +46,19 @@ public:
 
     glm::mat4 GetTransformMatrix() const;
 
-    bool IsDirty() const;
+    inline bool IsDirty() const { return m_hierarchy->IsDirty(m_id); }
+
+private:
+    // Create the transform and its descendants in the hierarchy, with the same values, and release their old ids
+    void MoveSubtree(const std::shared_ptr<TransformHierarchy>& hierarchy, TransformHierarchy::Id parentId);
 
 private:
-    glm::vec3 m_translation;
-    glm::vec3 m_rotation;
-    glm::vec3 m_scale;
+    std::shared_ptr<TransformHierarchy> m_hierarchy;
+    TransformHierarchy::Id m_id;
 
+    // Keeps the parent alive, the hierarchy only has its id
     std::shared_ptr<Transform> m_parent;
 
-    // Cached matrix
-    mutable glm::mat4 m_matrix;
-    mutable bool m_dirty;
+    // Needed to move the subtree to another hierarchy. The children keep this transform alive
+    std::vector<Transform*> m_children;
 };
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+class WorkerPool;
+
+// Storage for the data of many transforms, in contiguous arrays
+// Transforms are sorted depth-first, so each one is followed by all its descendants
+// Changes are only flagged; world matrices are recomputed in one pass over the changed subtrees, when they are needed
+// Each Scene has its own hierarchy, and transforms outside a scene have one for their tree
+class TransformHierarchy
+{
+public:
+    using Id = unsigned int;
+    static const Id InvalidId = ~0u;
+
+public:
+    TransformHierarchy();
+
+    // Pool that updates the world matrices of large changes in parallel. Without a pool, they are updated in the calling thread
+    inline WorkerPool* GetWorkerPool() const { return m_workerPool; }
+    inline void SetWorkerPool(WorkerPool* workerPool) { m_workerPool = workerPool; }
+
+    // Maximum number of threads of the pool used to update the world matrices. 0 uses all the hardware threads
+    inline unsigned int GetThreadCount() const { return m_threadCount; }
+    inline void SetThreadCount(unsigned int threadCount) { m_threadCount = threadCount; }
+
+    // Add a transform without parent, with identity TRS. Ids of destroyed transforms are reused
+    Id Create();
+
+    // The transform must not have children
+    void Destroy(Id id);
+
+    inline unsigned int GetTransformCount() const { return static_cast<unsigned int>(m_slots.size() - m_freeIds.size()); }
+
+    inline const glm::vec3& GetTranslation(Id id) const { return m_translations[m_slots[id]]; }
+    inline void SetTranslation(Id id, const glm::vec3& translation) { m_translations[m_slots[id]] = translation; MarkDirty(id); }
+
+    // Euler angles, applied in the order Y, X, Z
+    inline const glm::vec3& GetRotation(Id id) const { return m_rotations[m_slots[id]]; }
+    inline void SetRotation(Id id, const glm::vec3& rotation) { m_rotations[m_slots[id]] = rotation; MarkDirty(id); }
+
+    inline const glm::vec3& GetScale(Id id) const { return m_scales[m_slots[id]]; }
+    inline void SetScale(Id id, const glm::vec3& scale) { m_scales[m_slots[id]] = scale; MarkDirty(id); }
+
+    Id GetParent(Id id) const;
+    void SetParent(Id id, Id parentId);
+
+    // True if a parent changed without keeping the depth-first order, so the next update sorts the transforms again
+    inline bool IsOrderChanged() const { return m_orderChanged; }
+
+    // True if the transform or one of its ancestors changed since the world matrices were updated
+    bool IsDirty(Id id) const;
+
+    // World matrix of the transform, updating the changed transforms first
+    glm::mat4 GetWorldMatrix(Id id);
+
+    // Recompute the world matrices of the changed transforms and their descendants
+    void UpdateWorldMatrices();
+
+    static glm::mat4 ComputeRotationMatrix(const glm::vec3& rotation);
+    static glm::mat4 ComputeLocalMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale);
+
+private:
+    void MarkDirty(Id id);
+
+    inline bool HasChanges() const { return m_orderChanged || !m_dirtyIds.empty(); }
+
+    // Sort the transforms depth-first again, after parents changed, and remove the free slots
+    void SortDepthFirst();
+
+    // Compute the world matrices of the slots in [first, last), in order. The parent of the first one must be updated
+    void UpdateSlots(unsigned int first, unsigned int last);
+
+    unsigned int GetUpdateThreadCount(unsigned int slotCount) const;
+
+private:
+    WorkerPool* m_workerPool;
+    unsigned int m_threadCount;
+
+    // Indexed by slot, in depth-first order
+    std::vector<glm::vec3> m_translations;
+    std::vector<glm::vec3> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<glm::mat4> m_worldMatrices;
+    std::vector<unsigned int> m_parentSlots;
+    // Number of slots taken by the transform and its descendants
+    std::vector<unsigned int> m_subtreeSizes;
+    // InvalidId for the slots of destroyed transforms
+    std::vector<Id> m_ids;
+    std::vector<unsigned char> m_dirty;
+
+    // Indexed by id
+    std::vector<unsigned int> m_slots;
+    std::vector<Id> m_freeIds;
+
+    // Transforms with changes since the last update
+    std::vector<Id> m_dirtyIds;
+
+    // Parents changed, so the slots must be sorted again
+    bool m_orderChanged;
+
+    unsigned int m_freeSlotCount;
+};
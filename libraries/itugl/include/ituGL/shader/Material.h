@@ -126,6 +126,10 @@ public:
     // You can skip depth, stencil or blending using the override flags
     void Use(OverrideFlags overrideFlags = OverrideFlags::NoOverride) const;
 
+    // Set only depth properties, stencil properties, and blending, keeping the shader program and uniforms
+    // Useful to restore the render states when the material is already in use
+    void UseRenderStates(OverrideFlags overrideFlags = OverrideFlags::NoOverride) const;
+
 private:
     // Set all the properties relative to depth
     void UseDepthTest() const;
@@ -29,6 +29,9 @@ public:
     // Declare the type used for uniform locations
     using Location = GLint;
 
+    // Registration id of programs that are not registered in a Renderer
+    static const unsigned int InvalidRegistrationId = ~0u;
+
 public:
     ShaderProgram();
     virtual ~ShaderProgram();
@@ -116,6 +119,9 @@ public:
     // Set the shader program as the active one to be used for rendering
     void Use() const;
 
+    // Id assigned when the program is registered in a Renderer, used to find its binders without lookups
+    inline unsigned int GetRegistrationId() const { return m_registrationId; }
+
 private:
     // Build (Attach and link) all shaders provided for the rasterization pipeline
     bool Build(const Shader& vertexShader, const Shader& fragmentShader,
@@ -139,6 +145,10 @@ private:
     void SetUniforms(Location location, const T* values, GLsizei count) const;
 
 private:
+    // Registering doesn't modify the program, so the Renderer can assign the id to const programs
+    friend class Renderer;
+    mutable unsigned int m_registrationId;
+
 #ifndef NDEBUG
     inline bool IsUsed() const { return s_usedHandle == GetHandle(); }
     static Handle s_usedHandle;
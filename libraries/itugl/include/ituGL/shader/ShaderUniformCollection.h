@@ -68,6 +68,14 @@ public:
     template<typename T>
     T* GetDataUniformPointer(ShaderProgram::Location location);
 
+    // Get all the stored values of data uniforms of one type, in the order of the shader program. Used to save them
+    template<typename T>
+    inline std::span<const T> GetAllDataValues() const { return GetDataValues<T>(); }
+
+    // Restore all the values of one type. The shader program must be the same used when they were saved
+    template<typename T>
+    void SetAllDataValues(std::span<const T> values);
+
     // Set all the properties to the shader. Requires the shader program to be in use
     void SetUniforms() const;
 
@@ -300,6 +308,14 @@ void ShaderUniformCollection::SetUniformValues(ShaderProgram::Location location,
     std::memcpy(storedValues.data(), values.data(), values.size_bytes());
 }
 
+template<typename T>
+void ShaderUniformCollection::SetAllDataValues(std::span<const T> values)
+{
+    std::vector<T>& storedValues = GetDataValues<T>();
+    assert(values.size() == storedValues.size());
+    std::memcpy(storedValues.data(), values.data(), values.size_bytes());
+}
+
 template<typename T>
 inline std::vector<T>& ShaderUniformCollection::GetDataValues()
 {
@@ -30,6 +30,16 @@ public:
     void SetTexture(Target target, Attachment attachment, const Texture2DObject& texture, int level = 0);
 
     void SetDrawBuffers(std::span<const Attachment> attachments);
+    // Buffer used by reads and blits. Framebuffers without color attachments can use None
+    void SetReadBuffer(Attachment attachment);
+
+    // Copy a rectangle of the framebuffer bound to Read into the same rectangle of the framebuffer bound to Draw
+    // Mask is a combination of GL_COLOR_BUFFER_BIT, GL_DEPTH_BUFFER_BIT and GL_STENCIL_BUFFER_BIT
+    static void Blit(GLint x, GLint y, GLsizei width, GLsizei height, GLbitfield mask);
+
+    // Discard the contents of the attachments, so the driver doesn't need to keep them (GL 4.3)
+    // The framebuffer must be bound to the target
+    void Invalidate(Target target, std::span<const Attachment> attachments) const;
 
     static std::shared_ptr<const FramebufferObject> GetDefault();
 
@@ -49,7 +59,9 @@ enum class FramebufferObject::Target : GLenum
 
 enum class FramebufferObject::Attachment : GLenum
 {
+    None = GL_NONE,
     Depth = GL_DEPTH_ATTACHMENT,
+    DepthStencil = GL_DEPTH_STENCIL_ATTACHMENT,
     Color0 = GL_COLOR_ATTACHMENT0,
     Color1 = GL_COLOR_ATTACHMENT1,
     Color2 = GL_COLOR_ATTACHMENT2,
@@ -60,6 +60,7 @@ int Application::Run()
 
             // Swap buffers and poll events at the end of the frame
             m_mainWindow.SwapBuffers();
+            m_device.EndFrame();
             m_device.PollEvents();
         }
 
@@ -6,7 +6,9 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <glm/common.hpp>
 #include <iostream>
+#include <limits>
 #include <bit>
 
 ModelLoader::ModelLoader(std::shared_ptr<Material> referenceMaterial)
@@ -123,6 +125,17 @@ void ModelLoader::GenerateSubmesh(Mesh& mesh, const aiMesh& meshData)
     std::vector<GLubyte> elementData = CollectElementData(meshData, elementType, primitives, elementCounts);
     int eboIndex = mesh.AddElementData<GLubyte>(elementData);
 
+    // Grow the mesh bounds with the vertex positions, used for culling
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (unsigned int vertexIndex = 0; vertexIndex < meshData.mNumVertices; ++vertexIndex)
+    {
+        const aiVector3D& position = meshData.mVertices[vertexIndex];
+        boundsMin = glm::min(boundsMin, glm::vec3(position.x, position.y, position.z));
+        boundsMax = glm::max(boundsMax, glm::vec3(position.x, position.y, position.z));
+    }
+    mesh.AddBounds(boundsMin, boundsMax);
+
     // Add submeshes
     int start = 0;
     assert(primitives.size() == elementCounts.size());
@@ -1,5 +1,9 @@
 #include <ituGL/asset/TextureCubemapLoader.h>
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <cassert>
 #include <stb_image.h>
 
@@ -52,7 +56,7 @@ TextureCubemapObject TextureCubemapLoader::Load(const char* path)
 
             // Adjust mip levels
             textureCubemap.SetParameter(TextureObject::ParameterFloat::MinLod, 0.0f);
-            float maxLod = 1.0f + std::floorf(std::log2f(static_cast<float>(std::max(width, height))));
+            float maxLod = 1.0f + std::floor(std::log2(static_cast<float>(std::max(width, height))));
             textureCubemap.SetParameter(TextureObject::ParameterFloat::MaxLod, maxLod);
         }
 
@@ -1,5 +1,6 @@
 #include <ituGL/core/BufferObject.h>
 
+#include <ituGL/core/DeviceGL.h>
 #include <cassert>
 
 // Create the object initially null, get object handle and generate 1 buffer
@@ -13,6 +14,10 @@ BufferObject::BufferObject() : Object(NullHandle)
 BufferObject::~BufferObject()
 {
     Handle& handle = GetHandle();
+    if (DeviceGL* device = DeviceGL::GetInstancePointer())
+    {
+        device->ForgetBuffer(handle);
+    }
     glDeleteBuffers(1, &handle);
 }
 
@@ -30,14 +35,14 @@ BufferObject& BufferObject::operator = (BufferObject&& bufferObject) noexcept
 void BufferObject::Bind(Target target) const
 {
     Handle handle = GetHandle();
-    glBindBuffer(target, handle);
+    DeviceGL::GetInstance().BindBuffer(target, handle);
 }
 
 // Bind the null handle to the specific target
 void BufferObject::Unbind(Target target)
 {
     Handle handle = NullHandle;
-    glBindBuffer(target, handle);
+    DeviceGL::GetInstance().BindBuffer(target, handle);
 }
 
 // Get buffer Target and allocate buffer data
@@ -63,3 +68,10 @@ void BufferObject::UpdateData(std::span<const std::byte> data, size_t offset)
     Target target = GetTarget();
     glBufferSubData(target, offset, data.size_bytes(), data.data());
 }
+
+// Bind the buffer handle to the indexed binding point of the target
+void BufferObject::BindBase(Target target, GLuint index) const
+{
+    Handle handle = GetHandle();
+    DeviceGL::GetInstance().BindBufferBase(target, index, handle);
+}
@@ -2,14 +2,21 @@
 
 #include <ituGL/application/Window.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <limits>
 #include <cassert>
 
 DeviceGL* DeviceGL::m_instance = nullptr;
 
-DeviceGL::DeviceGL() : m_contextLoaded(false)
+// Passed by reference to the standard algorithms, so it needs a definition
+const GLuint DeviceGL::UnknownState;
+
+DeviceGL::DeviceGL() : m_contextLoaded(false), m_majorVersion(0), m_minorVersion(0)
 {
     m_instance = this;
 
+    InvalidateState();
+
     // Init GLFW
     glfwInit();
 }
@@ -35,13 +42,56 @@ void DeviceGL::SetCurrentWindow(Window& window)
     {
         // Set callback to be called when the window is resized
         glfwSetFramebufferSizeCallback(glfwWindow, FrameBufferResized);
+
+        UpdateVersion();
     }
+
+    // New context, we don't know its state
+    InvalidateState();
+}
+
+void DeviceGL::UpdateVersion()
+{
+    // The actual version can be higher than the one requested by the window
+    glGetIntegerv(GL_MAJOR_VERSION, &m_majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &m_minorVersion);
+}
+
+// Check if the context supports, at least, the OpenGL version
+bool DeviceGL::IsVersionSupported(int major, int minor) const
+{
+    return m_majorVersion > major || (m_majorVersion == major && m_minorVersion >= minor);
 }
 
 // Set the dimensions of the viewport
 void DeviceGL::SetViewport(GLint x, GLint y, GLsizei width, GLsizei height)
 {
-    glViewport(0, 0, width, height);
+    glViewport(x, y, width, height);
+}
+
+void DeviceGL::GetViewport(GLint& x, GLint& y, GLsizei& width, GLsizei& height) const
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    x = viewport[0];
+    y = viewport[1];
+    width = viewport[2];
+    height = viewport[3];
+}
+
+void DeviceGL::SetScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glScissor(x, y, width, height);
+}
+
+void DeviceGL::SetCullFace(GLenum face)
+{
+    glCullFace(face);
+}
+
+void DeviceGL::SetPolygonOffset(GLfloat factor, GLfloat units)
+{
+    glPolygonOffset(factor, units);
 }
 
 // Poll the events in the window event queue
@@ -85,12 +135,27 @@ void DeviceGL::Clear(bool clearColor, const Color& color, bool clearDepth, GLdou
 // Get if a feature is enabled
 bool DeviceGL::IsFeatureEnabled(GLenum feature) const
 {
-    return glIsEnabled(feature);
+    // Only query OpenGL if the feature is not in the cache
+    auto itFind = m_features.find(feature);
+    if (itFind == m_features.end())
+    {
+        itFind = m_features.emplace(feature, glIsEnabled(feature)).first;
+    }
+    return itFind->second;
 }
 
 // enable / disable a feature
 void DeviceGL::SetFeatureEnabled(GLenum feature, bool enabled)
 {
+    auto itFind = m_features.find(feature);
+    if (itFind != m_features.end() && itFind->second == enabled)
+    {
+        m_frameStateStats.filteredCalls++;
+        return;
+    }
+    m_features[feature] = enabled;
+    m_frameStateStats.issuedCalls++;
+
     if (enabled)
     {
         glEnable(feature);
@@ -112,3 +177,373 @@ void DeviceGL::SetVSyncEnabled(bool enabled)
 {
     glfwSwapInterval(enabled ? 1 : 0);
 }
+
+// Set the test function for depth
+void DeviceGL::SetDepthFunction(GLenum function)
+{
+    if (UpdateState(m_depthFunction, function))
+    {
+        glDepthFunc(function);
+    }
+}
+
+// Set if depth test writes to the depth buffer
+void DeviceGL::SetDepthWrite(bool depthWrite)
+{
+    if (UpdateState(m_depthWrite, static_cast<GLuint>(depthWrite)))
+    {
+        glDepthMask(depthWrite ? GL_TRUE : GL_FALSE);
+    }
+}
+
+// Set if the color buffers are written
+void DeviceGL::SetColorWrite(bool colorWrite)
+{
+    if (UpdateState(m_colorWrite, static_cast<GLuint>(colorWrite)))
+    {
+        GLboolean mask = colorWrite ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+}
+
+// Set the stencil test function
+void DeviceGL::SetStencilFunction(GLenum face, GLenum function, GLint refValue, GLuint mask)
+{
+    std::array<GLuint, 3> value = { function, static_cast<GLuint>(refValue), mask };
+    std::array<GLuint, 3> front = { m_stencilState[0][0], m_stencilState[0][1], m_stencilState[0][2] };
+    std::array<GLuint, 3> back = { m_stencilState[1][0], m_stencilState[1][1], m_stencilState[1][2] };
+
+    bool changeFront = face != GL_BACK && front != value;
+    bool changeBack = face != GL_FRONT && back != value;
+    if (!changeFront && !changeBack)
+    {
+        m_frameStateStats.filteredCalls++;
+        return;
+    }
+    m_frameStateStats.issuedCalls++;
+
+    // If only one side changed, we send only that one
+    if (changeFront && changeBack)
+    {
+        glStencilFunc(function, refValue, mask);
+    }
+    else
+    {
+        glStencilFuncSeparate(changeFront ? GL_FRONT : GL_BACK, function, refValue, mask);
+    }
+
+    for (int side = 0; side < 2; ++side)
+    {
+        if (side == 0 ? changeFront : changeBack)
+        {
+            std::copy(value.begin(), value.end(), m_stencilState[side].begin());
+        }
+    }
+}
+
+// Set the stencil operations
+void DeviceGL::SetStencilOperations(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+{
+    std::array<GLuint, 3> value = { stencilFail, depthFail, depthPass };
+    std::array<GLuint, 3> front = { m_stencilState[0][3], m_stencilState[0][4], m_stencilState[0][5] };
+    std::array<GLuint, 3> back = { m_stencilState[1][3], m_stencilState[1][4], m_stencilState[1][5] };
+
+    bool changeFront = face != GL_BACK && front != value;
+    bool changeBack = face != GL_FRONT && back != value;
+    if (!changeFront && !changeBack)
+    {
+        m_frameStateStats.filteredCalls++;
+        return;
+    }
+    m_frameStateStats.issuedCalls++;
+
+    // If only one side changed, we send only that one
+    if (changeFront && changeBack)
+    {
+        glStencilOp(stencilFail, depthFail, depthPass);
+    }
+    else
+    {
+        glStencilOpSeparate(changeFront ? GL_FRONT : GL_BACK, stencilFail, depthFail, depthPass);
+    }
+
+    for (int side = 0; side < 2; ++side)
+    {
+        if (side == 0 ? changeFront : changeBack)
+        {
+            std::copy(value.begin(), value.end(), m_stencilState[side].begin() + 3);
+        }
+    }
+}
+
+// Set the blend equation for color and alpha
+void DeviceGL::SetBlendEquation(GLenum equationColor, GLenum equationAlpha)
+{
+    if (UpdateState(m_blendEquations, std::array<GLenum, 2>{ equationColor, equationAlpha }))
+    {
+        if (equationColor == equationAlpha)
+        {
+            glBlendEquation(equationColor);
+        }
+        else
+        {
+            glBlendEquationSeparate(equationColor, equationAlpha);
+        }
+    }
+}
+
+// Set the blend parameters for color and alpha
+void DeviceGL::SetBlendFunction(GLenum sourceColor, GLenum destColor, GLenum sourceAlpha, GLenum destAlpha)
+{
+    if (UpdateState(m_blendParams, std::array<GLenum, 4>{ sourceColor, destColor, sourceAlpha, destAlpha }))
+    {
+        if (sourceColor == sourceAlpha && destColor == destAlpha)
+        {
+            glBlendFunc(sourceColor, destColor);
+        }
+        else
+        {
+            glBlendFuncSeparate(sourceColor, destColor, sourceAlpha, destAlpha);
+        }
+    }
+}
+
+// Set the blend parameters of one draw buffer
+void DeviceGL::SetBlendFunction(GLuint drawBuffer, GLenum sourceColor, GLenum destColor, GLenum sourceAlpha, GLenum destAlpha)
+{
+    assert(IsVersionSupported(4, 0));
+    glBlendFuncSeparatei(drawBuffer, sourceColor, destColor, sourceAlpha, destAlpha);
+    m_blendParams.fill(UnknownState);
+    m_frameStateStats.issuedCalls++;
+}
+
+// Set the blend color used by constant color and constant alpha parameters
+void DeviceGL::SetBlendColor(const Color& color)
+{
+    if (UpdateState(m_blendColor, static_cast<glm::vec4>(color)))
+    {
+        glBlendColor(color.GetRed(), color.GetGreen(), color.GetBlue(), color.GetAlpha());
+    }
+}
+
+// Set the shader program in use
+void DeviceGL::UseProgram(GLuint program)
+{
+    if (UpdateState(m_program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+// Bind the vertex array object
+void DeviceGL::BindVertexArray(GLuint vertexArray)
+{
+    if (UpdateState(m_vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+
+        // The element array buffer binding is part of the VAO state
+        m_buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UnknownState;
+    }
+}
+
+// Bind a buffer to the target
+void DeviceGL::BindBuffer(GLenum target, GLuint buffer)
+{
+    int targetIndex = GetBufferTargetIndex(target);
+    if (targetIndex < 0 || UpdateState(m_buffers[targetIndex], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Bind a buffer to an indexed binding point of the target. It also binds the generic target
+void DeviceGL::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    // Indexed bindings are not cached, but the generic binding has to be updated
+    int targetIndex = GetBufferTargetIndex(target);
+    if (targetIndex >= 0)
+    {
+        m_buffers[targetIndex] = buffer;
+    }
+    m_frameStateStats.issuedCalls++;
+    glBindBufferBase(target, index, buffer);
+}
+
+// Bind a framebuffer to the target
+void DeviceGL::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool changed = false;
+    switch (target)
+    {
+    case GL_DRAW_FRAMEBUFFER:
+        changed = m_drawFramebuffer != framebuffer;
+        m_drawFramebuffer = framebuffer;
+        break;
+    case GL_READ_FRAMEBUFFER:
+        changed = m_readFramebuffer != framebuffer;
+        m_readFramebuffer = framebuffer;
+        break;
+    default:
+        changed = m_drawFramebuffer != framebuffer || m_readFramebuffer != framebuffer;
+        m_drawFramebuffer = framebuffer;
+        m_readFramebuffer = framebuffer;
+        break;
+    }
+
+    if (changed)
+    {
+        m_frameStateStats.issuedCalls++;
+        glBindFramebuffer(target, framebuffer);
+    }
+    else
+    {
+        m_frameStateStats.filteredCalls++;
+    }
+}
+
+// Set the texture unit affected by BindTexture
+void DeviceGL::SetActiveTexture(GLint textureUnit)
+{
+    if (UpdateState(m_activeTexture, textureUnit))
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+    }
+}
+
+// Bind a texture to the target in the active texture unit
+void DeviceGL::BindTexture(GLenum target, GLuint texture)
+{
+    int targetIndex = GetTextureTargetIndex(target);
+    bool cached = targetIndex >= 0 && m_activeTexture >= 0 && m_activeTexture < CachedTextureUnits;
+    if (!cached || UpdateState(m_textures[m_activeTexture][targetIndex], texture))
+    {
+        glBindTexture(target, texture);
+    }
+}
+
+void DeviceGL::ForgetProgram(GLuint program)
+{
+    if (m_program == program)
+    {
+        m_program = UnknownState;
+    }
+}
+
+void DeviceGL::ForgetVertexArray(GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+    {
+        m_vertexArray = 0;
+    }
+}
+
+void DeviceGL::ForgetBuffer(GLuint buffer)
+{
+    for (GLuint& boundBuffer : m_buffers)
+    {
+        if (boundBuffer == buffer)
+        {
+            boundBuffer = 0;
+        }
+    }
+}
+
+void DeviceGL::ForgetFramebuffer(GLuint framebuffer)
+{
+    if (m_drawFramebuffer == framebuffer)
+    {
+        m_drawFramebuffer = 0;
+    }
+    if (m_readFramebuffer == framebuffer)
+    {
+        m_readFramebuffer = 0;
+    }
+}
+
+void DeviceGL::ForgetTexture(GLuint texture)
+{
+    for (auto& unitTextures : m_textures)
+    {
+        for (GLuint& boundTexture : unitTextures)
+        {
+            if (boundTexture == texture)
+            {
+                boundTexture = 0;
+            }
+        }
+    }
+}
+
+// Mark all the cached state as unknown
+void DeviceGL::InvalidateState()
+{
+    m_features.clear();
+
+    m_depthFunction = UnknownState;
+    m_depthWrite = UnknownState;
+
+    m_colorWrite = UnknownState;
+
+    for (auto& stencilState : m_stencilState)
+    {
+        stencilState.fill(UnknownState);
+    }
+
+    m_blendEquations.fill(UnknownState);
+    m_blendParams.fill(UnknownState);
+    // NaN is never equal to any color
+    m_blendColor = glm::vec4(std::numeric_limits<float>::quiet_NaN());
+
+    m_program = UnknownState;
+    m_vertexArray = UnknownState;
+    m_buffers.fill(UnknownState);
+    m_drawFramebuffer = UnknownState;
+    m_readFramebuffer = UnknownState;
+    m_activeTexture = -1;
+    for (auto& unitTextures : m_textures)
+    {
+        unitTextures.fill(UnknownState);
+    }
+}
+
+// Complete the current frame, storing and resetting the per-frame counters
+void DeviceGL::EndFrame()
+{
+    m_lastFrameStateStats = m_frameStateStats;
+    m_frameStateStats = StateStats();
+}
+
+int DeviceGL::GetBufferTargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return 0;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return 1;
+    case GL_SHADER_STORAGE_BUFFER:
+        return 2;
+    case GL_DRAW_INDIRECT_BUFFER:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+int DeviceGL::GetTextureTargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_CUBE_MAP:
+        return 1;
+    case GL_TEXTURE_2D_ARRAY:
+        return 2;
+    case GL_TEXTURE_3D:
+        return 3;
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,79 @@
+#include <ituGL/core/FrameArena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+FrameArena::FrameArena(size_t capacity) : m_currentFrame(0), m_reservedCapacity(capacity)
+{
+    for (Frame& frame : m_frames)
+    {
+        AddBlock(frame, capacity);
+    }
+    m_stats.capacity = capacity;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    Frame& frame = m_frames[m_currentFrame];
+    size_t usedBytes = frame.usedBytes;
+
+    // Find the first aligned address in the current block, or continue in a new one if it doesn't fit
+    // New blocks double the size of the last one, so a frame only needs a few of them while the arena grows
+    Block* block = &frame.blocks.back();
+    uintptr_t address = reinterpret_cast<uintptr_t>(block->data.get()) + frame.offset;
+    size_t padding = (alignment - address % alignment) % alignment;
+    if (frame.offset + padding + size > block->size)
+    {
+        AddBlock(frame, std::max(size + alignment, 2 * block->size));
+        block = &frame.blocks.back();
+        m_stats.capacity += block->size;
+        address = reinterpret_cast<uintptr_t>(block->data.get());
+        padding = (alignment - address % alignment) % alignment;
+        // The remaining space of the previous block is lost for this frame
+        usedBytes += frame.blocks[frame.blocks.size() - 2].size - frame.offset;
+        frame.offset = 0;
+    }
+
+    void* allocation = block->data.get() + frame.offset + padding;
+    frame.offset += padding + size;
+    frame.usedBytes = usedBytes + padding + size;
+
+    m_stats.usedBytes = frame.usedBytes;
+    m_stats.highWaterMark = std::max(m_stats.highWaterMark, frame.usedBytes);
+
+    return allocation;
+}
+
+void FrameArena::BeginFrame()
+{
+    m_currentFrame = 1 - m_currentFrame;
+    Frame& frame = m_frames[m_currentFrame];
+
+    // If the frame needed more blocks, replace them with a single one that can hold the whole frame
+    size_t capacity = std::max(m_reservedCapacity, m_stats.highWaterMark);
+    if (frame.blocks.size() > 1 || frame.blocks.front().size < capacity)
+    {
+        frame.blocks.clear();
+        AddBlock(frame, capacity);
+    }
+
+    frame.offset = 0;
+    frame.usedBytes = 0;
+
+    m_stats.usedBytes = 0;
+    m_stats.capacity = frame.blocks.front().size;
+}
+
+void FrameArena::Reserve(size_t capacity)
+{
+    m_reservedCapacity = std::max(m_reservedCapacity, capacity);
+}
+
+void FrameArena::AddBlock(Frame& frame, size_t size)
+{
+    frame.blocks.push_back(Block{ std::make_unique_for_overwrite<std::byte[]>(size), size });
+    m_stats.heapAllocations++;
+}
@@ -0,0 +1,99 @@
+#include <ituGL/core/WorkerPool.h>
+
+#include <cassert>
+
+WorkerPool::WorkerPool()
+    : m_generation(0)
+    , m_itemCount(0)
+    , m_threadCount(0)
+    , m_function(nullptr)
+    , m_context(nullptr)
+    , m_pendingCount(0)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    // Each thread is asked to stop and joined when it is destroyed, the stop token wakes it up
+    m_workers.clear();
+}
+
+void WorkerPool::Run(size_t itemCount, size_t threadCount, RangeFunction function, void* context)
+{
+    assert(threadCount > 0);
+
+    // Small jobs don't need to wake up the workers
+    if (threadCount == 1)
+    {
+        function(context, 0, 0, itemCount);
+        return;
+    }
+
+    // Threads are only created when a job needs more of them than ever before. They start waiting for the next job
+    while (m_workers.size() < threadCount - 1)
+    {
+        m_workers.emplace_back([this, threadIndex = m_workers.size() + 1, generation = m_generation](std::stop_token stopToken)
+            {
+                WorkerMain(stopToken, threadIndex, generation);
+            });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_itemCount = itemCount;
+        m_threadCount = threadCount;
+        m_function = function;
+        m_context = context;
+        m_pendingCount = threadCount - 1;
+        ++m_generation;
+    }
+    m_startCondition.notify_all();
+
+    // The calling thread takes the first range
+    RunRange(0);
+
+    // Wait for all the workers to finish
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return m_pendingCount == 0; });
+}
+
+void WorkerPool::WorkerMain(std::stop_token stopToken, size_t threadIndex, uint64_t generation)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_startCondition.wait(lock, stopToken, [&]() { return m_generation != generation; }))
+            {
+                // Stop requested
+                return;
+            }
+            generation = m_generation;
+
+            // Jobs with fewer threads leave the last workers idle
+            if (threadIndex >= m_threadCount)
+            {
+                continue;
+            }
+        }
+
+        RunRange(threadIndex);
+
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            done = --m_pendingCount == 0;
+        }
+        if (done)
+        {
+            m_doneCondition.notify_one();
+        }
+    }
+}
+
+void WorkerPool::RunRange(size_t threadIndex) const
+{
+    size_t begin = m_itemCount * threadIndex / m_threadCount;
+    size_t end = m_itemCount * (threadIndex + 1) / m_threadCount;
+    m_function(m_context, threadIndex, begin, end);
+}
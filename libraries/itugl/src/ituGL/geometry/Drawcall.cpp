@@ -5,7 +5,7 @@
 #include <cassert>
 
 Drawcall::Drawcall()
-    : m_primitive(Primitive::Invalid), m_first(0), m_count(0), m_eboType(Data::Type::None)
+    : m_primitive(Primitive::Invalid), m_first(0), m_count(0), m_eboType(Data::Type::None), m_instanceCount(1)
 {
 }
 
@@ -15,13 +15,19 @@ Drawcall::Drawcall(Primitive primitive, GLsizei count, GLint first)
 }
 
 Drawcall::Drawcall(Primitive primitive, GLsizei count, Data::Type eboType, GLint first)
-    : m_primitive(primitive), m_first(first), m_count(count), m_eboType(eboType)
+    : m_primitive(primitive), m_first(first), m_count(count), m_eboType(eboType), m_instanceCount(1)
 {
     assert(primitive != Primitive::Invalid);
     assert(first >= 0);
     assert(count > 0);
 }
 
+void Drawcall::SetInstanceCount(GLsizei instanceCount)
+{
+    assert(instanceCount > 0);
+    m_instanceCount = instanceCount;
+}
+
 // Execute the drawcall
 void Drawcall::Draw() const
 {
@@ -32,13 +38,88 @@ void Drawcall::Draw() const
     if (m_eboType == Data::Type::None)
     {
         // If no EBO is present, use glDrawArrays
-        glDrawArrays(primitive, m_first, m_count);
+        if (m_instanceCount == 1)
+        {
+            glDrawArrays(primitive, m_first, m_count);
+        }
+        else
+        {
+            glDrawArraysInstanced(primitive, m_first, m_count, m_instanceCount);
+        }
     }
     else
     {
         // If there is an EBO, use glDrawElements
         assert(ElementBufferObject::IsSupportedType(m_eboType));
         const char* basePointer = nullptr; // Actual element pointer is in VAO
-        glDrawElements(primitive, m_count, static_cast<GLenum>(m_eboType), basePointer + m_first);
+        if (m_instanceCount == 1)
+        {
+            glDrawElements(primitive, m_count, static_cast<GLenum>(m_eboType), basePointer + m_first);
+        }
+        else
+        {
+            glDrawElementsInstanced(primitive, m_count, static_cast<GLenum>(m_eboType), basePointer + m_first, m_instanceCount);
+        }
+    }
+}
+
+GLsizei Drawcall::GetTriangleCount() const
+{
+    switch (m_primitive)
+    {
+    case Primitive::Triangles:
+        return m_count / 3;
+    case Primitive::TrianglesAdjacency:
+        return m_count / 6;
+    case Primitive::TriangleStrip:
+    case Primitive::TriangleFan:
+        return m_count > 2 ? m_count - 2 : 0;
+    case Primitive::TriangleStripAdjacency:
+        return m_count > 5 ? (m_count - 4) / 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+// Get the parameters of the drawcall to be executed indirectly
+Drawcall::IndirectCommand Drawcall::GetIndirectCommand(GLuint baseInstance) const
+{
+    assert(IsValid());
+
+    IndirectCommand command;
+    command.count = m_count;
+    command.instanceCount = m_instanceCount;
+    if (m_eboType == Data::Type::None)
+    {
+        command.first = m_first;
+        command.baseVertex = baseInstance;
+        command.baseInstance = 0;
+    }
+    else
+    {
+        // For elements, m_first is in bytes, and the command needs the first index
+        command.first = m_first / Data::GetTypeSize(m_eboType);
+        command.baseVertex = 0;
+        command.baseInstance = baseInstance;
+    }
+    return command;
+}
+
+// Execute several drawcalls from the bound draw indirect buffer
+void Drawcall::DrawIndirect(Primitive primitive, Data::Type eboType, GLsizei commandCount, GLsizei commandOffset)
+{
+    assert(primitive != Primitive::Invalid);
+    assert(VertexArrayObject::IsAnyBound());
+
+    const char* basePointer = nullptr; // Actual command pointer is in the draw indirect buffer
+    const char* commandPointer = basePointer + commandOffset * sizeof(IndirectCommand);
+    if (eboType == Data::Type::None)
+    {
+        glMultiDrawArraysIndirect(static_cast<GLenum>(primitive), commandPointer, commandCount, sizeof(IndirectCommand));
+    }
+    else
+    {
+        assert(ElementBufferObject::IsSupportedType(eboType));
+        glMultiDrawElementsIndirect(static_cast<GLenum>(primitive), static_cast<GLenum>(eboType), commandPointer, commandCount, sizeof(IndirectCommand));
     }
 }
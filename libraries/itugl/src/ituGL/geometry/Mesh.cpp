@@ -1,6 +1,9 @@
 #include <ituGL/geometry/Mesh.h>
 
-Mesh::Mesh()
+#include <glm/common.hpp>
+#include <limits>
+
+Mesh::Mesh() : m_boundsMin(std::numeric_limits<float>::max()), m_boundsMax(-std::numeric_limits<float>::max())
 {
 }
 
@@ -45,6 +48,12 @@ void Mesh::DrawSubmesh(int submeshIndex) const
     //VertexArrayObject::Unbind(); // No need to unbind
 }
 
+void Mesh::AddBounds(const glm::vec3& min, const glm::vec3& max)
+{
+    m_boundsMin = glm::min(m_boundsMin, min);
+    m_boundsMax = glm::max(m_boundsMax, max);
+}
+
 void Mesh::SetupVertexAttribute(VertexArrayObject& vao, const VertexAttribute::Layout& attributeLayout, GLuint& location, const SemanticMap& locations)
 {
     const VertexAttribute& attribute = attributeLayout.GetAttribute();
@@ -2,6 +2,8 @@
 
 #include <ituGL/geometry/Mesh.h>
 #include <ituGL/shader/Material.h>
+#include <limits>
+#include <cassert>
 
 Model::Model(std::shared_ptr<Mesh> mesh) : m_mesh(mesh)
 {
@@ -24,6 +26,51 @@ void Model::SetMesh(std::shared_ptr<Mesh> mesh)
     m_mesh = mesh;
 }
 
+unsigned int Model::AddLod(std::shared_ptr<Mesh> mesh, float screenSize)
+{
+    assert(m_mesh && mesh);
+    assert(mesh->GetSubmeshCount() == m_mesh->GetSubmeshCount());
+    assert(GetLodCount() < MaxLodCount);
+    assert(m_lods.empty() || screenSize < m_lods.back().screenSize);
+
+    unsigned int lod = GetLodCount();
+    m_lods.push_back(Lod{ mesh, screenSize });
+    return lod;
+}
+
+void Model::ClearLods()
+{
+    m_lods.clear();
+}
+
+const Mesh& Model::GetLodMesh(unsigned int lod) const
+{
+    assert(lod < GetLodCount());
+    return lod == 0 ? *m_mesh : *m_lods[lod - 1].mesh;
+}
+
+float Model::GetLodScreenSize(unsigned int lod) const
+{
+    assert(lod < GetLodCount());
+    return lod == 0 ? std::numeric_limits<float>::infinity() : m_lods[lod - 1].screenSize;
+}
+
+unsigned int Model::SelectLod(float screenSize, unsigned int currentLod, float hysteresis) const
+{
+    // Thresholds of the current and finer LODs are raised, and the ones of coarser LODs are lowered
+    unsigned int lod = 0;
+    for (unsigned int i = 0; i < m_lods.size(); ++i)
+    {
+        float threshold = m_lods[i].screenSize * (i < currentLod ? 1.0f + hysteresis : 1.0f - hysteresis);
+        if (screenSize >= threshold)
+        {
+            break;
+        }
+        lod = i + 1;
+    }
+    return lod;
+}
+
 unsigned int Model::GetMaterialCount()
 {
     return static_cast<unsigned int>(m_materials.size());
@@ -1,6 +1,7 @@
 #include <ituGL/geometry/VertexArrayObject.h>
 
 #include <ituGL/geometry/VertexAttribute.h>
+#include <ituGL/core/DeviceGL.h>
 #include <cassert>
 
 #ifndef NDEBUG
@@ -20,6 +21,10 @@ VertexArrayObject::VertexArrayObject() : Object(NullHandle)
 VertexArrayObject::~VertexArrayObject()
 {
     Handle& handle = GetHandle();
+    if (DeviceGL* device = DeviceGL::GetInstancePointer())
+    {
+        device->ForgetVertexArray(handle);
+    }
     glDeleteVertexArrays(1, &handle);
 }
 
@@ -37,7 +42,7 @@ VertexArrayObject& VertexArrayObject::operator = (VertexArrayObject&& vao) noexc
 void VertexArrayObject::Bind() const
 {
     Handle handle = GetHandle();
-    glBindVertexArray(handle);
+    DeviceGL::GetInstance().BindVertexArray(handle);
 #ifndef NDEBUG
     s_boundHandle = handle;
 #endif
@@ -47,14 +52,14 @@ void VertexArrayObject::Bind() const
 void VertexArrayObject::Unbind()
 {
     Handle handle = NullHandle;
-    glBindVertexArray(handle);
+    DeviceGL::GetInstance().BindVertexArray(handle);
 #ifndef NDEBUG
     s_boundHandle = handle;
 #endif
 }
 
 // Sets the VertexAttribute pointer and enables the VertexAttribute in that location
-void VertexArrayObject::SetAttribute(GLuint location, const VertexAttribute& attribute, GLint offset, GLsizei stride)
+void VertexArrayObject::SetAttribute(GLuint location, const VertexAttribute& attribute, GLint offset, GLsizei stride) const
 {
     assert(IsBound());
     assert(VertexBufferObject::IsAnyBound());
@@ -81,3 +86,19 @@ void VertexArrayObject::SetAttribute(GLuint location, const VertexAttribute& att
     // Finally, we enable the VertexAttribute in this location
     glEnableVertexAttribArray(location);
 }
+
+// Disables the VertexAttribute in that location
+void VertexArrayObject::DisableAttribute(GLuint location) const
+{
+    assert(IsBound());
+
+    glDisableVertexAttribArray(location);
+}
+
+// Sets the divisor of the VertexAttribute in that location
+void VertexArrayObject::SetAttributeDivisor(GLuint location, GLuint divisor) const
+{
+    assert(IsBound());
+
+    glVertexAttribDivisor(location, divisor);
+}
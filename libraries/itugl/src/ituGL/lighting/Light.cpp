@@ -1,5 +1,7 @@
 #include <ituGL/lighting/Light.h>
 
+#include <ituGL/scene/Bounds.h>
+
 Light::Light() : m_color(1.0f), m_intensity(1.0f)
 {
 }
@@ -18,7 +20,7 @@ glm::vec3 Light::GetPosition(const glm::vec3& fallback) const
     return fallback;
 }
 
-void Light::SetPosition(const glm::vec3& position)
+void Light::SetPosition(const glm::vec3& /*position*/)
 {
 }
 
@@ -32,7 +34,7 @@ glm::vec3 Light::GetDirection(const glm::vec3& fallback) const
     return fallback;
 }
 
-void Light::SetDirection(const glm::vec3& direction)
+void Light::SetDirection(const glm::vec3& /*direction*/)
 {
 }
 
@@ -41,6 +43,11 @@ glm::vec4 Light::GetAttenuation() const
     return glm::vec4(-1);
 }
 
+bool Light::GetInfluenceBounds(SphereBounds& /*bounds*/) const
+{
+    return false;
+}
+
 glm::vec3 Light::GetColor() const
 {
     return m_color;
@@ -1,5 +1,7 @@
 #include <ituGL/lighting/PointLight.h>
 
+#include <ituGL/scene/Bounds.h>
+
 PointLight::PointLight() : m_position(0.0f), m_attenuation(0.0f)
 {
 }
@@ -24,6 +26,19 @@ glm::vec4 PointLight::GetAttenuation() const
     return glm::vec4(m_attenuation, 0.0f, 0.0f);
 }
 
+bool PointLight::GetInfluenceBounds(SphereBounds& bounds) const
+{
+    // The light fades to 0 at the end of the distance attenuation
+    if (m_attenuation.y <= 0.0f)
+    {
+        return false;
+    }
+
+    bounds.SetCenter(m_position);
+    bounds.SetRadius(m_attenuation.y);
+    return true;
+}
+
 glm::vec2 PointLight::GetDistanceAttenuation() const
 {
     return m_attenuation;
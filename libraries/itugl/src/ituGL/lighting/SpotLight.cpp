@@ -1,6 +1,9 @@
 #include <ituGL/lighting/SpotLight.h>
 
+#include <ituGL/scene/Bounds.h>
 #include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
 
 SpotLight::SpotLight() : m_position(0.0f), m_direction(0.0f, 1.0f, 0.0f), m_attenuation(0.0f)
 {
@@ -36,6 +39,41 @@ glm::vec4 SpotLight::GetAttenuation() const
     return m_attenuation;
 }
 
+bool SpotLight::GetInfluenceBounds(SphereBounds& bounds) const
+{
+    float range = m_attenuation.y;
+    if (range <= 0.0f)
+    {
+        return false;
+    }
+
+    // Without angular attenuation, or with a cone wider than a hemisphere, it reaches the whole sphere
+    float angle = m_attenuation.w;
+    if (angle <= 0.0f || angle >= glm::half_pi<float>())
+    {
+        bounds.SetCenter(m_position);
+        bounds.SetRadius(range);
+        return true;
+    }
+
+    // Smallest sphere around the cone, that opens opposite to the direction. Narrow cones are bounded by the apex and the rim,
+    // wide cones by the rim only
+    glm::vec3 axis = -m_direction;
+    float cosAngle = std::cos(angle);
+    if (angle < glm::quarter_pi<float>())
+    {
+        float radius = range / (2.0f * cosAngle);
+        bounds.SetCenter(m_position + axis * radius);
+        bounds.SetRadius(radius);
+    }
+    else
+    {
+        bounds.SetCenter(m_position + axis * (range * cosAngle));
+        bounds.SetRadius(range * std::sin(angle));
+    }
+    return true;
+}
+
 float SpotLight::GetAngle() const
 {
     return m_attenuation.w;
@@ -6,10 +6,22 @@
 #include <ituGL/camera/Camera.h>
 #include <ituGL/shader/Material.h>
 #include <ituGL/texture/Texture2DObject.h>
+#include <ituGL/texture/FramebufferObject.h>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Tessellation of the proxy meshes
+const unsigned int ProxySliceCount = 16;
+const unsigned int ProxyStackCount = 8;
+
+// Wider spot lights use the sphere, the cone would be bigger
+const float MaxProxyConeAngle = 1.3f;
 
 DeferredRenderPass::DeferredRenderPass(std::shared_ptr<Material> material, std::shared_ptr<const FramebufferObject> framebuffer)
-    : RenderPass(framebuffer), m_material(material)
+    : RenderPass(framebuffer), m_material(material), m_lightVolumeMode(LightVolumeMode::Proxy), m_minProxyPixelCount(64 * 64)
 {
     InitializeMeshes();
 }
@@ -17,8 +29,21 @@ DeferredRenderPass::DeferredRenderPass(std::shared_ptr<Material> material, std::
 void DeferredRenderPass::Render()
 {
     Renderer& renderer = GetRenderer();
+    DeviceGL& device = renderer.GetDevice();
+
+    glm::ivec4 viewport;
+    device.GetViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+
+    // Copy the g-buffer depth, so the proxies can be depth tested against it
+    if (m_depthFramebuffer)
+    {
+        m_depthFramebuffer->Bind(FramebufferObject::Target::Read);
+        FramebufferObject::Blit(viewport.x, viewport.y, viewport.z, viewport.w, GL_DEPTH_BUFFER_BIT);
+        renderer.GetCurrentFramebuffer()->Bind(FramebufferObject::Target::Read);
+    }
 
-    renderer.GetDevice().Clear(true, Color(0.0f, 0.0f, 0.0f, 1.0f), false, 1.0f);
+    // The depth of the g-buffer is kept, the stencil starts unmarked for the light volumes
+    device.Clear(true, Color(0.0f, 0.0f, 0.0f, 1.0f), false, 1.0f, true, 0);
 
     const Camera& camera = renderer.GetCurrentCamera();
 
@@ -26,36 +51,243 @@ void DeferredRenderPass::Render()
     m_material->Use();
     std::shared_ptr<const ShaderProgram> shaderProgram = m_material->GetShaderProgram();
 
+    // The positions come from the g-buffer depth, so the light geometry is not depth tested, except to mark the proxies in the stencil
+    device.DisableFeature(GL_DEPTH_TEST);
+
+    uint64_t viewportPixelCount = static_cast<uint64_t>(viewport.z) * viewport.w;
+
+    m_stats = Stats();
+
     // Our fullscreen triangle is directly in clip coordinates.
     // Use the inverse view proj matrix to cancel view projection from the camera
     glm::mat4 fullscreenMatrix = glm::inverse(camera.GetViewProjectionMatrix());
 
     bool first = true;
     unsigned int lightIndex = 0;
-    const auto& lights = renderer.GetLights();
+    // Lights that are not in the list of any object are skipped, like in the forward passes
+    const auto& lights = renderer.GetAffectingLights();
     while (renderer.UpdateLights(shaderProgram, lights, lightIndex))
     {
         const Light* light = lightIndex <= lights.size() ? lights[lightIndex - 1] : nullptr;
         assert(first || light);
 
-        const Mesh* mesh = &renderer.GetFullscreenMesh();
-        glm::mat4 worldMatrix = fullscreenMatrix;
-
-        // TODO: select different meshes depending on the type
-
         // Set the render states for the first and additional lights
         renderer.SetLightingRenderStates(first);
 
-        renderer.UpdateTransforms(shaderProgram, fullscreenMatrix, first);
-        mesh->DrawSubmesh(0);
+        // The first pass adds the indirect lighting to all the pixels. Lights without range reach all of them too
+        if (first || m_lightVolumeMode == LightVolumeMode::Fullscreen || light->GetAttenuation().y <= 0.0f)
+        {
+            renderer.UpdateTransforms(shaderProgram, fullscreenMatrix, first);
+            renderer.GetFullscreenMesh().DrawSubmesh(0);
+            m_stats.fullscreenCount++;
+            m_stats.shadedPixelCount += viewportPixelCount;
+        }
+        else
+        {
+            DrawLightVolume(*light, camera, viewport, fullscreenMatrix);
+        }
         first = false;
     }
 
     //TODO: temp hack
     renderer.GetDevice().EnableFeature(GL_DEPTH_TEST);
+    device.SetDepthWrite(true);
+
+    // We changed the program, the uniforms and the VAO without the renderer
+    renderer.InvalidateDrawcallState();
+}
+
+void DeferredRenderPass::DrawLightVolume(const Light& light, const Camera& camera, const glm::ivec4& viewport, const glm::mat4& fullscreenMatrix)
+{
+    Renderer& renderer = GetRenderer();
+    DeviceGL& device = renderer.GetDevice();
+    std::shared_ptr<const ShaderProgram> shaderProgram = m_material->GetShaderProgram();
+
+    // The bounding sphere of the light gives its screen rectangle, also for spot lights
+    float range = light.GetAttenuation().y;
+    glm::vec3 viewCenter = camera.GetViewMatrix() * glm::vec4(light.GetPosition(), 1.0f);
+    glm::ivec4 rect;
+    if (!ComputeScissorRect(viewCenter, range, camera.GetProjectionMatrix(), viewport, rect))
+    {
+        m_stats.culledCount++;
+        return;
+    }
+    uint64_t rectPixelCount = static_cast<uint64_t>(rect.z) * rect.w;
+    m_stats.shadedPixelCount += rectPixelCount;
+
+    if (m_lightVolumeMode == LightVolumeMode::Scissor || rectPixelCount < m_minProxyPixelCount)
+    {
+        device.EnableFeature(GL_SCISSOR_TEST);
+        device.SetScissor(rect.x, rect.y, rect.z, rect.w);
+
+        renderer.UpdateTransforms(shaderProgram, fullscreenMatrix, false);
+        renderer.GetFullscreenMesh().DrawSubmesh(0);
+
+        device.DisableFeature(GL_SCISSOR_TEST);
+        m_stats.scissorCount++;
+    }
+    else
+    {
+        glm::mat4 worldMatrix;
+        const Mesh& mesh = GetProxyMesh(light, worldMatrix);
+        renderer.UpdateTransforms(shaderProgram, worldMatrix, false);
+
+        // Mark the surfaces inside the volume in the stencil, testing both sides against the g-buffer depth without writing it
+        // Back faces behind the surface add 1 and front faces behind it subtract 1, so only the surfaces between them are marked
+        device.SetColorWrite(false);
+        device.EnableFeature(GL_DEPTH_TEST);
+        device.SetDepthFunction(GL_LESS);
+        device.SetDepthWrite(false);
+        device.DisableFeature(GL_CULL_FACE);
+        device.EnableFeature(GL_STENCIL_TEST);
+        device.SetStencilFunction(GL_FRONT_AND_BACK, GL_ALWAYS, 0, 0xFF);
+        device.SetStencilOperations(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        device.SetStencilOperations(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        mesh.DrawSubmesh(0);
+
+        // Shade the marked pixels and unmark them for the next light
+        // Only the back faces are drawn, so each pixel is shaded once, even with the camera inside the volume
+        device.SetColorWrite(true);
+        device.DisableFeature(GL_DEPTH_TEST);
+        device.EnableFeature(GL_CULL_FACE);
+        device.SetCullFace(GL_FRONT);
+        device.SetStencilFunction(GL_FRONT_AND_BACK, GL_NOTEQUAL, 0, 0xFF);
+        device.SetStencilOperations(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_ZERO);
+        mesh.DrawSubmesh(0);
+
+        device.SetCullFace(GL_BACK);
+        device.DisableFeature(GL_STENCIL_TEST);
+        m_stats.proxyCount++;
+    }
+}
+
+const Mesh& DeferredRenderPass::GetProxyMesh(const Light& light, glm::mat4& worldMatrix) const
+{
+    glm::vec4 attenuation = light.GetAttenuation();
+    float range = attenuation.y;
+    glm::vec3 position = light.GetPosition();
+
+    // Spot lights fade to 0 at the angle in attenuation.w
+    float angle = attenuation.w;
+    if (light.GetType() == Light::Type::Spot && angle > 0.0f && angle < MaxProxyConeAngle)
+    {
+        // Basis with the cone axis in Z. The shaders compare the direction with the vector towards the light, so the cone opens backwards
+        glm::vec3 axisZ = -glm::normalize(light.GetDirection());
+        glm::vec3 up = std::abs(axisZ.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 axisX = glm::normalize(glm::cross(up, axisZ));
+        glm::vec3 axisY = glm::cross(axisZ, axisX);
+
+        float radius = range * std::tan(angle);
+        worldMatrix = glm::mat4(glm::vec4(axisX * radius, 0.0f), glm::vec4(axisY * radius, 0.0f), glm::vec4(axisZ * range, 0.0f), glm::vec4(position, 1.0f));
+        return m_coneMesh;
+    }
+
+    worldMatrix = glm::translate(position) * glm::scale(glm::vec3(range));
+    return m_sphereMesh;
+}
+
+bool DeferredRenderPass::ComputeScissorRect(const glm::vec3& viewCenter, float radius, const glm::mat4& projMatrix,
+    const glm::ivec4& viewport, glm::ivec4& rect)
+{
+    bool perspective = projMatrix[3][3] == 0.0f;
+
+    // The camera looks down -Z, a sphere completely behind it is not visible
+    if (perspective && viewCenter.z - radius >= 0.0f)
+    {
+        return false;
+    }
+
+    // Project the corners of the box around the sphere
+    glm::vec2 ndcMin(1.0f);
+    glm::vec2 ndcMax(-1.0f);
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec3 offset((i & 1) ? radius : -radius, (i & 2) ? radius : -radius, (i & 4) ? radius : -radius);
+        glm::vec4 clipCorner = projMatrix * glm::vec4(viewCenter + offset, 1.0f);
+
+        // Corners behind the camera can't be projected, the box could cover any part of the screen
+        if (clipCorner.w <= 0.0f)
+        {
+            rect = viewport;
+            return true;
+        }
+
+        glm::vec2 ndcCorner = glm::vec2(clipCorner) / clipCorner.w;
+        ndcMin = glm::min(ndcMin, ndcCorner);
+        ndcMax = glm::max(ndcMax, ndcCorner);
+    }
+
+    // Convert to pixels, rounding outwards
+    glm::vec2 viewportSize(viewport.z, viewport.w);
+    glm::vec2 pixelMin = glm::floor((glm::clamp(ndcMin, -1.0f, 1.0f) * 0.5f + 0.5f) * viewportSize);
+    glm::vec2 pixelMax = glm::ceil((glm::clamp(ndcMax, -1.0f, 1.0f) * 0.5f + 0.5f) * viewportSize);
+
+    rect = glm::ivec4(viewport.x + static_cast<int>(pixelMin.x), viewport.y + static_cast<int>(pixelMin.y),
+        static_cast<int>(pixelMax.x - pixelMin.x), static_cast<int>(pixelMax.y - pixelMin.y));
+    return rect.z > 0 && rect.w > 0;
 }
 
 void DeferredRenderPass::InitializeMeshes()
 {
-    //TODO: Create meshes for spot and point lights
+    VertexFormat vertexFormat;
+    vertexFormat.AddVertexAttribute<float>(3, VertexAttribute::Semantic::Position);
+
+    // The faces are inside the exact shape, so the vertices are pushed out until the faces contain it
+    float sliceScale = 1.0f / std::cos(glm::pi<float>() / ProxySliceCount);
+    float stackScale = 1.0f / std::cos(glm::half_pi<float>() / ProxyStackCount);
+
+    // Sphere, with a ring of vertices per stack, from the top to the bottom
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned short> indices;
+        for (unsigned int stack = 0; stack <= ProxyStackCount; ++stack)
+        {
+            float polarAngle = glm::pi<float>() * stack / ProxyStackCount;
+            for (unsigned int slice = 0; slice <= ProxySliceCount; ++slice)
+            {
+                float azimuthAngle = glm::two_pi<float>() * slice / ProxySliceCount;
+                glm::vec3 direction(std::sin(polarAngle) * std::cos(azimuthAngle), std::cos(polarAngle), std::sin(polarAngle) * std::sin(azimuthAngle));
+                vertices.push_back(direction * sliceScale * stackScale);
+            }
+        }
+        unsigned int ringSize = ProxySliceCount + 1;
+        for (unsigned int stack = 0; stack < ProxyStackCount; ++stack)
+        {
+            for (unsigned int slice = 0; slice < ProxySliceCount; ++slice)
+            {
+                unsigned short top = static_cast<unsigned short>(stack * ringSize + slice);
+                unsigned short bottom = static_cast<unsigned short>(top + ringSize);
+
+                // Counter-clockwise seen from outside
+                indices.insert(indices.end(), { top, static_cast<unsigned short>(top + 1), bottom });
+                indices.insert(indices.end(), { static_cast<unsigned short>(top + 1), static_cast<unsigned short>(bottom + 1), bottom });
+            }
+        }
+        m_sphereMesh.AddSubmesh<glm::vec3, unsigned short, VertexFormat::LayoutIterator>(Drawcall::Primitive::Triangles, vertices, indices,
+            vertexFormat.LayoutBegin(static_cast<int>(vertices.size()), false), vertexFormat.LayoutEnd());
+    }
+
+    // Cone, with the apex, the center of the base and the ring of the base
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned short> indices;
+        vertices.emplace_back(0.0f, 0.0f, 0.0f);
+        vertices.emplace_back(0.0f, 0.0f, 1.0f);
+        for (unsigned int slice = 0; slice < ProxySliceCount; ++slice)
+        {
+            float azimuthAngle = glm::two_pi<float>() * slice / ProxySliceCount;
+            vertices.emplace_back(std::cos(azimuthAngle) * sliceScale, std::sin(azimuthAngle) * sliceScale, 1.0f);
+        }
+        for (unsigned int slice = 0; slice < ProxySliceCount; ++slice)
+        {
+            unsigned short current = static_cast<unsigned short>(2 + slice);
+            unsigned short next = static_cast<unsigned short>(2 + (slice + 1) % ProxySliceCount);
+
+            // Counter-clockwise seen from outside
+            indices.insert(indices.end(), { 0, next, current });
+            indices.insert(indices.end(), { 1, current, next });
+        }
+        m_coneMesh.AddSubmesh<glm::vec3, unsigned short, VertexFormat::LayoutIterator>(Drawcall::Primitive::Triangles, vertices, indices,
+            vertexFormat.LayoutBegin(static_cast<int>(vertices.size()), false), vertexFormat.LayoutEnd());
+    }
 }
@@ -5,6 +5,40 @@
 #include <ituGL/geometry/VertexArrayObject.h>
 #include <ituGL/renderer/Renderer.h>
 
+// Draw once with all the lights if the shader supports clustered lighting, or once per light otherwise
+template<typename TDraw>
+static void DrawLit(Renderer& renderer, const std::shared_ptr<const ShaderProgram>& shaderProgram,
+    std::span<const Light* const> lights, bool clustered, TDraw draw)
+{
+    if (clustered && renderer.UpdateClusteredLights(shaderProgram))
+    {
+        // The lights come from the cluster buffers, the light binder only sets the indirect lighting
+        unsigned int lightIndex = 0;
+        renderer.UpdateLights(shaderProgram, {}, lightIndex);
+
+        // Set the renderstates
+        renderer.SetLightingRenderStates(true);
+
+        // Draw
+        draw();
+        return;
+    }
+
+    //for all lights
+    bool first = true;
+    unsigned int lightIndex = 0;
+    while (renderer.UpdateLights(shaderProgram, lights, lightIndex))
+    {
+        // Set the renderstates
+        renderer.SetLightingRenderStates(first);
+
+        // Draw
+        draw();
+
+        first = false;
+    }
+}
+
 ForwardRenderPass::ForwardRenderPass()
     : ForwardRenderPass(0)
 {
@@ -20,29 +54,52 @@ void ForwardRenderPass::Render()
     Renderer& renderer = GetRenderer();
 
     const Camera& camera = renderer.GetCurrentCamera();
-    const auto& lights = renderer.GetLights();
     const auto& drawcallCollection = renderer.GetDrawcalls(m_drawcallCollectionIndex);
 
-    // for all drawcalls
-    for (const Renderer::DrawcallInfo& drawcallInfo : drawcallCollection)
+    bool indirect = IsIndirectSubmission();
+    std::span<const Renderer::IndirectBucket> buckets;
+    if (indirect)
     {
-        // Prepare drawcall states
-        renderer.PrepareDrawcall(drawcallInfo);
+        buckets = renderer.BuildIndirectBuckets(m_drawcallCollectionIndex);
+    }
+    auto nextBucket = buckets.begin();
 
-        std::shared_ptr<const ShaderProgram> shaderProgram = drawcallInfo.GetMaterial().GetShaderProgram();
+    // Lights and clusters are uploaded once, and shared by all the drawcalls with clustered shaders
+    bool clustered = renderer.GetDevice().IsVersionSupported(4, 3);
+    if (clustered)
+    {
+        renderer.PrepareClusteredLights();
+    }
 
-        //for all lights
-        bool first = true;
-        unsigned int lightIndex = 0;
-        while (renderer.UpdateLights(shaderProgram, lights, lightIndex))
+    // for all drawcalls
+    for (unsigned int index = 0; index < drawcallCollection.size(); ++index)
+    {
+        const Renderer::DrawcallInfo& drawcallInfo = drawcallCollection[index];
+
+        // Drawcalls submitted indirectly are rendered with their bucket, when the first one is found
+        if (indirect && renderer.IsIndirectSupported(drawcallInfo))
         {
-            // Set the renderstates
-            renderer.SetLightingRenderStates(first);
+            if (nextBucket != buckets.end() && nextBucket->GetFirstDrawcallIndex() == index)
+            {
+                const Renderer::IndirectBucket& bucket = *nextBucket++;
 
-            // Draw
-            drawcallInfo.GetDrawcall().Draw();
+                // Prepare bucket states
+                renderer.PrepareIndirectBucket(bucket);
 
-            first = false;
+                std::shared_ptr<const ShaderProgram> shaderProgram = bucket.GetMaterial().GetShaderProgram();
+
+                // Draw all the drawcalls in the bucket, with the lights that reach any object
+                DrawLit(renderer, shaderProgram, renderer.GetAffectingLights(), clustered, [&]() { renderer.DrawIndirectBucket(bucket); });
+            }
+            continue;
         }
+
+        // Prepare drawcall states
+        renderer.PrepareDrawcall(drawcallInfo);
+
+        std::shared_ptr<const ShaderProgram> shaderProgram = drawcallInfo.GetMaterial().GetShaderProgram();
+
+        // Only the lights that reach the object get a pass
+        DrawLit(renderer, shaderProgram, renderer.GetDrawcallLights(drawcallInfo), clustered, [&]() { drawcallInfo.GetDrawcall().Draw(); });
     }
 }
@@ -14,13 +14,18 @@ GBufferRenderPass::GBufferRenderPass(int width, int height, int drawcallCollecti
     InitFramebuffer();
 }
 
+GBufferRenderPass::GBufferRenderPass(std::shared_ptr<const FramebufferObject> targetFramebuffer, int drawcallCollectionIndex)
+    : RenderPass(targetFramebuffer), m_drawcallCollectionIndex(drawcallCollectionIndex)
+{
+}
+
 void GBufferRenderPass::InitFramebuffer()
 {
     std::shared_ptr<FramebufferObject> targetFramebuffer = std::make_shared<FramebufferObject>();
 
     targetFramebuffer->Bind();
 
-    targetFramebuffer->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::Depth, *m_depthTexture);
+    targetFramebuffer->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::DepthStencil, *m_depthTexture);
 
     // Set the albedo texture as color attachment 0
     targetFramebuffer->SetTexture(FramebufferObject::Target::Draw, FramebufferObject::Attachment::Color0, *m_albedoTexture);
@@ -47,9 +52,10 @@ void GBufferRenderPass::InitFramebuffer()
 void GBufferRenderPass::InitTextures(int width, int height)
 {
     // Depth: Set the min and magfilter as nearest
+    // It has the same format as the depth-stencil of the default framebuffer, so the deferred pass can copy it there
     m_depthTexture = std::make_shared<Texture2DObject>();
     m_depthTexture->Bind();
-    m_depthTexture->SetImage(0, width, height, TextureObject::FormatDepth, TextureObject::InternalFormatDepth);
+    m_depthTexture->SetImage(0, width, height, TextureObject::FormatDepthStencil, TextureObject::InternalFormatDepth24Stencil8);
     m_depthTexture->SetParameter(TextureObject::ParameterEnum::MinFilter, GL_NEAREST);
     m_depthTexture->SetParameter(TextureObject::ParameterEnum::MagFilter, GL_NEAREST);
 
@@ -90,14 +96,38 @@ void GBufferRenderPass::Render()
     bool wasSRGB = renderer.GetDevice().IsFeatureEnabled(GL_FRAMEBUFFER_SRGB);
     renderer.GetDevice().EnableFeature(GL_FRAMEBUFFER_SRGB);
 
+    bool indirect = IsIndirectSubmission();
+    std::span<const Renderer::IndirectBucket> buckets;
+    if (indirect)
+    {
+        buckets = renderer.BuildIndirectBuckets(m_drawcallCollectionIndex);
+    }
+    auto nextBucket = buckets.begin();
+
     // for all drawcalls
-    for (const Renderer::DrawcallInfo& drawcallInfo : drawcallCollection)
+    for (unsigned int index = 0; index < drawcallCollection.size(); ++index)
     {
+        const Renderer::DrawcallInfo& drawcallInfo = drawcallCollection[index];
         const Material& material = drawcallInfo.GetMaterial();
         assert(material.GetBlendEquationColor() == Material::BlendEquation::None);
         assert(material.GetBlendEquationAlpha() == Material::BlendEquation::None);
         assert(material.GetDepthWrite());
 
+        // Drawcalls submitted indirectly are rendered with their bucket, when the first one is found
+        if (indirect && renderer.IsIndirectSupported(drawcallInfo))
+        {
+            if (nextBucket != buckets.end() && nextBucket->GetFirstDrawcallIndex() == index)
+            {
+                // Prepare bucket (similar to drawcalls)
+                renderer.PrepareIndirectBucket(*nextBucket);
+
+                // Render all the drawcalls in the bucket
+                renderer.DrawIndirectBucket(*nextBucket);
+                ++nextBucket;
+            }
+            continue;
+        }
+
         // Prepare drawcall (similar to forward)
         renderer.PrepareDrawcall(drawcallInfo);
 
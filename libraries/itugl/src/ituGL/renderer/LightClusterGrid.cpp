@@ -0,0 +1,283 @@
+#include <ituGL/renderer/LightClusterGrid.h>
+
+#include <ituGL/lighting/Light.h>
+#include <ituGL/core/WorkerPool.h>
+#include <glm/common.hpp>
+#include <glm/exponential.hpp>
+#include <glm/matrix.hpp>
+#include <algorithm>
+#include <thread>
+#include <bit>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+// SSE is always available on x86-64. Other platforms use the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define LIGHTCLUSTERGRID_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Below this number of lights with range, the grid is built in the calling thread only
+static const size_t MinLightsForThreads = 256;
+
+// Point at view depth on the line between the near and far points, that goes through a corner of a tile
+static glm::vec3 GetPointAtDepth(const glm::vec3& nearPoint, const glm::vec3& farPoint, float depth)
+{
+    float t = (depth + nearPoint.z) / (nearPoint.z - farPoint.z);
+    return glm::mix(nearPoint, farPoint, t);
+}
+
+void LightClusterGrid::SliceLights::Clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radiusSquared.clear();
+    lightIndices.clear();
+}
+
+void LightClusterGrid::SliceLights::Add(const glm::vec3& center, float radius, uint32_t lightIndex)
+{
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radiusSquared.push_back(radius * radius);
+    lightIndices.push_back(lightIndex);
+}
+
+void LightClusterGrid::SliceLights::Pad()
+{
+    // Padding lights have negative squared radius, so they never intersect
+    while (lightIndices.size() % 4 != 0)
+    {
+        Add(glm::vec3(0.0f), 0.0f, 0);
+        radiusSquared.back() = -1.0f;
+    }
+}
+
+LightClusterGrid::LightClusterGrid(unsigned int tileCountX, unsigned int tileCountY, unsigned int sliceCount)
+    : m_gridSize(tileCountX, tileCountY, sliceCount), m_workerPool(nullptr), m_threadCount(0)
+    , m_projMatrix(0.0f), m_boundsDirty(true), m_nearDepth(0.0f), m_farDepth(0.0f), m_depthSliceScaleBias(0.0f)
+{
+    assert(tileCountX > 0 && tileCountY > 0 && sliceCount > 0);
+}
+
+void LightClusterGrid::SetGridSize(const glm::uvec3& gridSize)
+{
+    assert(gridSize.x > 0 && gridSize.y > 0 && gridSize.z > 0);
+    if (gridSize != m_gridSize)
+    {
+        m_gridSize = gridSize;
+        m_boundsDirty = true;
+    }
+}
+
+unsigned int LightClusterGrid::GetSlice(float depth) const
+{
+    float slice = std::log(std::max(depth, m_nearDepth)) * m_depthSliceScaleBias.x + m_depthSliceScaleBias.y;
+    return std::min(static_cast<unsigned int>(std::max(slice, 0.0f)), m_gridSize.z - 1);
+}
+
+void LightClusterGrid::Build(std::span<const Light* const> lights, const glm::mat4& viewMatrix, const glm::mat4& projMatrix)
+{
+    if (m_boundsDirty || projMatrix != m_projMatrix)
+    {
+        UpdateClusterBounds(projMatrix);
+    }
+
+    // Sort the lights into the slices they can reach, in view space
+    m_sliceLights.resize(m_gridSize.z);
+    for (SliceLights& sliceLights : m_sliceLights)
+    {
+        sliceLights.Clear();
+    }
+    m_globalLightIndices.clear();
+
+    size_t rangeLightCount = 0;
+    for (uint32_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+    {
+        const Light& light = *lights[lightIndex];
+        float range = light.GetAttenuation().y;
+        if (range <= 0.0f)
+        {
+            m_globalLightIndices.push_back(lightIndex);
+            continue;
+        }
+
+        glm::vec3 center = viewMatrix * glm::vec4(light.GetPosition(), 1.0f);
+        float depth = -center.z;
+        if (depth + range < m_nearDepth || depth - range > m_farDepth)
+        {
+            continue;
+        }
+
+        unsigned int lastSlice = GetSlice(depth + range);
+        for (unsigned int slice = GetSlice(depth - range); slice <= lastSlice; ++slice)
+        {
+            m_sliceLights[slice].Add(center, range, lightIndex);
+        }
+        rangeLightCount++;
+    }
+    for (SliceLights& sliceLights : m_sliceLights)
+    {
+        sliceLights.Pad();
+    }
+
+    // Each thread fills the clusters of a contiguous range of slices, so it only writes its own clusters and indices
+    size_t threadCount = m_threadCount ? m_threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = !m_workerPool || rangeLightCount < MinLightsForThreads ? 1 : std::min<size_t>(threadCount, m_gridSize.z);
+
+    m_clusters.resize(GetClusterCount());
+    m_threadLightIndices.resize(std::max(m_threadLightIndices.size(), threadCount));
+
+    auto assignRange = [&](size_t threadIndex, size_t sliceBegin, size_t sliceEnd)
+    {
+        std::vector<uint32_t>& threadLightIndices = m_threadLightIndices[threadIndex];
+        threadLightIndices.clear();
+        AssignSlices(static_cast<unsigned int>(sliceBegin), static_cast<unsigned int>(sliceEnd), threadLightIndices);
+    };
+
+    // The pool splits the slices in the same ranges as the loop below
+    if (threadCount > 1)
+    {
+        m_workerPool->Run(m_gridSize.z, threadCount, assignRange);
+    }
+    else
+    {
+        assignRange(0, 0, m_gridSize.z);
+    }
+
+    // Concatenate the lists of the threads, moving the offsets of their clusters
+    m_lightIndices.clear();
+    for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        unsigned int sliceBegin = static_cast<unsigned int>(m_gridSize.z * threadIndex / threadCount);
+        unsigned int sliceEnd = static_cast<unsigned int>(m_gridSize.z * (threadIndex + 1) / threadCount);
+        uint32_t baseOffset = static_cast<uint32_t>(m_lightIndices.size());
+        for (unsigned int clusterIndex = GetClusterIndex(0, 0, sliceBegin); clusterIndex < GetClusterIndex(0, 0, sliceEnd); ++clusterIndex)
+        {
+            m_clusters[clusterIndex].offset += baseOffset;
+        }
+
+        const std::vector<uint32_t>& threadLightIndices = m_threadLightIndices[threadIndex];
+        m_lightIndices.insert(m_lightIndices.end(), threadLightIndices.begin(), threadLightIndices.end());
+    }
+}
+
+void LightClusterGrid::UpdateClusterBounds(const glm::mat4& projMatrix)
+{
+    m_projMatrix = projMatrix;
+    m_boundsDirty = false;
+
+    // Unproject the points of the screen on the near and far planes
+    glm::mat4 invProjMatrix = glm::inverse(projMatrix);
+    auto unproject = [&](float x, float y, float z)
+    {
+        glm::vec4 point = invProjMatrix * glm::vec4(x, y, z, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+
+    m_nearDepth = -unproject(0.0f, 0.0f, -1.0f).z;
+    m_farDepth = -unproject(0.0f, 0.0f, 1.0f).z;
+    assert(m_nearDepth > 0.0f && m_farDepth > m_nearDepth);
+
+    // Slice i starts at depth near * (far / near) ^ (i / sliceCount)
+    float sliceCount = static_cast<float>(m_gridSize.z);
+    float logDepthRange = std::log(m_farDepth / m_nearDepth);
+    m_depthSliceScaleBias.x = sliceCount / logDepthRange;
+    m_depthSliceScaleBias.y = -sliceCount * std::log(m_nearDepth) / logDepthRange;
+
+    std::vector<float> sliceDepths(m_gridSize.z + 1);
+    for (unsigned int slice = 0; slice <= m_gridSize.z; ++slice)
+    {
+        sliceDepths[slice] = m_nearDepth * std::pow(m_farDepth / m_nearDepth, static_cast<float>(slice) / m_gridSize.z);
+    }
+
+    m_clusterBounds.resize(GetClusterCount());
+    for (unsigned int tileY = 0; tileY < m_gridSize.y; ++tileY)
+    {
+        for (unsigned int tileX = 0; tileX < m_gridSize.x; ++tileX)
+        {
+            // Corners of the tile on the near and far planes
+            glm::vec3 nearPoints[4], farPoints[4];
+            for (unsigned int corner = 0; corner < 4; ++corner)
+            {
+                float x = 2.0f * (tileX + (corner & 1)) / m_gridSize.x - 1.0f;
+                float y = 2.0f * (tileY + (corner >> 1)) / m_gridSize.y - 1.0f;
+                nearPoints[corner] = unproject(x, y, -1.0f);
+                farPoints[corner] = unproject(x, y, 1.0f);
+            }
+
+            // The bounds of each cluster contain the corners of the tile at the depths of the slice
+            for (unsigned int slice = 0; slice < m_gridSize.z; ++slice)
+            {
+                ClusterBounds& bounds = m_clusterBounds[GetClusterIndex(tileX, tileY, slice)];
+                bounds.min = glm::vec3(std::numeric_limits<float>::max());
+                bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+                for (unsigned int corner = 0; corner < 4; ++corner)
+                {
+                    for (unsigned int side = 0; side < 2; ++side)
+                    {
+                        glm::vec3 point = GetPointAtDepth(nearPoints[corner], farPoints[corner], sliceDepths[slice + side]);
+                        bounds.min = glm::min(bounds.min, point);
+                        bounds.max = glm::max(bounds.max, point);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LightClusterGrid::AssignSlices(unsigned int sliceBegin, unsigned int sliceEnd, std::vector<uint32_t>& lightIndices)
+{
+    for (unsigned int slice = sliceBegin; slice < sliceEnd; ++slice)
+    {
+        const SliceLights& sliceLights = m_sliceLights[slice];
+        size_t sliceLightCount = sliceLights.lightIndices.size();
+
+        unsigned int clusterEnd = GetClusterIndex(0, 0, slice + 1);
+        for (unsigned int clusterIndex = GetClusterIndex(0, 0, slice); clusterIndex < clusterEnd; ++clusterIndex)
+        {
+            Cluster& cluster = m_clusters[clusterIndex];
+            cluster.offset = static_cast<uint32_t>(lightIndices.size());
+            lightIndices.insert(lightIndices.end(), m_globalLightIndices.begin(), m_globalLightIndices.end());
+
+            // The sphere intersects the box if the distance from the center to the closest point in the box is less than the radius
+            const ClusterBounds& bounds = m_clusterBounds[clusterIndex];
+#ifdef LIGHTCLUSTERGRID_USE_SSE
+            const __m128 zero = _mm_setzero_ps();
+            __m128 minX = _mm_set1_ps(bounds.min.x), minY = _mm_set1_ps(bounds.min.y), minZ = _mm_set1_ps(bounds.min.z);
+            __m128 maxX = _mm_set1_ps(bounds.max.x), maxY = _mm_set1_ps(bounds.max.y), maxZ = _mm_set1_ps(bounds.max.z);
+            for (size_t i = 0; i < sliceLightCount; i += 4)
+            {
+                __m128 centerX = _mm_loadu_ps(&sliceLights.centerX[i]);
+                __m128 centerY = _mm_loadu_ps(&sliceLights.centerY[i]);
+                __m128 centerZ = _mm_loadu_ps(&sliceLights.centerZ[i]);
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)), zero);
+                __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)), zero);
+                __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                unsigned int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&sliceLights.radiusSquared[i])));
+                while (mask)
+                {
+                    lightIndices.push_back(sliceLights.lightIndices[i + std::countr_zero(mask)]);
+                    mask &= mask - 1;
+                }
+            }
+#else
+            for (size_t i = 0; i < sliceLightCount; ++i)
+            {
+                glm::vec3 center(sliceLights.centerX[i], sliceLights.centerY[i], sliceLights.centerZ[i]);
+                glm::vec3 distance = glm::max(glm::max(bounds.min - center, center - bounds.max), 0.0f);
+                if (glm::dot(distance, distance) <= sliceLights.radiusSquared[i])
+                {
+                    lightIndices.push_back(sliceLights.lightIndices[i]);
+                }
+            }
+#endif
+
+            cluster.count = static_cast<uint32_t>(lightIndices.size()) - cluster.offset;
+        }
+    }
+}
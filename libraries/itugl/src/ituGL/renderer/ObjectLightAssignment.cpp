@@ -0,0 +1,274 @@
+#include <ituGL/renderer/ObjectLightAssignment.h>
+
+#include <ituGL/lighting/Light.h>
+#include <ituGL/core/WorkerPool.h>
+#include <ituGL/scene/Bounds.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <thread>
+#include <bit>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+// SSE is always available on x86-64. Other platforms use the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define OBJECTLIGHTASSIGNMENT_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Index of m_rangeLightCones for lights without cone
+static const uint32_t NoCone = ~0u;
+
+// Below this number of object and light pairs, the lights are assigned in the calling thread only
+static const size_t MinPairsForThreads = 64 * 1024;
+
+// Sphere against the cone of a spot light. Conservative, it can accept spheres that are close to the cone
+static bool ConeIntersectsSphere(const glm::vec3& apex, const glm::vec3& axis, float range, float cosAngle, float sinAngle,
+    const glm::vec3& center, float radius)
+{
+    glm::vec3 offset = center - apex;
+    float axisDistance = glm::dot(offset, axis);
+    float radialDistance = std::sqrt(std::max(glm::dot(offset, offset) - axisDistance * axisDistance, 0.0f));
+
+    // Distance from the center to the side of the cone
+    float sideDistance = cosAngle * radialDistance - axisDistance * sinAngle;
+    return sideDistance <= radius && axisDistance <= range + radius && axisDistance >= -radius;
+}
+
+ObjectLightAssignment::ObjectLightAssignment() : m_maxLightCount(Unlimited), m_workerPool(nullptr), m_threadCount(0)
+{
+}
+
+void ObjectLightAssignment::Build(std::span<const Light* const> lights, std::span<const glm::vec3> boundsMin, std::span<const glm::vec3> boundsMax)
+{
+    assert(boundsMin.size() == boundsMax.size());
+
+    m_lights = lights;
+    m_globalLightIndices.clear();
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_radiusSquared.clear();
+    m_rangeLightIndices.clear();
+    m_rangeLightPositions.clear();
+    m_rangeLightBrightness.clear();
+    m_rangeLightCones.clear();
+    m_cones.clear();
+
+    SphereBounds influenceBounds(glm::vec3(0.0f), 0.0f);
+    for (uint32_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+    {
+        const Light& light = *lights[lightIndex];
+        if (!light.GetInfluenceBounds(influenceBounds))
+        {
+            m_globalLightIndices.push_back(lightIndex);
+            continue;
+        }
+
+        const glm::vec3& center = influenceBounds.GetCenter();
+        m_centerX.push_back(center.x);
+        m_centerY.push_back(center.y);
+        m_centerZ.push_back(center.z);
+        m_radiusSquared.push_back(influenceBounds.GetRadius() * influenceBounds.GetRadius());
+        m_rangeLightIndices.push_back(lightIndex);
+        m_rangeLightPositions.push_back(light.GetPosition());
+        m_rangeLightBrightness.push_back(light.GetIntensity() * glm::max(glm::max(light.GetColor().r, light.GetColor().g), light.GetColor().b));
+
+        // Spot lights narrower than a hemisphere are also tested with their cone. It opens opposite to the direction
+        glm::vec4 attenuation = light.GetAttenuation();
+        if (light.GetType() == Light::Type::Spot && attenuation.w > 0.0f && attenuation.w < glm::half_pi<float>())
+        {
+            m_rangeLightCones.push_back(static_cast<uint32_t>(m_cones.size()));
+            m_cones.push_back(Cone{ light.GetPosition(), -glm::normalize(light.GetDirection()), attenuation.y,
+                std::cos(attenuation.w), std::sin(attenuation.w) });
+        }
+        else
+        {
+            m_rangeLightCones.push_back(NoCone);
+        }
+    }
+
+    // Padding lights have negative squared radius, so they never intersect
+    size_t rangeLightCount = m_rangeLightIndices.size();
+    size_t paddedLightCount = (rangeLightCount + 3) & ~size_t(3);
+    m_centerX.resize(paddedLightCount, 0.0f);
+    m_centerY.resize(paddedLightCount, 0.0f);
+    m_centerZ.resize(paddedLightCount, 0.0f);
+    m_radiusSquared.resize(paddedLightCount, -1.0f);
+
+    // Each thread assigns a contiguous range of objects, so it only writes its own ranges and lists
+    size_t objectCount = boundsMin.size();
+    size_t threadCount = m_threadCount ? m_threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = !m_workerPool || objectCount * rangeLightCount < MinPairsForThreads ? 1 : std::clamp<size_t>(objectCount, 1, threadCount);
+
+    m_objectLightRanges.resize(objectCount);
+    m_threadObjectLights.resize(std::max(m_threadObjectLights.size(), threadCount));
+    m_threadLightsReached.resize(std::max(m_threadLightsReached.size(), threadCount));
+
+    auto assignRange = [&](size_t threadIndex, size_t objectBegin, size_t objectEnd)
+    {
+        std::vector<const Light*>& threadObjectLights = m_threadObjectLights[threadIndex];
+        std::vector<uint8_t>& threadLightsReached = m_threadLightsReached[threadIndex];
+        threadObjectLights.clear();
+        threadLightsReached.assign(lights.size(), 0);
+        AssignObjects(objectBegin, objectEnd, boundsMin, boundsMax, threadObjectLights, threadLightsReached);
+    };
+
+    // The pool splits the objects in the same ranges as the merge below
+    if (threadCount > 1)
+    {
+        m_workerPool->Run(objectCount, threadCount, assignRange);
+    }
+    else
+    {
+        assignRange(0, 0, objectCount);
+    }
+
+    // Concatenate the lists of the threads, moving the offsets of their objects
+    m_objectLights.clear();
+    for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        size_t objectBegin = objectCount * threadIndex / threadCount;
+        size_t objectEnd = objectCount * (threadIndex + 1) / threadCount;
+        uint32_t baseOffset = static_cast<uint32_t>(m_objectLights.size());
+        for (size_t objectIndex = objectBegin; objectIndex < objectEnd; ++objectIndex)
+        {
+            m_objectLightRanges[objectIndex].offset += baseOffset;
+        }
+
+        const std::vector<const Light*>& threadObjectLights = m_threadObjectLights[threadIndex];
+        m_objectLights.insert(m_objectLights.end(), threadObjectLights.begin(), threadObjectLights.end());
+    }
+
+    // A light reaches some object if it reaches one in any of the threads
+    m_affectingLights.clear();
+    for (uint32_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+    {
+        bool reached = false;
+        for (size_t threadIndex = 0; threadIndex < threadCount && !reached; ++threadIndex)
+        {
+            reached = m_threadLightsReached[threadIndex][lightIndex] != 0;
+        }
+        if (reached)
+        {
+            m_affectingLights.push_back(lights[lightIndex]);
+        }
+    }
+}
+
+std::span<const Light* const> ObjectLightAssignment::GetObjectLights(unsigned int objectIndex) const
+{
+    assert(objectIndex < m_objectLightRanges.size());
+    const LightRange& range = m_objectLightRanges[objectIndex];
+    return std::span<const Light* const>(m_objectLights).subspan(range.offset, range.count);
+}
+
+void ObjectLightAssignment::AssignObjects(size_t objectBegin, size_t objectEnd, std::span<const glm::vec3> boundsMin, std::span<const glm::vec3> boundsMax,
+    std::vector<const Light*>& objectLights, std::vector<uint8_t>& lightsReached)
+{
+    size_t paddedLightCount = m_radiusSquared.size();
+    size_t globalLightCount = std::min<size_t>(m_globalLightIndices.size(), m_maxLightCount);
+    size_t maxRangeLightCount = m_maxLightCount - globalLightCount;
+
+    std::vector<Candidate> candidates;
+    for (size_t objectIndex = objectBegin; objectIndex < objectEnd; ++objectIndex)
+    {
+        const glm::vec3& objectMin = boundsMin[objectIndex];
+        const glm::vec3& objectMax = boundsMax[objectIndex];
+
+        LightRange& range = m_objectLightRanges[objectIndex];
+        range.offset = static_cast<uint32_t>(objectLights.size());
+
+        // Lights without range reach every object
+        for (size_t i = 0; i < globalLightCount; ++i)
+        {
+            uint32_t lightIndex = m_globalLightIndices[i];
+            objectLights.push_back(m_lights[lightIndex]);
+            lightsReached[lightIndex] = 1;
+        }
+
+        // The sphere intersects the box if the distance from the center to the closest point in the box is less than the radius
+        candidates.clear();
+#ifdef OBJECTLIGHTASSIGNMENT_USE_SSE
+        const __m128 zero = _mm_setzero_ps();
+        __m128 minX = _mm_set1_ps(objectMin.x), minY = _mm_set1_ps(objectMin.y), minZ = _mm_set1_ps(objectMin.z);
+        __m128 maxX = _mm_set1_ps(objectMax.x), maxY = _mm_set1_ps(objectMax.y), maxZ = _mm_set1_ps(objectMax.z);
+        for (size_t i = 0; i < paddedLightCount; i += 4)
+        {
+            __m128 centerX = _mm_loadu_ps(&m_centerX[i]);
+            __m128 centerY = _mm_loadu_ps(&m_centerY[i]);
+            __m128 centerZ = _mm_loadu_ps(&m_centerZ[i]);
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)), zero);
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            unsigned int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&m_radiusSquared[i])));
+            while (mask)
+            {
+                candidates.push_back(Candidate{ static_cast<uint32_t>(i + std::countr_zero(mask)), 0.0f });
+                mask &= mask - 1;
+            }
+        }
+#else
+        for (size_t i = 0; i < paddedLightCount; ++i)
+        {
+            glm::vec3 center(m_centerX[i], m_centerY[i], m_centerZ[i]);
+            glm::vec3 distance = glm::max(glm::max(objectMin - center, center - objectMax), 0.0f);
+            if (glm::dot(distance, distance) <= m_radiusSquared[i])
+            {
+                candidates.push_back(Candidate{ static_cast<uint32_t>(i), 0.0f });
+            }
+        }
+#endif
+
+        // Spot lights are tested again with the sphere around the box. Objects without bounds keep all of them
+        if (!m_cones.empty())
+        {
+            glm::vec3 objectCenter = 0.5f * (objectMin + objectMax);
+            float objectRadius = 0.5f * glm::distance(objectMin, objectMax);
+            if (std::isfinite(objectRadius))
+            {
+                std::erase_if(candidates, [&](const Candidate& candidate)
+                    {
+                        uint32_t coneIndex = m_rangeLightCones[candidate.rangeLightIndex];
+                        if (coneIndex == NoCone)
+                        {
+                            return false;
+                        }
+                        const Cone& cone = m_cones[coneIndex];
+                        return !ConeIntersectsSphere(cone.apex, cone.axis, cone.range, cone.cosAngle, cone.sinAngle, objectCenter, objectRadius);
+                    });
+            }
+        }
+
+        // Too many lights, keep the brightest relative to their squared distance to the box
+        if (candidates.size() > maxRangeLightCount)
+        {
+            for (Candidate& candidate : candidates)
+            {
+                const glm::vec3& position = m_rangeLightPositions[candidate.rangeLightIndex];
+                glm::vec3 distance = glm::max(glm::max(objectMin - position, position - objectMax), 0.0f);
+                candidate.priority = m_rangeLightBrightness[candidate.rangeLightIndex] / (1.0f + glm::dot(distance, distance));
+            }
+            auto keptEnd = candidates.begin() + maxRangeLightCount;
+            std::nth_element(candidates.begin(), keptEnd, candidates.end(),
+                [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+            candidates.erase(keptEnd, candidates.end());
+
+            // Keep the order of the lights, so the result doesn't depend on the selection algorithm
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.rangeLightIndex < b.rangeLightIndex; });
+        }
+
+        for (const Candidate& candidate : candidates)
+        {
+            uint32_t lightIndex = m_rangeLightIndices[candidate.rangeLightIndex];
+            objectLights.push_back(m_lights[lightIndex]);
+            lightsReached[lightIndex] = 1;
+        }
+
+        range.count = static_cast<uint32_t>(objectLights.size()) - range.offset;
+    }
+}
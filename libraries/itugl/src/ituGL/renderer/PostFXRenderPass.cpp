@@ -18,4 +18,7 @@ void PostFXRenderPass::Render()
 
     const Mesh* mesh = &renderer.GetFullscreenMesh();
     mesh->DrawSubmesh(0);
+
+    // We changed the program and the VAO without the renderer
+    renderer.InvalidateDrawcallState();
 }
@@ -0,0 +1,347 @@
+#include <ituGL/renderer/RenderGraph.h>
+
+#include <ituGL/renderer/RenderPass.h>
+#include <ituGL/renderer/Renderer.h>
+#include <ituGL/texture/Texture2DObject.h>
+#include <algorithm>
+#include <cassert>
+
+// Pass added by the graph to discard the contents of framebuffer attachments
+class InvalidateFramebufferRenderPass : public RenderPass
+{
+public:
+    InvalidateFramebufferRenderPass(std::shared_ptr<const FramebufferObject> framebuffer, std::vector<FramebufferObject::Attachment>&& attachments)
+        : RenderPass(framebuffer), m_attachments(std::move(attachments))
+    {
+    }
+
+    void Render() override
+    {
+        // The renderer has already bound the framebuffer
+        if (GetRenderer().GetDevice().IsVersionSupported(4, 3))
+        {
+            m_targetFramebuffer->Invalidate(FramebufferObject::Target::Draw, m_attachments);
+        }
+    }
+
+private:
+    std::vector<FramebufferObject::Attachment> m_attachments;
+};
+
+// Bytes per pixel of a texture format. Unsized formats are approximated by their component count
+static size_t GetPixelSize(TextureObject::InternalFormat internalFormat)
+{
+    switch (internalFormat)
+    {
+    case TextureObject::InternalFormatR8:
+    case TextureObject::InternalFormatR8SNorm:
+        return 1;
+    case TextureObject::InternalFormatRG8:
+    case TextureObject::InternalFormatRG8SNorm:
+    case TextureObject::InternalFormatR16:
+    case TextureObject::InternalFormatR16SNorm:
+    case TextureObject::InternalFormatR16F:
+    case TextureObject::InternalFormatDepth16:
+        return 2;
+    case TextureObject::InternalFormatRGB8:
+    case TextureObject::InternalFormatRGB8SNorm:
+    case TextureObject::InternalFormatSRGB8:
+        return 3;
+    case TextureObject::InternalFormatRGBA8:
+    case TextureObject::InternalFormatRGBA8SNorm:
+    case TextureObject::InternalFormatSRGBA8:
+    case TextureObject::InternalFormatRG16:
+    case TextureObject::InternalFormatRG16SNorm:
+    case TextureObject::InternalFormatRG16F:
+    case TextureObject::InternalFormatR32F:
+    case TextureObject::InternalFormatR11G11B10:
+    case TextureObject::InternalFormatRGB10A2:
+    case TextureObject::InternalFormatDepth:
+    case TextureObject::InternalFormatDepth24:
+    case TextureObject::InternalFormatDepth32:
+    case TextureObject::InternalFormatDepth32F:
+    case TextureObject::InternalFormatDepthStencil:
+    case TextureObject::InternalFormatDepth24Stencil8:
+        return 4;
+    case TextureObject::InternalFormatRGB16:
+    case TextureObject::InternalFormatRGB16SNorm:
+    case TextureObject::InternalFormatRGB16F:
+        return 6;
+    case TextureObject::InternalFormatRGBA16:
+    case TextureObject::InternalFormatRGBA16SNorm:
+    case TextureObject::InternalFormatRGBA16F:
+    case TextureObject::InternalFormatRG32F:
+    case TextureObject::InternalFormatDepth32FStencil8:
+        return 8;
+    case TextureObject::InternalFormatRGB32F:
+        return 12;
+    case TextureObject::InternalFormatRGBA32F:
+        return 16;
+    default:
+        return TextureObject::GetDataComponentCount(internalFormat);
+    }
+}
+
+RenderGraph::RenderGraph() : m_compiled(false)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+RenderGraph::ResourceId RenderGraph::CreateTexture(const char* name, const TextureDesc& desc)
+{
+    assert(!m_compiled);
+    ResourceId texture = static_cast<ResourceId>(m_textures.size());
+    m_textures.push_back(Texture{ name, desc, ~0u });
+    return texture;
+}
+
+const char* RenderGraph::GetTextureName(ResourceId texture) const
+{
+    assert(texture < m_textures.size());
+    return m_textures[texture].name.c_str();
+}
+
+unsigned int RenderGraph::AddPass(std::unique_ptr<RenderPass> renderPass)
+{
+    assert(!m_compiled);
+    assert(renderPass);
+    unsigned int passIndex = static_cast<unsigned int>(m_passes.size());
+    m_passes.push_back(Pass{ std::move(renderPass), {}, {}, false });
+    return passIndex;
+}
+
+void RenderGraph::AddRead(unsigned int passIndex, ResourceId texture)
+{
+    assert(passIndex < m_passes.size());
+    assert(texture < m_textures.size());
+    m_passes[passIndex].reads.push_back(texture);
+}
+
+void RenderGraph::AddWrite(unsigned int passIndex, ResourceId texture, FramebufferObject::Attachment attachment, bool keepContents)
+{
+    assert(passIndex < m_passes.size());
+    assert(texture < m_textures.size());
+    // Passes that write to the graph get their framebuffer from it
+    assert(!m_passes[passIndex].renderPass->GetTargetFramebuffer());
+    m_passes[passIndex].writes.push_back(Write{ texture, attachment, keepContents });
+}
+
+void RenderGraph::Compile(Renderer& renderer)
+{
+    assert(!m_compiled);
+    m_compiled = true;
+
+    CullPasses();
+    AssignPhysicalTextures();
+
+    // Last pass that uses each texture, to discard it when it won't be read again
+    std::vector<unsigned int> lastPassIndices(m_textures.size(), 0);
+    for (unsigned int passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        const Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+        for (ResourceId texture : pass.reads)
+            lastPassIndices[texture] = passIndex;
+        for (const Write& write : pass.writes)
+            lastPassIndices[write.texture] = passIndex;
+    }
+
+    for (unsigned int passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+        {
+            pass.renderPass.reset();
+            continue;
+        }
+
+        if (pass.writes.empty())
+        {
+            renderer.AddRenderPass(std::move(pass.renderPass));
+            continue;
+        }
+
+        std::shared_ptr<FramebufferObject> framebuffer = CreateFramebuffer(pass);
+        pass.renderPass->SetTargetFramebuffer(framebuffer);
+
+        // Attachments that are going to be overwritten, and attachments that are not read after this pass
+        std::vector<FramebufferObject::Attachment> discardBefore, discardAfter;
+        for (const Write& write : pass.writes)
+        {
+            if (!write.keepContents)
+                discardBefore.push_back(write.attachment);
+            if (lastPassIndices[write.texture] == passIndex)
+                discardAfter.push_back(write.attachment);
+        }
+
+        if (!discardBefore.empty())
+        {
+            renderer.AddRenderPass(std::make_unique<InvalidateFramebufferRenderPass>(framebuffer, std::move(discardBefore)));
+        }
+        renderer.AddRenderPass(std::move(pass.renderPass));
+        if (!discardAfter.empty())
+        {
+            renderer.AddRenderPass(std::make_unique<InvalidateFramebufferRenderPass>(framebuffer, std::move(discardAfter)));
+        }
+    }
+
+    // Memory with and without sharing texture objects
+    m_stats.textureCount = 0;
+    m_stats.unaliasedMemory = 0;
+    for (const Texture& texture : m_textures)
+    {
+        if (texture.physicalIndex < m_physicalTextures.size())
+        {
+            m_stats.textureCount++;
+            m_stats.unaliasedMemory += GetMemorySize(texture.desc);
+        }
+    }
+    m_stats.physicalTextureCount = static_cast<unsigned int>(m_physicalTextures.size());
+    m_stats.aliasedMemory = 0;
+    for (const PhysicalTexture& physicalTexture : m_physicalTextures)
+    {
+        m_stats.aliasedMemory += GetMemorySize(physicalTexture.desc);
+    }
+}
+
+std::shared_ptr<Texture2DObject> RenderGraph::GetTexture(ResourceId texture) const
+{
+    assert(m_compiled);
+    assert(texture < m_textures.size());
+    unsigned int physicalIndex = m_textures[texture].physicalIndex;
+    return physicalIndex < m_physicalTextures.size() ? m_physicalTextures[physicalIndex].texture : nullptr;
+}
+
+size_t RenderGraph::GetMemorySize(const TextureDesc& desc)
+{
+    return static_cast<size_t>(desc.width) * desc.height * GetPixelSize(desc.internalFormat);
+}
+
+void RenderGraph::CullPasses()
+{
+    // Passes without writes render to their own target, outside of the graph, so they are always kept
+    for (Pass& pass : m_passes)
+    {
+        pass.culled = !pass.writes.empty();
+    }
+
+    // Going backwards, the passes that are kept keep the last passes that wrote the textures they need
+    for (unsigned int passIndex = static_cast<unsigned int>(m_passes.size()); passIndex-- > 0; )
+    {
+        const Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        auto keepLastWriter = [&](ResourceId texture)
+        {
+            for (unsigned int writerIndex = passIndex; writerIndex-- > 0; )
+            {
+                Pass& writer = m_passes[writerIndex];
+                auto itWrite = std::find_if(writer.writes.begin(), writer.writes.end(), [&](const Write& write) { return write.texture == texture; });
+                if (itWrite != writer.writes.end())
+                {
+                    writer.culled = false;
+                    break;
+                }
+            }
+        };
+
+        for (ResourceId texture : pass.reads)
+        {
+            keepLastWriter(texture);
+        }
+        for (const Write& write : pass.writes)
+        {
+            if (write.keepContents)
+            {
+                keepLastWriter(write.texture);
+            }
+        }
+    }
+
+    m_stats.passCount = static_cast<unsigned int>(m_passes.size());
+    m_stats.culledPassCount = static_cast<unsigned int>(std::count_if(m_passes.begin(), m_passes.end(), [](const Pass& pass) { return pass.culled; }));
+}
+
+void RenderGraph::AssignPhysicalTextures()
+{
+    // Lifetime of each texture, from the first to the last pass that uses it
+    const unsigned int Unused = ~0u;
+    std::vector<unsigned int> firstPassIndices(m_textures.size(), Unused);
+    std::vector<unsigned int> lastPassIndices(m_textures.size(), Unused);
+    for (unsigned int passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        const Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        auto use = [&](ResourceId texture)
+        {
+            if (firstPassIndices[texture] == Unused)
+                firstPassIndices[texture] = passIndex;
+            lastPassIndices[texture] = passIndex;
+        };
+        std::for_each(pass.reads.begin(), pass.reads.end(), use);
+        for (const Write& write : pass.writes)
+            use(write.texture);
+    }
+
+    // Textures are assigned in the order they start. A texture object is free after the last pass of its previous texture
+    for (unsigned int passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        for (ResourceId textureIndex = 0; textureIndex < m_textures.size(); ++textureIndex)
+        {
+            if (firstPassIndices[textureIndex] != passIndex)
+                continue;
+
+            Texture& texture = m_textures[textureIndex];
+            auto itFree = std::find_if(m_physicalTextures.begin(), m_physicalTextures.end(), [&](const PhysicalTexture& physicalTexture)
+                {
+                    return physicalTexture.desc == texture.desc && physicalTexture.lastPassIndex < passIndex;
+                });
+
+            if (itFree == m_physicalTextures.end())
+            {
+                const TextureDesc& desc = texture.desc;
+                std::shared_ptr<Texture2DObject> texture2D = std::make_shared<Texture2DObject>();
+                texture2D->Bind();
+                texture2D->SetImage(0, desc.width, desc.height, desc.format, desc.internalFormat);
+                texture2D->SetParameter(TextureObject::ParameterEnum::WrapS, desc.wrap);
+                texture2D->SetParameter(TextureObject::ParameterEnum::WrapT, desc.wrap);
+                texture2D->SetParameter(TextureObject::ParameterEnum::MinFilter, desc.filter);
+                texture2D->SetParameter(TextureObject::ParameterEnum::MagFilter, desc.filter);
+                Texture2DObject::Unbind();
+
+                itFree = m_physicalTextures.insert(m_physicalTextures.end(), PhysicalTexture{ desc, texture2D, 0 });
+            }
+
+            texture.physicalIndex = static_cast<unsigned int>(itFree - m_physicalTextures.begin());
+            itFree->lastPassIndex = lastPassIndices[textureIndex];
+        }
+    }
+}
+
+std::shared_ptr<FramebufferObject> RenderGraph::CreateFramebuffer(const Pass& pass) const
+{
+    std::shared_ptr<FramebufferObject> framebuffer = std::make_shared<FramebufferObject>();
+    framebuffer->Bind();
+
+    std::vector<FramebufferObject::Attachment> drawBuffers;
+    for (const Write& write : pass.writes)
+    {
+        const PhysicalTexture& physicalTexture = m_physicalTextures[m_textures[write.texture].physicalIndex];
+        framebuffer->SetTexture(FramebufferObject::Target::Draw, write.attachment, *physicalTexture.texture);
+        if (write.attachment != FramebufferObject::Attachment::Depth && write.attachment != FramebufferObject::Attachment::DepthStencil)
+        {
+            drawBuffers.push_back(write.attachment);
+        }
+    }
+    framebuffer->SetDrawBuffers(drawBuffers);
+
+    FramebufferObject::Unbind();
+    return framebuffer;
+}
@@ -6,6 +6,8 @@
 RenderPass::RenderPass(std::shared_ptr<const FramebufferObject> targetFramebuffer)
     : m_renderer(nullptr)
     , m_targetFramebuffer(targetFramebuffer)
+    , m_submissionMode(SubmissionMode::Direct)
+    , m_viewIndex(0)
 {
 }
 
@@ -18,6 +20,36 @@ std::shared_ptr<const FramebufferObject> RenderPass::GetTargetFramebuffer() cons
     return m_targetFramebuffer;
 }
 
+void RenderPass::SetTargetFramebuffer(std::shared_ptr<const FramebufferObject> targetFramebuffer)
+{
+    m_targetFramebuffer = targetFramebuffer;
+}
+
+RenderPass::SubmissionMode RenderPass::GetSubmissionMode() const
+{
+    return m_submissionMode;
+}
+
+void RenderPass::SetSubmissionMode(SubmissionMode submissionMode)
+{
+    m_submissionMode = submissionMode;
+}
+
+unsigned int RenderPass::GetViewIndex() const
+{
+    return m_viewIndex;
+}
+
+void RenderPass::SetViewIndex(unsigned int viewIndex)
+{
+    m_viewIndex = viewIndex;
+}
+
+bool RenderPass::IsIndirectSubmission() const
+{
+    return m_submissionMode == SubmissionMode::Indirect && GetRenderer().GetDevice().IsVersionSupported(4, 3);
+}
+
 void RenderPass::SetRenderer(Renderer* renderer)
 {
     m_renderer = renderer;
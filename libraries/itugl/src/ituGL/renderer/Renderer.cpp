@@ -1,6 +1,7 @@
 #include <ituGL/renderer/Renderer.h>
 
 #include <ituGL/geometry/VertexFormat.h>
+#include <ituGL/geometry/VertexAttribute.h>
 #include <ituGL/geometry/VertexArrayObject.h>
 #include <ituGL/geometry/Drawcall.h>
 #include <ituGL/geometry/Mesh.h>
@@ -9,16 +10,137 @@
 #include <ituGL/camera/Camera.h>
 #include <ituGL/texture/FramebufferObject.h>
 #include <ituGL/renderer/RenderPass.h>
+#include <ituGL/scene/Bounds.h>
+#include <glm/geometric.hpp>
 #include <span>
+#include <array>
+#include <bit>
 #include <algorithm>
+#include <limits>
+#include <thread>
+#include <cstddef>
 #include <cassert>
 
+// SSE is always available on x86-64. Other platforms use the scalar glm path
+#if defined(__SSE__) || defined(_M_X64)
+#define RENDERER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Sort key layout, from most significant to least significant bits:
+// - FrontToBack / BackToFront: layer (4) | depth (24) | shader program (12) | material (12) | VAO (12)
+// - StateMinimizing:           layer (4) | shader program (12) | material (12) | VAO (12) | depth (24)
+const unsigned int SortKeyLayerBits = 4;
+const unsigned int SortKeyDepthBits = 24;
+const unsigned int SortKeyIdBits = 12;
+
+// Get the first bits of an id, to be used inside the sort key
+static uint64_t GetSortKeyId(uint64_t id)
+{
+    return id & ((1ull << SortKeyIdBits) - 1);
+}
+
+// Materials don't have an id, so we fold their address. Collisions only make the grouping less effective
+static uint64_t GetSortKeyId(const Material& material)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(&material) >> 4;
+    return GetSortKeyId(address ^ (address >> SortKeyIdBits) ^ (address >> (2 * SortKeyIdBits)));
+}
+
+// Quantize a view depth to the bits available in the sort key
+static uint64_t GetSortKeyDepth(float depth)
+{
+    // Positive floats keep their order when their bits are compared as integers, so we keep the highest ones
+    // Depth behind the camera is clamped to 0
+    uint32_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.0f));
+    return depthBits >> (31 - SortKeyDepthBits);
+}
+
+// Inverse transpose of the upper 3x3 of a matrix, built from the cross products of its columns
+static glm::mat3 GetNormalMatrix(const glm::mat4& matrix)
+{
+    glm::vec3 x(matrix[0]), y(matrix[1]), z(matrix[2]);
+    glm::mat3 cofactors(glm::cross(y, z), glm::cross(z, x), glm::cross(x, y));
+    float determinant = glm::dot(x, cofactors[0]);
+    return determinant != 0.0f ? cofactors / determinant : glm::mat3(1.0f);
+}
+
+// Compute worldView, worldViewProj and normal matrices for a range of world matrices, skipping the ones not in the view
+// Both products share the loads of the world matrix, and each column is computed with 4-wide SSE operations
+static void ComputeTransforms(const glm::mat4& viewMatrix, const glm::mat4& viewProjMatrix, std::span<const glm::mat4> worldMatrices,
+    const Renderer::ViewMask* viewMasks, Renderer::ViewMask viewMask,
+    glm::mat4* worldViewMatrices, glm::mat4* worldViewProjMatrices, glm::mat3* normalMatrices)
+{
+#ifdef RENDERER_USE_SSE
+    __m128 viewColumns[4], viewProjColumns[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        viewColumns[k] = _mm_loadu_ps(&viewMatrix[k][0]);
+        viewProjColumns[k] = _mm_loadu_ps(&viewProjMatrix[k][0]);
+    }
+#endif
+
+    for (size_t i = 0; i < worldMatrices.size(); ++i)
+    {
+        if ((viewMasks[i] & viewMask) == 0)
+        {
+            continue;
+        }
+
+        const glm::mat4& worldMatrix = worldMatrices[i];
+#ifdef RENDERER_USE_SSE
+        // Each column of the result is the combination of the camera columns, weighted by a column of the world matrix
+        for (int column = 0; column < 4; ++column)
+        {
+            __m128 weight = _mm_set1_ps(worldMatrix[column][0]);
+            __m128 worldView = _mm_mul_ps(viewColumns[0], weight);
+            __m128 worldViewProj = _mm_mul_ps(viewProjColumns[0], weight);
+            for (int k = 1; k < 4; ++k)
+            {
+                weight = _mm_set1_ps(worldMatrix[column][k]);
+                worldView = _mm_add_ps(worldView, _mm_mul_ps(viewColumns[k], weight));
+                worldViewProj = _mm_add_ps(worldViewProj, _mm_mul_ps(viewProjColumns[k], weight));
+            }
+            _mm_storeu_ps(&worldViewMatrices[i][column][0], worldView);
+            _mm_storeu_ps(&worldViewProjMatrices[i][column][0], worldViewProj);
+        }
+#else
+        worldViewMatrices[i] = viewMatrix * worldMatrix;
+        worldViewProjMatrices[i] = viewProjMatrix * worldMatrix;
+#endif
+        normalMatrices[i] = GetNormalMatrix(worldViewMatrices[i]);
+    }
+}
+
+// Replace a container allocated in the frame arena with an empty one in the current frame
+// It reserves the size it had, so it doesn't grow again, wasting arena memory, if the next frame is similar
+template<typename TContainer>
+static void ResetFrameContainer(TContainer& container)
+{
+    size_t size = container.size();
+    container = TContainer(container.get_allocator());
+    container.reserve(size);
+}
+
+// World matrix index used by PrepareDrawcall for instanced drawcalls, that get an identity world matrix
+const unsigned int InstancedWorldMatrixIndex = ~0u - 1;
+
+const unsigned int InvalidViewIndex = ~0u;
+
+
 Renderer::DrawcallInfo::DrawcallInfo(const Material& material, unsigned int worldMatrixIndex, const VertexArrayObject& vao, const Drawcall& drawcall)
-    : m_material(material), m_worldMatrixIndex(worldMatrixIndex), m_vao(vao), m_drawcall(drawcall)
+    : m_material(material), m_worldMatrixIndex(worldMatrixIndex), m_vao(vao), m_drawcall(drawcall), m_sortKey(0), m_firstInstance(NoInstance)
+{
+}
+
+void Renderer::DrawcallInfo::SetInstances(unsigned int firstInstance, GLsizei instanceCount)
 {
+    m_firstInstance = firstInstance;
+    m_drawcall.SetInstanceCount(instanceCount);
 }
 
-Renderer::DrawcallCollection::DrawcallCollection(const DrawcallSupportedFunction& isSupported) : m_isSupported(isSupported)
+Renderer::DrawcallCollection::DrawcallCollection(FrameArena& frameArena, const DrawcallSupportedFunction& isSupported, unsigned int viewIndex)
+    : m_isSupported(isSupported), m_viewIndex(viewIndex), m_orderIndependent(false), m_drawcallInfos(frameArena), m_sortedDrawcallInfos(frameArena)
 {
 }
 
@@ -40,19 +162,134 @@ void Renderer::DrawcallCollection::AddDrawcall(const DrawcallInfo& drawcallInfo)
     }
 }
 
+void Renderer::DrawcallCollection::AddSupportedDrawcalls(std::span<const DrawcallInfo> drawcallInfos)
+{
+    m_drawcallInfos.insert(m_drawcallInfos.end(), drawcallInfos.begin(), drawcallInfos.end());
+}
+
 void Renderer::DrawcallCollection::Clear()
 {
-    m_drawcallInfos.clear();
+    ResetFrameContainer(m_drawcallInfos);
+    m_sortedDrawcallInfos = FrameVector<DrawcallInfo>(m_sortedDrawcallInfos.get_allocator());
+}
+
+void Renderer::DrawcallCollection::Truncate(unsigned int count)
+{
+    assert(count <= m_drawcallInfos.size());
+    m_drawcallInfos.erase(m_drawcallInfos.begin() + count, m_drawcallInfos.end());
 }
 
+void Renderer::DrawcallCollection::SortByKey()
+{
+    unsigned int count = static_cast<unsigned int>(m_drawcallInfos.size());
+    if (count < 2)
+    {
+        return;
+    }
+
+    // Resizing keeps the capacity, so the buffers only allocate when the collection grows
+    m_sortEntries.resize(count);
+    m_sortEntriesScratch.resize(count);
+
+    // Copy the keys and build the histograms of the 8 digits (1 byte each) in a single pass
+    std::array<std::array<unsigned int, 256>, 8> histograms = {};
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        uint64_t key = m_drawcallInfos[i].GetSortKey();
+        m_sortEntries[i] = { key, i };
+        for (unsigned int digit = 0; digit < 8; ++digit)
+        {
+            histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+        }
+    }
+
+    SortEntry* source = m_sortEntries.data();
+    SortEntry* destination = m_sortEntriesScratch.data();
+
+    // One stable pass per digit, from least significant to most significant
+    for (unsigned int digit = 0; digit < 8; ++digit)
+    {
+        std::array<unsigned int, 256>& offsets = histograms[digit];
+        unsigned int shift = digit * 8;
+
+        // If all the keys have the same value in this digit, the pass would not change the order
+        if (offsets[(source[0].key >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        // Convert the histogram to the offset where each value starts
+        unsigned int offset = 0;
+        for (unsigned int& value : offsets)
+        {
+            unsigned int valueCount = value;
+            value = offset;
+            offset += valueCount;
+        }
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            const SortEntry& entry = source[i];
+            destination[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        std::swap(source, destination);
+    }
+
+    // Reorder the drawcalls following the sorted entries
+    m_sortedDrawcallInfos.clear();
+    m_sortedDrawcallInfos.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        m_sortedDrawcallInfos.push_back(m_drawcallInfos[source[i].index]);
+    }
+    m_drawcallInfos.swap(m_sortedDrawcallInfos);
+}
+
+
+// Passed by reference to the standard containers, so it needs a definition
+const Renderer::ViewMask Renderer::AllViews;
 
 Renderer::Renderer(DeviceGL& device)
     : m_device(device)
     , m_currentCamera(nullptr)
+    , m_views(m_frameArena)
+    , m_currentViewIndex(0)
+    , m_staticViewMask(AllViews)
+    , m_dynamicViewMask(AllViews)
+    , m_transformsViewIndex(InvalidViewIndex)
     , m_defaultFramebuffer(FramebufferObject::GetDefault())
     , m_currentFramebuffer(m_defaultFramebuffer)
-    , m_drawcallCollections(1)
+    , m_lights(m_frameArena)
+    , m_worldMatrices(m_frameArena)
+    , m_worldMatrixViewMasks(m_frameArena)
+    , m_worldMatrixMeshes(m_frameArena)
+    , m_worldViewMatrices(m_frameArena)
+    , m_worldViewProjMatrices(m_frameArena)
+    , m_normalMatrices(m_frameArena)
+    , m_viewProjMatrix(1.0f)
+    , m_viewNormalMatrix(1.0f)
+    , m_workerThreadCount(0)
+    , m_instancingEnabled(true)
+    , m_objectData(m_frameArena)
+    , m_instanceBatchIndices(m_frameArena)
+    , m_indirectBucketIndices(m_frameArena)
+    , m_objectLightAssignmentEnabled(true)
+    , m_objectLightsAssigned(false)
+    , m_worldBoundsMin(m_frameArena)
+    , m_worldBoundsMax(m_frameArena)
+    , m_lightData(m_frameArena)
+    , m_lightDataUploaded(false)
+    , m_clusterViewIndex(InvalidViewIndex)
+    , m_clusterVersion(0)
 {
+    m_drawcallCollections.emplace_back(m_frameArena);
+
+    // The light jobs run in the same threads as the other parallel jobs of the frame
+    m_lightClusterGrid.SetWorkerPool(&m_workerPool);
+    m_objectLightAssignment.SetWorkerPool(&m_workerPool);
+
+    InvalidateDrawcallState();
+
     InitializeFullscreenMesh();
 
     device.EnableFeature(GL_FRAMEBUFFER_SRGB);
@@ -74,7 +311,49 @@ const Camera& Renderer::GetCurrentCamera() const
 
 void Renderer::SetCurrentCamera(const Camera& camera)
 {
+    // The current camera outside of Render is the main view
+    if (m_views.empty())
+    {
+        m_views.push_back(&camera);
+    }
+    else
+    {
+        m_views[0] = &camera;
+    }
     m_currentCamera = &camera;
+    m_currentViewIndex = 0;
+}
+
+unsigned int Renderer::AddView(const Camera& camera, ViewObjects objects)
+{
+    unsigned int viewIndex = 0;
+    if (m_views.empty())
+    {
+        SetCurrentCamera(camera);
+    }
+    else
+    {
+        assert(m_views.size() < MaxViewCount);
+        m_views.push_back(&camera);
+        viewIndex = static_cast<unsigned int>(m_views.size() - 1);
+    }
+
+    ViewMask viewBit = 1u << viewIndex;
+    if (objects == ViewObjects::Dynamic)
+    {
+        m_staticViewMask &= ~viewBit;
+    }
+    if (objects == ViewObjects::Static)
+    {
+        m_dynamicViewMask &= ~viewBit;
+    }
+    return viewIndex;
+}
+
+const Camera& Renderer::GetViewCamera(unsigned int viewIndex) const
+{
+    assert(viewIndex < m_views.size());
+    return *m_views[viewIndex];
 }
 
 std::shared_ptr<const FramebufferObject> Renderer::GetDefaultFramebuffer() const
@@ -106,10 +385,36 @@ void Renderer::Render()
 {
     assert(m_currentCamera);
 
+    for (auto& collection : m_drawcallCollections)
+    {
+        BuildInstances(collection);
+    }
+
+    // Upload the data of all the objects at once, discarding the previous contents
+    if (!m_objectData.empty())
+    {
+        m_objectBuffer.Bind();
+        m_objectBuffer.AllocateData(std::span<const ObjectData>(m_objectData), BufferObject::StreamDraw);
+        VertexBufferObject::Unbind();
+    }
+
+    if (m_objectLightAssignmentEnabled)
+    {
+        AssignObjectLights();
+    }
+
     for (auto& pass : m_passes)
     {
+        // Transforms are computed the first time a view is used, passes of the same view share them
+        SetCurrentView(pass->GetViewIndex());
         SetCurrentFramebuffer(pass->GetTargetFramebuffer());
+
+        // Each pass starts with no drawcall state applied
+        InvalidateDrawcallState();
         pass->Render();
+
+        // Other passes, and code outside of the renderer, can use the same VAOs without instances
+        ResetInstanceAttributes();
     }
 
     Reset();
@@ -117,8 +422,26 @@ void Renderer::Render()
 
 void Renderer::Reset()
 {
-    m_worldMatrices.clear();
-    m_lights.clear();
+    // The data of this frame stays in the arena, and the containers start again in the other frame
+    m_frameArena.BeginFrame();
+
+    ResetFrameContainer(m_worldMatrices);
+    ResetFrameContainer(m_worldMatrixViewMasks);
+    ResetFrameContainer(m_worldMatrixMeshes);
+    ResetFrameContainer(m_worldBoundsMin);
+    ResetFrameContainer(m_worldBoundsMax);
+
+    m_lastLodStats = m_lodStats;
+    m_lodStats = LodStats();
+    ResetFrameContainer(m_worldViewMatrices);
+    ResetFrameContainer(m_worldViewProjMatrices);
+    ResetFrameContainer(m_normalMatrices);
+    ResetFrameContainer(m_lights);
+    ResetFrameContainer(m_views);
+    ResetFrameContainer(m_objectData);
+    ResetFrameContainer(m_instanceBatchIndices);
+    ResetFrameContainer(m_indirectBucketIndices);
+    ResetFrameContainer(m_lightData);
 
     for (auto& collection : m_drawcallCollections)
     {
@@ -126,6 +449,13 @@ void Renderer::Reset()
     }
 
     m_currentCamera = nullptr;
+    m_currentViewIndex = 0;
+    m_staticViewMask = AllViews;
+    m_dynamicViewMask = AllViews;
+    m_transformsViewIndex = InvalidViewIndex;
+    m_objectLightsAssigned = false;
+    m_lightDataUploaded = false;
+    m_clusterViewIndex = InvalidViewIndex;
 }
 
 int Renderer::AddRenderPass(std::unique_ptr<RenderPass> renderPass)
@@ -141,32 +471,96 @@ void Renderer::RegisterShaderProgram(std::shared_ptr<const ShaderProgram> shader
     const UpdateTransformsFunction& updateTransformFunction,
     const UpdateLightsFunction& updateLightsFunction)
 {
-    assert(shaderProgramPtr);
+    ShaderProgramRegistration& registration = AddShaderProgramRegistration(shaderProgramPtr);
 
     if (updateTransformFunction)
     {
-        m_updateTransformsFunctions[shaderProgramPtr] = updateTransformFunction;
+        registration.SetTransformBinder(updateTransformFunction);
     }
 
     if (updateLightsFunction)
     {
-        m_updateLightsFunctions[shaderProgramPtr] = updateLightsFunction;
+        registration.SetLightBinder(updateLightsFunction);
     }
 }
 
-void Renderer::UpdateTransforms(std::shared_ptr<const ShaderProgram> shaderProgramPtr, unsigned int worldMatrixIndex, bool cameraChanged) const
+Renderer::ShaderProgramRegistration& Renderer::AddShaderProgramRegistration(std::shared_ptr<const ShaderProgram> shaderProgramPtr)
 {
-    const glm::mat4& worldMatrix = m_worldMatrices[worldMatrixIndex];
-    UpdateTransforms(shaderProgramPtr, worldMatrix);
+    assert(shaderProgramPtr);
+
+    unsigned int registrationId = shaderProgramPtr->GetRegistrationId();
+    if (registrationId == ShaderProgram::InvalidRegistrationId)
+    {
+        registrationId = static_cast<unsigned int>(m_shaderProgramRegistrations.size());
+        m_shaderProgramRegistrations.emplace_back().shaderProgram = shaderProgramPtr;
+        shaderProgramPtr->m_registrationId = registrationId;
+    }
+
+    // A shader program can only be registered in one renderer
+    assert(registrationId < m_shaderProgramRegistrations.size());
+    ShaderProgramRegistration& registration = m_shaderProgramRegistrations[registrationId];
+    assert(registration.shaderProgram == shaderProgramPtr);
+
+    // The cached registration could have been moved or replaced
+    InvalidateDrawcallState();
+
+    // Shaders that read the world matrix from the instance attributes can be instanced
+    registration.instanced = shaderProgramPtr->GetAttributeLocation("InstanceWorldMatrix") == InstanceWorldMatrixLocation;
+
+    // Shaders that declare the cluster uniforms read the lights from the cluster buffers
+    registration.clusterGridSizeLocation = shaderProgramPtr->GetUniformLocation("ClusterGridSize");
+    registration.clusterDepthScaleBiasLocation = shaderProgramPtr->GetUniformLocation("ClusterDepthScaleBias");
+    registration.clusterDepthPlaneLocation = shaderProgramPtr->GetUniformLocation("ClusterDepthPlane");
+    registration.clusterViewProjMatrixLocation = shaderProgramPtr->GetUniformLocation("ClusterViewProjMatrix");
+    registration.clustered = registration.clusterGridSizeLocation >= 0;
+    registration.clusterVersion = 0;
+
+    return registration;
 }
 
-void Renderer::UpdateTransforms(std::shared_ptr<const ShaderProgram> shaderProgramPtr, const glm::mat4& worldMatrix, bool cameraChanged) const
+const Renderer::ShaderProgramRegistration* Renderer::FindShaderProgramRegistration(const ShaderProgram& shaderProgram) const
 {
-    const auto& itFind = m_updateTransformsFunctions.find(shaderProgramPtr);
-    if (itFind != m_updateTransformsFunctions.end())
+    unsigned int registrationId = shaderProgram.GetRegistrationId();
+    if (registrationId < m_shaderProgramRegistrations.size())
     {
-        itFind->second(*shaderProgramPtr, worldMatrix, *m_currentCamera, cameraChanged);
+        const ShaderProgramRegistration& registration = m_shaderProgramRegistrations[registrationId];
+        // Programs registered in a different renderer could get the same id
+        if (registration.shaderProgram.get() == &shaderProgram)
+        {
+            return &registration;
+        }
     }
+    return nullptr;
+}
+
+void Renderer::UpdateTransforms(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, unsigned int worldMatrixIndex, bool cameraChanged) const
+{
+    // Transforms are only precomputed while rendering, for the objects visible in the current view
+    if (worldMatrixIndex >= m_worldViewMatrices.size() || ((m_worldMatrixViewMasks[worldMatrixIndex] >> m_transformsViewIndex) & 1) == 0)
+    {
+        UpdateTransforms(shaderProgramPtr, m_worldMatrices[worldMatrixIndex], cameraChanged);
+    }
+    else if (const ShaderProgramRegistration* registration = FindShaderProgramRegistration(*shaderProgramPtr))
+    {
+        registration->UpdateTransforms(GetObjectTransforms(worldMatrixIndex), *m_currentCamera, cameraChanged);
+    }
+}
+
+void Renderer::UpdateTransforms(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, const glm::mat4& worldMatrix, bool cameraChanged) const
+{
+    if (const ShaderProgramRegistration* registration = FindShaderProgramRegistration(*shaderProgramPtr))
+    {
+        glm::mat4 worldViewMatrix = m_currentCamera->GetViewMatrix() * worldMatrix;
+        glm::mat4 worldViewProjMatrix = m_currentCamera->GetViewProjectionMatrix() * worldMatrix;
+        glm::mat3 normalMatrix = GetNormalMatrix(worldViewMatrix);
+        registration->UpdateTransforms({ worldMatrix, worldViewMatrix, worldViewProjMatrix, normalMatrix }, *m_currentCamera, cameraChanged);
+    }
+}
+
+bool Renderer::IsInstancingSupported(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr) const
+{
+    const ShaderProgramRegistration* registration = FindShaderProgramRegistration(*shaderProgramPtr);
+    return registration && registration->instanced;
 }
 
 Renderer::UpdateLightsFunction Renderer::GetDefaultUpdateLightsFunction(const ShaderProgram& shaderProgram)
@@ -205,14 +599,154 @@ Renderer::UpdateLightsFunction Renderer::GetDefaultUpdateLightsFunction(const Sh
     };
 }
 
-bool Renderer::UpdateLights(std::shared_ptr<const ShaderProgram> shaderProgramPtr, std::span<const Light* const> lights, unsigned int& lightIndex) const
+bool Renderer::UpdateLights(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr, std::span<const Light* const> lights, unsigned int& lightIndex) const
+{
+    const ShaderProgramRegistration* registration = FindShaderProgramRegistration(*shaderProgramPtr);
+    return registration && registration->UpdateLights(lights, lightIndex);
+}
+
+bool Renderer::IsClusteredLightingSupported(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr) const
+{
+    const ShaderProgramRegistration* registration = FindShaderProgramRegistration(*shaderProgramPtr);
+    return registration && registration->clustered;
+}
+
+void Renderer::PrepareClusteredLights()
+{
+    assert(m_device.IsVersionSupported(4, 3));
+
+    if (!m_lightDataUploaded)
+    {
+        UploadLightData();
+        m_lightDataUploaded = true;
+    }
+
+    // Passes of the same view share the clusters
+    if (m_clusterViewIndex != m_currentViewIndex)
+    {
+        m_lightClusterGrid.SetThreadCount(m_workerThreadCount);
+        m_lightClusterGrid.Build(m_lights, m_currentCamera->GetViewMatrix(), m_currentCamera->GetProjectionMatrix());
+
+        m_clusterBuffer.Bind();
+        m_clusterBuffer.AllocateData(m_lightClusterGrid.GetClusters(), BufferObject::StreamDraw);
+
+        // Buffers bound to a shader storage block can't be empty
+        std::span<const uint32_t> lightIndices = m_lightClusterGrid.GetLightIndices();
+        const uint32_t emptyLightIndex = 0;
+        if (lightIndices.empty())
+        {
+            lightIndices = std::span<const uint32_t>(&emptyLightIndex, 1);
+        }
+        m_lightIndexBuffer.Bind();
+        m_lightIndexBuffer.AllocateData(lightIndices, BufferObject::StreamDraw);
+        VertexBufferObject::Unbind();
+
+        m_clusterViewIndex = m_currentViewIndex;
+        ++m_clusterVersion;
+    }
+
+    m_lightBuffer.BindBase(BufferObject::ShaderStorageBuffer, LightBufferBinding);
+    m_clusterBuffer.BindBase(BufferObject::ShaderStorageBuffer, ClusterBufferBinding);
+    m_lightIndexBuffer.BindBase(BufferObject::ShaderStorageBuffer, LightIndexBufferBinding);
+}
+
+bool Renderer::UpdateClusteredLights(const std::shared_ptr<const ShaderProgram>& shaderProgramPtr)
 {
-    const auto& itFind = m_updateLightsFunctions.find(shaderProgramPtr);
-    if (itFind != m_updateLightsFunctions.end())
+    if (!IsClusteredLightingSupported(shaderProgramPtr))
     {
-        return itFind->second(*shaderProgramPtr, lights, lightIndex);
+        return false;
     }
-    return false;
+    ShaderProgramRegistration& registration = m_shaderProgramRegistrations[shaderProgramPtr->GetRegistrationId()];
+
+    assert(m_clusterViewIndex == m_currentViewIndex);
+
+    // Uniforms are kept by the shader program, so they only change with the clusters
+    if (registration.clusterVersion != m_clusterVersion)
+    {
+        // View depth of a world position is dot(plane, vec4(position, 1)), the third row of the view matrix negated
+        const glm::mat4& viewMatrix = m_currentCamera->GetViewMatrix();
+        glm::vec4 depthPlane = -glm::vec4(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+
+        const ShaderProgram& shaderProgram = *shaderProgramPtr;
+        shaderProgram.SetUniform(registration.clusterGridSizeLocation, m_lightClusterGrid.GetGridSize());
+        shaderProgram.SetUniform(registration.clusterDepthScaleBiasLocation, m_lightClusterGrid.GetDepthSliceScaleBias());
+        shaderProgram.SetUniform(registration.clusterDepthPlaneLocation, depthPlane);
+        shaderProgram.SetUniform(registration.clusterViewProjMatrixLocation, m_currentCamera->GetViewProjectionMatrix());
+        registration.clusterVersion = m_clusterVersion;
+    }
+
+    return true;
+}
+
+void Renderer::UploadLightData()
+{
+    m_lightData.clear();
+    m_lightData.reserve(m_lights.size());
+    for (const Light* light : m_lights)
+    {
+        LightData& lightData = m_lightData.emplace_back();
+        lightData.color = glm::vec4(light->GetColor() * light->GetIntensity(), 1.0f);
+        lightData.position = glm::vec4(light->GetPosition(), 1.0f);
+        lightData.direction = glm::vec4(light->GetDirection(), 0.0f);
+        lightData.attenuation = light->GetAttenuation();
+    }
+
+    // Buffers bound to a shader storage block can't be empty
+    if (m_lightData.empty())
+    {
+        m_lightData.emplace_back(LightData{});
+    }
+
+    m_lightBuffer.Bind();
+    m_lightBuffer.AllocateData(std::span<const LightData>(m_lightData), BufferObject::StreamDraw);
+    VertexBufferObject::Unbind();
+}
+
+std::span<const Light* const> Renderer::GetDrawcallLights(const DrawcallInfo& drawcallInfo) const
+{
+    if (!m_objectLightsAssigned)
+    {
+        return m_lights;
+    }
+    return drawcallInfo.IsInstanced() ? m_objectLightAssignment.GetAffectingLights() : m_objectLightAssignment.GetObjectLights(drawcallInfo.GetWorldMatrixIndex());
+}
+
+std::span<const Light* const> Renderer::GetAffectingLights() const
+{
+    return m_objectLightsAssigned ? m_objectLightAssignment.GetAffectingLights() : m_lights;
+}
+
+void Renderer::AssignObjectLights()
+{
+    size_t count = m_worldMatrices.size();
+    m_worldBoundsMin.resize(count);
+    m_worldBoundsMax.resize(count);
+
+    // Meshes without bounds get infinite bounds, so all the lights reach them
+    const size_t MinBoundsPerThread = 4096;
+    RunParallel(count, GetParallelThreadCount(count, MinBoundsPerThread), [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+            {
+                const Mesh& mesh = *m_worldMatrixMeshes[index];
+                if (mesh.HasBounds())
+                {
+                    AabbBounds localBounds(0.5f * (mesh.GetBoundsMin() + mesh.GetBoundsMax()), 0.5f * (mesh.GetBoundsMax() - mesh.GetBoundsMin()));
+                    AabbBounds worldBounds = localBounds.GetTransformed(m_worldMatrices[index]);
+                    m_worldBoundsMin[index] = worldBounds.GetMin();
+                    m_worldBoundsMax[index] = worldBounds.GetMax();
+                }
+                else
+                {
+                    m_worldBoundsMin[index] = glm::vec3(-std::numeric_limits<float>::infinity());
+                    m_worldBoundsMax[index] = glm::vec3(std::numeric_limits<float>::infinity());
+                }
+            }
+        });
+
+    m_objectLightAssignment.SetThreadCount(m_workerThreadCount);
+    m_objectLightAssignment.Build(m_lights, m_worldBoundsMin, m_worldBoundsMax);
+    m_objectLightsAssigned = true;
 }
 
 std::span<const Light* const> Renderer::GetLights() const
@@ -230,12 +764,38 @@ std::span<const Renderer::DrawcallInfo> Renderer::GetDrawcalls(unsigned int coll
     return m_drawcallCollections[collectionIndex].GetDrawcalls();
 }
 
-void Renderer::AddModel(const Model& model, const glm::mat4& worldMatrix)
+// Triangles of all the submeshes of the mesh
+static uint64_t GetTriangleCount(const Mesh& mesh)
+{
+    uint64_t triangleCount = 0;
+    for (unsigned int submeshIndex = 0; submeshIndex < mesh.GetSubmeshCount(); ++submeshIndex)
+    {
+        triangleCount += mesh.GetSubmeshDrawcall(submeshIndex).GetTriangleCount();
+    }
+    return triangleCount;
+}
+
+Renderer::LodStats& Renderer::LodStats::operator += (const LodStats& other)
+{
+    for (unsigned int lod = 0; lod < Model::MaxLodCount; ++lod)
+    {
+        objectCounts[lod] += other.objectCounts[lod];
+        triangleCounts[lod] += other.triangleCounts[lod];
+    }
+    return *this;
+}
+
+void Renderer::AddModel(const Model& model, const glm::mat4& worldMatrix, ViewMask viewMask, unsigned int lod)
 {
     unsigned int worldMatrixIndex = static_cast<unsigned int>(m_worldMatrices.size());
     m_worldMatrices.push_back(worldMatrix);
+    m_worldMatrixViewMasks.push_back(viewMask);
+
+    const Mesh& mesh = model.GetLodMesh(lod);
+    m_worldMatrixMeshes.push_back(&mesh);
+    m_lodStats.objectCounts[lod]++;
+    m_lodStats.triangleCounts[lod] += GetTriangleCount(mesh);
 
-    const Mesh& mesh = model.GetMesh();
     for (unsigned int submeshIndex = 0; submeshIndex < mesh.GetSubmeshCount(); ++submeshIndex)
     {
         DrawcallInfo drawcallInfo(model.GetMaterial(submeshIndex), worldMatrixIndex,
@@ -243,15 +803,111 @@ void Renderer::AddModel(const Model& model, const glm::mat4& worldMatrix)
 
         for (DrawcallCollection& collection : m_drawcallCollections)
         {
-            collection.AddDrawcall(drawcallInfo);
+            if (collection.IsInView(viewMask))
+            {
+                collection.AddDrawcall(drawcallInfo);
+            }
         }
     }
 }
 
-unsigned int Renderer::AddDrawcallCollection(const DrawcallSupportedFunction& drawcallSupportedFunction)
+void Renderer::AddModels(std::span<const Model* const> models, std::span<const glm::mat4> worldMatrices,
+    std::span<const ViewMask> viewMasks, std::span<const unsigned int> lods)
 {
+    assert(models.size() == worldMatrices.size());
+    assert(viewMasks.empty() || viewMasks.size() == models.size());
+    assert(lods.empty() || lods.size() == models.size());
+
+    // World matrices keep the order of the models, so each model knows its index in advance
+    unsigned int firstWorldMatrixIndex = static_cast<unsigned int>(m_worldMatrices.size());
+    m_worldMatrices.insert(m_worldMatrices.end(), worldMatrices.begin(), worldMatrices.end());
+    if (viewMasks.empty())
+    {
+        m_worldMatrixViewMasks.resize(m_worldMatrices.size(), AllViews);
+    }
+    else
+    {
+        m_worldMatrixViewMasks.insert(m_worldMatrixViewMasks.end(), viewMasks.begin(), viewMasks.end());
+    }
+    std::span<const ViewMask> modelViewMasks = std::span<const ViewMask>(m_worldMatrixViewMasks).subspan(firstWorldMatrixIndex);
+    for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+    {
+        m_worldMatrixMeshes.push_back(&models[modelIndex]->GetLodMesh(lods.empty() ? 0 : lods[modelIndex]));
+    }
+
+    const size_t MinModelsPerThread = 1024;
+    size_t threadCount = GetParallelThreadCount(models.size(), MinModelsPerThread);
+
+    // Each worker has its own drawcall lists, so no synchronization is needed while filling them
+    m_workerDrawcalls.resize(std::max(m_workerDrawcalls.size(), threadCount));
+    m_workerLodStats.resize(std::max(m_workerLodStats.size(), threadCount));
+    for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        m_workerDrawcalls[threadIndex].resize(m_drawcallCollections.size());
+        m_workerLodStats[threadIndex] = LodStats();
+    }
+
+    RunParallel(models.size(), threadCount, [&](size_t threadIndex, size_t begin, size_t end)
+        {
+            AddModelDrawcalls(models.subspan(begin, end - begin), modelViewMasks.subspan(begin, end - begin),
+                lods.empty() ? lods : lods.subspan(begin, end - begin),
+                firstWorldMatrixIndex + static_cast<unsigned int>(begin), m_workerDrawcalls[threadIndex], m_workerLodStats[threadIndex]);
+        });
+
+    for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        m_lodStats += m_workerLodStats[threadIndex];
+    }
+
+    // Concatenate the results in worker order, that is the same order as the models
+    for (unsigned int collectionIndex = 0; collectionIndex < m_drawcallCollections.size(); ++collectionIndex)
+    {
+        for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+        {
+            std::vector<DrawcallInfo>& drawcallInfos = m_workerDrawcalls[threadIndex][collectionIndex];
+            m_drawcallCollections[collectionIndex].AddSupportedDrawcalls(drawcallInfos);
+            drawcallInfos.clear();
+        }
+    }
+}
+
+void Renderer::AddModelDrawcalls(std::span<const Model* const> models, std::span<const ViewMask> viewMasks, std::span<const unsigned int> lods,
+    unsigned int firstWorldMatrixIndex, std::vector<std::vector<DrawcallInfo>>& workerDrawcalls, LodStats& workerLodStats) const
+{
+    unsigned int worldMatrixIndex = firstWorldMatrixIndex;
+    for (unsigned int modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+    {
+        const Model* model = models[modelIndex];
+        ViewMask viewMask = viewMasks[modelIndex];
+        unsigned int lod = lods.empty() ? 0 : lods[modelIndex];
+        assert(model);
+        const Mesh& mesh = model->GetLodMesh(lod);
+        workerLodStats.objectCounts[lod]++;
+        workerLodStats.triangleCounts[lod] += GetTriangleCount(mesh);
+
+        for (unsigned int submeshIndex = 0; submeshIndex < mesh.GetSubmeshCount(); ++submeshIndex)
+        {
+            DrawcallInfo drawcallInfo(model->GetMaterial(submeshIndex), worldMatrixIndex,
+                mesh.GetSubmeshVertexArray(submeshIndex), mesh.GetSubmeshDrawcall(submeshIndex));
+
+            for (unsigned int collectionIndex = 0; collectionIndex < m_drawcallCollections.size(); ++collectionIndex)
+            {
+                const DrawcallCollection& collection = m_drawcallCollections[collectionIndex];
+                if (collection.IsInView(viewMask) && collection.IsSupported(drawcallInfo))
+                {
+                    workerDrawcalls[collectionIndex].push_back(drawcallInfo);
+                }
+            }
+        }
+        worldMatrixIndex++;
+    }
+}
+
+unsigned int Renderer::AddDrawcallCollection(const DrawcallSupportedFunction& drawcallSupportedFunction, unsigned int viewIndex)
+{
+    assert(viewIndex < MaxViewCount);
     unsigned int index = static_cast<unsigned int>(m_drawcallCollections.size());
-    m_drawcallCollections.push_back(DrawcallCollection(drawcallSupportedFunction));
+    m_drawcallCollections.push_back(DrawcallCollection(m_frameArena, drawcallSupportedFunction, viewIndex));
     return index;
 }
 
@@ -260,12 +916,73 @@ void Renderer::SetDrawcallCollectionSupportedFunction(unsigned int index, const
     m_drawcallCollections[index].SetSupportedFunction(drawcallSupportedFunction);
 }
 
+void Renderer::SetDrawcallCollectionViewIndex(unsigned int index, unsigned int viewIndex)
+{
+    assert(viewIndex < MaxViewCount);
+    m_drawcallCollections[index].SetViewIndex(viewIndex);
+}
+
+void Renderer::SetDrawcallCollectionOrderIndependent(unsigned int index, bool orderIndependent)
+{
+    m_drawcallCollections[index].SetOrderIndependent(orderIndependent);
+}
+
 void Renderer::SortDrawcallCollection(unsigned int index, const DrawcallSortFunction& drawcallSortFunction)
 {
     auto drawcalls = m_drawcallCollections[index].GetDrawcalls();
     std::sort(drawcalls.begin(), drawcalls.end(), drawcallSortFunction);
 }
 
+void Renderer::SortDrawcallCollection(unsigned int index, DrawcallSortMode sortMode)
+{
+    DrawcallCollection& collection = m_drawcallCollections[index];
+    UpdateSortKeys(collection, sortMode);
+    collection.SortByKey();
+}
+
+void Renderer::UpdateSortKeys(DrawcallCollection& collection, DrawcallSortMode sortMode) const
+{
+    // View depth is the negated Z coordinate in view space. We only need the third row of the view matrix
+    const glm::mat4& viewMatrix = GetViewCamera(collection.GetViewIndex()).GetViewMatrix();
+    glm::vec4 viewRowZ(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+
+    const uint64_t maxDepth = (1ull << SortKeyDepthBits) - 1;
+
+    for (DrawcallInfo& drawcallInfo : collection.GetDrawcalls())
+    {
+        const Material& material = drawcallInfo.GetMaterial();
+
+        // Blended materials go in a later layer than opaque ones
+        uint64_t layer = material.HasBlend() ? 1 : 0;
+        assert(layer < (1ull << SortKeyLayerBits));
+
+        uint64_t state = GetSortKeyId(material.GetShaderProgram()->GetHandle());
+        state = (state << SortKeyIdBits) | GetSortKeyId(material);
+        state = (state << SortKeyIdBits) | GetSortKeyId(drawcallInfo.GetVAO().GetHandle());
+
+        float viewDepth = -glm::dot(viewRowZ, GetWorldMatrix(drawcallInfo)[3]);
+        uint64_t depth = GetSortKeyDepth(viewDepth);
+
+        uint64_t key = layer;
+        switch (sortMode)
+        {
+        case DrawcallSortMode::FrontToBack:
+            key = (key << SortKeyDepthBits) | depth;
+            key = (key << (3 * SortKeyIdBits)) | state;
+            break;
+        case DrawcallSortMode::BackToFront:
+            key = (key << SortKeyDepthBits) | (maxDepth - depth);
+            key = (key << (3 * SortKeyIdBits)) | state;
+            break;
+        case DrawcallSortMode::StateMinimizing:
+            key = (key << (3 * SortKeyIdBits)) | state;
+            key = (key << SortKeyDepthBits) | depth;
+            break;
+        }
+        drawcallInfo.SetSortKey(key);
+    }
+}
+
 bool Renderer::IsBackToFront(const DrawcallInfo& a, const DrawcallInfo& b) const
 {
     const Camera& camera = GetCurrentCamera();
@@ -285,19 +1002,85 @@ bool Renderer::IsFrontToBack(const DrawcallInfo& a, const DrawcallInfo& b) const
 
 void Renderer::PrepareDrawcall(const DrawcallInfo& drawcallInfo, Material::OverrideFlags materialOverride)
 {
-    std::shared_ptr<const ShaderProgram> shaderProgram = drawcallInfo.GetMaterial().GetShaderProgram();
+    // Instanced drawcalls get identity, their world matrices are in the instance attributes
+    bool instanced = drawcallInfo.IsInstanced();
+    unsigned int worldMatrixIndex = instanced ? InstancedWorldMatrixIndex : drawcallInfo.GetWorldMatrixIndex();
 
-    // TODO: Room for optimization here, caching current material, current worldMatrixIndex and current VAO
+    // Each instanced drawcall uses a different range of the object buffer
+    PrepareState(drawcallInfo.GetMaterial(), materialOverride, worldMatrixIndex, drawcallInfo.GetVAO(), instanced, drawcallInfo.GetFirstInstance());
+}
 
-    // Setup material
-    drawcallInfo.GetMaterial().Use(materialOverride);
+void Renderer::PrepareState(const Material& material, Material::OverrideFlags materialOverride,
+    unsigned int worldMatrixIndex, const VertexArrayObject& vao, bool instanced, unsigned int firstInstance)
+{
+    // Setup material, only if it is different from the previous drawcall
+    if (&material != m_currentDrawcallMaterial || materialOverride != m_currentMaterialOverride)
+    {
+        material.Use(materialOverride);
+        m_currentDrawcallMaterial = &material;
+        m_currentMaterialOverride = materialOverride;
+        m_renderStatesDirty = false;
+    }
+    else if (m_renderStatesDirty)
+    {
+        // Same material, but the render states were modified after it was used (for example, by the lighting)
+        material.UseRenderStates(materialOverride);
+        m_renderStatesDirty = false;
+    }
 
-    // Setup world matrix
-    // Setup camera
-    UpdateTransforms(shaderProgram, drawcallInfo.GetWorldMatrixIndex());
+    // Setup camera, only if the shader program changed. Uniforms keep their values while the program is not relinked
+    const ShaderProgram* shaderProgram = material.GetShaderProgram().get();
+    bool programChanged = shaderProgram != m_currentTransformsProgram;
+    if (programChanged)
+    {
+        m_currentShaderProgramRegistration = FindShaderProgramRegistration(*shaderProgram);
+        m_currentTransformsProgram = shaderProgram;
+    }
 
-    // Setup VAO
-    drawcallInfo.GetVAO().Bind();
+    // Setup world matrix, only if it changed or the shader program changed
+    if (programChanged || worldMatrixIndex != m_currentWorldMatrixIndex)
+    {
+        if (m_currentShaderProgramRegistration)
+        {
+            m_currentShaderProgramRegistration->UpdateTransforms(GetObjectTransforms(worldMatrixIndex), *m_currentCamera, programChanged);
+        }
+        m_currentWorldMatrixIndex = worldMatrixIndex;
+    }
+
+    // Setup VAO, only if it changed
+    if (&vao != m_currentVAO)
+    {
+        vao.Bind();
+        m_currentVAO = &vao;
+    }
+
+    // The instance attributes are state of the VAO, so they are only set again when the first instance changes
+    // Drawcalls that are not instanced can share the VAO, and must not read the attributes left by an instanced one
+    auto itInstanceAttributes = m_instanceAttributeVAOs.find(&vao);
+    if (instanced)
+    {
+        if (itInstanceAttributes == m_instanceAttributeVAOs.end() || itInstanceAttributes->second != firstInstance)
+        {
+            SetupInstanceAttributes(vao, firstInstance);
+            m_instanceAttributeVAOs[&vao] = firstInstance;
+        }
+    }
+    else if (itInstanceAttributes != m_instanceAttributeVAOs.end())
+    {
+        DisableInstanceAttributes(vao);
+        m_instanceAttributeVAOs.erase(itInstanceAttributes);
+    }
+}
+
+void Renderer::InvalidateDrawcallState()
+{
+    m_currentDrawcallMaterial = nullptr;
+    m_currentMaterialOverride = Material::NoOverride;
+    m_renderStatesDirty = true;
+    m_currentTransformsProgram = nullptr;
+    m_currentShaderProgramRegistration = nullptr;
+    m_currentWorldMatrixIndex = ~0u;
+    m_currentVAO = nullptr;
 }
 
 void Renderer::SetLightingRenderStates(bool firstPass)
@@ -305,9 +1088,12 @@ void Renderer::SetLightingRenderStates(bool firstPass)
     // Set the render states for the first and additional lights
     if (!firstPass)
     {
+        // The material render states need to be restored on the next drawcall
+        m_renderStatesDirty = true;
+
         m_device.SetFeatureEnabled(GL_BLEND, true);
-        glDepthFunc(firstPass ? GL_LESS : GL_EQUAL);
-        glBlendFunc(GL_ONE, GL_ONE);
+        m_device.SetDepthFunction(firstPass ? GL_LESS : GL_EQUAL);
+        m_device.SetBlendFunction(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
     }
 }
 
@@ -328,3 +1114,301 @@ const glm::mat4& Renderer::GetWorldMatrix(const DrawcallInfo& drawcallInfo) cons
 {
     return m_worldMatrices[drawcallInfo.GetWorldMatrixIndex()];
 }
+
+Renderer::ObjectTransforms Renderer::GetObjectTransforms(unsigned int worldMatrixIndex) const
+{
+    if (worldMatrixIndex == InstancedWorldMatrixIndex)
+    {
+        static const glm::mat4 identity(1.0f);
+        return { identity, m_currentCamera->GetViewMatrix(), m_viewProjMatrix, m_viewNormalMatrix };
+    }
+
+    assert(worldMatrixIndex < m_worldViewMatrices.size());
+    return { m_worldMatrices[worldMatrixIndex], m_worldViewMatrices[worldMatrixIndex],
+        m_worldViewProjMatrices[worldMatrixIndex], m_normalMatrices[worldMatrixIndex] };
+}
+
+void Renderer::SetCurrentView(unsigned int viewIndex)
+{
+    m_currentCamera = &GetViewCamera(viewIndex);
+    m_currentViewIndex = viewIndex;
+    if (m_transformsViewIndex != viewIndex)
+    {
+        PrecomputeTransforms();
+        m_transformsViewIndex = viewIndex;
+    }
+}
+
+void Renderer::PrecomputeTransforms()
+{
+    const glm::mat4& viewMatrix = m_currentCamera->GetViewMatrix();
+    m_viewProjMatrix = m_currentCamera->GetViewProjectionMatrix();
+    m_viewNormalMatrix = GetNormalMatrix(viewMatrix);
+
+    size_t count = m_worldMatrices.size();
+    m_worldViewMatrices.resize(count);
+    m_worldViewProjMatrices.resize(count);
+    m_normalMatrices.resize(count);
+
+    // Only the objects visible in the view are referenced by its drawcalls, the others keep the values of another view
+    ViewMask viewMask = 1u << m_currentViewIndex;
+
+    // Each matrix is cheap, so threads only pay off for many of them
+    const size_t MinTransformsPerThread = 4096;
+    RunParallel(count, GetParallelThreadCount(count, MinTransformsPerThread), [&](size_t, size_t begin, size_t end)
+        {
+            ComputeTransforms(viewMatrix, m_viewProjMatrix, std::span<const glm::mat4>(m_worldMatrices).subspan(begin, end - begin),
+                m_worldMatrixViewMasks.data() + begin, viewMask,
+                m_worldViewMatrices.data() + begin, m_worldViewProjMatrices.data() + begin, m_normalMatrices.data() + begin);
+        });
+}
+
+size_t Renderer::GetParallelThreadCount(size_t itemCount, size_t minItemsPerThread) const
+{
+    // Don't use more threads than needed, waking them up has a cost
+    size_t threadCount = m_workerThreadCount > 0 ? m_workerThreadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    return std::clamp<size_t>(itemCount / minItemsPerThread, 1, threadCount);
+}
+
+size_t Renderer::InstanceBatchKeyHash::operator()(const InstanceBatchKey& key) const
+{
+    size_t hash = std::hash<const void*>()(key.material);
+    hash = hash * 31 + std::hash<const void*>()(key.vao);
+    hash = hash * 31 + std::hash<GLint>()(key.first);
+    hash = hash * 31 + std::hash<GLsizei>()(key.count);
+    return hash;
+}
+
+void Renderer::BuildInstances(DrawcallCollection& collection)
+{
+    std::span<DrawcallInfo> drawcallInfos = collection.GetDrawcalls();
+
+    m_instanceBatchIndices.clear();
+    m_instanceBatches.clear();
+    m_drawcallInstanceBatches.clear();
+
+    // Find the batch of each drawcall. Drawcalls that are not instanced get NoBatch
+    const unsigned int NoBatch = ~0u;
+    for (const DrawcallInfo& drawcallInfo : drawcallInfos)
+    {
+        const Material& material = drawcallInfo.GetMaterial();
+        if (!IsInstancingSupported(material.GetShaderProgram()))
+        {
+            m_drawcallInstanceBatches.push_back(NoBatch);
+            continue;
+        }
+
+        const Drawcall& drawcall = drawcallInfo.GetDrawcall();
+        InstanceBatchKey key = { &material, &drawcallInfo.GetVAO(), drawcall.GetPrimitive(), drawcall.GetFirst(), drawcall.GetCount(), drawcall.GetEBOType() };
+
+        // If instancing is disabled, shaders still read the instance attributes, so each drawcall gets its own batch
+        unsigned int batchIndex = static_cast<unsigned int>(m_instanceBatches.size());
+        if (m_instancingEnabled && material.HasBlend() && !collection.IsOrderIndependent())
+        {
+            // Blended drawcalls have to keep their order, so they are only merged with the previous one
+            unsigned int previousBatchIndex = m_drawcallInstanceBatches.empty() ? NoBatch : m_drawcallInstanceBatches.back();
+            auto itFind = m_instanceBatchIndices.find(key);
+            if (itFind != m_instanceBatchIndices.end() && itFind->second == previousBatchIndex)
+            {
+                batchIndex = previousBatchIndex;
+            }
+            else
+            {
+                m_instanceBatchIndices[key] = batchIndex;
+            }
+        }
+        else if (m_instancingEnabled)
+        {
+            batchIndex = m_instanceBatchIndices.try_emplace(key, batchIndex).first->second;
+        }
+
+        if (batchIndex == m_instanceBatches.size())
+        {
+            m_instanceBatches.push_back(InstanceBatch{ 0, 0, NoBatch });
+        }
+        m_instanceBatches[batchIndex].instanceCount++;
+        m_drawcallInstanceBatches.push_back(batchIndex);
+    }
+
+    if (m_instanceBatches.empty())
+    {
+        return;
+    }
+
+    // Reserve a contiguous range of the instance data for each batch
+    unsigned int instanceCount = static_cast<unsigned int>(m_objectData.size());
+    for (InstanceBatch& batch : m_instanceBatches)
+    {
+        batch.firstInstance = instanceCount;
+        instanceCount += batch.instanceCount;
+        batch.instanceCount = 0;
+    }
+    m_objectData.resize(instanceCount);
+
+    // Copy the world matrices and keep only the first drawcall of each batch, in place
+    unsigned int drawcallCount = 0;
+    for (unsigned int index = 0; index < drawcallInfos.size(); ++index)
+    {
+        const DrawcallInfo& drawcallInfo = drawcallInfos[index];
+        unsigned int batchIndex = m_drawcallInstanceBatches[index];
+        if (batchIndex == NoBatch)
+        {
+            drawcallInfos[drawcallCount++] = drawcallInfo;
+            continue;
+        }
+
+        InstanceBatch& batch = m_instanceBatches[batchIndex];
+        ObjectData& objectData = m_objectData[batch.firstInstance + batch.instanceCount];
+        objectData.worldMatrix = GetWorldMatrix(drawcallInfo);
+        batch.instanceCount++;
+
+        if (batch.drawcallIndex == NoBatch)
+        {
+            batch.drawcallIndex = drawcallCount;
+            drawcallInfos[drawcallCount++] = drawcallInfo;
+        }
+    }
+    collection.Truncate(drawcallCount);
+
+    // Once all the instances are known, set them in the merged drawcalls
+    for (const InstanceBatch& batch : m_instanceBatches)
+    {
+        drawcallInfos[batch.drawcallIndex].SetInstances(batch.firstInstance, batch.instanceCount);
+    }
+}
+
+void Renderer::SetupInstanceAttributes(const VertexArrayObject& vao, unsigned int firstInstance)
+{
+    // A mat4 attribute uses 4 locations, one for each column
+    VertexAttribute columnAttribute(Data::Type::Float, 4);
+    GLint offset = firstInstance * sizeof(ObjectData) + offsetof(ObjectData, worldMatrix);
+    GLsizei stride = sizeof(ObjectData);
+
+    m_objectBuffer.Bind();
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLuint location = InstanceWorldMatrixLocation + column;
+        vao.SetAttribute(location, columnAttribute, offset + column * sizeof(glm::vec4), stride);
+        vao.SetAttributeDivisor(location, 1);
+    }
+    VertexBufferObject::Unbind();
+}
+
+void Renderer::DisableInstanceAttributes(const VertexArrayObject& vao)
+{
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        vao.DisableAttribute(InstanceWorldMatrixLocation + column);
+    }
+}
+
+void Renderer::ResetInstanceAttributes()
+{
+    if (m_instanceAttributeVAOs.empty())
+    {
+        return;
+    }
+
+    for (const auto& [vao, firstInstance] : m_instanceAttributeVAOs)
+    {
+        vao->Bind();
+        DisableInstanceAttributes(*vao);
+    }
+    m_instanceAttributeVAOs.clear();
+    VertexArrayObject::Unbind();
+    m_currentVAO = nullptr;
+}
+
+Renderer::IndirectBucket::IndirectBucket(const DrawcallInfo& drawcallInfo, unsigned int firstDrawcallIndex)
+    : m_material(drawcallInfo.GetMaterial()), m_vao(drawcallInfo.GetVAO())
+    , m_primitive(drawcallInfo.GetDrawcall().GetPrimitive()), m_eboType(drawcallInfo.GetDrawcall().GetEBOType())
+    , m_firstDrawcallIndex(firstDrawcallIndex), m_firstCommand(0), m_commandCount(0)
+{
+}
+
+bool Renderer::IsIndirectSupported(const DrawcallInfo& drawcallInfo, bool orderIndependent) const
+{
+    // Blended drawcalls need to keep their order, so they are not grouped
+    return drawcallInfo.IsInstanced() && (orderIndependent || !drawcallInfo.GetMaterial().HasBlend());
+}
+
+std::span<const Renderer::IndirectBucket> Renderer::BuildIndirectBuckets(unsigned int collectionIndex)
+{
+    std::span<const DrawcallInfo> drawcallInfos = GetDrawcalls(collectionIndex);
+    bool orderIndependent = m_drawcallCollections[collectionIndex].IsOrderIndependent();
+
+    m_indirectBuckets.clear();
+    m_indirectBucketIndices.clear();
+    m_drawcallIndirectBuckets.clear();
+
+    // Find the bucket of each drawcall, and count the commands in each bucket
+    const unsigned int NoBucket = ~0u;
+    for (unsigned int index = 0; index < drawcallInfos.size(); ++index)
+    {
+        const DrawcallInfo& drawcallInfo = drawcallInfos[index];
+        if (!IsIndirectSupported(drawcallInfo, orderIndependent))
+        {
+            m_drawcallIndirectBuckets.push_back(NoBucket);
+            continue;
+        }
+
+        // Same key as instancing, but the range of the submesh can be different
+        const Drawcall& drawcall = drawcallInfo.GetDrawcall();
+        InstanceBatchKey key = { &drawcallInfo.GetMaterial(), &drawcallInfo.GetVAO(), drawcall.GetPrimitive(), 0, 0, drawcall.GetEBOType() };
+
+        unsigned int bucketIndex = static_cast<unsigned int>(m_indirectBuckets.size());
+        bucketIndex = m_indirectBucketIndices.try_emplace(key, bucketIndex).first->second;
+        if (bucketIndex == m_indirectBuckets.size())
+        {
+            m_indirectBuckets.emplace_back(drawcallInfo, index);
+        }
+        m_indirectBuckets[bucketIndex].m_commandCount++;
+        m_drawcallIndirectBuckets.push_back(bucketIndex);
+    }
+
+    // Reserve a contiguous range of commands for each bucket
+    unsigned int commandCount = 0;
+    for (IndirectBucket& bucket : m_indirectBuckets)
+    {
+        bucket.m_firstCommand = commandCount;
+        commandCount += bucket.m_commandCount;
+        bucket.m_commandCount = 0;
+    }
+    m_indirectCommands.resize(commandCount);
+
+    // Instances are already in the object buffer, each command starts at its first instance
+    for (unsigned int index = 0; index < drawcallInfos.size(); ++index)
+    {
+        unsigned int bucketIndex = m_drawcallIndirectBuckets[index];
+        if (bucketIndex != NoBucket)
+        {
+            const DrawcallInfo& drawcallInfo = drawcallInfos[index];
+            IndirectBucket& bucket = m_indirectBuckets[bucketIndex];
+            m_indirectCommands[bucket.m_firstCommand + bucket.m_commandCount] = drawcallInfo.GetDrawcall().GetIndirectCommand(drawcallInfo.GetFirstInstance());
+            bucket.m_commandCount++;
+        }
+    }
+
+    if (!m_indirectCommands.empty())
+    {
+        m_indirectBuffer.Bind();
+        m_indirectBuffer.AllocateData(std::span<const Drawcall::IndirectCommand>(m_indirectCommands));
+        DrawIndirectBufferObject::Unbind();
+    }
+
+    return m_indirectBuckets;
+}
+
+void Renderer::PrepareIndirectBucket(const IndirectBucket& bucket, Material::OverrideFlags materialOverride)
+{
+    // The base instance of each command selects its objects, so the attributes start at the beginning of the buffer
+    PrepareState(bucket.GetMaterial(), materialOverride, InstancedWorldMatrixIndex, bucket.GetVAO(), true, 0);
+
+    m_objectBuffer.BindBase(BufferObject::ShaderStorageBuffer, ObjectBufferBinding);
+    m_indirectBuffer.Bind();
+}
+
+void Renderer::DrawIndirectBucket(const IndirectBucket& bucket) const
+{
+    Drawcall::DrawIndirect(bucket.GetPrimitive(), bucket.GetEBOType(), bucket.GetCommandCount(), bucket.GetFirstCommand());
+}
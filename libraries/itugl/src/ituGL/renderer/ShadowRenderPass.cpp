@@ -0,0 +1,673 @@
+#include <ituGL/renderer/ShadowRenderPass.h>
+
+#include <ituGL/core/DeviceGL.h>
+#include <ituGL/lighting/Light.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/texture/Texture2DObject.h>
+#include <ituGL/texture/FramebufferObject.h>
+#include <ituGL/scene/Bounds.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+
+// Spot lights wider than this half angle only get shadows inside it
+static const float MaxSpotShadowAngle = glm::radians(80.0f);
+
+static const uint64_t HashOffset = 14695981039346656037ull;
+static const uint64_t HashPrime = 1099511628211ull;
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * HashPrime;
+    }
+    return hash;
+}
+
+// Move the bits of the value to the even bits
+static uint64_t SpreadBits(unsigned int value)
+{
+    uint64_t bits = value;
+    bits = (bits | (bits << 16)) & 0x0000ffff0000ffffull;
+    bits = (bits | (bits << 8)) & 0x00ff00ff00ff00ffull;
+    bits = (bits | (bits << 4)) & 0x0f0f0f0f0f0f0f0full;
+    bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+    bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+    return bits;
+}
+
+// Keep the even bits of the value, packed in the lower half
+static unsigned int CompactBits(uint64_t value)
+{
+    value &= 0x5555555555555555ull;
+    value = (value | (value >> 1)) & 0x3333333333333333ull;
+    value = (value | (value >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    value = (value | (value >> 4)) & 0x00ff00ff00ff00ffull;
+    value = (value | (value >> 8)) & 0x0000ffff0000ffffull;
+    value = (value | (value >> 16)) & 0x00000000ffffffffull;
+    return static_cast<unsigned int>(value);
+}
+
+static int RoundToPowerOfTwo(float size)
+{
+    return 1 << std::max(static_cast<int>(std::round(std::log2(std::max(size, 1.0f)))), 0);
+}
+
+static std::shared_ptr<Texture2DObject> CreateDepthTexture(int size, bool compare)
+{
+    std::shared_ptr<Texture2DObject> texture = std::make_shared<Texture2DObject>();
+    texture->Bind();
+    texture->SetImage(0, size, size, TextureObject::FormatDepth, TextureObject::InternalFormatDepth24);
+    texture->SetParameter(TextureObject::ParameterEnum::WrapS, GL_CLAMP_TO_EDGE);
+    texture->SetParameter(TextureObject::ParameterEnum::WrapT, GL_CLAMP_TO_EDGE);
+    if (compare)
+    {
+        // Linear filtering of compared depth gives bilinear PCF
+        texture->SetParameter(TextureObject::ParameterEnum::MinFilter, GL_LINEAR);
+        texture->SetParameter(TextureObject::ParameterEnum::MagFilter, GL_LINEAR);
+        texture->SetParameter(TextureObject::ParameterEnum::CompareMode, GL_COMPARE_REF_TO_TEXTURE);
+        texture->SetParameter(TextureObject::ParameterEnum::CompareFunction, GL_LEQUAL);
+    }
+    else
+    {
+        texture->SetParameter(TextureObject::ParameterEnum::MinFilter, GL_NEAREST);
+        texture->SetParameter(TextureObject::ParameterEnum::MagFilter, GL_NEAREST);
+    }
+    return texture;
+}
+
+static std::shared_ptr<FramebufferObject> CreateDepthFramebuffer(const Texture2DObject& depthTexture)
+{
+    std::shared_ptr<FramebufferObject> framebuffer = std::make_shared<FramebufferObject>();
+    framebuffer->Bind();
+    framebuffer->SetTexture(FramebufferObject::Target::Both, FramebufferObject::Attachment::Depth, depthTexture);
+    framebuffer->SetDrawBuffers(std::span<const FramebufferObject::Attachment>());
+    framebuffer->SetReadBuffer(FramebufferObject::Attachment::None);
+    return framebuffer;
+}
+
+ShadowRenderPass::ShadowRenderPass(int atlasSize)
+    : m_atlasSize(atlasSize), m_maxTileSize(atlasSize / 4), m_minTileSize(std::min(128, atlasSize / 4))
+    , m_cascadeCount(MaxCascadeCount), m_shadowDistance(50.0f), m_cascadeSplitLambda(0.75f), m_casterDistance(50.0f)
+    , m_depthBias(2.0f, 4.0f), m_activeTileCount(0), m_staticCacheUpdated(false), m_droppedLightCount(0)
+{
+    assert(atlasSize > 0 && (atlasSize & (atlasSize - 1)) == 0);
+
+    m_atlasTexture = CreateDepthTexture(atlasSize, true);
+    m_staticTexture = CreateDepthTexture(atlasSize, false);
+    Texture2DObject::Unbind();
+
+    m_targetFramebuffer = CreateDepthFramebuffer(*m_atlasTexture);
+    m_staticFramebuffer = CreateDepthFramebuffer(*m_staticTexture);
+    FramebufferObject::Unbind();
+}
+
+void ShadowRenderPass::SetMaxTileSize(int maxTileSize)
+{
+    assert(maxTileSize > 0 && (maxTileSize & (maxTileSize - 1)) == 0 && maxTileSize <= m_atlasSize);
+    m_maxTileSize = maxTileSize;
+    m_minTileSize = std::min(m_minTileSize, maxTileSize);
+}
+
+void ShadowRenderPass::SetMinTileSize(int minTileSize)
+{
+    assert(minTileSize > 0 && (minTileSize & (minTileSize - 1)) == 0 && minTileSize <= m_maxTileSize);
+    m_minTileSize = minTileSize;
+}
+
+void ShadowRenderPass::SetCascadeCount(unsigned int cascadeCount)
+{
+    assert(cascadeCount > 0 && cascadeCount <= MaxCascadeCount);
+    m_cascadeCount = cascadeCount;
+}
+
+void ShadowRenderPass::InitializeCollections(unsigned int tileCount)
+{
+    Renderer& renderer = GetRenderer();
+
+    // Collections are only created when more tiles are needed, and kept for the next frames
+    for (unsigned int tileIndex = static_cast<unsigned int>(m_staticCollections.size()); tileIndex < tileCount; ++tileIndex)
+    {
+        auto isSupported = [this, tileIndex](const Renderer::DrawcallInfo& drawcallInfo)
+        {
+            return tileIndex < m_activeTileCount && IsShadowCaster(drawcallInfo.GetMaterial());
+        };
+        m_staticCollections.push_back(renderer.AddDrawcallCollection(isSupported, Renderer::MaxViewCount - 1));
+        m_dynamicCollections.push_back(renderer.AddDrawcallCollection(isSupported, Renderer::MaxViewCount - 1));
+    }
+}
+
+bool ShadowRenderPass::IsShadowCaster(const Material& material)
+{
+    return material.GetBlendEquationColor() == Material::BlendEquation::None && material.GetDepthWrite();
+}
+
+const ShadowRenderPass::Tile* ShadowRenderPass::FindPreviousTile(const Light* light, unsigned int cascade) const
+{
+    auto it = std::find_if(m_previousTiles.begin(), m_previousTiles.end(),
+        [&](const Tile& tile) { return tile.light == light && tile.cascade == cascade; });
+    return it != m_previousTiles.end() ? &*it : nullptr;
+}
+
+void ShadowRenderPass::AddViews()
+{
+    Renderer& renderer = GetRenderer();
+    assert(renderer.HasCamera());
+
+    m_tiles.clear();
+    m_lightShadows.clear();
+    m_droppedLightCount = 0;
+
+    const Camera& camera = renderer.GetViewCamera(0);
+    const glm::mat4& viewMatrix = camera.GetViewMatrix();
+    const glm::mat4& projMatrix = camera.GetProjectionMatrix();
+    FrustumBounds frustum(camera.GetViewProjectionMatrix());
+
+    // Cascades split the view between the near plane and the shadow distance
+    glm::mat4 invProjMatrix = glm::inverse(projMatrix);
+    glm::vec4 nearPoint = invProjMatrix * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+    glm::vec4 farPoint = invProjMatrix * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    float nearDepth = -nearPoint.z / nearPoint.w;
+    float farDepth = std::min(-farPoint.z / farPoint.w, nearDepth + m_shadowDistance);
+    std::array<float, MaxCascadeCount + 1> cascadeDepths;
+    ComputeCascadeSplits(nearDepth, farDepth, m_cascadeSplitLambda, std::span(cascadeDepths.data(), m_cascadeCount + 1));
+
+    // Tiles wanted by the lights, with their importance on the screen
+    SphereBounds influenceBounds(glm::vec3(0.0f), 0.0f);
+    for (const Light* light : renderer.GetLights())
+    {
+        switch (light->GetType())
+        {
+        case Light::Type::Directional:
+            // Cascades go first, the closest one before the others
+            for (unsigned int cascade = 0; cascade < m_cascadeCount; ++cascade)
+            {
+                Tile& tile = m_tiles.emplace_back();
+                tile.light = light;
+                tile.cascade = cascade;
+                tile.importance = std::numeric_limits<float>::infinity();
+                tile.wantedSize = static_cast<float>(m_maxTileSize);
+            }
+            break;
+        case Light::Type::Spot:
+            // Lights that don't reach the view can't shadow anything visible
+            if (light->GetInfluenceBounds(influenceBounds) && Bounds::Intersects(frustum, influenceBounds))
+            {
+                // Fraction of the screen covered by the light, the whole screen if the camera is inside
+                float depth = -(viewMatrix * glm::vec4(influenceBounds.GetCenter(), 1.0f)).z;
+                float radius = influenceBounds.GetRadius();
+                float screenSize = depth > radius ? std::min(radius * projMatrix[1][1] / depth, 1.0f) : 1.0f;
+
+                Tile& tile = m_tiles.emplace_back();
+                tile.light = light;
+                tile.cascade = 0;
+                tile.importance = screenSize;
+                tile.wantedSize = screenSize * m_maxTileSize;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Keep the most important tiles that have free views
+    std::stable_sort(m_tiles.begin(), m_tiles.end(), [](const Tile& a, const Tile& b) { return a.importance > b.importance; });
+    unsigned int freeViewCount = Renderer::MaxViewCount - renderer.GetViewCount();
+    size_t maxTileCount = std::min<size_t>(MaxTileCount, freeViewCount / 2);
+    auto countDropped = [&](size_t tileCount)
+    {
+        // Cascade 0 is the most important tile of each light, if it is dropped the light has no tiles
+        m_droppedLightCount += static_cast<unsigned int>(std::count_if(m_tiles.begin() + tileCount, m_tiles.end(),
+            [](const Tile& tile) { return tile.cascade == 0; }));
+        m_tiles.resize(tileCount);
+    };
+    if (m_tiles.size() > maxTileCount)
+    {
+        countDropped(maxTileCount);
+    }
+
+    // Tiles keep their size until the wanted size is half or double of it, so they don't lose their cache on small changes
+    for (Tile& tile : m_tiles)
+    {
+        const Tile* previousTile = FindPreviousTile(tile.light, tile.cascade);
+        tile.size = std::clamp(RoundToPowerOfTwo(tile.wantedSize), m_minTileSize, m_maxTileSize);
+        if (previousTile && previousTile->size >= m_minTileSize && previousTile->size <= m_maxTileSize
+            && tile.wantedSize > 0.5f * previousTile->size && tile.wantedSize < 2.0f * previousTile->size)
+        {
+            tile.size = previousTile->size;
+        }
+    }
+
+    // Pack the tiles from the largest to the smallest. Tiles that were in the atlas keep their order, to keep their positions
+    // If they don't fit, the sizes are halved, and at the minimum size the least important tiles are dropped
+    std::vector<int> sizes;
+    std::vector<glm::ivec2> positions;
+    while (true)
+    {
+        for (Tile& tile : m_tiles)
+        {
+            const Tile* previousTile = FindPreviousTile(tile.light, tile.cascade);
+            tile.position = previousTile ? previousTile->position : glm::ivec2(m_atlasSize);
+        }
+        // Previous positions in the order of the Z-order curve. If the tiles don't change, they are packed at the same place
+        auto getCell = [this](const Tile& tile)
+        {
+            return SpreadBits(tile.position.x / m_minTileSize) | (SpreadBits(tile.position.y / m_minTileSize) << 1);
+        };
+        std::vector<Tile> packOrder = m_tiles;
+        std::stable_sort(packOrder.begin(), packOrder.end(), [&](const Tile& a, const Tile& b)
+            {
+                return a.size != b.size ? a.size > b.size : getCell(a) < getCell(b);
+            });
+
+        sizes.resize(packOrder.size());
+        positions.resize(packOrder.size());
+        std::transform(packOrder.begin(), packOrder.end(), sizes.begin(), [](const Tile& tile) { return tile.size; });
+        if (PackTiles(sizes, m_atlasSize, m_minTileSize, positions))
+        {
+            for (size_t i = 0; i < packOrder.size(); ++i)
+            {
+                packOrder[i].position = positions[i];
+            }
+            m_tiles = std::move(packOrder);
+            break;
+        }
+
+        bool halved = false;
+        for (Tile& tile : m_tiles)
+        {
+            if (tile.size > m_minTileSize)
+            {
+                tile.size /= 2;
+                halved = true;
+            }
+        }
+        if (!halved)
+        {
+            countDropped(m_tiles.size() - 1);
+        }
+    }
+
+    InitializeCollections(static_cast<unsigned int>(m_tiles.size()));
+    m_activeTileCount = static_cast<unsigned int>(m_tiles.size());
+
+    // From clip space to the [0, 1] coordinates and depth of the tile
+    const glm::mat4 clipToTileMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+    for (unsigned int tileIndex = 0; tileIndex < m_tiles.size(); ++tileIndex)
+    {
+        Tile& tile = m_tiles[tileIndex];
+        const Light& light = *tile.light;
+        Camera& tileCamera = m_tileCameras[tileIndex];
+
+        if (light.GetType() == Light::Type::Directional)
+        {
+            FitCascade(camera, cascadeDepths[tile.cascade], cascadeDepths[tile.cascade + 1], light.GetDirection(), m_casterDistance, tileCamera);
+        }
+        else
+        {
+            // Spot lights shine opposite to their direction
+            glm::vec3 position = light.GetPosition();
+            glm::vec3 forward = -glm::normalize(light.GetDirection());
+            glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec4 attenuation = light.GetAttenuation();
+            float angle = attenuation.w > 0.0f ? std::min(attenuation.w, MaxSpotShadowAngle) : MaxSpotShadowAngle;
+            tileCamera.SetViewMatrix(position, position + forward, up);
+            tileCamera.SetPerspectiveProjectionMatrix(2.0f * angle, 1.0f, 0.01f * attenuation.y, attenuation.y);
+        }
+
+        // The cache is only valid if the tile is the same, at the same place, with the same projection
+        tile.viewProjMatrix = tileCamera.GetViewProjectionMatrix();
+        const Tile* previousTile = FindPreviousTile(tile.light, tile.cascade);
+        if (previousTile && previousTile->size == tile.size && previousTile->position == tile.position
+            && previousTile->viewProjMatrix == tile.viewProjMatrix)
+        {
+            tile.staticHash = previousTile->staticHash;
+            tile.staticValid = previousTile->staticValid;
+            tile.staticDrawcallCount = previousTile->staticDrawcallCount;
+            tile.staticRenderTime = previousTile->staticRenderTime;
+        }
+        else
+        {
+            tile.staticHash = 0;
+            tile.staticValid = false;
+            tile.staticDrawcallCount = 0;
+            tile.staticRenderTime = 0.0f;
+        }
+
+        tile.staticViewIndex = renderer.AddView(tileCamera, Renderer::ViewObjects::Static);
+        tile.dynamicViewIndex = renderer.AddView(tileCamera, Renderer::ViewObjects::Dynamic);
+        renderer.SetDrawcallCollectionViewIndex(m_staticCollections[tileIndex], tile.staticViewIndex);
+        renderer.SetDrawcallCollectionViewIndex(m_dynamicCollections[tileIndex], tile.dynamicViewIndex);
+
+        // Add the tile to the shadow of its light
+        auto it = std::find_if(m_lightShadows.begin(), m_lightShadows.end(), [&](const auto& lightShadow) { return lightShadow.first == &light; });
+        if (it == m_lightShadows.end())
+        {
+            it = m_lightShadows.insert(m_lightShadows.end(), std::make_pair(&light, LightShadow()));
+            it->second.tileCount = 0;
+        }
+        LightShadow& lightShadow = it->second;
+        lightShadow.matrices[tile.cascade] = clipToTileMatrix * tile.viewProjMatrix;
+        lightShadow.rects[tile.cascade] = glm::vec4(glm::vec2(tile.position), glm::vec2(static_cast<float>(tile.size))) / static_cast<float>(m_atlasSize);
+        lightShadow.tileCount = std::max(lightShadow.tileCount, tile.cascade + 1);
+    }
+
+    // Unused collections point to a view that no culled model is in, and reject the drawcalls anyway
+    for (unsigned int tileIndex = m_activeTileCount; tileIndex < m_staticCollections.size(); ++tileIndex)
+    {
+        renderer.SetDrawcallCollectionViewIndex(m_staticCollections[tileIndex], Renderer::MaxViewCount - 1);
+        renderer.SetDrawcallCollectionViewIndex(m_dynamicCollections[tileIndex], Renderer::MaxViewCount - 1);
+    }
+}
+
+Renderer::ViewMask ShadowRenderPass::UpdateStaticCache(std::span<const Model* const> models, std::span<const glm::mat4> worldMatrices,
+    std::span<const Renderer::ViewMask> viewMasks, std::span<const unsigned int> lods)
+{
+    assert(models.size() == worldMatrices.size() && models.size() == viewMasks.size());
+    assert(lods.empty() || lods.size() == models.size());
+
+    Renderer::ViewMask staticViews = 0;
+    for (const Tile& tile : m_tiles)
+    {
+        staticViews |= 1u << tile.staticViewIndex;
+    }
+
+    // Hash the static objects of each tile, with their model, LOD and world matrix, in the order they are added
+    std::array<uint64_t, MaxTileCount> hashes;
+    hashes.fill(HashOffset);
+    for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+    {
+        Renderer::ViewMask viewMask = viewMasks[modelIndex] & staticViews;
+        if (viewMask == 0)
+        {
+            continue;
+        }
+
+        unsigned int lod = lods.empty() ? 0 : lods[modelIndex];
+        uint64_t hash = HashBytes(HashOffset, &models[modelIndex], sizeof(const Model*));
+        hash = HashBytes(hash, &lod, sizeof(lod));
+        hash = HashBytes(hash, &worldMatrices[modelIndex], sizeof(glm::mat4));
+        for (unsigned int tileIndex = 0; tileIndex < m_tiles.size(); ++tileIndex)
+        {
+            if ((viewMask >> m_tiles[tileIndex].staticViewIndex) & 1)
+            {
+                hashes[tileIndex] = (hashes[tileIndex] ^ hash) * HashPrime;
+            }
+        }
+    }
+
+    Renderer::ViewMask cachedViews = 0;
+    for (unsigned int tileIndex = 0; tileIndex < m_tiles.size(); ++tileIndex)
+    {
+        Tile& tile = m_tiles[tileIndex];
+        if (tile.staticValid && tile.staticHash == hashes[tileIndex])
+        {
+            cachedViews |= 1u << tile.staticViewIndex;
+        }
+        else
+        {
+            tile.staticValid = false;
+            tile.staticHash = hashes[tileIndex];
+        }
+    }
+    m_staticCacheUpdated = true;
+    return cachedViews;
+}
+
+const ShadowRenderPass::LightShadow* ShadowRenderPass::GetLightShadow(const Light& light) const
+{
+    auto it = std::find_if(m_lightShadows.begin(), m_lightShadows.end(), [&](const auto& lightShadow) { return lightShadow.first == &light; });
+    return it != m_lightShadows.end() ? &it->second : nullptr;
+}
+
+Renderer::UpdateLightsFunction ShadowRenderPass::GetUpdateLightsFunction(const ShaderProgram& shaderProgram, const Renderer::UpdateLightsFunction& updateLights) const
+{
+    ShaderProgram::Location shadowCountLocation = shaderProgram.GetUniformLocation("LightShadowCount");
+    ShaderProgram::Location shadowMatricesLocation = shaderProgram.GetUniformLocation("LightShadowMatrices");
+    ShaderProgram::Location shadowRectsLocation = shaderProgram.GetUniformLocation("LightShadowRects");
+
+    return [=, this](const ShaderProgram& shaderProgram, std::span<const Light* const> lights, unsigned int& lightIndex) -> bool
+    {
+        unsigned int currentLightIndex = lightIndex;
+        if (!updateLights(shaderProgram, lights, lightIndex))
+        {
+            return false;
+        }
+
+        const LightShadow* lightShadow = currentLightIndex < lights.size() ? GetLightShadow(*lights[currentLightIndex]) : nullptr;
+        shaderProgram.SetUniform(shadowCountLocation, lightShadow ? static_cast<int>(lightShadow->tileCount) : 0);
+        if (lightShadow)
+        {
+            shaderProgram.SetUniforms(shadowMatricesLocation, std::span<const glm::mat4>(lightShadow->matrices));
+            shaderProgram.SetUniforms(shadowRectsLocation, std::span<const glm::vec4>(lightShadow->rects));
+        }
+        return true;
+    };
+}
+
+unsigned int ShadowRenderPass::RenderCollection(unsigned int collectionIndex)
+{
+    Renderer& renderer = GetRenderer();
+
+    bool indirect = IsIndirectSubmission();
+    std::span<const Renderer::IndirectBucket> buckets;
+    if (indirect)
+    {
+        buckets = renderer.BuildIndirectBuckets(collectionIndex);
+    }
+    auto nextBucket = buckets.begin();
+    unsigned int drawcallCount = 0;
+
+    std::span<const Renderer::DrawcallInfo> drawcallInfos = renderer.GetDrawcalls(collectionIndex);
+    for (unsigned int index = 0; index < drawcallInfos.size(); ++index)
+    {
+        const Renderer::DrawcallInfo& drawcallInfo = drawcallInfos[index];
+
+        // Drawcalls submitted indirectly are rendered with their bucket, when the first one is found
+        if (indirect && renderer.IsIndirectSupported(drawcallInfo))
+        {
+            if (nextBucket != buckets.end() && nextBucket->GetFirstDrawcallIndex() == index)
+            {
+                renderer.PrepareIndirectBucket(*nextBucket);
+                renderer.DrawIndirectBucket(*nextBucket);
+                drawcallCount += nextBucket->GetCommandCount();
+                ++nextBucket;
+            }
+            continue;
+        }
+
+        renderer.PrepareDrawcall(drawcallInfo);
+        drawcallInfo.GetDrawcall().Draw();
+        drawcallCount++;
+    }
+
+    return drawcallCount;
+}
+
+void ShadowRenderPass::Render()
+{
+    Renderer& renderer = GetRenderer();
+    DeviceGL& device = renderer.GetDevice();
+
+    m_stats = Stats();
+    m_stats.tileCount = static_cast<unsigned int>(m_tiles.size());
+    m_stats.droppedLightCount = m_droppedLightCount;
+
+    // Without views this frame there are no shadows to render or to sample
+    if (m_tiles.empty())
+    {
+        m_lightShadows.clear();
+    }
+    else
+    {
+        GLint viewportX, viewportY;
+        GLsizei viewportWidth, viewportHeight;
+        device.GetViewport(viewportX, viewportY, viewportWidth, viewportHeight);
+
+        // The scissor keeps the clears inside the tiles
+        device.EnableFeature(GL_SCISSOR_TEST);
+        device.EnableFeature(GL_POLYGON_OFFSET_FILL);
+        device.SetPolygonOffset(m_depthBias.x, m_depthBias.y);
+
+        // Static objects, only in the tiles that are not cached
+        for (unsigned int tileIndex = 0; tileIndex < m_tiles.size(); ++tileIndex)
+        {
+            Tile& tile = m_tiles[tileIndex];
+            if (m_staticCacheUpdated && tile.staticValid)
+            {
+                m_stats.staticCachedTileCount++;
+                m_stats.savedDrawcallCount += tile.staticDrawcallCount;
+                m_stats.savedTime += tile.staticRenderTime;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            renderer.SetCurrentFramebuffer(m_staticFramebuffer);
+            device.SetViewport(tile.position.x, tile.position.y, tile.size, tile.size);
+            device.SetScissor(tile.position.x, tile.position.y, tile.size, tile.size);
+            device.Clear(false, Color(), true, 1.0);
+
+            renderer.SetCurrentView(tile.staticViewIndex);
+            renderer.InvalidateDrawcallState();
+            tile.staticDrawcallCount = RenderCollection(m_staticCollections[tileIndex]);
+            tile.staticRenderTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            // Valid for the next frame, if nothing changes
+            tile.staticValid = m_staticCacheUpdated;
+
+            m_stats.staticRenderedTileCount++;
+            m_stats.staticDrawcallCount += tile.staticDrawcallCount;
+            m_stats.staticRenderTime += tile.staticRenderTime;
+        }
+
+        // Start each tile of the atlas with its static depth
+        device.DisableFeature(GL_SCISSOR_TEST);
+        m_staticFramebuffer->Bind(FramebufferObject::Target::Read);
+        m_targetFramebuffer->Bind(FramebufferObject::Target::Draw);
+        for (const Tile& tile : m_tiles)
+        {
+            FramebufferObject::Blit(tile.position.x, tile.position.y, tile.size, tile.size, GL_DEPTH_BUFFER_BIT);
+        }
+        m_targetFramebuffer->Bind();
+        renderer.SetCurrentFramebuffer(m_targetFramebuffer);
+
+        // Dynamic objects on top
+        device.EnableFeature(GL_SCISSOR_TEST);
+        for (unsigned int tileIndex = 0; tileIndex < m_tiles.size(); ++tileIndex)
+        {
+            const Tile& tile = m_tiles[tileIndex];
+            device.SetViewport(tile.position.x, tile.position.y, tile.size, tile.size);
+            device.SetScissor(tile.position.x, tile.position.y, tile.size, tile.size);
+
+            renderer.SetCurrentView(tile.dynamicViewIndex);
+            renderer.InvalidateDrawcallState();
+            m_stats.dynamicDrawcallCount += RenderCollection(m_dynamicCollections[tileIndex]);
+        }
+
+        device.DisableFeature(GL_SCISSOR_TEST);
+        device.DisableFeature(GL_POLYGON_OFFSET_FILL);
+        device.SetViewport(viewportX, viewportY, viewportWidth, viewportHeight);
+    }
+
+    // The tiles are compared with the next frame. The shadows stay until then, for the lighting passes
+    m_previousTiles.swap(m_tiles);
+    m_tiles.clear();
+    m_activeTileCount = 0;
+    m_staticCacheUpdated = false;
+}
+
+bool ShadowRenderPass::PackTiles(std::span<const int> sizes, int atlasSize, int minTileSize, std::span<glm::ivec2> positions)
+{
+    assert(sizes.size() == positions.size());
+
+    uint64_t cellsPerSide = atlasSize / minTileSize;
+    uint64_t cellCount = cellsPerSide * cellsPerSide;
+
+    // With decreasing power of two sizes, the first free cell is always aligned to the size of the tile
+    uint64_t cell = 0;
+    for (size_t tileIndex = 0; tileIndex < sizes.size(); ++tileIndex)
+    {
+        int size = sizes[tileIndex];
+        assert(size >= minTileSize && (size & (size - 1)) == 0);
+        assert(tileIndex == 0 || size <= sizes[tileIndex - 1]);
+
+        uint64_t tileCellsPerSide = size / minTileSize;
+        uint64_t tileCellCount = tileCellsPerSide * tileCellsPerSide;
+        if (cell + tileCellCount > cellCount)
+        {
+            return false;
+        }
+
+        positions[tileIndex] = glm::ivec2(CompactBits(cell), CompactBits(cell >> 1)) * minTileSize;
+        cell += tileCellCount;
+    }
+    return true;
+}
+
+void ShadowRenderPass::ComputeCascadeSplits(float near, float far, float lambda, std::span<float> depths)
+{
+    assert(depths.size() >= 2);
+
+    size_t cascadeCount = depths.size() - 1;
+    for (size_t i = 0; i <= cascadeCount; ++i)
+    {
+        float fraction = static_cast<float>(i) / cascadeCount;
+        float uniformDepth = near + (far - near) * fraction;
+        float logDepth = near * std::pow(far / near, fraction);
+        depths[i] = glm::mix(uniformDepth, logDepth, lambda);
+    }
+    depths.front() = near;
+    depths.back() = far;
+}
+
+void ShadowRenderPass::FitCascade(const Camera& camera, float nearDepth, float farDepth, const glm::vec3& lightDirection,
+    float casterDistance, Camera& cascadeCamera)
+{
+    // The light view is anchored at the origin, so the snapped bounds don't move with the camera
+    glm::vec3 forward = glm::normalize(lightDirection);
+    glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightViewMatrix = glm::lookAt(glm::vec3(0.0f), forward, up);
+
+    // Corners of the part of the view between the depths. Points along each edge of the frustum are linear in depth
+    glm::mat4 invProjMatrix = glm::inverse(camera.GetProjectionMatrix());
+    glm::mat4 viewToLightMatrix = lightViewMatrix * glm::inverse(camera.GetViewMatrix());
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        glm::vec2 ndc((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f);
+        glm::vec4 nearCorner = invProjMatrix * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farCorner = invProjMatrix * glm::vec4(ndc, 1.0f, 1.0f);
+        glm::vec3 edgeStart = glm::vec3(nearCorner) / nearCorner.w;
+        glm::vec3 edgeEnd = glm::vec3(farCorner) / farCorner.w;
+        for (float depth : { nearDepth, farDepth })
+        {
+            float t = (depth + edgeStart.z) / (edgeStart.z - edgeEnd.z);
+            glm::vec3 lightPoint = viewToLightMatrix * glm::vec4(glm::mix(edgeStart, edgeEnd, t), 1.0f);
+            boundsMin = glm::min(boundsMin, lightPoint);
+            boundsMax = glm::max(boundsMax, lightPoint);
+        }
+    }
+
+    // Casters between the light and the view also need to be in the map. The light looks down -Z
+    boundsMax.z += casterDistance;
+
+    // Snap the bounds outwards to a power of two grid, about 1/16 of the size of the cascade
+    glm::vec3 extent = boundsMax - boundsMin;
+    float gridSize = std::exp2(std::ceil(std::log2(std::max(std::max(extent.x, extent.y), 1e-4f) / 16.0f)));
+    boundsMin = glm::floor(boundsMin / gridSize) * gridSize;
+    boundsMax = glm::ceil(boundsMax / gridSize) * gridSize;
+
+    cascadeCamera.SetViewMatrix(lightViewMatrix);
+    cascadeCamera.SetOrthographicProjectionMatrix(glm::vec3(boundsMin.x, boundsMin.y, -boundsMax.z), glm::vec3(boundsMax.x, boundsMax.y, -boundsMin.z));
+}
@@ -1,6 +1,7 @@
 #include <ituGL/renderer/SkyboxRenderPass.h>
 
 #include <ituGL/renderer/Renderer.h>
+#include <ituGL/core/DeviceGL.h>
 #include <ituGL/geometry/Mesh.h>
 #include <ituGL/camera/Camera.h>
 #include <ituGL/asset/ShaderLoader.h>
@@ -45,11 +46,15 @@ void SkyboxRenderPass::Render()
     m_shaderProgram.SetTexture(m_skyboxTextureLocation, 0, *m_texture);
 
     // Only write to depth == 1
-    glDepthFunc(GL_EQUAL);
+    DeviceGL& device = renderer.GetDevice();
+    device.SetDepthFunction(GL_EQUAL);
 
     const Mesh& fullscreenMesh = renderer.GetFullscreenMesh();
     fullscreenMesh.DrawSubmesh(0);
     
     // Restore default value
-    glDepthFunc(GL_LESS);
+    device.SetDepthFunction(GL_LESS);
+
+    // We changed the program and the VAO without the renderer
+    renderer.InvalidateDrawcallState();
 }
@@ -0,0 +1,109 @@
+#include <ituGL/renderer/WeightedBlendedRenderPass.h>
+
+#include <ituGL/renderer/Renderer.h>
+#include <ituGL/core/DeviceGL.h>
+#include <ituGL/shader/Material.h>
+
+// Draw once, with all the lights if the shader supports clustered lighting, or with the first light and the indirect lighting otherwise
+// Additive passes for the other lights would add the coverage and the weights again
+template<typename TDraw>
+static void DrawLit(Renderer& renderer, const std::shared_ptr<const ShaderProgram>& shaderProgram,
+    std::span<const Light* const> lights, bool clustered, TDraw draw)
+{
+    unsigned int lightIndex = 0;
+    if (clustered && renderer.UpdateClusteredLights(shaderProgram))
+    {
+        // The lights come from the cluster buffers, the light binder only sets the indirect lighting
+        renderer.UpdateLights(shaderProgram, {}, lightIndex);
+    }
+    else
+    {
+        renderer.UpdateLights(shaderProgram, lights, lightIndex);
+    }
+
+    draw();
+}
+
+WeightedBlendedRenderPass::WeightedBlendedRenderPass(int drawcallCollectionIndex, std::shared_ptr<const FramebufferObject> targetFramebuffer)
+    : RenderPass(targetFramebuffer)
+    , m_drawcallCollectionIndex(drawcallCollectionIndex)
+{
+}
+
+void WeightedBlendedRenderPass::Render()
+{
+    Renderer& renderer = GetRenderer();
+    DeviceGL& device = renderer.GetDevice();
+
+    const auto& drawcallCollection = renderer.GetDrawcalls(m_drawcallCollectionIndex);
+    if (drawcallCollection.empty())
+    {
+        return;
+    }
+
+    assert(device.IsVersionSupported(4, 0));
+
+    // Both targets start at zero: no color, no weight and no coverage. The depth is the opaque one, it is kept
+    device.Clear(Color(0.0f, 0.0f, 0.0f, 0.0f));
+
+    // Transparent objects are hidden by the opaque ones, but not by each other
+    device.SetDepthFunction(GL_LESS);
+    device.SetDepthWrite(false);
+
+    // Accumulation adds the colors and the weights. Coverage is 1 - (1 - alpha) * (1 - coverage)
+    device.EnableFeature(GL_BLEND);
+    device.SetBlendEquation(GL_FUNC_ADD, GL_FUNC_ADD);
+    device.SetBlendFunction(0, GL_ONE, GL_ONE, GL_ONE, GL_ONE);
+    device.SetBlendFunction(1, GL_ONE, GL_ONE_MINUS_SRC_COLOR, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // The pass sets the depth and blend states, not the materials
+    Material::OverrideFlags materialOverride = static_cast<Material::OverrideFlags>(Material::OverrideBlend | Material::OverrideDepthTest);
+
+    bool indirect = IsIndirectSubmission();
+    bool orderIndependent = renderer.IsDrawcallCollectionOrderIndependent(m_drawcallCollectionIndex);
+    std::span<const Renderer::IndirectBucket> buckets;
+    if (indirect)
+    {
+        buckets = renderer.BuildIndirectBuckets(m_drawcallCollectionIndex);
+    }
+    auto nextBucket = buckets.begin();
+
+    bool clustered = device.IsVersionSupported(4, 3);
+    if (clustered)
+    {
+        renderer.PrepareClusteredLights();
+    }
+
+    // for all drawcalls, in any order
+    for (unsigned int index = 0; index < drawcallCollection.size(); ++index)
+    {
+        const Renderer::DrawcallInfo& drawcallInfo = drawcallCollection[index];
+
+        // Drawcalls submitted indirectly are rendered with their bucket, when the first one is found
+        // Blended buckets group drawcalls from anywhere in the collection, the order doesn't matter
+        if (indirect && renderer.IsIndirectSupported(drawcallInfo, orderIndependent))
+        {
+            if (nextBucket != buckets.end() && nextBucket->GetFirstDrawcallIndex() == index)
+            {
+                const Renderer::IndirectBucket& bucket = *nextBucket++;
+                renderer.PrepareIndirectBucket(bucket, materialOverride);
+
+                std::shared_ptr<const ShaderProgram> shaderProgram = bucket.GetMaterial().GetShaderProgram();
+                DrawLit(renderer, shaderProgram, renderer.GetAffectingLights(), clustered, [&]() { renderer.DrawIndirectBucket(bucket); });
+            }
+            continue;
+        }
+
+        renderer.PrepareDrawcall(drawcallInfo, materialOverride);
+
+        std::shared_ptr<const ShaderProgram> shaderProgram = drawcallInfo.GetMaterial().GetShaderProgram();
+        DrawLit(renderer, shaderProgram, renderer.GetDrawcallLights(drawcallInfo), clustered, [&]() { drawcallInfo.GetDrawcall().Draw(); });
+    }
+
+    // Restore default values
+    device.DisableFeature(GL_BLEND);
+    device.SetDepthWrite(true);
+
+    // We changed the render states without the renderer
+    renderer.InvalidateDrawcallState();
+}
@@ -0,0 +1,259 @@
+#include <ituGL/scene/BoundingVolumeHierarchy.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cassert>
+
+// Number of candidate split planes per axis when building with the SAH
+static const int SahBinCount = 16;
+
+// Cost of visiting a node, relative to testing an item
+static const float TraversalCost = 1.0f;
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() : m_cost(0.0f)
+{
+}
+
+void BoundingVolumeHierarchy::Build(std::span<const AabbBounds> bounds)
+{
+    unsigned int itemCount = static_cast<unsigned int>(bounds.size());
+
+    m_nodes.clear();
+    m_itemIndices.clear();
+    m_itemBounds.clear();
+    m_cost = 0.0f;
+
+    if (itemCount == 0)
+    {
+        return;
+    }
+
+    // Items are partitioned by value, so each node reads a contiguous range while building
+    std::vector<BuildItem> items(itemCount);
+    for (unsigned int i = 0; i < itemCount; ++i)
+    {
+        items[i] = BuildItem{ ItemBounds{ bounds[i].GetMin(), bounds[i].GetMax() }, bounds[i].GetCenter(), i };
+    }
+
+    // A binary tree with N leaves has 2N - 1 nodes, so node references stay valid while subdividing
+    m_nodes.reserve(2 * itemCount - 1);
+    Node& root = m_nodes.emplace_back();
+    root.first = 0;
+    root.count = itemCount;
+    root.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    root.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (const BuildItem& item : items)
+    {
+        root.boundsMin = glm::min(root.boundsMin, item.bounds.boundsMin);
+        root.boundsMax = glm::max(root.boundsMax, item.bounds.boundsMax);
+    }
+    Subdivide(0, items);
+
+    // Store the items in the order of the leaves
+    m_itemIndices.resize(itemCount);
+    m_itemBounds.resize(itemCount);
+    for (unsigned int i = 0; i < itemCount; ++i)
+    {
+        m_itemIndices[i] = items[i].index;
+        m_itemBounds[i] = items[i].bounds;
+    }
+
+    m_cost = ComputeCost();
+}
+
+void BoundingVolumeHierarchy::Refit(std::span<const AabbBounds> bounds)
+{
+    assert(bounds.size() == GetItemCount());
+
+    for (unsigned int i = 0; i < m_itemIndices.size(); ++i)
+    {
+        const AabbBounds& itemBounds = bounds[m_itemIndices[i]];
+        m_itemBounds[i] = ItemBounds{ itemBounds.GetMin(), itemBounds.GetMax() };
+    }
+
+    // Children are always after their parent, so updating backwards visits them first
+    for (size_t nodeIndex = m_nodes.size(); nodeIndex-- > 0;)
+    {
+        Node& node = m_nodes[nodeIndex];
+        if (node.count > 0)
+        {
+            node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                node.boundsMin = glm::min(node.boundsMin, m_itemBounds[i].boundsMin);
+                node.boundsMax = glm::max(node.boundsMax, m_itemBounds[i].boundsMax);
+            }
+        }
+        else
+        {
+            const Node& child0 = m_nodes[node.first];
+            const Node& child1 = m_nodes[node.first + 1];
+            node.boundsMin = glm::min(child0.boundsMin, child1.boundsMin);
+            node.boundsMax = glm::max(child0.boundsMax, child1.boundsMax);
+        }
+    }
+
+    m_cost = ComputeCost();
+}
+
+void BoundingVolumeHierarchy::Subdivide(unsigned int nodeIndex, std::vector<BuildItem>& items)
+{
+    Node& node = m_nodes[nodeIndex];
+    if (node.count <= 1)
+    {
+        return;
+    }
+
+    auto itBegin = items.begin() + node.first;
+    auto itEnd = itBegin + node.count;
+
+    glm::vec3 centroidMin(std::numeric_limits<float>::max());
+    glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+    for (auto it = itBegin; it != itEnd; ++it)
+    {
+        centroidMin = glm::min(centroidMin, it->centroid);
+        centroidMax = glm::max(centroidMax, it->centroid);
+    }
+
+    // Bin the items by their centroid in the 3 axes at the same time
+    struct Bin
+    {
+        glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        unsigned int count = 0;
+    };
+    Bin bins[3][SahBinCount];
+    glm::vec3 extent = centroidMax - centroidMin;
+    glm::vec3 binScale(0.0f);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        // Axes without extent put all the items in the first bin, and they are not evaluated
+        if (extent[axis] > 0.0f)
+        {
+            binScale[axis] = SahBinCount / extent[axis];
+        }
+    }
+    for (auto it = itBegin; it != itEnd; ++it)
+    {
+        glm::vec3 binPosition = (it->centroid - centroidMin) * binScale;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            Bin& bin = bins[axis][std::min(SahBinCount - 1, static_cast<int>(binPosition[axis]))];
+            bin.boundsMin = glm::min(bin.boundsMin, it->bounds.boundsMin);
+            bin.boundsMax = glm::max(bin.boundsMax, it->bounds.boundsMax);
+            bin.count++;
+        }
+    }
+
+    // Find the split plane with the lowest SAH cost
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    Bin bestLeft, bestRight;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+
+        // Sweep from the left accumulating bounds and counts, then from the right evaluating each split
+        Bin lefts[SahBinCount - 1];
+        Bin left;
+        for (int i = 0; i < SahBinCount - 1; ++i)
+        {
+            left.boundsMin = glm::min(left.boundsMin, bins[axis][i].boundsMin);
+            left.boundsMax = glm::max(left.boundsMax, bins[axis][i].boundsMax);
+            left.count += bins[axis][i].count;
+            lefts[i] = left;
+        }
+        Bin right;
+        for (int i = SahBinCount - 1; i > 0; --i)
+        {
+            right.boundsMin = glm::min(right.boundsMin, bins[axis][i].boundsMin);
+            right.boundsMax = glm::max(right.boundsMax, bins[axis][i].boundsMax);
+            right.count += bins[axis][i].count;
+            const Bin& left = lefts[i - 1];
+            if (right.count == 0 || left.count == 0)
+            {
+                continue;
+            }
+            float cost = GetArea(left.boundsMin, left.boundsMax) * left.count + GetArea(right.boundsMin, right.boundsMax) * right.count;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+                bestLeft = left;
+                bestRight = right;
+            }
+        }
+    }
+
+    // Keep it as a leaf if the items can't be split, or if splitting is more expensive and the leaf is small
+    if (bestAxis < 0)
+    {
+        return;
+    }
+    float nodeArea = GetArea(node.boundsMin, node.boundsMax);
+    float leafCost = node.count * nodeArea;
+    float splitCost = TraversalCost * nodeArea + bestCost;
+    if (splitCost >= leafCost && node.count <= MaxLeafItemCount)
+    {
+        return;
+    }
+
+    auto itMiddle = std::partition(itBegin, itEnd, [&](const BuildItem& item)
+        {
+            float binPosition = (item.centroid[bestAxis] - centroidMin[bestAxis]) * binScale[bestAxis];
+            return std::min(SahBinCount - 1, static_cast<int>(binPosition)) < bestSplit;
+        });
+    unsigned int leftCount = static_cast<unsigned int>(itMiddle - itBegin);
+    assert(leftCount == bestLeft.count);
+
+    // The bounds of the children are the bounds of their bins
+    unsigned int childIndex = static_cast<unsigned int>(m_nodes.size());
+    Node& leftChild = m_nodes.emplace_back();
+    leftChild.boundsMin = bestLeft.boundsMin;
+    leftChild.first = node.first;
+    leftChild.boundsMax = bestLeft.boundsMax;
+    leftChild.count = leftCount;
+    Node& rightChild = m_nodes.emplace_back();
+    rightChild.boundsMin = bestRight.boundsMin;
+    rightChild.first = node.first + leftCount;
+    rightChild.boundsMax = bestRight.boundsMax;
+    rightChild.count = node.count - leftCount;
+
+    node.first = childIndex;
+    node.count = 0;
+
+    Subdivide(childIndex, items);
+    Subdivide(childIndex + 1, items);
+}
+
+float BoundingVolumeHierarchy::ComputeCost() const
+{
+    if (m_nodes.empty())
+    {
+        return 0.0f;
+    }
+
+    float cost = 0.0f;
+    for (const Node& node : m_nodes)
+    {
+        float area = GetArea(node.boundsMin, node.boundsMax);
+        cost += node.count > 0 ? area * node.count : area * TraversalCost;
+    }
+    float rootArea = GetArea(m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+    return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
+
+float BoundingVolumeHierarchy::GetArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
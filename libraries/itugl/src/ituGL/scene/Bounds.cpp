@@ -1,5 +1,9 @@
 #include <ituGL/scene/Bounds.h>
 
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <cmath>
+
 SphereBounds::SphereBounds(const Bounds& bounds) : Bounds(bounds.GetCenter()), m_radius(0.0f)
 {
     switch (bounds.GetType())
@@ -8,10 +12,10 @@ SphereBounds::SphereBounds(const Bounds& bounds) : Bounds(bounds.GetCenter()), m
         m_radius = static_cast<const SphereBounds&>(bounds).GetRadius();
         break;
     case Type::AABB:
-        m_radius = static_cast<const AabbBounds&>(bounds).GetSize().length();
+        m_radius = glm::length(static_cast<const AabbBounds&>(bounds).GetSize());
         break;
     case Type::Box:
-        m_radius = static_cast<const BoxBounds&>(bounds).GetSize().length();
+        m_radius = glm::length(static_cast<const BoxBounds&>(bounds).GetSize());
         break;
     default:
         assert(false);
@@ -30,10 +34,9 @@ AabbBounds::AabbBounds(const Bounds& bounds) : Bounds(bounds.GetCenter()), m_siz
         break;
     case Type::Box:
         {
+            // Each axis of the box adds its projection to the size
             glm::mat3 scaledMatrix = static_cast<const BoxBounds&>(bounds).GetScaledMatrix();
-            m_size = glm::abs(scaledMatrix[0]);
-            m_size = glm::max(m_size, glm::abs(scaledMatrix[1]));
-            m_size = glm::max(m_size, glm::abs(scaledMatrix[2]));
+            m_size = glm::abs(scaledMatrix[0]) + glm::abs(scaledMatrix[1]) + glm::abs(scaledMatrix[2]);
         }
         break;
     default:
@@ -61,6 +64,42 @@ BoxBounds::BoxBounds(const Bounds& bounds) : RotatedBounds(bounds.GetCenter(), g
     }
 }
 
+AabbBounds AabbBounds::GetTransformed(const glm::mat4& matrix) const
+{
+    glm::vec3 center = matrix * glm::vec4(m_center, 1.0f);
+    glm::vec3 size = glm::abs(glm::vec3(matrix[0])) * m_size.x + glm::abs(glm::vec3(matrix[1])) * m_size.y + glm::abs(glm::vec3(matrix[2])) * m_size.z;
+    return AabbBounds(center, size);
+}
+
+FrustumBounds::FrustumBounds(const glm::mat4& viewProjMatrix) : Bounds(glm::vec3(0.0f))
+{
+    // Each plane is a combination of the rows of the matrix (Gribb-Hartmann), glm matrices are stored by columns
+    glm::mat4 rows = glm::transpose(viewProjMatrix);
+    m_planes[static_cast<int>(Plane::Left)] = rows[3] + rows[0];
+    m_planes[static_cast<int>(Plane::Right)] = rows[3] - rows[0];
+    m_planes[static_cast<int>(Plane::Bottom)] = rows[3] + rows[1];
+    m_planes[static_cast<int>(Plane::Top)] = rows[3] - rows[1];
+    m_planes[static_cast<int>(Plane::Near)] = rows[3] + rows[2];
+    m_planes[static_cast<int>(Plane::Far)] = rows[3] - rows[2];
+
+    // Normalize, so the distance to the planes can be compared with sizes in world space
+    for (glm::vec4& plane : m_planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    // The center is the origin of clip space
+    glm::mat4 inverseViewProjMatrix = glm::inverse(viewProjMatrix);
+    glm::vec4 center = inverseViewProjMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    m_center = glm::vec3(center) / center.w;
+
+    for (int i = 0; i < CornerCount; ++i)
+    {
+        glm::vec4 corner = inverseViewProjMatrix * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+        m_corners[i] = glm::vec3(corner) / corner.w;
+    }
+}
+
 template<>
 bool Bounds::Intersects(const SphereBounds& boundsA, const SphereBounds& boundsB)
 {
@@ -135,24 +174,81 @@ bool Bounds::Intersects(const BoxBounds& boundsA, const BoxBounds& boundsB)
         && TestSeparationAxis(glm::cross(boundsA.GetZVector(), boundsB.GetZVector()), distance, mA, mB);
 }
 
+// The bounds are outside if they are completely behind any of the planes
+// This is conservative: bounds near the corners can be outside the frustum and still pass the test
 template<>
 bool Bounds::Intersects(const FrustumBounds& boundsA, const SphereBounds& boundsB)
 {
+    for (int i = 0; i < static_cast<int>(FrustumBounds::Plane::Count); ++i)
+    {
+        const glm::vec4& plane = boundsA.GetPlane(static_cast<FrustumBounds::Plane>(i));
+        if (glm::dot(glm::vec3(plane), boundsB.GetCenter()) + plane.w < -boundsB.GetRadius())
+        {
+            return false;
+        }
+    }
     return true;
 }
 
 template<>
 bool Bounds::Intersects(const FrustumBounds& boundsA, const AabbBounds& boundsB)
 {
+    for (int i = 0; i < static_cast<int>(FrustumBounds::Plane::Count); ++i)
+    {
+        const glm::vec4& plane = boundsA.GetPlane(static_cast<FrustumBounds::Plane>(i));
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), boundsB.GetSize());
+        if (glm::dot(glm::vec3(plane), boundsB.GetCenter()) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
     return true;
 }
 
 template<>
 bool Bounds::Intersects(const FrustumBounds& boundsA, const BoxBounds& boundsB)
 {
+    glm::mat3 scaledMatrix = boundsB.GetScaledMatrix();
+    for (int i = 0; i < static_cast<int>(FrustumBounds::Plane::Count); ++i)
+    {
+        const glm::vec4& plane = boundsA.GetPlane(static_cast<FrustumBounds::Plane>(i));
+        glm::vec3 normal(plane);
+        float radius = std::abs(glm::dot(normal, scaledMatrix[0])) + std::abs(glm::dot(normal, scaledMatrix[1])) + std::abs(glm::dot(normal, scaledMatrix[2]));
+        if (glm::dot(normal, boundsB.GetCenter()) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
     return true;
 }
 
+// True if all the corners of the frustum are behind one of the planes of the other frustum
+static bool IsBehindAnyPlane(const FrustumBounds& planeFrustum, const FrustumBounds& cornerFrustum)
+{
+    for (int i = 0; i < static_cast<int>(FrustumBounds::Plane::Count); ++i)
+    {
+        const glm::vec4& plane = planeFrustum.GetPlane(static_cast<FrustumBounds::Plane>(i));
+        bool behind = true;
+        for (int corner = 0; corner < FrustumBounds::CornerCount && behind; ++corner)
+        {
+            behind = glm::dot(glm::vec3(plane), cornerFrustum.GetCorner(corner)) + plane.w < 0.0f;
+        }
+        if (behind)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Separating axis test with the face planes of both frustums
+// This is conservative too: the axes from the crossed edges are skipped, so some frustums close to each other still pass the test
+template<>
+bool Bounds::Intersects(const FrustumBounds& boundsA, const FrustumBounds& boundsB)
+{
+    return !IsBehindAnyPlane(boundsA, boundsB) && !IsBehindAnyPlane(boundsB, boundsA);
+}
+
 bool Bounds::Intersects(const Bounds& boundsA, const Bounds& boundsB)
 {
     switch (boundsA.GetType())
@@ -163,6 +259,8 @@ bool Bounds::Intersects(const Bounds& boundsA, const Bounds& boundsB)
         return Bounds::Intersects(static_cast<const AabbBounds&>(boundsA), boundsB);
     case Type::Box:
         return Bounds::Intersects(static_cast<const BoxBounds&>(boundsA), boundsB);
+    case Type::Frustum:
+        return Bounds::Intersects(static_cast<const FrustumBounds&>(boundsA), boundsB);
     default:
         assert(false);
         return false;
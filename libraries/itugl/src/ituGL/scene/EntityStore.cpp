@@ -0,0 +1,223 @@
+#include <ituGL/scene/EntityStore.h>
+
+#include <cassert>
+
+// Move the value of the row to the end of the destination column, if the destination has the component
+template<typename T>
+static void MoveColumnValue(std::vector<std::shared_ptr<T>>& source, bool sourceHasComponent, unsigned int row,
+    std::vector<std::shared_ptr<T>>& destination, bool destinationHasComponent)
+{
+    if (destinationHasComponent)
+    {
+        destination.push_back(sourceHasComponent ? std::move(source[row]) : nullptr);
+    }
+}
+
+// Move the last value of the column to the row, if the table has the component
+template<typename T>
+static void RemoveColumnValue(std::vector<std::shared_ptr<T>>& column, bool hasComponent, unsigned int row)
+{
+    if (hasComponent)
+    {
+        column[row] = std::move(column.back());
+        column.pop_back();
+    }
+}
+
+EntityStore::EntityStore() : m_tables(1u << static_cast<unsigned int>(Component::Count))
+{
+}
+
+Entity EntityStore::Create()
+{
+    Entity entity;
+    if (!m_freeIndices.empty())
+    {
+        entity.index = m_freeIndices.back();
+        m_freeIndices.pop_back();
+    }
+    else
+    {
+        entity.index = static_cast<unsigned int>(m_records.size());
+        m_records.push_back(EntityRecord{ 0, 0, 0, nullptr });
+    }
+
+    // Entities without components are in the table of mask 0
+    EntityRecord& record = m_records[entity.index];
+    entity.generation = record.generation;
+    record.mask = 0;
+    record.row = static_cast<unsigned int>(m_tables[0].entities.size());
+    m_tables[0].entities.push_back(entity);
+    return entity;
+}
+
+void EntityStore::Destroy(Entity entity)
+{
+    assert(IsValid(entity));
+    SetName(entity, "");
+
+    EntityRecord& record = m_records[entity.index];
+    RemoveRow(record.mask, record.row);
+
+    // Invalidate the handles to this entity
+    ++record.generation;
+    m_freeIndices.push_back(entity.index);
+}
+
+bool EntityStore::IsValid(Entity entity) const
+{
+    return entity.index < m_records.size() && m_records[entity.index].generation == entity.generation;
+}
+
+bool EntityStore::HasComponent(Entity entity, Component component) const
+{
+    assert(IsValid(entity));
+    return (m_records[entity.index].mask & GetComponentMask(component)) != 0;
+}
+
+std::shared_ptr<SceneNode> EntityStore::GetNode(Entity entity) const
+{
+    return GetComponent(entity, Component::Node, &Table::nodes);
+}
+
+void EntityStore::SetNode(Entity entity, std::shared_ptr<SceneNode> node)
+{
+    SetComponent(entity, Component::Node, &Table::nodes, node);
+}
+
+std::shared_ptr<Transform> EntityStore::GetTransform(Entity entity) const
+{
+    return GetComponent(entity, Component::Transform, &Table::transforms);
+}
+
+void EntityStore::SetTransform(Entity entity, std::shared_ptr<Transform> transform)
+{
+    SetComponent(entity, Component::Transform, &Table::transforms, transform);
+}
+
+std::shared_ptr<Model> EntityStore::GetModel(Entity entity) const
+{
+    return GetComponent(entity, Component::Model, &Table::models);
+}
+
+void EntityStore::SetModel(Entity entity, std::shared_ptr<Model> model)
+{
+    SetComponent(entity, Component::Model, &Table::models, model);
+}
+
+std::shared_ptr<Light> EntityStore::GetLight(Entity entity) const
+{
+    return GetComponent(entity, Component::Light, &Table::lights);
+}
+
+void EntityStore::SetLight(Entity entity, std::shared_ptr<Light> light)
+{
+    SetComponent(entity, Component::Light, &Table::lights, light);
+}
+
+std::shared_ptr<Camera> EntityStore::GetCamera(Entity entity) const
+{
+    return GetComponent(entity, Component::Camera, &Table::cameras);
+}
+
+void EntityStore::SetCamera(Entity entity, std::shared_ptr<Camera> camera)
+{
+    SetComponent(entity, Component::Camera, &Table::cameras, camera);
+}
+
+void EntityStore::SetName(Entity entity, const std::string& name)
+{
+    assert(IsValid(entity));
+
+    EntityRecord& record = m_records[entity.index];
+    if (record.name)
+    {
+        m_nameIndex.erase(*record.name);
+        record.name = nullptr;
+    }
+
+    if (!name.empty())
+    {
+        // Keys of the map don't move, so the record can point to it
+        auto result = m_nameIndex.emplace(name, entity);
+        assert(result.second);
+        record.name = &result.first->first;
+    }
+}
+
+Entity EntityStore::FindEntity(const std::string& name) const
+{
+    auto it = m_nameIndex.find(name);
+    return it != m_nameIndex.end() ? it->second : Entity();
+}
+
+void EntityStore::MoveEntity(Entity entity, unsigned int newMask)
+{
+    EntityRecord& record = m_records[entity.index];
+    unsigned int oldMask = record.mask;
+    Table& oldTable = m_tables[oldMask];
+    Table& newTable = m_tables[newMask];
+
+    auto has = [](unsigned int mask, Component component) { return (mask & GetComponentMask(component)) != 0; };
+    unsigned int oldRow = record.row;
+    MoveColumnValue(oldTable.nodes, has(oldMask, Component::Node), oldRow, newTable.nodes, has(newMask, Component::Node));
+    MoveColumnValue(oldTable.transforms, has(oldMask, Component::Transform), oldRow, newTable.transforms, has(newMask, Component::Transform));
+    MoveColumnValue(oldTable.models, has(oldMask, Component::Model), oldRow, newTable.models, has(newMask, Component::Model));
+    MoveColumnValue(oldTable.lights, has(oldMask, Component::Light), oldRow, newTable.lights, has(newMask, Component::Light));
+    MoveColumnValue(oldTable.cameras, has(oldMask, Component::Camera), oldRow, newTable.cameras, has(newMask, Component::Camera));
+    newTable.entities.push_back(entity);
+
+    RemoveRow(oldMask, oldRow);
+
+    record.mask = newMask;
+    record.row = static_cast<unsigned int>(newTable.entities.size() - 1);
+}
+
+void EntityStore::RemoveRow(unsigned int mask, unsigned int row)
+{
+    Table& table = m_tables[mask];
+    auto has = [mask](Component component) { return (mask & GetComponentMask(component)) != 0; };
+    RemoveColumnValue(table.nodes, has(Component::Node), row);
+    RemoveColumnValue(table.transforms, has(Component::Transform), row);
+    RemoveColumnValue(table.models, has(Component::Model), row);
+    RemoveColumnValue(table.lights, has(Component::Light), row);
+    RemoveColumnValue(table.cameras, has(Component::Camera), row);
+
+    Entity movedEntity = table.entities.back();
+    table.entities[row] = movedEntity;
+    table.entities.pop_back();
+    m_records[movedEntity.index].row = row;
+}
+
+template<typename T>
+std::shared_ptr<T> EntityStore::GetComponent(Entity entity, Component component, std::vector<std::shared_ptr<T>> Table::* column) const
+{
+    assert(IsValid(entity));
+    const EntityRecord& record = m_records[entity.index];
+    if (record.mask & GetComponentMask(component))
+    {
+        return (m_tables[record.mask].*column)[record.row];
+    }
+    return nullptr;
+}
+
+template<typename T>
+void EntityStore::SetComponent(Entity entity, Component component, std::vector<std::shared_ptr<T>> Table::* column, std::shared_ptr<T> value)
+{
+    assert(IsValid(entity));
+    unsigned int componentMask = GetComponentMask(component);
+    unsigned int mask = m_records[entity.index].mask;
+    if (value)
+    {
+        if ((mask & componentMask) == 0)
+        {
+            MoveEntity(entity, mask | componentMask);
+        }
+        const EntityRecord& record = m_records[entity.index];
+        (m_tables[record.mask].*column)[record.row] = value;
+    }
+    else if (mask & componentMask)
+    {
+        MoveEntity(entity, mask & ~componentMask);
+    }
+}
@@ -0,0 +1,227 @@
+#include <ituGL/scene/FrustumCuller.h>
+
+#include <glm/common.hpp>
+#include <cassert>
+
+// SSE is always available on x86-64. Other platforms use the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define FRUSTUMCULLER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+static const int PlaneCount = static_cast<int>(FrustumBounds::Plane::Count);
+
+// The bounds are outside if, for any plane, center distance + projected size < 0
+struct FrustumPlanes
+{
+    glm::vec4 planes[PlaneCount];
+    glm::vec3 absNormals[PlaneCount];
+};
+
+static FrustumPlanes GetFrustumPlanes(const FrustumBounds& frustum)
+{
+    FrustumPlanes frustumPlanes;
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        frustumPlanes.planes[i] = frustum.GetPlane(static_cast<FrustumBounds::Plane>(i));
+        frustumPlanes.absNormals[i] = glm::abs(glm::vec3(frustumPlanes.planes[i]));
+    }
+    return frustumPlanes;
+}
+
+static bool IsOutside(const FrustumPlanes& frustumPlanes, float centerX, float centerY, float centerZ, float sizeX, float sizeY, float sizeZ)
+{
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        const glm::vec4& plane = frustumPlanes.planes[i];
+        const glm::vec3& absNormal = frustumPlanes.absNormals[i];
+        float distance = (plane.x * centerX + plane.y * centerY) + (plane.z * centerZ + plane.w);
+        float radius = (absNormal.x * sizeX + absNormal.y * sizeY) + absNormal.z * sizeZ;
+        if (distance + radius < 0.0f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef FRUSTUMCULLER_USE_SSE
+// Planes with each component in the 4 lanes
+struct FrustumPlanesSSE
+{
+    __m128 planeX[PlaneCount], planeY[PlaneCount], planeZ[PlaneCount], planeW[PlaneCount];
+    __m128 absNormalX[PlaneCount], absNormalY[PlaneCount], absNormalZ[PlaneCount];
+};
+
+static FrustumPlanesSSE GetFrustumPlanesSSE(const FrustumPlanes& frustumPlanes)
+{
+    FrustumPlanesSSE planesSSE;
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        planesSSE.planeX[i] = _mm_set1_ps(frustumPlanes.planes[i].x);
+        planesSSE.planeY[i] = _mm_set1_ps(frustumPlanes.planes[i].y);
+        planesSSE.planeZ[i] = _mm_set1_ps(frustumPlanes.planes[i].z);
+        planesSSE.planeW[i] = _mm_set1_ps(frustumPlanes.planes[i].w);
+        planesSSE.absNormalX[i] = _mm_set1_ps(frustumPlanes.absNormals[i].x);
+        planesSSE.absNormalY[i] = _mm_set1_ps(frustumPlanes.absNormals[i].y);
+        planesSSE.absNormalZ[i] = _mm_set1_ps(frustumPlanes.absNormals[i].z);
+    }
+    return planesSSE;
+}
+
+// Test 4 bounds, each lane is one of them. Returns a bit mask with the bounds that are outside
+static int GetOutsideMask(const FrustumPlanesSSE& planes, __m128 centerX, __m128 centerY, __m128 centerZ, __m128 sizeX, __m128 sizeY, __m128 sizeZ)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 outside = _mm_setzero_ps();
+    for (int i = 0; i < PlaneCount; ++i)
+    {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.planeX[i], centerX), _mm_mul_ps(planes.planeY[i], centerY)),
+            _mm_add_ps(_mm_mul_ps(planes.planeZ[i], centerZ), planes.planeW[i]));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.absNormalX[i], sizeX), _mm_mul_ps(planes.absNormalY[i], sizeY)),
+            _mm_mul_ps(planes.absNormalZ[i], sizeZ));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    }
+    return _mm_movemask_ps(outside);
+}
+#endif
+
+FrustumCuller::FrustumCuller()
+{
+}
+
+void FrustumCuller::Clear()
+{
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_sizeX.clear();
+    m_sizeY.clear();
+    m_sizeZ.clear();
+}
+
+void FrustumCuller::Reserve(unsigned int count)
+{
+    m_centerX.reserve(count);
+    m_centerY.reserve(count);
+    m_centerZ.reserve(count);
+    m_sizeX.reserve(count);
+    m_sizeY.reserve(count);
+    m_sizeZ.reserve(count);
+}
+
+unsigned int FrustumCuller::AddBounds(const AabbBounds& bounds)
+{
+    unsigned int index = GetBoundsCount();
+    const glm::vec3& center = bounds.GetCenter();
+    const glm::vec3& size = bounds.GetSize();
+    m_centerX.push_back(center.x);
+    m_centerY.push_back(center.y);
+    m_centerZ.push_back(center.z);
+    m_sizeX.push_back(size.x);
+    m_sizeY.push_back(size.y);
+    m_sizeZ.push_back(size.z);
+    return index;
+}
+
+void FrustumCuller::Cull(const FrustumBounds& frustum, std::vector<unsigned int>& visibleIndices) const
+{
+    FrustumPlanes frustumPlanes = GetFrustumPlanes(frustum);
+
+    unsigned int count = GetBoundsCount();
+    unsigned int index = 0;
+
+#ifdef FRUSTUMCULLER_USE_SSE
+    FrustumPlanesSSE planesSSE = GetFrustumPlanesSSE(frustumPlanes);
+
+    // 4 bounds per iteration, each lane is one of them
+    for (; index + 4 <= count; index += 4)
+    {
+        int outsideMask = GetOutsideMask(planesSSE,
+            _mm_loadu_ps(m_centerX.data() + index), _mm_loadu_ps(m_centerY.data() + index), _mm_loadu_ps(m_centerZ.data() + index),
+            _mm_loadu_ps(m_sizeX.data() + index), _mm_loadu_ps(m_sizeY.data() + index), _mm_loadu_ps(m_sizeZ.data() + index));
+
+        for (unsigned int lane = 0; lane < 4; ++lane)
+        {
+            if ((outsideMask & (1 << lane)) == 0)
+            {
+                visibleIndices.push_back(index + lane);
+            }
+        }
+    }
+#endif
+
+    // Remaining bounds, one at a time
+    for (; index < count; ++index)
+    {
+        if (!IsOutside(frustumPlanes, m_centerX[index], m_centerY[index], m_centerZ[index], m_sizeX[index], m_sizeY[index], m_sizeZ[index]))
+        {
+            visibleIndices.push_back(index);
+        }
+    }
+}
+
+void FrustumCuller::CullViews(std::span<const FrustumBounds> frustums, std::vector<uint32_t>& viewMasks) const
+{
+    assert(frustums.size() <= 32);
+    unsigned int viewCount = static_cast<unsigned int>(frustums.size());
+
+    std::vector<FrustumPlanes> frustumPlanes;
+    frustumPlanes.reserve(viewCount);
+    for (const FrustumBounds& frustum : frustums)
+    {
+        frustumPlanes.push_back(GetFrustumPlanes(frustum));
+    }
+
+    unsigned int count = GetBoundsCount();
+    viewMasks.resize(count);
+    unsigned int index = 0;
+
+#ifdef FRUSTUMCULLER_USE_SSE
+    std::vector<FrustumPlanesSSE> planesSSE;
+    planesSSE.reserve(viewCount);
+    for (const FrustumPlanes& planes : frustumPlanes)
+    {
+        planesSSE.push_back(GetFrustumPlanesSSE(planes));
+    }
+
+    // The bounds are loaded once, and tested against all the frustums
+    for (; index + 4 <= count; index += 4)
+    {
+        __m128 centerX = _mm_loadu_ps(m_centerX.data() + index);
+        __m128 centerY = _mm_loadu_ps(m_centerY.data() + index);
+        __m128 centerZ = _mm_loadu_ps(m_centerZ.data() + index);
+        __m128 sizeX = _mm_loadu_ps(m_sizeX.data() + index);
+        __m128 sizeY = _mm_loadu_ps(m_sizeY.data() + index);
+        __m128 sizeZ = _mm_loadu_ps(m_sizeZ.data() + index);
+
+        uint32_t laneMasks[4] = {};
+        for (unsigned int view = 0; view < viewCount; ++view)
+        {
+            int outsideMask = GetOutsideMask(planesSSE[view], centerX, centerY, centerZ, sizeX, sizeY, sizeZ);
+            for (unsigned int lane = 0; lane < 4; ++lane)
+            {
+                laneMasks[lane] |= static_cast<uint32_t>(((outsideMask >> lane) & 1) ^ 1) << view;
+            }
+        }
+        for (unsigned int lane = 0; lane < 4; ++lane)
+        {
+            viewMasks[index + lane] = laneMasks[lane];
+        }
+    }
+#endif
+
+    // Remaining bounds, one at a time
+    for (; index < count; ++index)
+    {
+        uint32_t viewMask = 0;
+        for (unsigned int view = 0; view < viewCount; ++view)
+        {
+            if (!IsOutside(frustumPlanes[view], m_centerX[index], m_centerY[index], m_centerZ[index], m_sizeX[index], m_sizeY[index], m_sizeZ[index]))
+            {
+                viewMask |= 1u << view;
+            }
+        }
+        viewMasks[index] = viewMask;
+    }
+}
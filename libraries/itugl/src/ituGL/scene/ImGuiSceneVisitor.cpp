@@ -1,101 +1,284 @@
 #include <ituGL/scene/ImGuiSceneVisitor.h>
 
 #include <ituGL/utils/DearImGui.h>
+#include <ituGL/scene/Scene.h>
 #include <ituGL/scene/SceneCamera.h>
 #include <ituGL/scene/SceneLight.h>
 #include <ituGL/scene/SceneModel.h>
 #include <ituGL/scene/Transform.h>
 #include <ituGL/lighting/Light.h>
 #include <imgui.h>
+#include <string_view>
+#include <algorithm>
+#include <cctype>
+
+// Rows of the node list that fit in the window without scrolling
+static const int VisibleRowCount = 16;
+
+static std::string ToLower(std::string_view text)
+{
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower;
+}
 
 ImGuiSceneVisitor::ImGuiSceneVisitor(DearImGui& imGui, const char* windowName) : m_imGui(imGui), m_windowName(windowName)
+    , m_scene(nullptr), m_sceneNodeVersion(0), m_visitingScene(false), m_drawOnEndVisit(true), m_namesDirty(true)
+    , m_filter{}, m_filterBegin(0), m_filterEnd(0), m_selectedNode(nullptr), m_selectedType(NodeType::Model)
 {
 }
 
-void ImGuiSceneVisitor::VisitCamera(SceneCamera& sceneCamera)
+void ImGuiSceneVisitor::Draw(Scene& scene)
 {
-    if (auto window = m_imGui.UseWindow(m_windowName.c_str()))
+    if (&scene != m_scene || scene.GetNodeVersion() != m_sceneNodeVersion)
     {
-        ImGui::PushStyleColor(ImGuiCol_Header, ImVec4(0.3f, 0.3f, 0.3f, 1.0f));
-        if (ImGui::CollapsingHeader(sceneCamera.GetName().c_str()))
-        {
-            ImGui::PushID(&sceneCamera);
-            ImGui::Indent();
+        m_drawOnEndVisit = false;
+        scene.AcceptVisitor(*this);
+        m_drawOnEndVisit = true;
 
-            VisitTransform(*sceneCamera.GetTransform());
-            if (sceneCamera.GetTransform()->IsDirty())
-            {
-                sceneCamera.MatchCameraToTransform();
-            }
+        m_scene = &scene;
+        m_sceneNodeVersion = scene.GetNodeVersion();
+    }
 
-            ImGui::Separator();
+    DrawWindow();
+}
 
-            ImGui::Text("Camera stats");
+void ImGuiSceneVisitor::BeginVisit()
+{
+    // The index doesn't belong to any scene until the visit started by Draw ends
+    m_scene = nullptr;
+    m_nodes.clear();
+    m_namesDirty = true;
+    m_visitingScene = true;
+}
 
-            ImGui::Unindent();
-            ImGui::PopID();
+void ImGuiSceneVisitor::EndVisit()
+{
+    m_visitingScene = false;
+
+    // The selected node could have been removed
+    if (m_selectedNode)
+    {
+        auto it = std::find_if(m_nodes.begin(), m_nodes.end(), [&](const NodeEntry& entry) { return entry.node == m_selectedNode; });
+        if (it == m_nodes.end())
+        {
+            m_selectedNode = nullptr;
         }
-        ImGui::PopStyleColor();
+    }
+
+    if (m_drawOnEndVisit)
+    {
+        DrawWindow();
     }
 }
 
+void ImGuiSceneVisitor::VisitCamera(SceneCamera& sceneCamera)
+{
+    AddNode(sceneCamera, NodeType::Camera);
+}
+
 void ImGuiSceneVisitor::VisitLight(SceneLight& sceneLight)
+{
+    AddNode(sceneLight, NodeType::Light);
+}
+
+void ImGuiSceneVisitor::VisitModel(SceneModel& sceneModel)
+{
+    AddNode(sceneModel, NodeType::Model);
+}
+
+void ImGuiSceneVisitor::AddNode(SceneNode& node, NodeType type)
+{
+    if (m_visitingScene)
+    {
+        m_nodes.push_back(NodeEntry{ &node, type });
+    }
+    else if (auto window = m_imGui.UseWindow(m_windowName.c_str()))
+    {
+        ImGui::PushID(&node);
+        ImGui::TextUnformatted(node.GetName().c_str());
+        DrawNode(node, type);
+        ImGui::PopID();
+    }
+}
+
+void ImGuiSceneVisitor::DrawWindow()
 {
     if (auto window = m_imGui.UseWindow(m_windowName.c_str()))
     {
-        ImGui::PushStyleColor(ImGuiCol_Header, ImVec4(0.4f, 0.4f, 0.1f, 1.0f));
-        if (ImGui::CollapsingHeader(sceneLight.GetName().c_str()))
+        DrawFilter();
+        DrawNodeList();
+
+        if (m_selectedNode)
         {
-            ImGui::PushID(&sceneLight);
-            ImGui::Indent();
+            ImGui::Separator();
+            ImGui::PushID(m_selectedNode);
+            ImGui::TextUnformatted(m_selectedNode->GetName().c_str());
+            DrawNode(*m_selectedNode, m_selectedType);
+            ImGui::PopID();
+        }
+    }
+}
+
+void ImGuiSceneVisitor::DrawFilter()
+{
+    bool filterChanged = ImGui::InputText("Filter", m_filter, sizeof(m_filter));
+
+    // The name index is only needed while filtering, and the range only changes with the filter or the nodes
+    if (m_filter[0] != '\0' && (filterChanged || m_namesDirty))
+    {
+        BuildNameIndex();
+        UpdateFilterRange();
+    }
+}
 
-            VisitTransform(*sceneLight.GetTransform());
-            if (sceneLight.GetTransform()->IsDirty())
+void ImGuiSceneVisitor::DrawNodeList()
+{
+    bool filtered = m_filter[0] != '\0';
+    unsigned int nodeCount = static_cast<unsigned int>(m_nodes.size());
+    unsigned int rowCount = filtered ? m_filterEnd - m_filterBegin : nodeCount;
+    ImGui::Text("%u of %u nodes", rowCount, nodeCount);
+
+    float listHeight = ImGui::GetTextLineHeightWithSpacing() * VisibleRowCount;
+    if (ImGui::BeginChild("Nodes", ImVec2(0.0f, listHeight), true))
+    {
+        // Only the rows inside the scrolled region are built
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rowCount));
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
             {
-                sceneLight.MatchLightToTransform();
+                unsigned int entryIndex = filtered ? m_names[m_filterBegin + row].entryIndex : row;
+                const NodeEntry& entry = m_nodes[entryIndex];
+
+                ImGui::PushID(static_cast<int>(entryIndex));
+                switch (entry.type)
+                {
+                case NodeType::Camera:
+                    ImGui::TextDisabled("Camera");
+                    break;
+                case NodeType::Light:
+                    ImGui::TextDisabled("Light");
+                    break;
+                case NodeType::Model:
+                    ImGui::TextDisabled("Model");
+                    break;
+                }
+                ImGui::SameLine(ImGui::GetFontSize() * 4.0f);
+                if (ImGui::Selectable(entry.node->GetName().c_str(), entry.node == m_selectedNode))
+                {
+                    m_selectedNode = entry.node;
+                    m_selectedType = entry.type;
+                }
+                ImGui::PopID();
             }
+        }
+    }
+    ImGui::EndChild();
+}
 
-            ImGui::Separator();
+void ImGuiSceneVisitor::BuildNameIndex()
+{
+    if (!m_namesDirty)
+    {
+        return;
+    }
 
-            Light& light = *sceneLight.GetLight();
+    m_names.clear();
+    m_names.reserve(m_nodes.size());
+    for (unsigned int entryIndex = 0; entryIndex < m_nodes.size(); ++entryIndex)
+    {
+        m_names.push_back(NameEntry{ ToLower(m_nodes[entryIndex].node->GetName()), entryIndex });
+    }
+    std::sort(m_names.begin(), m_names.end(), [](const NameEntry& a, const NameEntry& b) { return a.name < b.name; });
+    m_namesDirty = false;
+}
 
-            glm::vec3 color = light.GetColor();
-            if (ImGui::ColorEdit3("Color", &color[0]))
-                light.SetColor(color);
+void ImGuiSceneVisitor::UpdateFilterRange()
+{
+    // Names with the same prefix are contiguous in the sorted index, so two binary searches find all of them
+    std::string prefix = ToLower(m_filter);
+    auto begin = std::lower_bound(m_names.begin(), m_names.end(), prefix,
+        [](const NameEntry& entry, const std::string& prefix) { return entry.name < prefix; });
+    auto end = std::partition_point(begin, m_names.end(),
+        [&](const NameEntry& entry) { return entry.name.starts_with(prefix); });
 
-            float intensity = light.GetIntensity();
-            if (ImGui::DragFloat("Intensity", &intensity, 0.1f, 0.0f, 100000.0f))
-                light.SetIntensity(intensity);
+    m_filterBegin = static_cast<unsigned int>(begin - m_names.begin());
+    m_filterEnd = static_cast<unsigned int>(end - m_names.begin());
+}
 
-            ImGui::Unindent();
-            ImGui::PopID();
-        }
-        ImGui::PopStyleColor();
+void ImGuiSceneVisitor::DrawNode(SceneNode& node, NodeType type)
+{
+    switch (type)
+    {
+    case NodeType::Camera:
+        DrawCamera(static_cast<SceneCamera&>(node));
+        break;
+    case NodeType::Light:
+        DrawLight(static_cast<SceneLight&>(node));
+        break;
+    case NodeType::Model:
+        DrawModel(static_cast<SceneModel&>(node));
+        break;
     }
 }
 
-void ImGuiSceneVisitor::VisitModel(SceneModel& sceneModel)
+void ImGuiSceneVisitor::DrawCamera(SceneCamera& sceneCamera)
 {
-    if (auto window = m_imGui.UseWindow(m_windowName.c_str()))
+    ImGui::Indent();
+
+    DrawTransform(*sceneCamera.GetTransform());
+    if (sceneCamera.GetTransform()->IsDirty())
     {
-        ImGui::PushStyleColor(ImGuiCol_Header, ImVec4(0.2f, 0.2f, 0.5f, 1.0f));
-        if (ImGui::CollapsingHeader(sceneModel.GetName().c_str()))
-        {
-            ImGui::PushID(&sceneModel);
-            ImGui::Indent();
+        sceneCamera.MatchCameraToTransform();
+    }
 
-            VisitTransform(*sceneModel.GetTransform());
-            ImGui::Separator();
+    ImGui::Separator();
 
-            ImGui::Text("Model stats");
-            ImGui::Unindent();
-            ImGui::PopID();
-        }
-        ImGui::PopStyleColor();
+    ImGui::Text("Camera stats");
+
+    ImGui::Unindent();
+}
+
+void ImGuiSceneVisitor::DrawLight(SceneLight& sceneLight)
+{
+    ImGui::Indent();
+
+    DrawTransform(*sceneLight.GetTransform());
+    if (sceneLight.GetTransform()->IsDirty())
+    {
+        sceneLight.MatchLightToTransform();
     }
+
+    ImGui::Separator();
+
+    Light& light = *sceneLight.GetLight();
+
+    glm::vec3 color = light.GetColor();
+    if (ImGui::ColorEdit3("Color", &color[0]))
+        light.SetColor(color);
+
+    float intensity = light.GetIntensity();
+    if (ImGui::DragFloat("Intensity", &intensity, 0.1f, 0.0f, 100000.0f))
+        light.SetIntensity(intensity);
+
+    ImGui::Unindent();
+}
+
+void ImGuiSceneVisitor::DrawModel(SceneModel& sceneModel)
+{
+    ImGui::Indent();
+
+    DrawTransform(*sceneModel.GetTransform());
+    ImGui::Separator();
+
+    ImGui::Text("Model stats");
+
+    ImGui::Unindent();
 }
 
-void ImGuiSceneVisitor::VisitTransform(Transform& transform)
+void ImGuiSceneVisitor::DrawTransform(Transform& transform)
 {
     glm::vec3 translation = transform.GetTranslation();
     glm::vec3 rotation = transform.GetRotation();
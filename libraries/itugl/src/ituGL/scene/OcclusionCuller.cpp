@@ -0,0 +1,496 @@
+#include <ituGL/scene/OcclusionCuller.h>
+
+#include <ituGL/core/WorkerPool.h>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+
+// SSE is always available on x86-64. Other platforms use the scalar path
+#if defined(__SSE__) || defined(_M_X64)
+#define OCCLUSIONCULLER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Vertices closer than this w are behind the near plane. Occluders crossing it are not drawn, which is conservative
+static const float MinClipW = 1e-5f;
+
+// Triangles with a smaller area in pixels are skipped, they are seen edge-on
+static const float MinTriangleArea = 1e-6f;
+
+// Pixel corners on an edge shared by two triangles can be missed by both because of rounding.
+// The edges are widened by this fraction of a pixel, so they are covered
+static const float EdgeTolerance = 1.0f / 1024.0f;
+
+// Corners of a tile, in rows padded so groups of 4 corners and pixels never read past the row
+static const int CornerRowSize = OcclusionCuller::TileWidth + 4;
+static const int CornerRowCount = OcclusionCuller::TileHeight + 1;
+
+// Corner not covered by the current occluder
+static const float UncoveredDepth = std::numeric_limits<float>::max();
+
+// Size of a level of the depth hierarchy, rounding up
+static int GetLevelSize(int size, int level)
+{
+    return std::max(1, (size + (1 << level) - 1) >> level);
+}
+
+static float GetElapsedTime(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+OccluderMesh OccluderMesh::CreateBox(const glm::vec3& min, const glm::vec3& max)
+{
+    OccluderMesh box;
+    for (int i = 0; i < 8; ++i)
+    {
+        box.vertices.push_back(glm::vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z));
+    }
+    // Two triangles per face. The rasterizer doesn't cull back faces, so the winding doesn't matter
+    box.indices = {
+        0, 2, 3, 0, 3, 1, // -Z
+        4, 5, 7, 4, 7, 6, // +Z
+        0, 4, 6, 0, 6, 2, // -X
+        1, 3, 7, 1, 7, 5, // +X
+        0, 1, 5, 0, 5, 4, // -Y
+        2, 6, 7, 2, 7, 3, // +Y
+    };
+    return box;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height) : m_width(width), m_height(height), m_workerPool(nullptr), m_threadCount(0), m_viewProjMatrix(1.0f)
+{
+    assert(width > 0 && width % TileWidth == 0);
+    assert(height > 0 && height % TileHeight == 0);
+
+    int level = 0;
+    do
+    {
+        m_depthLevels.emplace_back(GetLevelSize(width, level) * GetLevelSize(height, level), 1.0f);
+        ++level;
+    } while (GetLevelSize(width, level - 1) > 1 || GetLevelSize(height, level - 1) > 1);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjMatrix)
+{
+    m_viewProjMatrix = viewProjMatrix;
+    m_occluders.clear();
+    m_triangles.clear();
+    m_occluderTriangles.clear();
+    for (std::vector<float>& level : m_depthLevels)
+    {
+        std::fill(level.begin(), level.end(), 1.0f);
+    }
+    m_stats = Stats();
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& occluder, const glm::mat4& worldMatrix)
+{
+    assert(occluder.indices.size() % 3 == 0);
+    m_occluders.push_back(Occluder{ &occluder, worldMatrix });
+}
+
+void OcclusionCuller::RenderOccluders()
+{
+    auto start = std::chrono::steady_clock::now();
+    SetupTriangles();
+    m_stats.occluderCount = static_cast<unsigned int>(m_occluders.size());
+    m_stats.triangleCount = static_cast<unsigned int>(m_triangles.size());
+    m_stats.setupTime = GetElapsedTime(start);
+
+    // Each thread draws a range of whole rows of tiles, so they never write the same pixels
+    start = std::chrono::steady_clock::now();
+    int tileCountX = m_width / TileWidth;
+    int tileCountY = m_height / TileHeight;
+    auto rasterizeRows = [&](size_t, size_t rowBegin, size_t rowEnd)
+    {
+        for (int tileY = static_cast<int>(rowBegin); tileY < static_cast<int>(rowEnd); ++tileY)
+        {
+            for (int tileX = 0; tileX < tileCountX; ++tileX)
+            {
+                RasterizeTile(tileX, tileY);
+            }
+        }
+    };
+    unsigned int threadCount = GetRasterizeThreadCount(tileCountY);
+    if (threadCount > 1)
+    {
+        m_workerPool->Run(tileCountY, threadCount, rasterizeRows);
+    }
+    else
+    {
+        rasterizeRows(0, 0, tileCountY);
+    }
+    m_stats.rasterizeTime = GetElapsedTime(start);
+
+    start = std::chrono::steady_clock::now();
+    BuildDepthHierarchy();
+    m_stats.hierarchyTime = GetElapsedTime(start);
+
+    m_occluders.clear();
+}
+
+bool OcclusionCuller::IsVisible(const AabbBounds& bounds) const
+{
+    // Project the corners to find the rectangle in the screen and the closest depth
+    glm::vec3 boundsMin = bounds.GetMin();
+    glm::vec3 boundsMax = bounds.GetMax();
+    glm::vec2 screenMin(std::numeric_limits<float>::max());
+    glm::vec2 screenMax(-std::numeric_limits<float>::max());
+    float minDepth = std::numeric_limits<float>::max();
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec4 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+        glm::vec4 clip = m_viewProjMatrix * corner;
+        if (clip.w < MinClipW)
+        {
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screenMin = glm::min(screenMin, glm::vec2(ndc));
+        screenMax = glm::max(screenMax, glm::vec2(ndc));
+        minDepth = std::min(minDepth, ndc.z * 0.5f + 0.5f);
+    }
+
+    int minX = std::max(0, static_cast<int>(std::floor((screenMin.x * 0.5f + 0.5f) * m_width)));
+    int minY = std::max(0, static_cast<int>(std::floor((screenMin.y * 0.5f + 0.5f) * m_height)));
+    int maxX = std::min(m_width - 1, static_cast<int>(std::floor((screenMax.x * 0.5f + 0.5f) * m_width)));
+    int maxY = std::min(m_height - 1, static_cast<int>(std::floor((screenMax.y * 0.5f + 0.5f) * m_height)));
+    if (minX > maxX || minY > maxY || minDepth < 0.0f)
+    {
+        return true;
+    }
+
+    // Use the first level where the rectangle is, at most, 4x4 texels
+    int level = 0;
+    int levelCount = static_cast<int>(m_depthLevels.size());
+    while (level + 1 < levelCount && ((maxX >> level) - (minX >> level) >= 4 || (maxY >> level) - (minY >> level) >= 4))
+    {
+        ++level;
+    }
+
+    // Visible if any texel has an occluder behind the closest depth of the bounds
+    const std::vector<float>& depths = m_depthLevels[level];
+    int levelWidth = GetLevelSize(m_width, level);
+    for (int y = minY >> level; y <= (maxY >> level); ++y)
+    {
+        for (int x = minX >> level; x <= (maxX >> level); ++x)
+        {
+            if (minDepth <= depths[y * levelWidth + x])
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::Cull(std::span<const AabbBounds> bounds, std::vector<unsigned int>& visibleIndices)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned int culledCount = 0;
+    for (unsigned int index = 0; index < bounds.size(); ++index)
+    {
+        if (IsVisible(bounds[index]))
+        {
+            visibleIndices.push_back(index);
+        }
+        else
+        {
+            culledCount++;
+        }
+    }
+    m_stats.testedCount += static_cast<unsigned int>(bounds.size());
+    m_stats.culledCount += culledCount;
+    m_stats.testTime += GetElapsedTime(start);
+}
+
+void OcclusionCuller::SetupTriangles()
+{
+    glm::vec2 screenScale(0.5f * m_width, 0.5f * m_height);
+    std::vector<glm::vec4> clipVertices;
+    for (const Occluder& occluder : m_occluders)
+    {
+        OccluderTriangles occluderTriangles = { static_cast<unsigned int>(m_triangles.size()), 0, m_width, m_height, 0, 0 };
+        bool occluderClipped = false;
+
+        glm::mat4 worldViewProjMatrix = m_viewProjMatrix * occluder.worldMatrix;
+        const std::vector<glm::vec3>& vertices = occluder.mesh->vertices;
+        clipVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            clipVertices[i] = worldViewProjMatrix * glm::vec4(vertices[i], 1.0f);
+        }
+
+        const std::vector<unsigned int>& indices = occluder.mesh->indices;
+        for (size_t i = 0; i + 2 < indices.size() && !occluderClipped; i += 3)
+        {
+            glm::vec3 screenVertices[3];
+            bool clipped = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec4& clip = clipVertices[indices[i + k]];
+                clipped |= clip.w < MinClipW;
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                screenVertices[k] = glm::vec3((glm::vec2(ndc) + 1.0f) * screenScale, ndc.z * 0.5f + 0.5f);
+            }
+            // Without some of its triangles, the occluder could cover pixels only partly
+            if (clipped)
+            {
+                occluderClipped = true;
+                break;
+            }
+
+            // Make the triangles counter-clockwise, so the edge functions are positive inside
+            glm::vec3 d1 = screenVertices[1] - screenVertices[0];
+            glm::vec3 d2 = screenVertices[2] - screenVertices[0];
+            float area = d1.x * d2.y - d1.y * d2.x;
+            if (area < 0.0f)
+            {
+                std::swap(screenVertices[1], screenVertices[2]);
+                std::swap(d1, d2);
+                area = -area;
+            }
+            if (area < MinTriangleArea)
+            {
+                continue;
+            }
+
+            Triangle triangle;
+            triangle.minX = m_width;
+            triangle.minY = m_height;
+            triangle.maxX = -1;
+            triangle.maxY = -1;
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec3& v0 = screenVertices[k];
+                const glm::vec3& v1 = screenVertices[(k + 1) % 3];
+                triangle.edgeA[k] = v0.y - v1.y;
+                triangle.edgeB[k] = v1.x - v0.x;
+                triangle.edgeC[k] = -(triangle.edgeA[k] * v0.x + triangle.edgeB[k] * v0.y)
+                    + EdgeTolerance * glm::length(glm::vec2(triangle.edgeA[k], triangle.edgeB[k]));
+
+                triangle.minX = std::min(triangle.minX, static_cast<int>(std::floor(v0.x)));
+                triangle.minY = std::min(triangle.minY, static_cast<int>(std::floor(v0.y)));
+                triangle.maxX = std::max(triangle.maxX, static_cast<int>(std::ceil(v0.x)));
+                triangle.maxY = std::max(triangle.maxY, static_cast<int>(std::ceil(v0.y)));
+            }
+            triangle.minX = std::max(triangle.minX, 0);
+            triangle.minY = std::max(triangle.minY, 0);
+            triangle.maxX = std::min(triangle.maxX, m_width);
+            triangle.maxY = std::min(triangle.maxY, m_height);
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            {
+                continue;
+            }
+
+            // Depth is linear in screen space after the perspective division
+            triangle.depth.x = (d1.z * d2.y - d2.z * d1.y) / area;
+            triangle.depth.y = (d2.z * d1.x - d1.z * d2.x) / area;
+            triangle.depth.z = screenVertices[0].z - triangle.depth.x * screenVertices[0].x - triangle.depth.y * screenVertices[0].y;
+
+            occluderTriangles.minX = std::min(occluderTriangles.minX, triangle.minX);
+            occluderTriangles.minY = std::min(occluderTriangles.minY, triangle.minY);
+            occluderTriangles.maxX = std::max(occluderTriangles.maxX, triangle.maxX);
+            occluderTriangles.maxY = std::max(occluderTriangles.maxY, triangle.maxY);
+            m_triangles.push_back(triangle);
+        }
+
+        if (occluderClipped)
+        {
+            m_triangles.resize(occluderTriangles.firstTriangle);
+            continue;
+        }
+        occluderTriangles.triangleCount = static_cast<unsigned int>(m_triangles.size()) - occluderTriangles.firstTriangle;
+        if (occluderTriangles.triangleCount > 0)
+        {
+            m_occluderTriangles.push_back(occluderTriangles);
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeTile(int tileX, int tileY)
+{
+    int tileMinX = tileX * TileWidth;
+    int tileMinY = tileY * TileHeight;
+
+    // Depth of the current occluder at the corners of the pixels in the tile, the closest of its triangles
+    float corners[CornerRowCount * CornerRowSize];
+
+    std::vector<float>& depths = m_depthLevels[0];
+    for (const OccluderTriangles& occluder : m_occluderTriangles)
+    {
+        // Corners of the occluder in the tile, in tile coordinates
+        int occluderMinX = std::max(occluder.minX - tileMinX, 0);
+        int occluderMinY = std::max(occluder.minY - tileMinY, 0);
+        int occluderMaxX = std::min(occluder.maxX, tileMinX + TileWidth) - tileMinX;
+        int occluderMaxY = std::min(occluder.maxY, tileMinY + TileHeight) - tileMinY;
+        if (occluderMinX >= occluderMaxX || occluderMinY >= occluderMaxY)
+        {
+            continue;
+        }
+
+        // Clear the corners written by the groups of 4 corners, and read by the groups of 4 pixels below
+        int clearMinX = occluderMinX & ~3;
+        int clearMaxX = std::max(occluderMaxX | 3, ((occluderMaxX - 1) | 3) + 1);
+        for (int y = occluderMinY; y <= occluderMaxY; ++y)
+        {
+            std::fill(corners + y * CornerRowSize + clearMinX, corners + y * CornerRowSize + clearMaxX + 1, UncoveredDepth);
+        }
+
+        for (unsigned int triangleIndex = 0; triangleIndex < occluder.triangleCount; ++triangleIndex)
+        {
+            const Triangle& triangle = m_triangles[occluder.firstTriangle + triangleIndex];
+
+            // Groups of 4 corners, aligned to 4 so they never leave the row
+            int minX = std::max(triangle.minX - tileMinX, occluderMinX) & ~3;
+            int maxX = std::min(triangle.maxX - tileMinX, occluderMaxX);
+            int minY = std::max(triangle.minY - tileMinY, occluderMinY);
+            int maxY = std::min(triangle.maxY - tileMinY, occluderMaxY);
+
+#ifdef OCCLUSIONCULLER_USE_SSE
+            __m128 edgeA[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                edgeA[k] = _mm_set1_ps(triangle.edgeA[k]);
+            }
+            __m128 depthA = _mm_set1_ps(triangle.depth.x);
+            __m128 cornerOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            __m128 zero = _mm_setzero_ps();
+#endif
+
+            for (int y = minY; y <= maxY; ++y)
+            {
+                float cornerY = static_cast<float>(tileMinY + y);
+                float* row = corners + y * CornerRowSize;
+
+#ifdef OCCLUSIONCULLER_USE_SSE
+                __m128 edgeRow[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    edgeRow[k] = _mm_set1_ps(triangle.edgeB[k] * cornerY + triangle.edgeC[k]);
+                }
+                __m128 depthRow = _mm_set1_ps(triangle.depth.y * cornerY + triangle.depth.z);
+
+                for (int x = minX; x <= maxX; x += 4)
+                {
+                    __m128 cornerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(tileMinX + x)), cornerOffsets);
+
+                    // Coverage mask of the 4 corners, only the covered ones are written
+                    __m128 coverage = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], cornerX), edgeRow[0]), zero);
+                    coverage = _mm_and_ps(coverage, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], cornerX), edgeRow[1]), zero));
+                    coverage = _mm_and_ps(coverage, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], cornerX), edgeRow[2]), zero));
+                    if (_mm_movemask_ps(coverage) == 0)
+                    {
+                        continue;
+                    }
+
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, cornerX), depthRow);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 closest = _mm_min_ps(current, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(coverage, closest), _mm_andnot_ps(coverage, current)));
+                }
+#else
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    float cornerX = static_cast<float>(tileMinX + x);
+                    bool covered = true;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        covered &= triangle.edgeA[k] * cornerX + (triangle.edgeB[k] * cornerY + triangle.edgeC[k]) >= 0.0f;
+                    }
+                    if (covered)
+                    {
+                        float depth = triangle.depth.x * cornerX + (triangle.depth.y * cornerY + triangle.depth.z);
+                        row[x] = std::min(row[x], depth);
+                    }
+                }
+#endif
+            }
+        }
+
+        // Pixels with the 4 corners covered take their farthest depth. The corners out of the occluder are uncovered,
+        // so the pixels of a group that are out of it are not written
+        for (int y = occluderMinY; y < occluderMaxY; ++y)
+        {
+            const float* cornerRow = corners + y * CornerRowSize;
+            const float* nextCornerRow = cornerRow + CornerRowSize;
+            float* row = depths.data() + (tileMinY + y) * m_width + tileMinX;
+
+#ifdef OCCLUSIONCULLER_USE_SSE
+            __m128 uncovered = _mm_set1_ps(UncoveredDepth);
+            for (int x = occluderMinX & ~3; x < occluderMaxX; x += 4)
+            {
+                __m128 farthest = _mm_max_ps(_mm_max_ps(_mm_loadu_ps(cornerRow + x), _mm_loadu_ps(cornerRow + x + 1)),
+                    _mm_max_ps(_mm_loadu_ps(nextCornerRow + x), _mm_loadu_ps(nextCornerRow + x + 1)));
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 closest = _mm_min_ps(current, farthest);
+                __m128 coverage = _mm_cmplt_ps(farthest, uncovered);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(coverage, closest), _mm_andnot_ps(coverage, current)));
+            }
+#else
+            for (int x = occluderMinX; x < occluderMaxX; ++x)
+            {
+                float farthest = std::max(std::max(cornerRow[x], cornerRow[x + 1]), std::max(nextCornerRow[x], nextCornerRow[x + 1]));
+                if (farthest < UncoveredDepth)
+                {
+                    row[x] = std::min(row[x], farthest);
+                }
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::BuildDepthHierarchy()
+{
+    for (int level = 1; level < static_cast<int>(m_depthLevels.size()); ++level)
+    {
+        const std::vector<float>& source = m_depthLevels[level - 1];
+        std::vector<float>& destination = m_depthLevels[level];
+        int sourceWidth = GetLevelSize(m_width, level - 1);
+        int sourceHeight = GetLevelSize(m_height, level - 1);
+        int width = GetLevelSize(m_width, level);
+        int height = GetLevelSize(m_height, level);
+        for (int y = 0; y < height; ++y)
+        {
+            int y0 = 2 * y;
+            int y1 = std::min(y0 + 1, sourceHeight - 1);
+            for (int x = 0; x < width; ++x)
+            {
+                int x0 = 2 * x;
+                int x1 = std::min(x0 + 1, sourceWidth - 1);
+                destination[y * width + x] = std::max(
+                    std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+                    std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+            }
+        }
+    }
+}
+
+unsigned int OcclusionCuller::GetRasterizeThreadCount(unsigned int tileRowCount) const
+{
+    if (!m_workerPool)
+    {
+        return 1;
+    }
+
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Not worth starting threads for a few triangles
+    if (m_triangles.size() < 64)
+    {
+        threadCount = 1;
+    }
+    return std::min(threadCount, tileRowCount);
+}
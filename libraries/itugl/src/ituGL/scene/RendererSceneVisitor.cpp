@@ -1,19 +1,222 @@
 #include <ituGL/scene/RendererSceneVisitor.h>
 
 #include <ituGL/renderer/Renderer.h>
+#include <ituGL/camera/Camera.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/scene/Scene.h>
 #include <ituGL/scene/SceneCamera.h>
 #include <ituGL/scene/SceneLight.h>
 #include <ituGL/scene/SceneModel.h>
 #include <ituGL/scene/Transform.h>
+#include <ituGL/scene/OcclusionCuller.h>
+#include <ituGL/renderer/ShadowRenderPass.h>
+#include <algorithm>
+#include <limits>
+
+// Fraction of the viewport height covered by the sphere around the bounds, in the view of the camera
+// viewRowZ is the third row of the view matrix, to get the view depth of the center
+static float GetScreenSize(const AabbBounds& bounds, const glm::vec4& viewRowZ, const glm::mat4& projMatrix)
+{
+    float radius = glm::length(bounds.GetSize());
+    float scaleY = projMatrix[1][1];
+
+    // Orthographic projections don't have perspective division, the size does not depend on the depth
+    if (projMatrix[2][3] == 0.0f)
+    {
+        return radius * scaleY;
+    }
+
+    // The camera is inside the sphere, use the full detail
+    float depth = -glm::dot(viewRowZ, glm::vec4(bounds.GetCenter(), 1.0f));
+    if (depth <= radius)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+    return radius * scaleY / depth;
+}
 
 RendererSceneVisitor::RendererSceneVisitor(Renderer& renderer) : m_renderer(renderer)
+    , m_frustumCulling(true), m_lodSelection(true), m_lodHysteresis(0.1f), m_occlusionCuller(nullptr), m_shadowRenderPass(nullptr), m_visitingScene(false)
+    , m_sceneCulled(false), m_visitViewMask(Renderer::AllViews)
+    , m_culledModelCount(0), m_occludedModelCount(0)
+{
+}
+
+void RendererSceneVisitor::SetOcclusionCuller(OcclusionCuller* occlusionCuller)
+{
+    m_occlusionCuller = occlusionCuller;
+    if (occlusionCuller)
+    {
+        occlusionCuller->SetWorkerPool(&m_renderer.GetWorkerPool());
+    }
+}
+
+void RendererSceneVisitor::BeginVisit()
 {
+    m_sceneModels.clear();
+    m_models.clear();
+    m_worldMatrices.clear();
+    m_occluders.clear();
+    m_bounds.clear();
+    m_viewMasks.clear();
+    m_lods.clear();
+    m_frustumCuller.Clear();
+    m_culledModelCount = 0;
+    m_occludedModelCount = 0;
+    m_visitingScene = true;
+    m_sceneCulled = false;
+    m_visitViewMask = Renderer::AllViews;
+}
+
+void RendererSceneVisitor::EndVisit()
+{
+    // Shadow views need the camera and the lights, and are culled with the other views
+    if (m_shadowRenderPass && m_renderer.HasCamera() && !m_sceneCulled)
+    {
+        m_shadowRenderPass->AddViews();
+    }
+
+    // The camera can be visited after the models, so they are culled once the whole scene is visited
+    if (!m_models.empty())
+    {
+        if (m_renderer.HasCamera())
+        {
+            // Models found by VisitScene already have the mask of the views they intersect
+            unsigned int viewCount = m_renderer.GetViewCount();
+            if (m_frustumCulling && !m_sceneCulled)
+            {
+                UpdateViewFrustums();
+                m_frustumCuller.CullViews(m_frustums, m_viewMasks);
+            }
+            else if (!m_frustumCulling)
+            {
+                Renderer::ViewMask allViews = viewCount < Renderer::MaxViewCount ? (1u << viewCount) - 1 : Renderer::AllViews;
+                m_viewMasks.assign(m_models.size(), allViews);
+            }
+            m_culledModelCount = static_cast<unsigned int>(std::count(m_viewMasks.begin(), m_viewMasks.end(), 0u));
+
+            if (m_occlusionCuller)
+            {
+                CullOccludedModels(m_renderer.GetViewCamera(0).GetViewProjectionMatrix());
+            }
+
+            // Static nodes go to the views of static objects, and the others to the views of dynamic objects
+            Renderer::ViewMask staticViewMask = m_renderer.GetStaticViewMask();
+            Renderer::ViewMask dynamicViewMask = m_renderer.GetDynamicViewMask();
+            if (staticViewMask != Renderer::AllViews || dynamicViewMask != Renderer::AllViews)
+            {
+                for (unsigned int i = 0; i < m_models.size(); ++i)
+                {
+                    m_viewMasks[i] &= m_sceneModels[i]->IsStatic() ? staticViewMask : dynamicViewMask;
+                }
+            }
+
+            // The LOD is selected from the main view, also for the models that are only visible in other views
+            const Camera& mainCamera = m_renderer.GetViewCamera(0);
+            const glm::mat4& viewMatrix = mainCamera.GetViewMatrix();
+            glm::vec4 viewRowZ(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+            const glm::mat4& projMatrix = mainCamera.GetProjectionMatrix();
+
+            // Keep the models that are visible in any view, selecting their LOD in the same pass
+            std::vector<unsigned int> visibleIndices;
+            visibleIndices.reserve(m_models.size());
+            for (unsigned int i = 0; i < m_models.size(); ++i)
+            {
+                if (m_viewMasks[i])
+                {
+                    visibleIndices.push_back(i);
+
+                    const Model& model = *m_models[i];
+                    unsigned int lod = 0;
+                    if (m_lodSelection && model.GetLodCount() > 1)
+                    {
+                        float screenSize = GetScreenSize(m_bounds[i], viewRowZ, projMatrix);
+                        lod = model.SelectLod(screenSize, m_sceneModels[i]->GetLod(), m_lodHysteresis);
+                    }
+                    m_sceneModels[i]->SetLod(lod);
+                    m_lods[i] = lod;
+                }
+            }
+            KeepModels(visibleIndices);
+
+            // Static models don't need to be added to the shadow tiles that have their depth cached
+            if (m_shadowRenderPass)
+            {
+                Renderer::ViewMask cachedViewMask = m_shadowRenderPass->UpdateStaticCache(m_models, m_worldMatrices, m_viewMasks, m_lods);
+                if (cachedViewMask)
+                {
+                    visibleIndices.clear();
+                    for (unsigned int i = 0; i < m_models.size(); ++i)
+                    {
+                        m_viewMasks[i] &= ~cachedViewMask;
+                        if (m_viewMasks[i])
+                        {
+                            visibleIndices.push_back(i);
+                        }
+                    }
+                    KeepModels(visibleIndices);
+                }
+            }
+        }
+
+        m_renderer.AddModels(m_models, m_worldMatrices, m_viewMasks, m_lods);
+    }
+
+    m_sceneModels.clear();
+    m_models.clear();
+    m_worldMatrices.clear();
+    m_occluders.clear();
+    m_bounds.clear();
+    m_viewMasks.clear();
+    m_lods.clear();
+    m_frustumCuller.Clear();
+    m_visitingScene = false;
+    m_sceneCulled = false;
+}
+
+void RendererSceneVisitor::VisitScene(Scene& scene)
+{
+    BeginVisit();
+    scene.ForEachUnboundedNode([&](SceneNode& node) { node.AcceptVisitor(*this); });
+
+    // Without views to cull against, all the models are visited and EndVisit handles them
+    if (!m_frustumCulling || !m_renderer.HasCamera())
+    {
+        scene.GetEntityStore().ForEachNode([&](Entity, SceneNode& node)
+            {
+                if (node.HasBounds())
+                {
+                    node.AcceptVisitor(*this);
+                }
+            });
+        EndVisit();
+        return;
+    }
+
+    // Shadow views need the camera and the lights, that were visited with the nodes without bounds
+    if (m_shadowRenderPass)
+    {
+        m_shadowRenderPass->AddViews();
+    }
+
+    UpdateViewFrustums();
+    m_sceneCulled = true;
+    scene.QueryNodes(m_frustums, [&](SceneNode& node, uint32_t frustumMask)
+        {
+            m_visitViewMask = frustumMask;
+            node.AcceptVisitor(*this);
+        });
+
+    unsigned int foundModelCount = static_cast<unsigned int>(m_models.size());
+    EndVisit();
+    m_culledModelCount = scene.GetBoundedNodeCount() - foundModelCount;
 }
 
 void RendererSceneVisitor::VisitCamera(SceneCamera& sceneCamera)
 {
-    assert(!m_renderer.HasCamera()); // Currently, only one camera per scene supported
-    m_renderer.SetCurrentCamera(*sceneCamera.GetCamera());
+    // The first camera is the main view, the others are extra views
+    m_renderer.AddView(*sceneCamera.GetCamera());
 }
 
 void RendererSceneVisitor::VisitLight(SceneLight& sceneLight)
@@ -24,5 +227,106 @@ void RendererSceneVisitor::VisitLight(SceneLight& sceneLight)
 void RendererSceneVisitor::VisitModel(SceneModel& sceneModel)
 {
     assert(sceneModel.GetTransform());
-    m_renderer.AddModel(*sceneModel.GetModel(), sceneModel.GetTransform()->GetTransformMatrix());
+    const Model& model = *sceneModel.GetModel();
+    glm::mat4 worldMatrix = sceneModel.GetTransform()->GetTransformMatrix();
+
+    // Models without mesh bounds can't be culled, and nodes visited outside of a scene are added directly
+    // They still only go to the views of their kind of objects, static or dynamic
+    if (!m_visitingScene || !model.GetMesh().HasBounds())
+    {
+        m_renderer.AddModel(model, worldMatrix, sceneModel.IsStatic() ? m_renderer.GetStaticViewMask() : m_renderer.GetDynamicViewMask());
+        return;
+    }
+
+    AabbBounds bounds = sceneModel.GetAabbBounds();
+    m_sceneModels.push_back(&sceneModel);
+    m_models.push_back(&model);
+    m_worldMatrices.push_back(worldMatrix);
+    m_occluders.push_back(sceneModel.GetOccluder().get());
+    m_bounds.push_back(bounds);
+    m_lods.push_back(0);
+    m_viewMasks.push_back(m_visitViewMask);
+    if (!m_sceneCulled)
+    {
+        m_frustumCuller.AddBounds(bounds);
+    }
+}
+
+void RendererSceneVisitor::UpdateViewFrustums()
+{
+    m_frustums.clear();
+    for (unsigned int viewIndex = 0; viewIndex < m_renderer.GetViewCount(); ++viewIndex)
+    {
+        m_frustums.emplace_back(m_renderer.GetViewCamera(viewIndex).GetViewProjectionMatrix());
+    }
+}
+
+void RendererSceneVisitor::KeepModels(const std::vector<unsigned int>& indices)
+{
+    // Indices are increasing, so the models can be compacted in place
+    for (unsigned int i = 0; i < indices.size(); ++i)
+    {
+        assert(indices[i] >= i);
+        m_sceneModels[i] = m_sceneModels[indices[i]];
+        m_models[i] = m_models[indices[i]];
+        m_worldMatrices[i] = m_worldMatrices[indices[i]];
+        m_occluders[i] = m_occluders[indices[i]];
+        m_bounds[i] = m_bounds[indices[i]];
+        m_viewMasks[i] = m_viewMasks[indices[i]];
+        m_lods[i] = m_lods[indices[i]];
+    }
+    m_sceneModels.resize(indices.size());
+    m_models.resize(indices.size());
+    m_worldMatrices.resize(indices.size());
+    m_occluders.resize(indices.size());
+    m_viewMasks.resize(indices.size());
+    m_lods.resize(indices.size());
+    m_bounds.erase(m_bounds.begin() + indices.size(), m_bounds.end());
+}
+
+void RendererSceneVisitor::CullOccludedModels(const glm::mat4& viewProjMatrix)
+{
+    m_occlusionCuller->BeginFrame(viewProjMatrix);
+
+    // Only the occluders of models visible in the main view can hide something
+    const uint32_t mainViewMask = 1;
+    std::vector<AabbBounds> occludeeBounds;
+    std::vector<unsigned int> occludeeIndices;
+    for (unsigned int i = 0; i < m_models.size(); ++i)
+    {
+        if ((m_viewMasks[i] & mainViewMask) == 0)
+        {
+            continue;
+        }
+
+        if (m_occluders[i])
+        {
+            m_occlusionCuller->AddOccluder(*m_occluders[i], m_worldMatrices[i]);
+        }
+        else
+        {
+            occludeeBounds.push_back(m_bounds[i]);
+            occludeeIndices.push_back(i);
+        }
+    }
+    m_occlusionCuller->RenderOccluders();
+
+    std::vector<unsigned int> visibleOccludees;
+    m_occlusionCuller->Cull(occludeeBounds, visibleOccludees);
+
+    // Models with occluders are always kept, they would be hidden by their own depth
+    // Hidden models are removed from the main view only, they can still be visible in the other views
+    unsigned int visibleIndex = 0;
+    for (unsigned int occludeeIndex = 0; occludeeIndex < occludeeIndices.size(); ++occludeeIndex)
+    {
+        if (visibleIndex < visibleOccludees.size() && visibleOccludees[visibleIndex] == occludeeIndex)
+        {
+            visibleIndex++;
+        }
+        else
+        {
+            m_viewMasks[occludeeIndices[occludeeIndex]] &= ~mainViewMask;
+            m_occludedModelCount++;
+        }
+    }
 }
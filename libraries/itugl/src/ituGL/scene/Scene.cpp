@@ -2,54 +2,100 @@
 
 #include <ituGL/scene/SceneNode.h>
 #include <ituGL/scene/SceneVisitor.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/SceneLight.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/Transform.h>
+#include <algorithm>
+#include <limits>
 #include <cassert>
 
-Scene::Scene()
+// Adds the components of the visited node to its entity
+class EntityComponentVisitor : public SceneVisitor
+{
+public:
+    EntityComponentVisitor(EntityStore& entities, Entity entity) : m_entities(entities), m_entity(entity) {}
+
+    void VisitCamera(SceneCamera& sceneCamera) override { m_entities.SetCamera(m_entity, sceneCamera.GetCamera()); }
+    void VisitLight(SceneLight& sceneLight) override { m_entities.SetLight(m_entity, sceneLight.GetLight()); }
+    void VisitModel(SceneModel& sceneModel) override { m_entities.SetModel(m_entity, sceneModel.GetModel()); }
+
+private:
+    EntityStore& m_entities;
+    Entity m_entity;
+};
+
+Scene::Scene() : m_transformHierarchy(std::make_shared<TransformHierarchy>()), m_nodeVersion(0)
 {
 }
 
 Scene::~Scene()
 {
-    for (auto& pair : m_nodes)
-    {
-        pair.second->SetOwnerScene(nullptr);
-    }
+    // Release the hierarchy and the grid first, so nodes are only referenced by the map
+    m_staticHierarchy.nodes.clear();
+    m_dynamicGrid.nodes.clear();
+    m_unboundedNodes.clear();
+
+    m_entities.ForEachNode([](Entity, SceneNode& node)
+        {
+            node.SetOwnerScene(nullptr);
+            node.m_entity = Entity();
+        });
 }
 
 std::shared_ptr<SceneNode> Scene::GetSceneNode(const std::string& name) const
 {
-    auto it = m_nodes.find(name);
-    if (it != m_nodes.end())
-    {
-        return it->second;
-    }
-    return nullptr;
+    Entity entity = m_entities.FindEntity(name);
+    return entity.IsNull() ? nullptr : m_entities.GetNode(entity);
+}
+
+void Scene::SetWorkerPool(WorkerPool* workerPool)
+{
+    m_transformHierarchy->SetWorkerPool(workerPool);
+    m_dynamicGrid.grid.SetWorkerPool(workerPool);
 }
 
 bool Scene::AddSceneNode(std::shared_ptr<SceneNode> node)
 {
     assert(node);
-    assert(m_nodes.find(node->GetName()) == m_nodes.end());
-    m_nodes[node->GetName()] = node;
+    assert(m_entities.FindEntity(node->GetName()).IsNull());
+    if (std::shared_ptr<Transform> transform = node->GetTransform())
+    {
+        transform->SetHierarchy(m_transformHierarchy);
+    }
+    Entity entity = m_entities.Create();
+    m_entities.SetNode(entity, node);
+    m_entities.SetTransform(entity, node->GetTransform());
+    m_entities.SetName(entity, node->GetName());
+    EntityComponentVisitor componentVisitor(m_entities, entity);
+    node->AcceptVisitor(componentVisitor);
+
     node->SetOwnerScene(this);
+    node->m_entity = entity;
+    AddToHierarchy(node);
+    m_nodeVersion++;
     return true;
 }
 
 bool Scene::RemoveSceneNode(std::shared_ptr<SceneNode> node)
 {
-    assert(m_nodes.find(node->GetName()) == m_nodes.end() || m_nodes.find(node->GetName())->second == node);
+    assert(!GetSceneNode(node->GetName()) || GetSceneNode(node->GetName()) == node);
     return RemoveSceneNode(node->GetName());
 }
 
 bool Scene::RemoveSceneNode(const std::string& name)
 {
-    auto it = m_nodes.find(name);
-    if (it != m_nodes.end())
+    Entity entity = m_entities.FindEntity(name);
+    if (!entity.IsNull())
     {
-        assert(it->second);
-        assert(it->second->GetOwnerScene() == this);
-        it->second->SetOwnerScene(nullptr);
-        m_nodes.erase(it);
+        std::shared_ptr<SceneNode> node = m_entities.GetNode(entity);
+        assert(node);
+        assert(node->GetOwnerScene() == this);
+        node->SetOwnerScene(nullptr);
+        node->m_entity = Entity();
+        RemoveFromHierarchy(node);
+        m_entities.Destroy(entity);
+        m_nodeVersion++;
         return true;
     }
     return false;
@@ -57,16 +103,158 @@ bool Scene::RemoveSceneNode(const std::string& name)
 
 void Scene::AcceptVisitor(SceneVisitor& visitor)
 {
-    for (auto& pair : m_nodes)
+    visitor.BeginVisit();
+    m_entities.ForEachNode([&](Entity, SceneNode& node) { node.AcceptVisitor(visitor); });
+    visitor.EndVisit();
+}
+
+void Scene::AcceptVisitor(SceneVisitor& visitor) const
+{
+    visitor.BeginVisit();
+    m_entities.ForEachNode([&](Entity, SceneNode& node) { node.AcceptVisitor(visitor); });
+    visitor.EndVisit();
+}
+
+void Scene::UpdateBounds()
+{
+    // Moved nodes are updated together, before the bounds read their world matrices
+    m_transformHierarchy->UpdateWorldMatrices();
+    BuildDirtyHierarchies();
+
+    // Bounds are computed here, because the transforms of the nodes cache their matrices and can't be read in parallel
+    Grid& grid = m_dynamicGrid;
+    grid.updateHandles.clear();
+    grid.updateBounds.clear();
+    for (SpatialHashGrid::Handle handle = 0; handle < grid.nodes.size(); ++handle)
     {
-        pair.second->AcceptVisitor(visitor);
+        if (grid.nodes[handle])
+        {
+            grid.updateHandles.push_back(handle);
+            grid.updateBounds.push_back(grid.nodes[handle]->GetAabbBounds());
+        }
     }
+    grid.grid.Move(grid.updateHandles, grid.updateBounds);
 }
 
-void Scene::AcceptVisitor(SceneVisitor& visitor) const
+void Scene::AcceptVisitor(SceneVisitor& visitor, const FrustumBounds& frustum)
+{
+    visitor.BeginVisit();
+    for (auto& node : m_unboundedNodes)
+    {
+        node->AcceptVisitor(visitor);
+    }
+    QueryHierarchies(frustum, [&](SceneNode& node) { node.AcceptVisitor(visitor); });
+    visitor.EndVisit();
+}
+
+void Scene::AcceptVisitor(SceneVisitor& visitor, const AabbBounds& bounds)
+{
+    visitor.BeginVisit();
+    QueryHierarchies(bounds, [&](SceneNode& node) { node.AcceptVisitor(visitor); });
+    visitor.EndVisit();
+}
+
+void Scene::AcceptVisitor(SceneVisitor& visitor, const SphereBounds& bounds)
+{
+    visitor.BeginVisit();
+    QueryHierarchies(bounds, [&](SceneNode& node) { node.AcceptVisitor(visitor); });
+    visitor.EndVisit();
+}
+
+unsigned int Scene::GetBoundedNodeCount() const
+{
+    return static_cast<unsigned int>(m_staticHierarchy.nodes.size() + m_dynamicGrid.handles.size());
+}
+
+std::shared_ptr<SceneNode> Scene::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance)
+{
+    BuildDirtyHierarchies();
+
+    std::shared_ptr<SceneNode> closestNode;
+    distance = maxDistance;
+    m_staticHierarchy.bvh.RayCast(origin, direction, distance, [&](unsigned int index, float hitDistance)
+        {
+            if (hitDistance <= distance)
+            {
+                distance = hitDistance;
+                closestNode = m_staticHierarchy.nodes[index];
+            }
+            return distance;
+        });
+    m_dynamicGrid.grid.RayCast(origin, direction, distance, [&](SpatialHashGrid::Handle handle, float hitDistance)
+        {
+            if (hitDistance <= distance)
+            {
+                distance = hitDistance;
+                closestNode = m_dynamicGrid.nodes[handle];
+            }
+            return distance;
+        });
+    return closestNode;
+}
+
+void Scene::AddToHierarchy(std::shared_ptr<SceneNode> node)
+{
+    if (node->HasBounds() && node->IsStatic())
+    {
+        m_staticHierarchy.nodes.push_back(node);
+        m_staticHierarchy.dirty = true;
+    }
+    else if (node->HasBounds())
+    {
+        SpatialHashGrid::Handle handle = m_dynamicGrid.grid.Insert(node->GetAabbBounds());
+        if (handle >= m_dynamicGrid.nodes.size())
+        {
+            m_dynamicGrid.nodes.resize(handle + 1);
+        }
+        m_dynamicGrid.nodes[handle] = node;
+        m_dynamicGrid.handles[node.get()] = handle;
+    }
+    else
+    {
+        m_unboundedNodes.push_back(node);
+    }
+}
+
+void Scene::RemoveFromHierarchy(const std::shared_ptr<SceneNode>& node)
+{
+    auto handleIt = m_dynamicGrid.handles.find(node.get());
+    if (handleIt != m_dynamicGrid.handles.end())
+    {
+        m_dynamicGrid.grid.Remove(handleIt->second);
+        m_dynamicGrid.nodes[handleIt->second] = nullptr;
+        m_dynamicGrid.handles.erase(handleIt);
+        return;
+    }
+
+    for (std::vector<std::shared_ptr<SceneNode>>* nodes : { &m_staticHierarchy.nodes, &m_unboundedNodes })
+    {
+        auto it = std::find(nodes->begin(), nodes->end(), node);
+        if (it != nodes->end())
+        {
+            nodes->erase(it);
+            m_staticHierarchy.dirty |= nodes == &m_staticHierarchy.nodes;
+            return;
+        }
+    }
+}
+
+void Scene::BuildHierarchy(Hierarchy& hierarchy)
+{
+    hierarchy.bounds.clear();
+    hierarchy.bounds.reserve(hierarchy.nodes.size());
+    for (auto& node : hierarchy.nodes)
+    {
+        hierarchy.bounds.push_back(node->GetAabbBounds());
+    }
+    hierarchy.bvh.Build(hierarchy.bounds);
+    hierarchy.dirty = false;
+}
+
+void Scene::BuildDirtyHierarchies()
 {
-    for (auto& pair : m_nodes)
+    if (m_staticHierarchy.dirty)
     {
-        pair.second->AcceptVisitor(visitor);
+        BuildHierarchy(m_staticHierarchy);
     }
 }
@@ -1,6 +1,7 @@
 #include <ituGL/scene/SceneCamera.h>
 
 #include <ituGL/camera/Camera.h>
+#include <ituGL/scene/Scene.h>
 #include <ituGL/scene/SceneVisitor.h>
 #include <ituGL/scene/Transform.h>
 #include <glm/gtc/matrix_transform.hpp>
@@ -29,6 +30,10 @@ std::shared_ptr<const Camera> SceneCamera::GetCamera() const
 void SceneCamera::SetCamera(std::shared_ptr<Camera> camera)
 {
     m_camera = camera;
+    if (Scene* scene = GetOwnerScene())
+    {
+        scene->GetEntityStore().SetCamera(GetEntity(), camera);
+    }
 }
 
 void SceneCamera::AcceptVisitor(SceneVisitor& visitor)
@@ -4,6 +4,7 @@
 #include <ituGL/lighting/PointLight.h>
 #include <ituGL/lighting/SpotLight.h>
 #include <ituGL/scene/Transform.h>
+#include <ituGL/scene/Scene.h>
 #include <ituGL/scene/SceneVisitor.h>
 
 SceneLight::SceneLight(const std::string& name, std::shared_ptr<Light> light) : SceneNode(name), m_light(light)
@@ -24,6 +25,10 @@ std::shared_ptr<Light> SceneLight::GetLight() const
 void SceneLight::SetLight(std::shared_ptr<Light> light)
 {
     m_light = light;
+    if (Scene* scene = GetOwnerScene())
+    {
+        scene->GetEntityStore().SetLight(GetEntity(), light);
+    }
 }
 
 void SceneLight::AcceptVisitor(SceneVisitor& visitor)
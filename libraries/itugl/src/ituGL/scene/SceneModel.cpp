@@ -3,14 +3,16 @@
 #include <ituGL/geometry/Model.h>
 #include <ituGL/geometry/Mesh.h>
 #include <ituGL/scene/Transform.h>
+#include <ituGL/scene/Scene.h>
 #include <ituGL/scene/SceneVisitor.h>
+#include <glm/geometric.hpp>
 #include <cassert>
 
-SceneModel::SceneModel(const std::string& name, std::shared_ptr<Model> model) : SceneNode(name), m_model(model)
+SceneModel::SceneModel(const std::string& name, std::shared_ptr<Model> model) : SceneNode(name), m_model(model), m_lod(0)
 {
 }
 
-SceneModel::SceneModel(const std::string& name, std::shared_ptr<Model> model, std::shared_ptr<Transform> transform) : SceneNode(name, transform), m_model(model)
+SceneModel::SceneModel(const std::string& name, std::shared_ptr<Model> model, std::shared_ptr<Transform> transform) : SceneNode(name, transform), m_model(model), m_lod(0)
 {
 }
 
@@ -22,6 +24,20 @@ std::shared_ptr<Model> SceneModel::GetModel() const
 void SceneModel::SetModel(std::shared_ptr<Model> model)
 {
     m_model = model;
+    if (Scene* scene = GetOwnerScene())
+    {
+        scene->GetEntityStore().SetModel(GetEntity(), model);
+    }
+}
+
+std::shared_ptr<const OccluderMesh> SceneModel::GetOccluder() const
+{
+    return m_occluder;
+}
+
+void SceneModel::SetOccluder(std::shared_ptr<const OccluderMesh> occluder)
+{
+    m_occluder = occluder;
 }
 
 /*glm::mat4 SceneModel::GetWorldMatrix() const
@@ -50,14 +66,47 @@ SphereBounds SceneModel::GetSphereBounds() const
 
 AabbBounds SceneModel::GetAabbBounds() const
 {
-    return AabbBounds(GetBoxBounds());
+    assert(m_transform);
+    assert(m_model);
+    const Mesh& mesh = m_model->GetMesh();
+    if (!mesh.HasBounds())
+    {
+        return AabbBounds(GetBoxBounds());
+    }
+    return GetLocalBounds(mesh).GetTransformed(m_transform->GetTransformMatrix());
 }
 
 BoxBounds SceneModel::GetBoxBounds() const
 {
     assert(m_transform);
     assert(m_model);
-    return BoxBounds(m_transform->GetTranslation(), m_transform->GetRotationMatrix(), m_transform->GetScale() /* * m_model->GetSize()*/);
+    const Mesh& mesh = m_model->GetMesh();
+    if (!mesh.HasBounds())
+    {
+        // Without mesh bounds, the scale of the transform is used as the size
+        return BoxBounds(m_transform->GetTranslation(), m_transform->GetRotationMatrix(), m_transform->GetScale());
+    }
+
+    // Split the world matrix in rotation and scale, assuming there is no shear
+    glm::mat4 worldMatrix = m_transform->GetTransformMatrix();
+    glm::mat3 axes(worldMatrix);
+    glm::vec3 scale(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+    glm::mat3 rotationMatrix(axes[0] / scale.x, axes[1] / scale.y, axes[2] / scale.z);
+
+    AabbBounds localBounds = GetLocalBounds(mesh);
+    glm::vec3 center = worldMatrix * glm::vec4(localBounds.GetCenter(), 1.0f);
+    return BoxBounds(center, rotationMatrix, localBounds.GetSize() * scale);
+}
+
+bool SceneModel::HasBounds() const
+{
+    return m_model && m_model->GetMesh().HasBounds();
+}
+
+AabbBounds SceneModel::GetLocalBounds(const Mesh& mesh)
+{
+    assert(mesh.HasBounds());
+    return AabbBounds(0.5f * (mesh.GetBoundsMax() + mesh.GetBoundsMin()), 0.5f * (mesh.GetBoundsMax() - mesh.GetBoundsMin()));
 }
 
 void SceneModel::AcceptVisitor(SceneVisitor& visitor)
@@ -7,7 +7,7 @@ SceneNode::SceneNode(const std::string& name) : SceneNode(name, std::make_shared
 {
 }
 
-SceneNode::SceneNode(const std::string& name, std::shared_ptr<Transform> transform) : m_scene(nullptr), m_name(name), m_transform(transform)
+SceneNode::SceneNode(const std::string& name, std::shared_ptr<Transform> transform) : m_scene(nullptr), m_static(false), m_name(name), m_transform(transform)
 {
 }
 
@@ -22,18 +22,13 @@ const std::string& SceneNode::GetName() const
 
 void SceneNode::Rename(const std::string& name)
 {
-    std::shared_ptr<SceneNode> sceneNode;
+    // Only the name index changes, the node stays in the scene
     if (m_scene)
     {
-        sceneNode = m_scene->GetSceneNode(m_name);
-        assert(sceneNode.get() == this);
-        m_scene->RemoveSceneNode(m_name);
+        assert(m_scene->GetSceneNode(name) == nullptr);
+        m_scene->GetEntityStore().SetName(m_entity, name);
     }
     m_name = name;
-    if (m_scene)
-    {
-        m_scene->AddSceneNode(sceneNode);
-    }
 }
 
 std::shared_ptr<Transform> SceneNode::GetTransform()
@@ -49,6 +44,25 @@ std::shared_ptr<const Transform> SceneNode::GetTransform() const
 void SceneNode::SetTransform(std::shared_ptr<Transform> transform)
 {
     m_transform = transform;
+    if (m_scene)
+    {
+        if (transform)
+        {
+            transform->SetHierarchy(m_scene->GetTransformHierarchy());
+        }
+        m_scene->GetEntityStore().SetTransform(m_entity, transform);
+    }
+}
+
+bool SceneNode::HasBounds() const
+{
+    return false;
+}
+
+void SceneNode::SetStatic(bool isStatic)
+{
+    assert(!m_scene);
+    m_static = isStatic;
 }
 
 Scene* SceneNode::GetOwnerScene() const
@@ -0,0 +1,559 @@
+#include <ituGL/scene/SceneSnapshot.h>
+
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/SceneLight.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/lighting/DirectionalLight.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/lighting/SpotLight.h>
+#include <ituGL/camera/Camera.h>
+#include <unordered_map>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cassert>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char SnapshotMagic[4] = { 'I', 'S', 'C', 'N' };
+
+// All the arrays start aligned to this size, so the records can be read in place
+static const uint32_t SnapshotAlignment = 16;
+
+static uint32_t AlignOffset(size_t offset)
+{
+    return static_cast<uint32_t>((offset + SnapshotAlignment - 1) & ~static_cast<size_t>(SnapshotAlignment - 1));
+}
+
+// Append the values to the array and return their range, in elements
+template<typename T>
+static SceneSnapshot::Range AppendValues(std::vector<T>& array, std::span<const T> values)
+{
+    SceneSnapshot::Range range{ static_cast<uint32_t>(array.size()), static_cast<uint32_t>(values.size()) };
+    array.insert(array.end(), values.begin(), values.end());
+    return range;
+}
+
+static SceneSnapshot::Range AppendString(std::vector<char>& strings, std::string_view text)
+{
+    return AppendValues(strings, std::span<const char>(text.data(), text.size()));
+}
+
+// Set the byte range of the array in the file and advance the offset
+template<typename T>
+static SceneSnapshot::Range PlaceArray(const std::vector<T>& array, size_t& offset)
+{
+    SceneSnapshot::Range range{ AlignOffset(offset), static_cast<uint32_t>(array.size()) };
+    offset = range.offset + array.size() * sizeof(T);
+    return range;
+}
+
+template<typename T>
+static void WriteArray(std::ofstream& file, const std::vector<T>& array, const SceneSnapshot::Range& range)
+{
+    // Pad up to the start of the array
+    static const char padding[SnapshotAlignment] = {};
+    size_t position = static_cast<size_t>(file.tellp());
+    assert(position <= range.offset);
+    file.write(padding, range.offset - position);
+    file.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+}
+
+// Restore the values of one type, only if the material has the same number of them
+template<typename T>
+static void RestoreValues(Material& material, std::span<const T> allValues, const SceneSnapshot::Range& range)
+{
+    if (material.GetAllDataValues<T>().size() == range.count)
+    {
+        material.SetAllDataValues(allValues.subspan(range.offset, range.count));
+    }
+}
+
+SceneSnapshot::SceneSnapshot() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+    , m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr)
+#else
+    , m_fileDescriptor(-1)
+#endif
+{
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+    Unload();
+}
+
+bool SceneSnapshot::Save(const Scene& scene, const char* path, const ModelNameFunction& getModelName)
+{
+    const EntityStore& entities = scene.GetEntityStore();
+
+    // First, index the nodes by their transform, to find the parents
+    std::vector<Entity> nodeEntities;
+    std::unordered_map<const Transform*, int32_t> transformNodes;
+    entities.ForEachNode([&](Entity entity, SceneNode& node)
+        {
+            if (std::shared_ptr<const Transform> transform = node.GetTransform())
+            {
+                transformNodes[transform.get()] = static_cast<int32_t>(nodeEntities.size());
+            }
+            nodeEntities.push_back(entity);
+        });
+
+    std::vector<NodeRecord> nodes;
+    std::vector<ModelRecord> models;
+    std::vector<MaterialRecord> materials;
+    std::vector<LightRecord> lights;
+    std::vector<CameraRecord> cameras;
+    std::vector<int> intValues;
+    std::vector<unsigned int> uintValues;
+    std::vector<float> floatValues;
+    std::vector<double> doubleValues;
+    std::vector<char> strings;
+
+    // Models shared by many nodes are saved once
+    std::unordered_map<const Model*, uint32_t> modelIndices;
+
+    nodes.reserve(nodeEntities.size());
+    for (Entity entity : nodeEntities)
+    {
+        std::shared_ptr<const SceneNode> node = entities.GetNode(entity);
+
+        NodeRecord nodeRecord{};
+        nodeRecord.name = AppendString(strings, node->GetName());
+        nodeRecord.parent = -1;
+        nodeRecord.type = NodeType::Node;
+        nodeRecord.isStatic = node->IsStatic() ? 1 : 0;
+        nodeRecord.scale = glm::vec3(1.0f);
+
+        if (std::shared_ptr<const Transform> transform = node->GetTransform())
+        {
+            nodeRecord.translation = transform->GetTranslation();
+            nodeRecord.rotation = transform->GetRotation();
+            nodeRecord.scale = transform->GetScale();
+
+            // Parents that are not the transform of a node in the scene are not saved
+            if (std::shared_ptr<const Transform> parent = transform->GetParent())
+            {
+                auto itParent = transformNodes.find(parent.get());
+                if (itParent != transformNodes.end())
+                {
+                    nodeRecord.parent = itParent->second;
+                }
+            }
+        }
+
+        if (std::shared_ptr<Model> model = entities.GetModel(entity))
+        {
+            auto itModel = modelIndices.find(model.get());
+            if (itModel == modelIndices.end())
+            {
+                std::string reference = getModelName(*model);
+                if (!reference.empty())
+                {
+                    ModelRecord modelRecord;
+                    modelRecord.reference = AppendString(strings, reference);
+                    modelRecord.materials = Range{ static_cast<uint32_t>(materials.size()), model->GetMaterialCount() };
+                    for (unsigned int i = 0; i < model->GetMaterialCount(); ++i)
+                    {
+                        const Material& material = model->GetMaterial(i);
+                        MaterialRecord materialRecord;
+                        materialRecord.intValues = AppendValues(intValues, material.GetAllDataValues<int>());
+                        materialRecord.uintValues = AppendValues(uintValues, material.GetAllDataValues<unsigned int>());
+                        materialRecord.floatValues = AppendValues(floatValues, material.GetAllDataValues<float>());
+                        materialRecord.doubleValues = AppendValues(doubleValues, material.GetAllDataValues<double>());
+                        materials.push_back(materialRecord);
+                    }
+                    itModel = modelIndices.emplace(model.get(), static_cast<uint32_t>(models.size())).first;
+                    models.push_back(modelRecord);
+                }
+            }
+            if (itModel != modelIndices.end())
+            {
+                nodeRecord.type = NodeType::Model;
+                nodeRecord.dataIndex = itModel->second;
+            }
+        }
+        else if (std::shared_ptr<const Light> light = entities.GetLight(entity))
+        {
+            LightRecord lightRecord{};
+            lightRecord.type = static_cast<uint32_t>(light->GetType());
+            lightRecord.color = light->GetColor();
+            lightRecord.intensity = light->GetIntensity();
+            lightRecord.position = light->GetPosition(glm::vec3(0.0f));
+            lightRecord.direction = light->GetDirection(glm::vec3(0.0f, 0.0f, -1.0f));
+            switch (light->GetType())
+            {
+            case Light::Type::Point:
+                lightRecord.distanceAttenuation = static_cast<const PointLight&>(*light).GetDistanceAttenuation();
+                break;
+            case Light::Type::Spot:
+            {
+                const SpotLight& spotLight = static_cast<const SpotLight&>(*light);
+                lightRecord.distanceAttenuation = spotLight.GetDistanceAttenuation();
+                lightRecord.angleAttenuation = spotLight.GetAngleAttenuation();
+                lightRecord.angle = spotLight.GetAngle();
+                break;
+            }
+            default:
+                break;
+            }
+            nodeRecord.type = NodeType::Light;
+            nodeRecord.dataIndex = static_cast<uint32_t>(lights.size());
+            lights.push_back(lightRecord);
+        }
+        else if (std::shared_ptr<const Camera> camera = entities.GetCamera(entity))
+        {
+            nodeRecord.type = NodeType::Camera;
+            nodeRecord.dataIndex = static_cast<uint32_t>(cameras.size());
+            cameras.push_back(CameraRecord{ camera->GetViewMatrix(), camera->GetProjectionMatrix() });
+        }
+
+        nodes.push_back(nodeRecord);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+    header.version = Version;
+    size_t offset = sizeof(Header);
+    header.nodes = PlaceArray(nodes, offset);
+    header.models = PlaceArray(models, offset);
+    header.materials = PlaceArray(materials, offset);
+    header.lights = PlaceArray(lights, offset);
+    header.cameras = PlaceArray(cameras, offset);
+    header.intValues = PlaceArray(intValues, offset);
+    header.uintValues = PlaceArray(uintValues, offset);
+    header.floatValues = PlaceArray(floatValues, offset);
+    header.doubleValues = PlaceArray(doubleValues, offset);
+    header.strings = PlaceArray(strings, offset);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    WriteArray(file, nodes, header.nodes);
+    WriteArray(file, models, header.models);
+    WriteArray(file, materials, header.materials);
+    WriteArray(file, lights, header.lights);
+    WriteArray(file, cameras, header.cameras);
+    WriteArray(file, intValues, header.intValues);
+    WriteArray(file, uintValues, header.uintValues);
+    WriteArray(file, floatValues, header.floatValues);
+    WriteArray(file, doubleValues, header.doubleValues);
+    WriteArray(file, strings, header.strings);
+
+    return static_cast<bool>(file);
+}
+
+bool SceneSnapshot::Load(const char* path)
+{
+    Unload();
+
+#ifdef _WIN32
+    m_fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (m_fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Unload();
+        return false;
+    }
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = m_mappingHandle ? MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    m_fileDescriptor = open(path, O_RDONLY);
+    struct stat fileStat;
+    if (m_fileDescriptor < 0 || fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        Unload();
+        return false;
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        data = nullptr;
+    }
+#endif
+
+    m_data = static_cast<const unsigned char*>(data);
+    if (!m_data || !Validate())
+    {
+        Unload();
+        return false;
+    }
+    return true;
+}
+
+void SceneSnapshot::Unload()
+{
+#ifdef _WIN32
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle)
+    {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data)
+    {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+    if (m_fileDescriptor >= 0)
+    {
+        close(m_fileDescriptor);
+        m_fileDescriptor = -1;
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::string_view SceneSnapshot::GetString(const Range& range) const
+{
+    std::span<const char> strings = GetArray<char>(GetHeader().strings);
+    assert(range.offset + range.count <= strings.size());
+    return std::string_view(strings.data() + range.offset, range.count);
+}
+
+void SceneSnapshot::Instantiate(Scene& scene, const ModelFunction& getModel) const
+{
+    assert(IsLoaded());
+    std::span<const NodeRecord> nodeRecords = GetNodes();
+    std::span<const ModelRecord> modelRecords = GetModels();
+    std::span<const MaterialRecord> materialRecords = GetMaterials();
+    std::span<const LightRecord> lightRecords = GetLights();
+    std::span<const CameraRecord> cameraRecords = GetCameras();
+
+    const Header& header = GetHeader();
+    std::span<const int> intValues = GetArray<int>(header.intValues);
+    std::span<const unsigned int> uintValues = GetArray<unsigned int>(header.uintValues);
+    std::span<const float> floatValues = GetArray<float>(header.floatValues);
+    std::span<const double> doubleValues = GetArray<double>(header.doubleValues);
+
+    // Models are requested and restored once, even if many nodes use them
+    std::vector<std::shared_ptr<Model>> models(modelRecords.size());
+    std::vector<bool> modelsRequested(modelRecords.size(), false);
+
+    // Parents saved after their children are set when all the transforms exist
+    std::vector<std::shared_ptr<Transform>> transforms;
+    transforms.reserve(nodeRecords.size());
+    std::vector<unsigned int> lateParentNodes;
+
+    for (const NodeRecord& nodeRecord : nodeRecords)
+    {
+        std::string name(GetString(nodeRecord.name));
+
+        std::shared_ptr<Transform> transform = std::make_shared<Transform>(scene.GetTransformHierarchy());
+        transform->SetTranslation(nodeRecord.translation);
+        transform->SetRotation(nodeRecord.rotation);
+        transform->SetScale(nodeRecord.scale);
+
+        // Setting the parent before the node is added keeps the transform hierarchy sorted
+        if (nodeRecord.parent >= 0)
+        {
+            if (static_cast<size_t>(nodeRecord.parent) < transforms.size())
+            {
+                transform->SetParent(transforms[nodeRecord.parent]);
+            }
+            else
+            {
+                lateParentNodes.push_back(static_cast<unsigned int>(transforms.size()));
+            }
+        }
+        transforms.push_back(transform);
+
+        std::shared_ptr<SceneNode> node;
+        switch (nodeRecord.type)
+        {
+        case NodeType::Model:
+        {
+            uint32_t modelIndex = nodeRecord.dataIndex;
+            if (!modelsRequested[modelIndex])
+            {
+                const ModelRecord& modelRecord = modelRecords[modelIndex];
+                std::shared_ptr<Model> model = getModel(GetString(modelRecord.reference));
+                if (model && model->GetMaterialCount() == modelRecord.materials.count)
+                {
+                    for (unsigned int i = 0; i < modelRecord.materials.count; ++i)
+                    {
+                        Material& material = model->GetMaterial(i);
+                        const MaterialRecord& materialRecord = materialRecords[modelRecord.materials.offset + i];
+                        RestoreValues(material, intValues, materialRecord.intValues);
+                        RestoreValues(material, uintValues, materialRecord.uintValues);
+                        RestoreValues(material, floatValues, materialRecord.floatValues);
+                        RestoreValues(material, doubleValues, materialRecord.doubleValues);
+                    }
+                }
+                models[modelIndex] = model;
+                modelsRequested[modelIndex] = true;
+            }
+            if (models[modelIndex])
+            {
+                node = std::make_shared<SceneModel>(name, models[modelIndex], transform);
+            }
+            break;
+        }
+        case NodeType::Light:
+        {
+            const LightRecord& lightRecord = lightRecords[nodeRecord.dataIndex];
+            std::shared_ptr<Light> light;
+            switch (static_cast<Light::Type>(lightRecord.type))
+            {
+            case Light::Type::Directional:
+                light = std::make_shared<DirectionalLight>();
+                break;
+            case Light::Type::Point:
+            {
+                std::shared_ptr<PointLight> pointLight = std::make_shared<PointLight>();
+                pointLight->SetDistanceAttenuation(lightRecord.distanceAttenuation);
+                light = pointLight;
+                break;
+            }
+            case Light::Type::Spot:
+            {
+                std::shared_ptr<SpotLight> spotLight = std::make_shared<SpotLight>();
+                spotLight->SetDistanceAttenuation(lightRecord.distanceAttenuation);
+                spotLight->SetAngleAttenuation(lightRecord.angleAttenuation);
+                spotLight->SetAngle(lightRecord.angle);
+                light = spotLight;
+                break;
+            }
+            }
+            node = std::make_shared<SceneLight>(name, light, transform);
+
+            // The node matches the light to the transform, set the saved values after it
+            light->SetColor(lightRecord.color);
+            light->SetIntensity(lightRecord.intensity);
+            light->SetPosition(lightRecord.position);
+            light->SetDirection(lightRecord.direction);
+            break;
+        }
+        case NodeType::Camera:
+        {
+            const CameraRecord& cameraRecord = cameraRecords[nodeRecord.dataIndex];
+            std::shared_ptr<Camera> camera = std::make_shared<Camera>();
+            node = std::make_shared<SceneCamera>(name, camera, transform);
+
+            // The node matches the camera to the transform, set the saved values after it
+            camera->SetViewMatrix(cameraRecord.viewMatrix);
+            camera->SetProjectionMatrix(cameraRecord.projectionMatrix);
+            break;
+        }
+        default:
+            break;
+        }
+
+        // Models that were not found are added as nodes, to keep their children in place
+        if (!node)
+        {
+            node = std::make_shared<SceneNode>(name, transform);
+        }
+        node->SetStatic(nodeRecord.isStatic != 0);
+        scene.AddSceneNode(node);
+    }
+
+    for (unsigned int nodeIndex : lateParentNodes)
+    {
+        transforms[nodeIndex]->SetParent(transforms[nodeRecords[nodeIndex].parent]);
+    }
+}
+
+bool SceneSnapshot::Validate() const
+{
+    if (m_size < sizeof(Header))
+    {
+        return false;
+    }
+
+    const Header& header = GetHeader();
+    if (std::memcmp(header.magic, SnapshotMagic, sizeof(header.magic)) != 0 || header.version != Version)
+    {
+        return false;
+    }
+
+    auto isInside = [this](const Range& range, size_t elementSize)
+        {
+            return range.offset % SnapshotAlignment == 0 && range.offset + static_cast<size_t>(range.count) * elementSize <= m_size;
+        };
+    if (!isInside(header.nodes, sizeof(NodeRecord)) || !isInside(header.models, sizeof(ModelRecord))
+        || !isInside(header.materials, sizeof(MaterialRecord)) || !isInside(header.lights, sizeof(LightRecord))
+        || !isInside(header.cameras, sizeof(CameraRecord)) || !isInside(header.intValues, sizeof(int))
+        || !isInside(header.uintValues, sizeof(unsigned int)) || !isInside(header.floatValues, sizeof(float))
+        || !isInside(header.doubleValues, sizeof(double)) || !isInside(header.strings, sizeof(char)))
+    {
+        return false;
+    }
+
+    // Indices between the arrays must be valid, so Instantiate doesn't need to check them
+    for (const NodeRecord& nodeRecord : GetNodes())
+    {
+        if (nodeRecord.name.offset + static_cast<size_t>(nodeRecord.name.count) > header.strings.count
+            || nodeRecord.parent >= static_cast<int32_t>(header.nodes.count))
+        {
+            return false;
+        }
+        uint32_t dataCount = 0;
+        switch (nodeRecord.type)
+        {
+        case NodeType::Node: dataCount = ~0u; break;
+        case NodeType::Model: dataCount = header.models.count; break;
+        case NodeType::Light: dataCount = header.lights.count; break;
+        case NodeType::Camera: dataCount = header.cameras.count; break;
+        default: return false;
+        }
+        if (nodeRecord.dataIndex >= dataCount)
+        {
+            return false;
+        }
+    }
+    for (const ModelRecord& modelRecord : GetModels())
+    {
+        if (modelRecord.reference.offset + static_cast<size_t>(modelRecord.reference.count) > header.strings.count
+            || modelRecord.materials.offset + static_cast<size_t>(modelRecord.materials.count) > header.materials.count)
+        {
+            return false;
+        }
+    }
+    for (const MaterialRecord& materialRecord : GetMaterials())
+    {
+        if (materialRecord.intValues.offset + static_cast<size_t>(materialRecord.intValues.count) > header.intValues.count
+            || materialRecord.uintValues.offset + static_cast<size_t>(materialRecord.uintValues.count) > header.uintValues.count
+            || materialRecord.floatValues.offset + static_cast<size_t>(materialRecord.floatValues.count) > header.floatValues.count
+            || materialRecord.doubleValues.offset + static_cast<size_t>(materialRecord.doubleValues.count) > header.doubleValues.count)
+        {
+            return false;
+        }
+    }
+    for (const LightRecord& lightRecord : GetLights())
+    {
+        if (lightRecord.type > static_cast<uint32_t>(Light::Type::Spot))
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,5 +1,13 @@
 #include <ituGL/scene/SceneVisitor.h>
 
+void SceneVisitor::BeginVisit()
+{
+}
+
+void SceneVisitor::EndVisit()
+{
+}
+
 void SceneVisitor::VisitCamera(SceneCamera& sceneCamera)
 {
     VisitCamera(const_cast<const SceneCamera&>(sceneCamera));
@@ -0,0 +1,187 @@
+#include <ituGL/scene/SpatialHashGrid.h>
+
+#include <ituGL/core/WorkerPool.h>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cassert>
+
+// Minimum number of moved items for each thread of the batched Move
+static const unsigned int MinMovesPerThread = 8192;
+
+// Bits of each cell coordinate in the key, coordinates wrap around outside of this range
+static const int CellKeyBits = 21;
+
+SpatialHashGrid::SpatialHashGrid(float cellSize) : m_cellSize(cellSize), m_workerPool(nullptr), m_threadCount(0), m_maxHalfSize(0.0f)
+{
+    assert(cellSize > 0.0f);
+}
+
+SpatialHashGrid::Handle SpatialHashGrid::Insert(const AabbBounds& bounds)
+{
+    Handle handle;
+    if (!m_freeHandles.empty())
+    {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    else
+    {
+        handle = static_cast<Handle>(m_items.size());
+        m_items.emplace_back();
+    }
+
+    Item& item = m_items[handle];
+    item.boundsMin = bounds.GetMin();
+    item.boundsMax = bounds.GetMax();
+    item.valid = true;
+    const glm::vec3& halfSize = bounds.GetSize();
+    m_maxHalfSize = std::max(m_maxHalfSize, std::max(halfSize.x, std::max(halfSize.y, halfSize.z)));
+
+    AddToCell(handle, GetCellCoordinates(bounds.GetCenter()));
+    return handle;
+}
+
+void SpatialHashGrid::Remove(Handle handle)
+{
+    assert(handle < m_items.size() && m_items[handle].valid);
+    RemoveFromCell(handle);
+    m_items[handle].valid = false;
+    m_freeHandles.push_back(handle);
+}
+
+void SpatialHashGrid::Move(Handle handle, const AabbBounds& bounds)
+{
+    assert(handle < m_items.size() && m_items[handle].valid);
+    Item& item = m_items[handle];
+    item.boundsMin = bounds.GetMin();
+    item.boundsMax = bounds.GetMax();
+    const glm::vec3& halfSize = bounds.GetSize();
+    m_maxHalfSize = std::max(m_maxHalfSize, std::max(halfSize.x, std::max(halfSize.y, halfSize.z)));
+
+    glm::ivec3 coordinates = GetCellCoordinates(bounds.GetCenter());
+    if (GetCellKey(coordinates) != item.cellKey)
+    {
+        RemoveFromCell(handle);
+        AddToCell(handle, coordinates);
+    }
+}
+
+void SpatialHashGrid::Move(std::span<const Handle> handles, std::span<const AabbBounds> bounds)
+{
+    assert(handles.size() == bounds.size());
+    unsigned int itemCount = static_cast<unsigned int>(handles.size());
+    unsigned int threadCount = GetMoveThreadCount(itemCount);
+
+    // First, each thread updates the bounds of its items, and collects the ones that changed cell
+    // Items only write their own data, so the threads don't need to synchronize
+    m_threadCellChanges.resize(std::max<size_t>(m_threadCellChanges.size(), threadCount));
+    m_threadMaxHalfSizes.assign(threadCount, 0.0f);
+    auto updateItems = [&](size_t threadIndex, size_t begin, size_t end)
+    {
+        std::vector<unsigned int>& cellChanges = m_threadCellChanges[threadIndex];
+        float& maxHalfSize = m_threadMaxHalfSizes[threadIndex];
+        cellChanges.clear();
+        for (size_t i = begin; i < end; ++i)
+        {
+            Item& item = m_items[handles[i]];
+            assert(item.valid);
+            item.boundsMin = bounds[i].GetMin();
+            item.boundsMax = bounds[i].GetMax();
+            const glm::vec3& halfSize = bounds[i].GetSize();
+            maxHalfSize = std::max(maxHalfSize, std::max(halfSize.x, std::max(halfSize.y, halfSize.z)));
+            if (GetCellKey(GetCellCoordinates(bounds[i].GetCenter())) != item.cellKey)
+            {
+                cellChanges.push_back(static_cast<unsigned int>(i));
+            }
+        }
+    };
+    if (threadCount > 1)
+    {
+        m_workerPool->Run(itemCount, threadCount, updateItems);
+    }
+    else
+    {
+        updateItems(0, 0, itemCount);
+    }
+
+    // Then, the items that changed cell are moved. Usually only a few of them cross a cell boundary in a frame
+    for (unsigned int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        m_maxHalfSize = std::max(m_maxHalfSize, m_threadMaxHalfSizes[threadIndex]);
+        for (unsigned int i : m_threadCellChanges[threadIndex])
+        {
+            RemoveFromCell(handles[i]);
+            AddToCell(handles[i], GetCellCoordinates(bounds[i].GetCenter()));
+        }
+    }
+}
+
+void SpatialHashGrid::Clear()
+{
+    m_items.clear();
+    m_freeHandles.clear();
+    m_cells.clear();
+    m_maxHalfSize = 0.0f;
+}
+
+SpatialHashGrid::CellKey SpatialHashGrid::GetCellKey(const glm::ivec3& coordinates) const
+{
+    const CellKey mask = (CellKey(1) << CellKeyBits) - 1;
+    return (static_cast<CellKey>(coordinates.x) & mask)
+        | ((static_cast<CellKey>(coordinates.y) & mask) << CellKeyBits)
+        | ((static_cast<CellKey>(coordinates.z) & mask) << (2 * CellKeyBits));
+}
+
+glm::ivec3 SpatialHashGrid::GetCellCoordinates(const glm::vec3& position) const
+{
+    return glm::ivec3(glm::floor(position / m_cellSize));
+}
+
+void SpatialHashGrid::AddToCell(Handle handle, const glm::ivec3& coordinates)
+{
+    Item& item = m_items[handle];
+    item.cellKey = GetCellKey(coordinates);
+    Cell& cell = m_cells[item.cellKey];
+    if (cell.handles.empty())
+    {
+        cell.coordinates = coordinates;
+    }
+    item.cellSlot = static_cast<unsigned int>(cell.handles.size());
+    cell.handles.push_back(handle);
+}
+
+void SpatialHashGrid::RemoveFromCell(Handle handle)
+{
+    const Item& item = m_items[handle];
+    auto it = m_cells.find(item.cellKey);
+    assert(it != m_cells.end());
+    std::vector<Handle>& cellHandles = it->second.handles;
+    assert(cellHandles[item.cellSlot] == handle);
+
+    // Move the last item of the cell to the free slot
+    Handle lastHandle = cellHandles.back();
+    cellHandles[item.cellSlot] = lastHandle;
+    m_items[lastHandle].cellSlot = item.cellSlot;
+    cellHandles.pop_back();
+
+    if (cellHandles.empty())
+    {
+        m_cells.erase(it);
+    }
+}
+
+unsigned int SpatialHashGrid::GetMoveThreadCount(unsigned int itemCount) const
+{
+    if (!m_workerPool)
+    {
+        return 1;
+    }
+
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max(1u, std::min(threadCount, itemCount / MinMovesPerThread));
+}
@@ -1,45 +1,105 @@
 #include <ituGL/scene/Transform.h>
 
 #include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
+#include <cassert>
 
-Transform::Transform() : m_translation(0, 0, 0), m_rotation(0, 0, 0), m_scale(1, 1, 1), m_matrix(1.0f), m_dirty(false)
+Transform::Transform() : Transform(std::make_shared<TransformHierarchy>())
 {
 }
 
-glm::mat4 Transform::GetTranslationMatrix() const
+Transform::Transform(std::shared_ptr<TransformHierarchy> hierarchy) : m_hierarchy(hierarchy), m_id(hierarchy->Create())
 {
-    return glm::translate(glm::identity<glm::mat4>(), m_translation);
 }
 
-glm::mat4 Transform::GetRotationMatrix() const
+Transform::~Transform()
 {
-    glm::mat4 matrix = glm::identity<glm::mat4>();
-    matrix = glm::rotate(matrix, m_rotation.y, glm::vec3(0, 1, 0));
-    matrix = glm::rotate(matrix, m_rotation.x, glm::vec3(1, 0, 0));
-    matrix = glm::rotate(matrix, m_rotation.z, glm::vec3(0, 0, 1));
-    return matrix;
+    // Children keep their parent alive, so it can't have any
+    assert(m_children.empty());
+    if (m_parent)
+    {
+        std::erase(m_parent->m_children, this);
+    }
+    m_hierarchy->Destroy(m_id);
 }
 
-glm::mat4 Transform::GetScaleMatrix() const
+void Transform::SetHierarchy(std::shared_ptr<TransformHierarchy> hierarchy)
 {
-    return glm::scale(glm::identity<glm::mat4>(), m_scale);
+    assert(hierarchy);
+    if (hierarchy == m_hierarchy)
+    {
+        return;
+    }
+
+    Transform* root = this;
+    while (root->m_parent)
+    {
+        root = root->m_parent.get();
+    }
+    root->MoveSubtree(hierarchy, TransformHierarchy::InvalidId);
 }
 
-glm::mat4 Transform::GetTransformMatrix() const
+void Transform::SetParent(std::shared_ptr<Transform> parent)
 {
-    if (IsDirty())
+    assert(parent.get() != this);
+    if (m_parent)
     {
-        m_matrix = GetTranslationMatrix() * GetRotationMatrix() * GetScaleMatrix();
-        if (m_parent)
-        {
-            m_matrix = m_parent->GetTransformMatrix() * m_matrix;
-        }
-        m_dirty = false;
+        std::erase(m_parent->m_children, this);
+    }
+
+    // Detached from the old parent first, so only this subtree moves
+    if (parent && parent->m_hierarchy != m_hierarchy)
+    {
+        m_hierarchy->SetParent(m_id, TransformHierarchy::InvalidId);
+        MoveSubtree(parent->m_hierarchy, TransformHierarchy::InvalidId);
+    }
+
+    m_parent = parent;
+    m_hierarchy->SetParent(m_id, parent ? parent->m_id : TransformHierarchy::InvalidId);
+    if (parent)
+    {
+        parent->m_children.push_back(this);
     }
-    return m_matrix;
 }
 
-bool Transform::IsDirty() const
+void Transform::MoveSubtree(const std::shared_ptr<TransformHierarchy>& hierarchy, TransformHierarchy::Id parentId)
+{
+    // Parents are created before their children, so the new hierarchy stays sorted
+    TransformHierarchy::Id id = hierarchy->Create();
+    hierarchy->SetTranslation(id, m_hierarchy->GetTranslation(m_id));
+    hierarchy->SetRotation(id, m_hierarchy->GetRotation(m_id));
+    hierarchy->SetScale(id, m_hierarchy->GetScale(m_id));
+    hierarchy->SetParent(id, parentId);
+
+    std::shared_ptr<TransformHierarchy> oldHierarchy = m_hierarchy;
+    TransformHierarchy::Id oldId = m_id;
+    m_hierarchy = hierarchy;
+    m_id = id;
+    for (Transform* child : m_children)
+    {
+        child->MoveSubtree(hierarchy, id);
+    }
+
+    // The children were released from the old hierarchy before their parent
+    oldHierarchy->Destroy(oldId);
+}
+
+glm::mat4 Transform::GetTranslationMatrix() const
+{
+    return glm::translate(glm::identity<glm::mat4>(), GetTranslation());
+}
+
+glm::mat4 Transform::GetRotationMatrix() const
+{
+    return TransformHierarchy::ComputeRotationMatrix(GetRotation());
+}
+
+glm::mat4 Transform::GetScaleMatrix() const
+{
+    return glm::scale(glm::identity<glm::mat4>(), GetScale());
+}
+
+glm::mat4 Transform::GetTransformMatrix() const
 {
-    return m_dirty || (m_parent && m_parent->IsDirty());
+    return m_hierarchy->GetWorldMatrix(m_id);
 }
@@ -0,0 +1,435 @@
+#include <ituGL/scene/TransformHierarchy.h>
+
+#include <ituGL/core/WorkerPool.h>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cassert>
+
+#if defined(__SSE__) || defined(_M_X64)
+#define TRANSFORM_HIERARCHY_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Minimum number of updated transforms for each thread
+static const unsigned int MinSlotsPerThread = 4096;
+
+static const unsigned int InvalidSlot = ~0u;
+
+// result = a * b. result can't be a or b
+static void MultiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+#ifdef TRANSFORM_HIERARCHY_USE_SSE
+    // Each column of the result is a combination of the columns of a
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int column = 0; column < 4; ++column)
+    {
+        __m128 value = _mm_mul_ps(a0, _mm_set1_ps(b[column][0]));
+        value = _mm_add_ps(value, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+        value = _mm_add_ps(value, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+        value = _mm_add_ps(value, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+        _mm_storeu_ps(&result[column][0], value);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+TransformHierarchy::TransformHierarchy() : m_workerPool(nullptr), m_threadCount(0), m_orderChanged(false), m_freeSlotCount(0)
+{
+}
+
+TransformHierarchy::Id TransformHierarchy::Create()
+{
+    Id id;
+    if (!m_freeIds.empty())
+    {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else
+    {
+        id = static_cast<Id>(m_slots.size());
+        m_slots.push_back(InvalidSlot);
+    }
+
+    // A transform without parent at the end keeps the depth-first order
+    m_slots[id] = static_cast<unsigned int>(m_ids.size());
+    m_translations.push_back(glm::vec3(0.0f));
+    m_rotations.push_back(glm::vec3(0.0f));
+    m_scales.push_back(glm::vec3(1.0f));
+    m_worldMatrices.push_back(glm::mat4(1.0f));
+    m_parentSlots.push_back(InvalidSlot);
+    m_subtreeSizes.push_back(1);
+    m_ids.push_back(id);
+    m_dirty.push_back(0);
+    return id;
+}
+
+void TransformHierarchy::Destroy(Id id)
+{
+    assert(id < m_slots.size() && m_slots[id] != InvalidSlot);
+    unsigned int slot = m_slots[id];
+
+    // The slot stays in the arrays, so the order is kept, until the next sort
+    m_ids[slot] = InvalidId;
+    m_dirty[slot] = 0;
+    m_slots[id] = InvalidSlot;
+    m_freeIds.push_back(id);
+
+    // Sort when there are too many free slots, to compact the arrays
+    ++m_freeSlotCount;
+    if (m_freeSlotCount > m_ids.size() / 2)
+    {
+        m_orderChanged = true;
+    }
+}
+
+TransformHierarchy::Id TransformHierarchy::GetParent(Id id) const
+{
+    unsigned int parentSlot = m_parentSlots[m_slots[id]];
+    return parentSlot != InvalidSlot ? m_ids[parentSlot] : InvalidId;
+}
+
+void TransformHierarchy::SetParent(Id id, Id parentId)
+{
+    unsigned int slot = m_slots[id];
+    unsigned int parentSlot = parentId != InvalidId ? m_slots[parentId] : InvalidSlot;
+    if (m_parentSlots[slot] == parentSlot)
+    {
+        return;
+    }
+
+    // The parent can't be a descendant
+    for (unsigned int ancestorSlot = parentSlot; ancestorSlot != InvalidSlot; ancestorSlot = m_parentSlots[ancestorSlot])
+    {
+        assert(ancestorSlot != slot);
+    }
+
+    // A root that comes right after the subtree of the new parent joins that subtree without sorting
+    // That is the usual case when a hierarchy is built, adding each child after its parent
+    if (!m_orderChanged && m_parentSlots[slot] == InvalidSlot && parentSlot != InvalidSlot
+        && parentSlot + m_subtreeSizes[parentSlot] == slot)
+    {
+        for (unsigned int ancestorSlot = parentSlot; ancestorSlot != InvalidSlot; ancestorSlot = m_parentSlots[ancestorSlot])
+        {
+            m_subtreeSizes[ancestorSlot] += m_subtreeSizes[slot];
+        }
+    }
+    else
+    {
+        m_orderChanged = true;
+    }
+
+    m_parentSlots[slot] = parentSlot;
+    MarkDirty(id);
+}
+
+bool TransformHierarchy::IsDirty(Id id) const
+{
+    if (!HasChanges())
+    {
+        return false;
+    }
+
+    for (unsigned int slot = m_slots[id]; slot != InvalidSlot; slot = m_parentSlots[slot])
+    {
+        if (m_dirty[slot])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+glm::mat4 TransformHierarchy::GetWorldMatrix(Id id)
+{
+    if (HasChanges())
+    {
+        UpdateWorldMatrices();
+    }
+    return m_worldMatrices[m_slots[id]];
+}
+
+void TransformHierarchy::UpdateWorldMatrices()
+{
+    if (m_orderChanged)
+    {
+        SortDepthFirst();
+    }
+
+    if (m_dirtyIds.empty())
+    {
+        return;
+    }
+
+    // Find the changed subtrees. A changed transform inside another changed subtree is already included
+    // When many transforms changed, scanning the flags in order is faster than sorting the changed slots
+    std::vector<unsigned int> dirtySlots;
+    dirtySlots.reserve(m_dirtyIds.size());
+    if (m_dirtyIds.size() > m_ids.size() / 8)
+    {
+        for (unsigned int slot = 0; slot < m_ids.size(); ++slot)
+        {
+            if (m_dirty[slot])
+            {
+                dirtySlots.push_back(slot);
+            }
+        }
+    }
+    else
+    {
+        for (Id id : m_dirtyIds)
+        {
+            unsigned int slot = m_slots[id];
+            if (slot != InvalidSlot && m_dirty[slot])
+            {
+                dirtySlots.push_back(slot);
+            }
+        }
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+    }
+    m_dirtyIds.clear();
+
+    std::vector<unsigned int> rangeFirsts, rangeLasts;
+    unsigned int slotCount = 0;
+    for (unsigned int slot : dirtySlots)
+    {
+        if (rangeLasts.empty() || slot >= rangeLasts.back())
+        {
+            rangeFirsts.push_back(slot);
+            rangeLasts.push_back(slot + m_subtreeSizes[slot]);
+            slotCount += m_subtreeSizes[slot];
+        }
+    }
+
+    unsigned int threadCount = GetUpdateThreadCount(slotCount);
+    if (threadCount <= 1)
+    {
+        for (unsigned int i = 0; i < rangeFirsts.size(); ++i)
+        {
+            UpdateSlots(rangeFirsts[i], rangeLasts[i]);
+        }
+        return;
+    }
+
+    // Subtrees too big for one thread are split: their root is updated here, and the subtrees of its children are added
+    std::vector<unsigned int> splitFirsts, splitLasts;
+    unsigned int maxSlotsPerThread = slotCount / threadCount;
+    while (!rangeFirsts.empty())
+    {
+        unsigned int first = rangeFirsts.back();
+        unsigned int last = rangeLasts.back();
+        rangeFirsts.pop_back();
+        rangeLasts.pop_back();
+        if (last - first > maxSlotsPerThread)
+        {
+            UpdateSlots(first, first + 1);
+            for (unsigned int childSlot = first + 1; childSlot < last; childSlot += m_subtreeSizes[childSlot])
+            {
+                rangeFirsts.push_back(childSlot);
+                rangeLasts.push_back(childSlot + m_subtreeSizes[childSlot]);
+            }
+            slotCount -= 1;
+        }
+        else
+        {
+            splitFirsts.push_back(first);
+            splitLasts.push_back(last);
+        }
+    }
+
+    // The subtrees are independent, so they are split between threads with about the same number of slots each
+    unsigned int rangeCount = static_cast<unsigned int>(splitFirsts.size());
+    std::vector<unsigned int> threadFirstRanges(threadCount + 1, rangeCount);
+    unsigned int accumulatedCount = 0;
+    unsigned int threadIndex = 0;
+    for (unsigned int i = 0; i < rangeCount && threadIndex < threadCount; ++i)
+    {
+        if (accumulatedCount >= static_cast<uint64_t>(slotCount) * threadIndex / threadCount)
+        {
+            threadFirstRanges[threadIndex++] = i;
+        }
+        accumulatedCount += splitLasts[i] - splitFirsts[i];
+    }
+
+    // One item per thread, each one updates the ranges assigned to it above
+    m_workerPool->Run(threadCount, threadCount, [&](size_t threadIndex, size_t, size_t)
+        {
+            for (unsigned int i = threadFirstRanges[threadIndex]; i < threadFirstRanges[threadIndex + 1]; ++i)
+            {
+                UpdateSlots(splitFirsts[i], splitLasts[i]);
+            }
+        });
+}
+
+glm::mat4 TransformHierarchy::ComputeRotationMatrix(const glm::vec3& rotation)
+{
+    // Same as rotating around Y, then X, then Z, without building the 3 matrices
+    float sx = std::sin(rotation.x), cx = std::cos(rotation.x);
+    float sy = std::sin(rotation.y), cy = std::cos(rotation.y);
+    float sz = std::sin(rotation.z), cz = std::cos(rotation.z);
+    return glm::mat4(
+        cy * cz + sy * sx * sz, cx * sz, -sy * cz + cy * sx * sz, 0.0f,
+        -cy * sz + sy * sx * cz, cx * cz, sy * sz + cy * sx * cz, 0.0f,
+        sy * cx, -sx, cy * cx, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+glm::mat4 TransformHierarchy::ComputeLocalMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    glm::mat4 matrix = ComputeRotationMatrix(rotation);
+    matrix[0] *= scale.x;
+    matrix[1] *= scale.y;
+    matrix[2] *= scale.z;
+    matrix[3] = glm::vec4(translation, 1.0f);
+    return matrix;
+}
+
+void TransformHierarchy::MarkDirty(Id id)
+{
+    unsigned int slot = m_slots[id];
+    if (!m_dirty[slot])
+    {
+        m_dirty[slot] = 1;
+        m_dirtyIds.push_back(id);
+    }
+}
+
+void TransformHierarchy::SortDepthFirst()
+{
+    unsigned int oldSlotCount = static_cast<unsigned int>(m_ids.size());
+
+    // Children of each slot, with the roots as children of a virtual slot at the end
+    std::vector<unsigned int> childStarts(oldSlotCount + 2, 0);
+    for (unsigned int slot = 0; slot < oldSlotCount; ++slot)
+    {
+        if (m_ids[slot] != InvalidId)
+        {
+            unsigned int parentSlot = m_parentSlots[slot] != InvalidSlot ? m_parentSlots[slot] : oldSlotCount;
+            ++childStarts[parentSlot + 1];
+        }
+    }
+    for (unsigned int slot = 0; slot <= oldSlotCount; ++slot)
+    {
+        childStarts[slot + 1] += childStarts[slot];
+    }
+    std::vector<unsigned int> children(childStarts.back());
+    std::vector<unsigned int> childCounts(oldSlotCount + 1, 0);
+    for (unsigned int slot = 0; slot < oldSlotCount; ++slot)
+    {
+        if (m_ids[slot] != InvalidId)
+        {
+            unsigned int parentSlot = m_parentSlots[slot] != InvalidSlot ? m_parentSlots[slot] : oldSlotCount;
+            children[childStarts[parentSlot] + childCounts[parentSlot]++] = slot;
+        }
+    }
+
+    // Depth-first traversal, keeping the previous order between siblings
+    std::vector<unsigned int> order;
+    order.reserve(children.size());
+    std::vector<unsigned int> stack;
+    for (unsigned int i = childStarts[oldSlotCount + 1]; i > childStarts[oldSlotCount]; --i)
+    {
+        stack.push_back(children[i - 1]);
+    }
+    while (!stack.empty())
+    {
+        unsigned int slot = stack.back();
+        stack.pop_back();
+        order.push_back(slot);
+        for (unsigned int i = childStarts[slot + 1]; i > childStarts[slot]; --i)
+        {
+            stack.push_back(children[i - 1]);
+        }
+    }
+
+    std::vector<unsigned int> newSlots(oldSlotCount, InvalidSlot);
+    for (unsigned int newSlot = 0; newSlot < order.size(); ++newSlot)
+    {
+        newSlots[order[newSlot]] = newSlot;
+    }
+
+    // Move the data to the new slots
+    auto reorder = [&](auto& values)
+    {
+        std::remove_reference_t<decltype(values)> sortedValues;
+        sortedValues.reserve(order.size());
+        for (unsigned int oldSlot : order)
+        {
+            sortedValues.push_back(values[oldSlot]);
+        }
+        values.swap(sortedValues);
+    };
+    reorder(m_translations);
+    reorder(m_rotations);
+    reorder(m_scales);
+    reorder(m_worldMatrices);
+    reorder(m_parentSlots);
+    reorder(m_ids);
+    reorder(m_dirty);
+
+    for (unsigned int slot = 0; slot < order.size(); ++slot)
+    {
+        m_slots[m_ids[slot]] = slot;
+        if (m_parentSlots[slot] != InvalidSlot)
+        {
+            m_parentSlots[slot] = newSlots[m_parentSlots[slot]];
+        }
+    }
+
+    // Children are after their parent, so the sizes can be accumulated backwards
+    m_subtreeSizes.assign(order.size(), 1);
+    for (unsigned int slot = static_cast<unsigned int>(order.size()); slot-- > 0;)
+    {
+        if (m_parentSlots[slot] != InvalidSlot)
+        {
+            m_subtreeSizes[m_parentSlots[slot]] += m_subtreeSizes[slot];
+        }
+    }
+
+    m_orderChanged = false;
+    m_freeSlotCount = 0;
+}
+
+void TransformHierarchy::UpdateSlots(unsigned int first, unsigned int last)
+{
+    for (unsigned int slot = first; slot < last; ++slot)
+    {
+        if (m_ids[slot] == InvalidId)
+        {
+            continue;
+        }
+
+        glm::mat4 localMatrix = ComputeLocalMatrix(m_translations[slot], m_rotations[slot], m_scales[slot]);
+        unsigned int parentSlot = m_parentSlots[slot];
+        if (parentSlot != InvalidSlot)
+        {
+            MultiplyMatrices(m_worldMatrices[parentSlot], localMatrix, m_worldMatrices[slot]);
+        }
+        else
+        {
+            m_worldMatrices[slot] = localMatrix;
+        }
+        m_dirty[slot] = 0;
+    }
+}
+
+unsigned int TransformHierarchy::GetUpdateThreadCount(unsigned int slotCount) const
+{
+    if (!m_workerPool)
+    {
+        return 1;
+    }
+
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max(1u, std::min(threadCount, slotCount / MinSlotsPerThread));
+}
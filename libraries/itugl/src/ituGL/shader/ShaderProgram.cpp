@@ -2,13 +2,18 @@
 
 #include <ituGL/shader/Shader.h>
 #include <ituGL/texture/TextureObject.h>
+#include <ituGL/core/DeviceGL.h>
 #include <cassert>
+#include <utility>
 
 #ifndef NDEBUG
 ShaderProgram::Handle ShaderProgram::s_usedHandle = ShaderProgram::NullHandle;
 #endif
 
-ShaderProgram::ShaderProgram() : Object(NullHandle)
+// Passed by reference to the standard algorithms, so it needs a definition
+const unsigned int ShaderProgram::InvalidRegistrationId;
+
+ShaderProgram::ShaderProgram() : Object(NullHandle), m_registrationId(InvalidRegistrationId)
 {
     Handle& handle = GetHandle();
     handle = glCreateProgram();
@@ -19,18 +24,24 @@ ShaderProgram::~ShaderProgram()
     if (IsValid())
     {
         Handle& handle = GetHandle();
+        if (DeviceGL* device = DeviceGL::GetInstancePointer())
+        {
+            device->ForgetProgram(handle);
+        }
         glDeleteProgram(handle);
         handle = NullHandle;
     }
 }
 
 ShaderProgram::ShaderProgram(ShaderProgram&& shaderProgram) noexcept : Object(std::move(shaderProgram))
+    , m_registrationId(std::exchange(shaderProgram.m_registrationId, InvalidRegistrationId))
 {
 }
 
 ShaderProgram& ShaderProgram::operator = (ShaderProgram&& shaderProgram) noexcept
 {
     Object::operator=(std::move(shaderProgram));
+    m_registrationId = std::exchange(shaderProgram.m_registrationId, InvalidRegistrationId);
     return *this;
 }
 
@@ -124,7 +135,7 @@ void ShaderProgram::Use() const
     assert(IsValid());
     assert(IsLinked());
     Handle handle = GetHandle();
-    glUseProgram(handle);
+    DeviceGL::GetInstance().UseProgram(handle);
 #ifndef NDEBUG
     s_usedHandle = handle;
 #endif
@@ -1,6 +1,7 @@
 #include <ituGL/texture/FramebufferObject.h>
 
 #include <ituGL/texture/Texture2DObject.h>
+#include <ituGL/core/DeviceGL.h>
 #include <cassert>
 
 std::shared_ptr<const FramebufferObject> FramebufferObject::s_defaultFramebuffer(std::make_shared<FramebufferObject>(FramebufferObject(Object::NullHandle)));
@@ -22,6 +23,10 @@ FramebufferObject::~FramebufferObject()
     Handle& handle = GetHandle();
     if (handle != NullHandle)
     {
+        if (DeviceGL* device = DeviceGL::GetInstancePointer())
+        {
+            device->ForgetFramebuffer(handle);
+        }
         glDeleteFramebuffers(1, &handle);
     }
 }
@@ -34,7 +39,7 @@ void FramebufferObject::Bind() const
 void FramebufferObject::Bind(Target target) const
 {
     Handle handle = GetHandle();
-    glBindFramebuffer(static_cast<GLenum>(target), handle);
+    DeviceGL::GetInstance().BindFramebuffer(static_cast<GLenum>(target), handle);
 }
 
 void FramebufferObject::Unbind()
@@ -45,7 +50,7 @@ void FramebufferObject::Unbind()
 void FramebufferObject::Unbind(Target target)
 {
     Handle handle = NullHandle;
-    glBindFramebuffer(static_cast<GLenum>(target), handle);
+    DeviceGL::GetInstance().BindFramebuffer(static_cast<GLenum>(target), handle);
 }
 
 std::shared_ptr<const FramebufferObject> FramebufferObject::GetDefault()
@@ -62,3 +67,18 @@ void FramebufferObject::SetDrawBuffers(std::span<const Attachment> attachments)
 {
     glDrawBuffers(static_cast<GLint>(attachments.size()), reinterpret_cast<const GLenum*>(attachments.data()));
 }
+
+void FramebufferObject::SetReadBuffer(Attachment attachment)
+{
+    glReadBuffer(static_cast<GLenum>(attachment));
+}
+
+void FramebufferObject::Blit(GLint x, GLint y, GLsizei width, GLsizei height, GLbitfield mask)
+{
+    glBlitFramebuffer(x, y, x + width, y + height, x, y, x + width, y + height, mask, GL_NEAREST);
+}
+
+void FramebufferObject::Invalidate(Target target, std::span<const Attachment> attachments) const
+{
+    glInvalidateFramebuffer(static_cast<GLenum>(target), static_cast<GLsizei>(attachments.size()), reinterpret_cast<const GLenum*>(attachments.data()));
+}
@@ -13,10 +13,17 @@ void Texture2DObject::SetImage<std::byte>(GLint level, GLsizei width, GLsizei he
     assert(data.empty() || type != Data::Type::None);
     assert(IsValidFormat(format, internalFormat));
     assert(data.empty() || data.size_bytes() == width * height * GetDataComponentCount(internalFormat) * Data::GetTypeSize(type));
-    glTexImage2D(GetTarget(), level, internalFormat, width, height, 0, format, type == Data::Type::None ? GL_BYTE : static_cast<GLenum>(type), data.data());
+    // Without data the type is not used, but it still has to be valid for the format
+    GLenum dataType = static_cast<GLenum>(type);
+    if (type == Data::Type::None)
+    {
+        dataType = format == FormatDepthStencil ? GL_UNSIGNED_INT_24_8 : GL_BYTE;
+    }
+    glTexImage2D(GetTarget(), level, internalFormat, width, height, 0, format, dataType, data.data());
 }
 
 void Texture2DObject::SetImage(GLint level, GLsizei width, GLsizei height, Format format, InternalFormat internalFormat)
 {
-    SetImage<float>(level, width, height, format, internalFormat, std::span<float>());
+    // Without a data type, so it gets one that is valid for the format
+    SetImage<std::byte>(level, width, height, format, internalFormat, std::span<const std::byte>(), Data::Type::None);
 }
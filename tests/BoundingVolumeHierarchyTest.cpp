@@ -0,0 +1,205 @@
+#include "Test.h"
+
+#include <ituGL/scene/BoundingVolumeHierarchy.h>
+#include <ituGL/camera/Camera.h>
+
+#include <random>
+
+static std::vector<AabbBounds> CreateRandomBounds(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    std::vector<AabbBounds> bounds;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        bounds.emplace_back(glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)));
+    }
+    return bounds;
+}
+
+// Items found by the hierarchy, sorted, and the ones that pass the same test when all of them are checked
+template<typename TQuery>
+static void CheckQuery(const BoundingVolumeHierarchy& hierarchy, const std::vector<AabbBounds>& bounds, const TQuery& query)
+{
+    std::vector<unsigned int> found;
+    hierarchy.Query(query, [&](unsigned int itemIndex) { found.push_back(itemIndex); });
+    std::sort(found.begin(), found.end());
+
+    std::vector<unsigned int> expected;
+    for (unsigned int i = 0; i < bounds.size(); ++i)
+    {
+        if (query.IntersectsBox(bounds[i].GetMin(), bounds[i].GetMax()))
+        {
+            expected.push_back(i);
+        }
+    }
+    CHECK(found == expected);
+}
+
+static void CheckRayCast(const BoundingVolumeHierarchy& hierarchy, const std::vector<AabbBounds>& bounds, const glm::vec3& origin, const glm::vec3& direction)
+{
+    const float maxDistance = 500.0f;
+
+    float closest = -1.0f;
+    hierarchy.RayCast(origin, direction, maxDistance, [&](unsigned int, float distance) { closest = distance; return distance; });
+
+    float expected = -1.0f;
+    for (const AabbBounds& itemBounds : bounds)
+    {
+        float distance = AabbBounds::RayIntersection(origin, 1.0f / direction, maxDistance, itemBounds.GetMin(), itemBounds.GetMax());
+        if (distance >= 0.0f && (expected < 0.0f || distance < expected))
+        {
+            expected = distance;
+        }
+    }
+    CHECK(closest == expected);
+}
+
+static void CheckQueries(const BoundingVolumeHierarchy& hierarchy, const std::vector<AabbBounds>& bounds, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(1.0f, 30.0f);
+    for (unsigned int i = 0; i < 20; ++i)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        CheckQuery(hierarchy, bounds, AabbBounds(center, glm::vec3(size(random), size(random), size(random))));
+        CheckQuery(hierarchy, bounds, SphereBounds(center, size(random)));
+
+        Camera camera;
+        camera.SetViewMatrix(center, glm::vec3(position(random), position(random), position(random)));
+        camera.SetPerspectiveProjectionMatrix(1.0f, 1.5f, 0.1f, size(random) * 5.0f);
+        CheckQuery(hierarchy, bounds, FrustumBounds(camera.GetViewProjectionMatrix()));
+
+        glm::vec3 direction = glm::normalize(glm::vec3(position(random), position(random), position(random)));
+        CheckRayCast(hierarchy, bounds, center, direction);
+    }
+}
+
+TEST(BoundingVolumeHierarchyEmpty)
+{
+    BoundingVolumeHierarchy hierarchy;
+    hierarchy.Build({});
+    CHECK(hierarchy.GetItemCount() == 0);
+
+    unsigned int foundCount = 0;
+    hierarchy.Query(SphereBounds(glm::vec3(0.0f), 1000.0f), [&](unsigned int) { ++foundCount; });
+    CHECK(foundCount == 0);
+}
+
+TEST(BoundingVolumeHierarchyQueries)
+{
+    std::mt19937 random(13);
+    for (unsigned int count : { 1u, 3u, 100u, 2000u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        BoundingVolumeHierarchy hierarchy;
+        hierarchy.Build(bounds);
+        CHECK(hierarchy.GetItemCount() == count);
+        CheckQueries(hierarchy, bounds, random);
+    }
+}
+
+TEST(BoundingVolumeHierarchyRefit)
+{
+    std::mt19937 random(14);
+    std::vector<AabbBounds> bounds = CreateRandomBounds(2000, random);
+    BoundingVolumeHierarchy hierarchy;
+    hierarchy.Build(bounds);
+
+    // Move the items far, the refit tree is worse but must find the same items
+    std::uniform_real_distribution<float> offset(-50.0f, 50.0f);
+    for (AabbBounds& itemBounds : bounds)
+    {
+        itemBounds.SetCenter(itemBounds.GetCenter() + glm::vec3(offset(random), offset(random), offset(random)));
+    }
+    hierarchy.Refit(bounds);
+    CheckQueries(hierarchy, bounds, random);
+}
+
+// A single query with several frustums finds the same items as one query per frustum
+TEST(BoundingVolumeHierarchyFrustumsQuery)
+{
+    std::mt19937 random(13);
+    std::vector<AabbBounds> bounds = CreateRandomBounds(2000, random);
+    BoundingVolumeHierarchy hierarchy;
+    hierarchy.Build(bounds);
+
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::vector<FrustumBounds> frustums;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        Camera camera;
+        camera.SetViewMatrix(glm::vec3(position(random), position(random), position(random)), glm::vec3(0.0f));
+        camera.SetPerspectiveProjectionMatrix(1.0f, 1.5f, 0.1f, 100.0f);
+        frustums.emplace_back(camera.GetViewProjectionMatrix());
+    }
+
+    std::vector<uint32_t> frustumMasks(bounds.size(), 0);
+    unsigned int callCount = 0;
+    hierarchy.Query(frustums, [&](unsigned int itemIndex, uint32_t frustumMask)
+        {
+            frustumMasks[itemIndex] = frustumMask;
+            ++callCount;
+        });
+
+    std::vector<uint32_t> expectedMasks(bounds.size(), 0);
+    for (unsigned int i = 0; i < frustums.size(); ++i)
+    {
+        hierarchy.Query(frustums[i], [&](unsigned int itemIndex) { expectedMasks[itemIndex] |= 1u << i; });
+    }
+    CHECK(frustumMasks == expectedMasks);
+    CHECK(callCount == bounds.size() - std::count(expectedMasks.begin(), expectedMasks.end(), 0u));
+    CHECK(std::count(expectedMasks.begin(), expectedMasks.end(), 7u) > 0);
+}
+
+// Frustum query of the hierarchy against testing all the items, and the cost of keeping the tree up to date when they move
+BENCHMARK(BoundingVolumeHierarchyFrustumQuery)
+{
+    std::mt19937 random(13);
+    Camera camera;
+    camera.SetViewMatrix(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f));
+    camera.SetPerspectiveProjectionMatrix(0.5f, 1.5f, 0.1f, 100.0f);
+    FrustumBounds frustum(camera.GetViewProjectionMatrix());
+
+    for (unsigned int count : { 1000u, 10000u, 100000u, 1000000u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        BoundingVolumeHierarchy hierarchy;
+        double buildTime = MeasureMilliseconds([&]() { hierarchy.Build(bounds); });
+
+        // Small steps, like moving objects in a frame, so the refit tree stays good
+        std::vector<AabbBounds> movedBounds = bounds;
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        for (AabbBounds& itemBounds : movedBounds)
+        {
+            itemBounds.SetCenter(itemBounds.GetCenter() + glm::vec3(offset(random), offset(random), offset(random)));
+        }
+        bool moved = false;
+        double refitTime = MeasureMilliseconds([&]()
+            {
+                hierarchy.Refit(moved ? bounds : movedBounds);
+                moved = !moved;
+            });
+        hierarchy.Refit(bounds);
+
+        unsigned long long found = 0;
+        double queryTime = MeasureMilliseconds([&]()
+            {
+                hierarchy.Query(frustum, [&](unsigned int itemIndex) { found += itemIndex; });
+            });
+        double bruteForceTime = MeasureMilliseconds([&]()
+            {
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    if (frustum.IntersectsBox(bounds[i].GetMin(), bounds[i].GetMax()))
+                        found += i;
+                }
+            });
+        DoNotOptimize(found);
+
+        ReportTiming("build", count, buildTime);
+        ReportTiming("refit", count, refitTime);
+        ReportTiming("hierarchy query", count, queryTime);
+        ReportTiming("brute force query", count, bruteForceTime);
+    }
+}
@@ -0,0 +1,125 @@
+#include "Test.h"
+
+#include <ituGL/renderer/DeferredRenderPass.h>
+#include <ituGL/camera/Camera.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+static const glm::ivec4 Viewport(10, 20, 640, 480);
+
+// Pixel of a point in view space, false if it is not in front of the near plane or not on the screen
+static bool GetPixel(const glm::vec3& viewPoint, const glm::mat4& projMatrix, glm::vec2& pixel)
+{
+    glm::vec4 clipPoint = projMatrix * glm::vec4(viewPoint, 1.0f);
+    if (clipPoint.w <= 0.0f || std::abs(clipPoint.z) > clipPoint.w)
+    {
+        return false;
+    }
+    glm::vec2 ndcPoint = glm::vec2(clipPoint) / clipPoint.w;
+    if (glm::any(glm::greaterThan(glm::abs(ndcPoint), glm::vec2(1.0f))))
+    {
+        return false;
+    }
+    pixel = glm::vec2(Viewport.x, Viewport.y) + (ndcPoint * 0.5f + 0.5f) * glm::vec2(Viewport.z, Viewport.w);
+    return true;
+}
+
+// The visible points of random spheres must be inside their rectangle, and spheres without visible points can be skipped
+static void CheckRandomSpheres(const glm::mat4& projMatrix, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 8.0f);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    for (unsigned int sphere = 0; sphere < 500; ++sphere)
+    {
+        glm::vec3 viewCenter(position(random), position(random), position(random) - 20.0f);
+        float sphereRadius = radius(random);
+        glm::ivec4 rect(0);
+        bool visible = DeferredRenderPass::ComputeScissorRect(viewCenter, sphereRadius, projMatrix, Viewport, rect);
+        if (visible)
+        {
+            CHECK(rect.x >= Viewport.x && rect.y >= Viewport.y);
+            CHECK(rect.x + rect.z <= Viewport.x + Viewport.z && rect.y + rect.w <= Viewport.y + Viewport.w);
+        }
+
+        // Points on the surface and inside of the sphere
+        for (unsigned int sample = 0; sample < 200; ++sample)
+        {
+            glm::vec3 direction(coordinate(random), coordinate(random), coordinate(random));
+            if (glm::length(direction) < 0.001f)
+            {
+                continue;
+            }
+            float distance = sample % 2 ? sphereRadius : sphereRadius * std::abs(coordinate(random));
+            glm::vec2 pixel;
+            if (GetPixel(viewCenter + glm::normalize(direction) * distance, projMatrix, pixel))
+            {
+                CHECK(visible);
+                CHECK(pixel.x >= rect.x && pixel.x <= rect.x + rect.z);
+                CHECK(pixel.y >= rect.y && pixel.y <= rect.y + rect.w);
+            }
+        }
+    }
+}
+
+TEST(DeferredScissorRectContainsSphere)
+{
+    std::mt19937 random(22);
+    CheckRandomSpheres(glm::perspective(1.0f, 640.0f / 480.0f, 0.1f, 100.0f), random);
+    CheckRandomSpheres(glm::ortho(-40.0f, 40.0f, -30.0f, 30.0f, 0.1f, 100.0f), random);
+}
+
+TEST(DeferredScissorRectCases)
+{
+    glm::mat4 projMatrix = glm::perspective(1.0f, 640.0f / 480.0f, 0.1f, 100.0f);
+    glm::ivec4 rect;
+
+    // Behind the camera, and far to the side
+    CHECK(!DeferredRenderPass::ComputeScissorRect(glm::vec3(0.0f, 0.0f, 5.0f), 2.0f, projMatrix, Viewport, rect));
+    CHECK(!DeferredRenderPass::ComputeScissorRect(glm::vec3(-100.0f, 0.0f, -10.0f), 2.0f, projMatrix, Viewport, rect));
+
+    // With the camera inside, the sphere can cover the whole screen
+    CHECK(DeferredRenderPass::ComputeScissorRect(glm::vec3(0.0f, 0.0f, -1.0f), 2.0f, projMatrix, Viewport, rect));
+    CHECK(rect == Viewport);
+
+    // A small sphere in the center gets a small rectangle around the center of the viewport
+    CHECK(DeferredRenderPass::ComputeScissorRect(glm::vec3(0.0f, 0.0f, -50.0f), 0.5f, projMatrix, Viewport, rect));
+    CHECK(rect.z > 0 && rect.z < 20 && rect.w > 0 && rect.w < 20);
+    CHECK(rect.x < Viewport.x + Viewport.z / 2 && rect.x + rect.z > Viewport.x + Viewport.z / 2);
+    CHECK(rect.y < Viewport.y + Viewport.w / 2 && rect.y + rect.w > Viewport.y + Viewport.w / 2);
+}
+
+// Cost of the rectangles for 1000 lights, done every frame before drawing them
+BENCHMARK(DeferredScissorRect)
+{
+    std::mt19937 random(22);
+    std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+    Camera camera;
+    camera.SetViewMatrix(glm::vec3(0.0f, 10.0f, 40.0f), glm::vec3(0.0f));
+    camera.SetPerspectiveProjectionMatrix(1.0f, 1.0f, 0.1f, 100.0f);
+    const glm::ivec4 viewport(0, 0, 1024, 1024);
+
+    const unsigned int lightCount = 1000;
+    std::vector<glm::vec3> positions;
+    for (unsigned int i = 0; i < lightCount; ++i)
+    {
+        positions.emplace_back(position(random), position(random) * 0.1f, position(random));
+    }
+
+    double rectTime = MeasureMilliseconds([&]()
+        {
+            unsigned long long pixelCount = 0;
+            for (const glm::vec3& lightPosition : positions)
+            {
+                glm::vec3 viewCenter = camera.GetViewMatrix() * glm::vec4(lightPosition, 1.0f);
+                glm::ivec4 rect;
+                if (DeferredRenderPass::ComputeScissorRect(viewCenter, 2.0f, camera.GetProjectionMatrix(), viewport, rect))
+                {
+                    pixelCount += static_cast<unsigned long long>(rect.z) * rect.w;
+                }
+            }
+            DoNotOptimize(pixelCount);
+        });
+    ReportTiming("ComputeScissorRect", lightCount, rectTime);
+}
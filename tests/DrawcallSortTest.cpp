@@ -0,0 +1,145 @@
+#include "Test.h"
+#include "GLStubs.h"
+
+#include <ituGL/renderer/Renderer.h>
+#include <ituGL/camera/Camera.h>
+#include <ituGL/geometry/VertexArrayObject.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <bit>
+#include <random>
+
+// Collection with one drawcall per key. The world matrix index is the original position
+static void AddDrawcalls(Renderer::DrawcallCollection& collection, const Material& material, const VertexArrayObject& vao,
+    const std::vector<uint64_t>& keys)
+{
+    Drawcall drawcall(Drawcall::Primitive::Triangles, 3);
+    for (unsigned int i = 0; i < keys.size(); ++i)
+    {
+        Renderer::DrawcallInfo drawcallInfo(material, i, vao, drawcall);
+        drawcallInfo.SetSortKey(keys[i]);
+        collection.AddDrawcall(drawcallInfo);
+    }
+}
+
+// The radix sort must give the same order as a stable comparison sort of the keys
+static void CheckSortByKey(const std::vector<uint64_t>& keys)
+{
+    InstallGLStubs();
+    FrameArena frameArena;
+    Material material(std::make_shared<ShaderProgram>());
+    VertexArrayObject vao;
+
+    Renderer::DrawcallCollection collection(frameArena);
+    AddDrawcalls(collection, material, vao, keys);
+    collection.SortByKey();
+
+    std::vector<unsigned int> expected(keys.size());
+    for (unsigned int i = 0; i < expected.size(); ++i)
+    {
+        expected[i] = i;
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+    auto drawcalls = collection.GetDrawcalls();
+    CHECK(drawcalls.size() == expected.size());
+    for (unsigned int i = 0; i < drawcalls.size() && i < expected.size(); ++i)
+    {
+        CHECK(drawcalls[i].GetWorldMatrixIndex() == expected[i]);
+    }
+}
+
+TEST(DrawcallSortByKeyEmpty)
+{
+    CheckSortByKey({});
+    CheckSortByKey({ 42 });
+}
+
+TEST(DrawcallSortByKeyRandom)
+{
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> keys(5000);
+    for (uint64_t& key : keys)
+    {
+        key = random();
+    }
+    CheckSortByKey(keys);
+}
+
+TEST(DrawcallSortByKeyDuplicates)
+{
+    // Few different values, in the highest and lowest digits, so equal keys must keep their order
+    std::mt19937_64 random(2);
+    std::vector<uint64_t> keys(5000);
+    for (uint64_t& key : keys)
+    {
+        key = ((random() % 4) << 62) | (random() % 8);
+    }
+    CheckSortByKey(keys);
+
+    CheckSortByKey(std::vector<uint64_t>(100, 7));
+}
+
+// Back to front sorting of random objects: the comparator of the previous renderer against the keys and the radix sort
+BENCHMARK(DrawcallSortBackToFront)
+{
+    InstallGLStubs();
+    Material material(std::make_shared<ShaderProgram>());
+    VertexArrayObject vao;
+
+    Camera camera;
+    camera.SetViewMatrix(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f));
+
+    for (unsigned int count : { 1000u, 10000u, 100000u })
+    {
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> distribution(-50.0f, 50.0f);
+        std::vector<glm::mat4> worldMatrices(count);
+        for (glm::mat4& worldMatrix : worldMatrices)
+        {
+            worldMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(distribution(random), distribution(random), distribution(random)));
+        }
+
+        FrameArena frameArena;
+        Renderer::DrawcallCollection collection(frameArena);
+        AddDrawcalls(collection, material, vao, std::vector<uint64_t>(count, 0));
+        std::vector<Renderer::DrawcallInfo> unsorted(collection.GetDrawcalls().begin(), collection.GetDrawcalls().end());
+
+        // Same as Renderer::IsBackToFront: the camera vectors are extracted in each comparison
+        double comparatorTime = MeasureMilliseconds([&]()
+            {
+                std::vector<Renderer::DrawcallInfo> drawcalls(unsorted);
+                std::sort(drawcalls.begin(), drawcalls.end(), [&](const Renderer::DrawcallInfo& a, const Renderer::DrawcallInfo& b)
+                    {
+                        glm::vec3 cameraPosition = camera.ExtractTranslation();
+                        glm::vec3 right, up, forward;
+                        camera.ExtractVectors(right, up, forward);
+
+                        glm::vec3 aDistance = glm::vec3(worldMatrices[a.GetWorldMatrixIndex()][3]) - cameraPosition;
+                        glm::vec3 bDistance = glm::vec3(worldMatrices[b.GetWorldMatrixIndex()][3]) - cameraPosition;
+                        return glm::dot(forward, aDistance) < glm::dot(forward, bDistance);
+                    });
+                DoNotOptimize(drawcalls.front().GetWorldMatrixIndex());
+            });
+
+        // Same as Renderer::UpdateSortKeys for BackToFront, only with the depth bits
+        const glm::mat4& viewMatrix = camera.GetViewMatrix();
+        glm::vec4 viewRowZ(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+        double radixTime = MeasureMilliseconds([&]()
+            {
+                for (Renderer::DrawcallInfo& drawcallInfo : collection.GetDrawcalls())
+                {
+                    float viewDepth = -glm::dot(viewRowZ, worldMatrices[drawcallInfo.GetWorldMatrixIndex()][3]);
+                    uint32_t depthBits = std::bit_cast<uint32_t>(std::max(viewDepth, 0.0f));
+                    drawcallInfo.SetSortKey(~uint64_t(depthBits));
+                }
+                collection.SortByKey();
+                DoNotOptimize(collection.GetDrawcalls().front().GetWorldMatrixIndex());
+            });
+
+        ReportTiming("comparator std::sort", count, comparatorTime);
+        ReportTiming("sort keys + SortByKey", count, radixTime);
+    }
+}
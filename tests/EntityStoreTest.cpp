@@ -0,0 +1,293 @@
+#include "Test.h"
+
+#include <ituGL/scene/EntityStore.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/SceneVisitor.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/camera/Camera.h>
+
+#include <map>
+#include <random>
+#include <unordered_map>
+
+// What the store should have for each live entity
+struct ExpectedEntity
+{
+    std::shared_ptr<Transform> transform;
+    std::shared_ptr<Model> model;
+    std::shared_ptr<Light> light;
+    std::shared_ptr<Camera> camera;
+    std::string name;
+};
+
+// Each ForEach must visit exactly the entities with the component and a transform, once
+template<typename T, typename TForEach>
+static void CheckForEach(const std::map<unsigned int, std::pair<Entity, ExpectedEntity>>& expected,
+    std::shared_ptr<T> ExpectedEntity::* component, TForEach forEach)
+{
+    std::map<unsigned int, unsigned int> visits;
+    forEach([&](Entity entity, const T& value, const Transform& transform)
+        {
+            auto it = expected.find(entity.index);
+            CHECK(it != expected.end() && it->second.first == entity);
+            if (it != expected.end())
+            {
+                CHECK(&value == (it->second.second.*component).get());
+                CHECK(&transform == it->second.second.transform.get());
+            }
+            ++visits[entity.index];
+        });
+
+    unsigned int count = 0;
+    for (const auto& [index, pair] : expected)
+    {
+        if (pair.second.transform && pair.second.*component)
+        {
+            CHECK(visits[index] == 1);
+            ++count;
+        }
+    }
+    CHECK(visits.size() == count);
+}
+
+TEST(EntityStoreHandles)
+{
+    EntityStore store;
+    Entity entity = store.Create();
+    CHECK(!entity.IsNull());
+    CHECK(store.IsValid(entity));
+    CHECK(store.GetEntityCount() == 1);
+    CHECK(Entity().IsNull());
+    CHECK(!store.IsValid(Entity()));
+
+    store.Destroy(entity);
+    CHECK(!store.IsValid(entity));
+    CHECK(store.GetEntityCount() == 0);
+
+    // The index is reused with a new generation, the old handle stays invalid
+    Entity reused = store.Create();
+    CHECK(reused.index == entity.index);
+    CHECK(reused.generation != entity.generation);
+    CHECK(store.IsValid(reused));
+    CHECK(!store.IsValid(entity));
+}
+
+TEST(EntityStoreComponents)
+{
+    EntityStore store;
+    Entity entity = store.Create();
+    CHECK(!store.HasComponent(entity, EntityStore::Component::Transform));
+    CHECK(store.GetTransform(entity) == nullptr);
+
+    std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+    std::shared_ptr<Camera> camera = std::make_shared<Camera>();
+    store.SetTransform(entity, transform);
+    store.SetCamera(entity, camera);
+    CHECK(store.HasComponent(entity, EntityStore::Component::Transform));
+    CHECK(store.HasComponent(entity, EntityStore::Component::Camera));
+    CHECK(!store.HasComponent(entity, EntityStore::Component::Light));
+    CHECK(store.GetTransform(entity) == transform);
+    CHECK(store.GetCamera(entity) == camera);
+
+    // Replacing a component keeps the others
+    std::shared_ptr<Camera> otherCamera = std::make_shared<Camera>();
+    store.SetCamera(entity, otherCamera);
+    CHECK(store.GetCamera(entity) == otherCamera);
+    CHECK(store.GetTransform(entity) == transform);
+
+    // Setting nullptr removes it
+    store.SetTransform(entity, nullptr);
+    CHECK(!store.HasComponent(entity, EntityStore::Component::Transform));
+    CHECK(store.GetCamera(entity) == otherCamera);
+}
+
+TEST(EntityStoreNames)
+{
+    EntityStore store;
+    Entity a = store.Create();
+    Entity b = store.Create();
+    store.SetName(a, "a");
+    store.SetName(b, "b");
+    CHECK(store.FindEntity("a") == a);
+    CHECK(store.FindEntity("b") == b);
+    CHECK(store.FindEntity("c").IsNull());
+
+    store.SetName(a, "c");
+    CHECK(store.FindEntity("a").IsNull());
+    CHECK(store.FindEntity("c") == a);
+
+    store.Destroy(a);
+    CHECK(store.FindEntity("c").IsNull());
+    store.SetName(b, "");
+    CHECK(store.FindEntity("b").IsNull());
+}
+
+// Random creates, destroys and component changes, compared with a plain map of what each entity should have
+TEST(EntityStoreRandomOperations)
+{
+    std::mt19937 random(16);
+    EntityStore store;
+    std::map<unsigned int, std::pair<Entity, ExpectedEntity>> expected;
+    std::vector<Entity> destroyed;
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    for (int step = 0; step < 5000; ++step)
+    {
+        unsigned int operation = random() % 8;
+        if (operation == 0 || expected.empty())
+        {
+            Entity entity = store.Create();
+            CHECK(expected.find(entity.index) == expected.end());
+            expected[entity.index] = { entity, ExpectedEntity() };
+            continue;
+        }
+
+        auto it = expected.begin();
+        std::advance(it, random() % expected.size());
+        Entity entity = it->second.first;
+        ExpectedEntity& components = it->second.second;
+        bool remove = random() % 3 == 0;
+        switch (operation)
+        {
+        case 1:
+            store.Destroy(entity);
+            destroyed.push_back(entity);
+            expected.erase(it);
+            break;
+        case 2:
+            components.transform = remove ? nullptr : std::make_shared<Transform>();
+            store.SetTransform(entity, components.transform);
+            break;
+        case 3:
+            components.model = remove ? nullptr : std::make_shared<Model>(mesh);
+            store.SetModel(entity, components.model);
+            break;
+        case 4:
+            components.light = remove ? nullptr : std::make_shared<PointLight>();
+            store.SetLight(entity, components.light);
+            break;
+        case 5:
+            components.camera = remove ? nullptr : std::make_shared<Camera>();
+            store.SetCamera(entity, components.camera);
+            break;
+        default:
+            components.name = remove ? "" : "entity" + std::to_string(step);
+            store.SetName(entity, components.name);
+            break;
+        }
+    }
+
+    CHECK(store.GetEntityCount() == expected.size());
+    for (const auto& [index, pair] : expected)
+    {
+        const auto& [entity, components] = pair;
+        CHECK(store.IsValid(entity));
+        CHECK(store.GetTransform(entity) == components.transform);
+        CHECK(store.GetModel(entity) == components.model);
+        CHECK(store.GetLight(entity) == components.light);
+        CHECK(store.GetCamera(entity) == components.camera);
+        CHECK(store.HasComponent(entity, EntityStore::Component::Transform) == (components.transform != nullptr));
+        CHECK(store.HasComponent(entity, EntityStore::Component::Node) == false);
+        if (!components.name.empty())
+        {
+            CHECK(store.FindEntity(components.name) == entity);
+        }
+    }
+    for (Entity entity : destroyed)
+    {
+        CHECK(!store.IsValid(entity));
+    }
+
+    CheckForEach(expected, &ExpectedEntity::model, [&](auto function) { store.ForEachModel(function); });
+    CheckForEach(expected, &ExpectedEntity::light, [&](auto function) { store.ForEachLight(function); });
+    CheckForEach(expected, &ExpectedEntity::camera, [&](auto function) { store.ForEachCamera(function); });
+
+    // No entity has a scene node
+    unsigned int nodeCount = 0;
+    store.ForEachNode([&](Entity, const SceneNode&) { ++nodeCount; });
+    CHECK(nodeCount == 0);
+}
+
+// Visitor that moves each model, or reads its world matrix like the renderer does
+class ModelMatrixVisitor : public SceneVisitor
+{
+public:
+    ModelMatrixVisitor(bool move) : m_move(move), m_sum(0.0f) {}
+
+    void VisitModel(SceneModel& sceneModel) override
+    {
+        std::shared_ptr<Transform> transform = sceneModel.GetTransform();
+        if (m_move)
+        {
+            transform->SetTranslation(transform->GetTranslation() + glm::vec3(1.0f, 0.0f, 0.0f));
+        }
+        else
+        {
+            m_sum += transform->GetTransformMatrix()[3][0] + static_cast<float>(sceneModel.GetModel()->GetMaterialCount());
+        }
+    }
+
+    float GetSum() const { return m_sum; }
+
+private:
+    bool m_move;
+    float m_sum;
+};
+
+// Read and move all the models, in the old layout of the scene nodes and in the entity store
+// The old layout kept the nodes in a map by name, and reached each model through its virtual AcceptVisitor
+// The world matrices are updated once after the moves, the same in both layouts
+BENCHMARK(EntityStoreIteration)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    for (unsigned int count : { 10000u, 100000u })
+    {
+        Scene scene;
+        std::unordered_map<std::string, std::shared_ptr<SceneNode>> nodes;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            std::string name = "model" + std::to_string(i);
+            std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>(name, std::make_shared<Model>(mesh));
+            scene.AddSceneNode(sceneModel);
+            nodes[name] = sceneModel;
+        }
+        EntityStore& store = scene.GetEntityStore();
+
+        for (bool move : { false, true })
+        {
+            double nodeTime = MeasureMilliseconds([&]()
+                {
+                    ModelMatrixVisitor visitor(move);
+                    for (auto& pair : nodes)
+                    {
+                        pair.second->AcceptVisitor(visitor);
+                    }
+                    scene.GetTransformHierarchy()->UpdateWorldMatrices();
+                    DoNotOptimize(static_cast<unsigned long long>(visitor.GetSum()));
+                });
+            double storeTime = MeasureMilliseconds([&]()
+                {
+                    float sum = 0.0f;
+                    store.ForEachModel([&](Entity, Model& model, Transform& transform)
+                        {
+                            if (move)
+                            {
+                                transform.SetTranslation(transform.GetTranslation() + glm::vec3(1.0f, 0.0f, 0.0f));
+                            }
+                            else
+                            {
+                                sum += transform.GetTransformMatrix()[3][0] + static_cast<float>(model.GetMaterialCount());
+                            }
+                        });
+                    scene.GetTransformHierarchy()->UpdateWorldMatrices();
+                    DoNotOptimize(static_cast<unsigned long long>(sum));
+                });
+            ReportTiming(move ? "move models, node map and visitor" : "read models, node map and visitor", count, nodeTime);
+            ReportTiming(move ? "move models, entity store" : "read models, entity store", count, storeTime);
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#include "Test.h"
+
+#include <ituGL/scene/FrustumCuller.h>
+#include <ituGL/camera/Camera.h>
+
+#include <random>
+
+static std::vector<AabbBounds> CreateRandomBounds(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 5.0f);
+    std::vector<AabbBounds> bounds;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        bounds.emplace_back(glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)));
+    }
+    return bounds;
+}
+
+static FrustumBounds CreateFrustum(const glm::vec3& position, const glm::vec3& lookAt, float far)
+{
+    Camera camera;
+    camera.SetViewMatrix(position, lookAt);
+    camera.SetPerspectiveProjectionMatrix(1.0f, 1.5f, 0.1f, far);
+    return FrustumBounds(camera.GetViewProjectionMatrix());
+}
+
+TEST(FrustumCullerSameAsIntersects)
+{
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> far(10.0f, 200.0f);
+
+    // Counts that are not a multiple of the SIMD width too
+    for (unsigned int count : { 0u, 1u, 5u, 1001u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        FrustumCuller culler;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            CHECK(culler.AddBounds(bounds[i]) == i);
+        }
+        CHECK(culler.GetBoundsCount() == count);
+
+        for (unsigned int test = 0; test < 20; ++test)
+        {
+            FrustumBounds frustum = CreateFrustum(glm::vec3(position(random), position(random), position(random)),
+                glm::vec3(position(random), position(random), position(random)), far(random));
+
+            // Cull appends to the indices that are already there
+            std::vector<unsigned int> visibleIndices = { ~0u };
+            culler.Cull(frustum, visibleIndices);
+
+            std::vector<unsigned int> expected = { ~0u };
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                if (Bounds::Intersects(frustum, bounds[i]))
+                {
+                    expected.push_back(i);
+                }
+            }
+            CHECK(visibleIndices == expected);
+        }
+
+        culler.Clear();
+        CHECK(culler.GetBoundsCount() == 0);
+    }
+}
+
+static std::vector<FrustumBounds> CreateRandomFrustums(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> far(10.0f, 200.0f);
+    std::vector<FrustumBounds> frustums;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        frustums.push_back(CreateFrustum(glm::vec3(position(random), position(random), position(random)),
+            glm::vec3(position(random), position(random), position(random)), far(random)));
+    }
+    return frustums;
+}
+
+TEST(FrustumCullerCullViewsSameAsCull)
+{
+    std::mt19937 random(18);
+    for (unsigned int count : { 0u, 1u, 5u, 1001u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        FrustumCuller culler;
+        for (const AabbBounds& itemBounds : bounds)
+        {
+            culler.AddBounds(itemBounds);
+        }
+
+        for (unsigned int viewCount : { 1u, 3u, 32u })
+        {
+            std::vector<FrustumBounds> frustums = CreateRandomFrustums(viewCount, random);
+
+            // Bit i of each mask must be set only if Cull with frustum i keeps the bounds
+            std::vector<uint32_t> expected(count, 0);
+            for (unsigned int view = 0; view < viewCount; ++view)
+            {
+                std::vector<unsigned int> visibleIndices;
+                culler.Cull(frustums[view], visibleIndices);
+                for (unsigned int index : visibleIndices)
+                {
+                    expected[index] |= 1u << view;
+                }
+            }
+
+            // Masks left from a previous call are replaced
+            std::vector<uint32_t> viewMasks(count + 3, ~0u);
+            culler.CullViews(frustums, viewMasks);
+            CHECK(viewMasks == expected);
+        }
+    }
+}
+
+TEST(FrustumIntersectsFrustum)
+{
+    FrustumBounds frustum = CreateFrustum(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 50.0f);
+    FrustumBounds overlapping = CreateFrustum(glm::vec3(5.0f, 0.0f, 0.0f), glm::vec3(5.0f, 0.0f, -1.0f), 50.0f);
+    FrustumBounds behind = CreateFrustum(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 20.0f), 50.0f);
+    FrustumBounds far = CreateFrustum(glm::vec3(0.0f, 0.0f, -200.0f), glm::vec3(0.0f, 0.0f, -201.0f), 50.0f);
+
+    CHECK(Bounds::Intersects(frustum, overlapping));
+    CHECK(Bounds::Intersects(overlapping, frustum));
+    CHECK(!Bounds::Intersects(frustum, behind));
+    CHECK(!Bounds::Intersects(frustum, far));
+
+    // Through the base class, both bounds are dispatched by their type
+    const Bounds& boundsA = frustum;
+    const Bounds& boundsB = overlapping;
+    const Bounds& boundsC = far;
+    CHECK(Bounds::Intersects(boundsA, boundsB));
+    CHECK(!Bounds::Intersects(boundsA, boundsC));
+    CHECK(boundsA.Intersects(boundsB));
+}
+
+TEST(FrustumIntersectsSphere)
+{
+    FrustumBounds frustum = CreateFrustum(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 50.0f);
+    CHECK(Bounds::Intersects(frustum, SphereBounds(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f)));
+    CHECK(Bounds::Intersects(frustum, SphereBounds(glm::vec3(0.0f, 0.0f, 1.0f), 2.0f)));
+    CHECK(!Bounds::Intersects(frustum, SphereBounds(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f)));
+    CHECK(!Bounds::Intersects(frustum, SphereBounds(glm::vec3(0.0f, 0.0f, -60.0f), 1.0f)));
+}
+
+// One pass over the bounds for all the views, against one Cull per view
+// The views of a frame with a main camera, 4 shadow cascades and 6 cubemap faces
+BENCHMARK(FrustumCullerCullViews)
+{
+    std::mt19937 random(18);
+    std::vector<FrustumBounds> frustums = CreateRandomFrustums(11, random);
+    for (unsigned int count : { 1000u, 10000u, 100000u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        FrustumCuller culler;
+        for (const AabbBounds& itemBounds : bounds)
+        {
+            culler.AddBounds(itemBounds);
+        }
+
+        std::vector<uint32_t> viewMasks;
+        double cullViewsTime = MeasureMilliseconds([&]()
+            {
+                culler.CullViews(frustums, viewMasks);
+                DoNotOptimize(viewMasks.back());
+            });
+
+        std::vector<unsigned int> visibleIndices;
+        visibleIndices.reserve(count);
+        double cullTime = MeasureMilliseconds([&]()
+            {
+                viewMasks.assign(count, 0);
+                for (unsigned int view = 0; view < frustums.size(); ++view)
+                {
+                    visibleIndices.clear();
+                    culler.Cull(frustums[view], visibleIndices);
+                    for (unsigned int index : visibleIndices)
+                    {
+                        viewMasks[index] |= 1u << view;
+                    }
+                }
+                DoNotOptimize(viewMasks.back());
+            });
+
+        ReportTiming("CullViews, 11 views", count, cullViewsTime);
+        ReportTiming("Cull per view, 11 views", count, cullTime);
+    }
+}
+
+// The SIMD kernel against testing each bounds with Bounds::Intersects
+BENCHMARK(FrustumCullerCull)
+{
+    std::mt19937 random(11);
+    FrustumBounds frustum = CreateFrustum(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f), 150.0f);
+    for (unsigned int count : { 1000u, 10000u, 100000u })
+    {
+        std::vector<AabbBounds> bounds = CreateRandomBounds(count, random);
+        FrustumCuller culler;
+        for (const AabbBounds& itemBounds : bounds)
+        {
+            culler.AddBounds(itemBounds);
+        }
+
+        std::vector<unsigned int> visibleIndices;
+        visibleIndices.reserve(count);
+        double cullerTime = MeasureMilliseconds([&]()
+            {
+                visibleIndices.clear();
+                culler.Cull(frustum, visibleIndices);
+                DoNotOptimize(visibleIndices.size());
+            });
+        double intersectsTime = MeasureMilliseconds([&]()
+            {
+                visibleIndices.clear();
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    if (Bounds::Intersects(frustum, bounds[i]))
+                        visibleIndices.push_back(i);
+                }
+                DoNotOptimize(visibleIndices.size());
+            });
+
+        ReportTiming("FrustumCuller::Cull", count, cullerTime);
+        ReportTiming("Bounds::Intersects", count, intersectsTime);
+    }
+}
@@ -0,0 +1,404 @@
+#include "GLStubs.h"
+
+#include <cstring>
+#include <set>
+#include <utility>
+
+static GLuint s_nextHandle = 1;
+static std::vector<GLStubUniform> s_uniforms;
+static std::vector<GLStubAttribute> s_attributes;
+static GLint s_version[2] = { 0, 0 };
+static unsigned int s_drawCount = 0;
+static GLuint s_boundVertexArray = 0;
+static std::set<std::pair<GLuint, GLuint>> s_enabledAttributes;
+static unsigned int s_attributePointerCount = 0;
+static GLuint s_currentProgram = 0;
+static std::vector<GLStubDraw> s_draws;
+
+static void APIENTRY GenObjects(GLsizei count, GLuint* handles)
+{
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        handles[i] = s_nextHandle++;
+    }
+}
+
+static void APIENTRY DeleteObjects(GLsizei, const GLuint*)
+{
+}
+
+static void APIENTRY BindObject(GLenum, GLuint)
+{
+}
+
+static void APIENTRY BindVertexArray(GLuint vertexArray)
+{
+    s_boundVertexArray = vertexArray;
+}
+
+static void APIENTRY UseProgram(GLuint program)
+{
+    s_currentProgram = program;
+}
+
+static void APIENTRY Clear(GLbitfield)
+{
+}
+
+static void APIENTRY ClearDepth(GLdouble)
+{
+}
+
+static void APIENTRY BufferData(GLenum, GLsizeiptr, const void*, GLenum)
+{
+}
+
+static void APIENTRY BufferSubData(GLenum, GLintptr, GLsizeiptr, const void*)
+{
+}
+
+static void APIENTRY TexImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*)
+{
+}
+
+static void APIENTRY TexParameteri(GLenum, GLenum, GLint)
+{
+}
+
+static void APIENTRY TexParameterf(GLenum, GLenum, GLfloat)
+{
+}
+
+static void APIENTRY FramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint)
+{
+}
+
+static void APIENTRY DrawBuffers(GLsizei, const GLenum*)
+{
+}
+
+static void APIENTRY InvalidateFramebuffer(GLenum, GLsizei, const GLenum*)
+{
+}
+
+static void APIENTRY BlitFramebuffer(GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum)
+{
+}
+
+static void APIENTRY VertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*)
+{
+    ++s_attributePointerCount;
+}
+
+static void APIENTRY VertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void*)
+{
+    ++s_attributePointerCount;
+}
+
+static void APIENTRY EnableAttribute(GLuint location)
+{
+    s_enabledAttributes.emplace(s_boundVertexArray, location);
+}
+
+static void APIENTRY DisableAttribute(GLuint location)
+{
+    s_enabledAttributes.erase({ s_boundVertexArray, location });
+}
+
+static void APIENTRY VertexAttribDivisor(GLuint, GLuint)
+{
+}
+
+static void APIENTRY SetFeature(GLenum)
+{
+}
+
+static GLboolean APIENTRY IsEnabled(GLenum)
+{
+    return GL_FALSE;
+}
+
+static GLuint APIENTRY CreateProgram()
+{
+    return s_nextHandle++;
+}
+
+static void APIENTRY DeleteProgram(GLuint)
+{
+}
+
+static void APIENTRY GetProgramiv(GLuint, GLenum name, GLint* params)
+{
+    switch (name)
+    {
+    case GL_LINK_STATUS:
+        *params = GL_TRUE;
+        break;
+    case GL_ACTIVE_UNIFORMS:
+        *params = static_cast<GLint>(s_uniforms.size());
+        break;
+    default:
+        *params = 0;
+        break;
+    }
+}
+
+static void APIENTRY GetActiveUniform(GLuint, GLuint index, GLsizei bufferSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name)
+{
+    const GLStubUniform& uniform = s_uniforms[index];
+    std::strncpy(name, uniform.name, bufferSize - 1);
+    name[bufferSize - 1] = '\0';
+    if (length)
+    {
+        *length = static_cast<GLsizei>(std::strlen(name));
+    }
+    *size = 1;
+    *type = uniform.type;
+}
+
+static GLint APIENTRY GetUniformLocation(GLuint, const GLchar* name)
+{
+    for (unsigned int i = 0; i < s_uniforms.size(); ++i)
+    {
+        if (std::strcmp(s_uniforms[i].name, name) == 0)
+        {
+            return static_cast<GLint>(i);
+        }
+    }
+    return -1;
+}
+
+static GLint APIENTRY GetAttribLocation(GLuint, const GLchar* name)
+{
+    for (const GLStubAttribute& attribute : s_attributes)
+    {
+        if (std::strcmp(attribute.name, name) == 0)
+        {
+            return attribute.location;
+        }
+    }
+    return -1;
+}
+
+// State and uniform calls are ignored, they only need to match the signatures
+static void APIENTRY SetUniformFloats(GLint, GLsizei, const GLfloat*)
+{
+}
+
+static void APIENTRY SetUniformInts(GLint, GLsizei, const GLint*)
+{
+}
+
+static void APIENTRY SetUniformUInts(GLint, GLsizei, const GLuint*)
+{
+}
+
+static void APIENTRY SetUniformMatrix(GLint, GLsizei, GLboolean, const GLfloat*)
+{
+}
+
+static void APIENTRY SetState1(GLenum)
+{
+}
+
+static void APIENTRY SetState2(GLenum, GLenum)
+{
+}
+
+static void APIENTRY SetState3(GLenum, GLenum, GLenum)
+{
+}
+
+static void APIENTRY SetState4(GLenum, GLenum, GLenum, GLenum)
+{
+}
+
+static void APIENTRY SetMask(GLboolean)
+{
+}
+
+static void APIENTRY SetMask4(GLboolean, GLboolean, GLboolean, GLboolean)
+{
+}
+
+static void APIENTRY SetColor(GLfloat, GLfloat, GLfloat, GLfloat)
+{
+}
+
+static void APIENTRY SetRect(GLint, GLint, GLsizei, GLsizei)
+{
+}
+
+static void APIENTRY SetPolygonOffset(GLfloat, GLfloat)
+{
+}
+
+static void APIENTRY SetStencilFunction(GLenum, GLint, GLuint)
+{
+}
+
+static void APIENTRY SetStencilFunctionSeparate(GLenum, GLenum, GLint, GLuint)
+{
+}
+
+static void APIENTRY BindBufferBase(GLenum, GLuint, GLuint)
+{
+}
+
+static void APIENTRY GetIntegerv(GLenum name, GLint* data)
+{
+    switch (name)
+    {
+    case GL_MAJOR_VERSION:
+        *data = s_version[0];
+        break;
+    case GL_MINOR_VERSION:
+        *data = s_version[1];
+        break;
+    case GL_VIEWPORT:
+        data[0] = data[1] = 0;
+        data[2] = data[3] = 1024;
+        break;
+    default:
+        *data = 0;
+        break;
+    }
+}
+
+static void AddDraw(bool indirect)
+{
+    ++s_drawCount;
+    s_draws.push_back({ s_currentProgram, indirect });
+}
+
+static void APIENTRY DrawArrays(GLenum, GLint, GLsizei)
+{
+    AddDraw(false);
+}
+
+static void APIENTRY DrawElements(GLenum, GLsizei, GLenum, const void*)
+{
+    AddDraw(false);
+}
+
+static void APIENTRY DrawArraysInstanced(GLenum, GLint, GLsizei, GLsizei)
+{
+    AddDraw(false);
+}
+
+static void APIENTRY DrawElementsInstanced(GLenum, GLsizei, GLenum, const void*, GLsizei)
+{
+    AddDraw(false);
+}
+
+static void APIENTRY MultiDrawArraysIndirect(GLenum, const void*, GLsizei, GLsizei)
+{
+    AddDraw(true);
+}
+
+static void APIENTRY MultiDrawElementsIndirect(GLenum, GLenum, const void*, GLsizei, GLsizei)
+{
+    AddDraw(true);
+}
+
+void InstallGLStubs()
+{
+    // The names are macros for the glad function pointers, also in the debug version
+    glGenVertexArrays = GenObjects;
+    glDeleteVertexArrays = DeleteObjects;
+    glGenBuffers = GenObjects;
+    glDeleteBuffers = DeleteObjects;
+    glBindBuffer = BindObject;
+    glBufferData = BufferData;
+    glBufferSubData = BufferSubData;
+    glBindVertexArray = BindVertexArray;
+    glGenTextures = GenObjects;
+    glDeleteTextures = DeleteObjects;
+    glTexImage2D = TexImage2D;
+    glTexParameteri = TexParameteri;
+    glTexParameterf = TexParameterf;
+    glGenFramebuffers = GenObjects;
+    glDeleteFramebuffers = DeleteObjects;
+    glBindFramebuffer = BindObject;
+    glFramebufferTexture2D = FramebufferTexture2D;
+    glDrawBuffers = DrawBuffers;
+    glInvalidateFramebuffer = InvalidateFramebuffer;
+    glBlitFramebuffer = BlitFramebuffer;
+    glVertexAttribPointer = VertexAttribPointer;
+    glVertexAttribIPointer = VertexAttribIPointer;
+    glEnableVertexAttribArray = EnableAttribute;
+    glDisableVertexAttribArray = DisableAttribute;
+    glVertexAttribDivisor = VertexAttribDivisor;
+    glEnable = SetFeature;
+    glDisable = SetFeature;
+    glIsEnabled = IsEnabled;
+    glCreateProgram = CreateProgram;
+    glDeleteProgram = DeleteProgram;
+    glGetProgramiv = GetProgramiv;
+    glGetActiveUniform = GetActiveUniform;
+    glGetUniformLocation = GetUniformLocation;
+    glGetAttribLocation = GetAttribLocation;
+    glGetIntegerv = GetIntegerv;
+    glUseProgram = UseProgram;
+    glUniform1fv = glUniform2fv = glUniform3fv = glUniform4fv = SetUniformFloats;
+    glUniform1iv = glUniform2iv = glUniform3iv = glUniform4iv = SetUniformInts;
+    glUniform1uiv = glUniform2uiv = glUniform3uiv = glUniform4uiv = SetUniformUInts;
+    glUniformMatrix2fv = glUniformMatrix3fv = glUniformMatrix4fv = SetUniformMatrix;
+    glDepthFunc = glCullFace = glBlendEquation = glActiveTexture = glReadBuffer = SetState1;
+    glBlendFunc = glBlendEquationSeparate = glPolygonMode = SetState2;
+    glStencilOp = SetState3;
+    glBlendFuncSeparate = glStencilOpSeparate = SetState4;
+    glDepthMask = SetMask;
+    glColorMask = SetMask4;
+    glClearColor = glBlendColor = SetColor;
+    glClear = Clear;
+    glClearDepth = ClearDepth;
+    glViewport = glScissor = SetRect;
+    glPolygonOffset = SetPolygonOffset;
+    glStencilFunc = SetStencilFunction;
+    glStencilFuncSeparate = SetStencilFunctionSeparate;
+    glBindBufferBase = BindBufferBase;
+    glBindTexture = BindObject;
+    glDrawArrays = DrawArrays;
+    glDrawElements = DrawElements;
+    glDrawArraysInstanced = DrawArraysInstanced;
+    glDrawElementsInstanced = DrawElementsInstanced;
+    glMultiDrawArraysIndirect = MultiDrawArraysIndirect;
+    glMultiDrawElementsIndirect = MultiDrawElementsIndirect;
+}
+
+void SetGLStubUniforms(std::vector<GLStubUniform> uniforms)
+{
+    s_uniforms = std::move(uniforms);
+}
+
+void SetGLStubAttributes(std::vector<GLStubAttribute> attributes)
+{
+    s_attributes = std::move(attributes);
+}
+
+void SetGLStubVersion(GLint major, GLint minor)
+{
+    s_version[0] = major;
+    s_version[1] = minor;
+}
+
+unsigned int GetGLStubDrawCount()
+{
+    return s_drawCount;
+}
+
+std::span<const GLStubDraw> GetGLStubDraws()
+{
+    return s_draws;
+}
+
+bool IsGLStubAttributeEnabled(GLuint vertexArray, GLuint location)
+{
+    return s_enabledAttributes.count({ vertexArray, location }) > 0;
+}
+
+unsigned int GetGLStubAttributePointerCount()
+{
+    return s_attributePointerCount;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <span>
+#include <vector>
+
+// Replace the OpenGL functions used by the objects created in the tests, so they don't need a context
+// Generated handles are unique, programs are always linked, and nothing is drawn
+void InstallGLStubs();
+
+// Active uniform reported by the stub programs. The location is the position in the list
+struct GLStubUniform
+{
+    const char* name;
+    GLenum type;
+};
+
+// Uniforms of all the programs, read when their materials are created. None by default
+void SetGLStubUniforms(std::vector<GLStubUniform> uniforms);
+
+// Vertex attribute reported by the stub programs
+struct GLStubAttribute
+{
+    const char* name;
+    GLint location;
+};
+
+// Attributes of all the programs, read when they are registered in the renderer. None by default
+void SetGLStubAttributes(std::vector<GLStubAttribute> attributes);
+
+// Context version reported by glGetIntegerv, read by DeviceGL::UpdateVersion. 0.0 by default
+void SetGLStubVersion(GLint major, GLint minor);
+
+// Drawcalls sent since the stubs were installed. Each indirect multi-drawcall counts once
+unsigned int GetGLStubDrawCount();
+
+// Program in use by each drawcall, and if it was an indirect multi-drawcall
+struct GLStubDraw
+{
+    GLuint program;
+    bool indirect;
+};
+
+// Drawcalls sent since the stubs were installed, in order
+std::span<const GLStubDraw> GetGLStubDraws();
+
+// Vertex attribute arrays enabled in each vertex array, tracked through the bound vertex array
+bool IsGLStubAttributeEnabled(GLuint vertexArray, GLuint location);
+
+// Attribute pointers set since the stubs were installed
+unsigned int GetGLStubAttributePointerCount();
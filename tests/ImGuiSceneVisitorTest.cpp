@@ -0,0 +1,173 @@
+#include "Test.h"
+
+#include <ituGL/scene/ImGuiSceneVisitor.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneLight.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/utils/DearImGui.h>
+
+#include <imgui.h>
+#include <imgui_internal.h>
+
+static const char* WindowName = "Scene";
+
+// Dear ImGui without platform and renderer backends. Frames are built, but not drawn
+struct HeadlessImGui
+{
+    DearImGui imGui;
+
+    HeadlessImGui()
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(1280.0f, 720.0f);
+        io.DeltaTime = 1.0f / 60.0f;
+        io.IniFilename = nullptr;
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
+
+    // Build a frame with the window of the visitor, and get the number of vertices in it
+    int DrawFrame(ImGuiSceneVisitor& visitor, Scene& scene)
+    {
+        ImGui::NewFrame();
+        visitor.Draw(scene);
+        ImGui::Render();
+        return ImGui::GetDrawData()->TotalVtxCount;
+    }
+
+    // Rows in the node list of the last frame, from the height of its contents
+    // The clipper moves the cursor over the rows that are not built, so the height counts all the rows
+    int GetRowCount()
+    {
+        ImGuiWindow* window = ImGui::FindWindowByName(WindowName);
+        if (!window || window->DC.ChildWindows.empty())
+        {
+            return -1;
+        }
+        const ImGuiWindow* list = window->DC.ChildWindows[0];
+        float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+        float contentHeight = list->DC.CursorMaxPos.y - list->DC.CursorStartPos.y + ImGui::GetStyle().ItemSpacing.y;
+        return static_cast<int>(contentHeight / rowHeight + 0.5f);
+    }
+
+    // Click the filter, the first widget of the window, one frame per input event
+    void ClickFilter(ImGuiSceneVisitor& visitor, Scene& scene)
+    {
+        ImGuiWindow* window = ImGui::FindWindowByName(WindowName);
+        ImGuiIO& io = ImGui::GetIO();
+        io.AddMousePosEvent(window->ContentRegionRect.Min.x + 5.0f, window->ContentRegionRect.Min.y + 5.0f);
+        DrawFrame(visitor, scene);
+        io.AddMouseButtonEvent(ImGuiMouseButton_Left, true);
+        DrawFrame(visitor, scene);
+        io.AddMouseButtonEvent(ImGuiMouseButton_Left, false);
+        DrawFrame(visitor, scene);
+    }
+
+    // Type the text in the focused widget, one frame per character
+    void Type(ImGuiSceneVisitor& visitor, Scene& scene, const char* text)
+    {
+        for (const char* c = text; *c; ++c)
+        {
+            ImGui::GetIO().AddInputCharacter(*c);
+            DrawFrame(visitor, scene);
+        }
+    }
+};
+
+static void AddLights(Scene& scene, const char* prefix, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        scene.AddSceneNode(std::make_shared<SceneLight>(prefix + std::to_string(i), std::make_shared<PointLight>()));
+    }
+}
+
+TEST(ImGuiSceneVisitorNodeList)
+{
+    HeadlessImGui headless;
+    ImGuiSceneVisitor visitor(headless.imGui, WindowName);
+    Scene scene;
+    AddLights(scene, "Lamp", 300);
+    AddLights(scene, "torch", 200);
+
+    headless.DrawFrame(visitor, scene);
+    CHECK(headless.GetRowCount() == 500);
+
+    // Nodes added after the index was built are found in the next frame
+    AddLights(scene, "lantern", 20);
+    headless.DrawFrame(visitor, scene);
+    CHECK(headless.GetRowCount() == 520);
+
+    // The filter matches the start of the names, ignoring the case
+    headless.ClickFilter(visitor, scene);
+    headless.Type(visitor, scene, "la");
+    CHECK(headless.GetRowCount() == 320);
+    headless.Type(visitor, scene, "m");
+    CHECK(headless.GetRowCount() == 300);
+
+    // The range follows the nodes that are removed while filtering
+    scene.RemoveSceneNode("Lamp7");
+    headless.DrawFrame(visitor, scene);
+    CHECK(headless.GetRowCount() == 299);
+}
+
+TEST(ImGuiSceneVisitorBuildsVisibleRows)
+{
+    // The list builds the same rows for any scene size, only the node count text can change
+    int vertexCounts[2] = {};
+    unsigned int nodeCounts[2] = { 1000, 50000 };
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        HeadlessImGui headless;
+        ImGuiSceneVisitor visitor(headless.imGui, WindowName);
+        Scene scene;
+        AddLights(scene, "light", nodeCounts[i]);
+        headless.DrawFrame(visitor, scene);
+        vertexCounts[i] = headless.DrawFrame(visitor, scene);
+        CHECK(headless.GetRowCount() == static_cast<int>(nodeCounts[i]));
+    }
+    CHECK(vertexCounts[0] > 0);
+    CHECK(std::abs(vertexCounts[1] - vertexCounts[0]) < 200);
+}
+
+// Frame of the inspector, against building one collapsing header per node like the inspector used to
+BENCHMARK(ImGuiSceneVisitorDraw)
+{
+    for (unsigned int nodeCount : { 1000u, 10000u, 100000u })
+    {
+        HeadlessImGui headless;
+        ImGuiSceneVisitor visitor(headless.imGui, WindowName);
+        Scene scene;
+        AddLights(scene, "light", nodeCount);
+
+        // Visiting the scene builds the index again, like Draw does when nodes are added or removed
+        double indexTime = MeasureMilliseconds([&]()
+            {
+                ImGui::NewFrame();
+                scene.AcceptVisitor(visitor);
+                ImGui::Render();
+            }, 1);
+        double drawTime = MeasureMilliseconds([&]() { DoNotOptimize(headless.DrawFrame(visitor, scene)); });
+        double headersTime = MeasureMilliseconds([&]()
+            {
+                ImGui::NewFrame();
+                if (ImGui::Begin("Headers"))
+                {
+                    scene.GetEntityStore().ForEachNode([](Entity, SceneNode& node)
+                        {
+                            ImGui::PushID(&node);
+                            ImGui::CollapsingHeader(node.GetName().c_str());
+                            ImGui::PopID();
+                        });
+                }
+                ImGui::End();
+                ImGui::Render();
+                DoNotOptimize(ImGui::GetDrawData()->TotalVtxCount);
+            });
+
+        ReportTiming("visit, index and Draw", nodeCount, indexTime);
+        ReportTiming("Draw, clipped list", nodeCount, drawTime);
+        ReportTiming("header per node", nodeCount, headersTime);
+    }
+}
@@ -0,0 +1,256 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/renderer/LightClusterGrid.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/lighting/DirectionalLight.h>
+#include <ituGL/camera/Camera.h>
+#include <ituGL/core/WorkerPool.h>
+#include <ituGL/renderer/ForwardRenderPass.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+// Point lights around the camera, and one directional light at the end
+static std::vector<std::shared_ptr<Light>> CreateLights(unsigned int pointLightCount, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> range(0.5f, 10.0f);
+    std::vector<std::shared_ptr<Light>> lights;
+    for (unsigned int i = 0; i < pointLightCount; ++i)
+    {
+        std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
+        light->SetPosition(glm::vec3(position(random), position(random), position(random)));
+        light->SetDistanceAttenuation(glm::vec2(0.0f, range(random)));
+        lights.push_back(light);
+    }
+    lights.push_back(std::make_shared<DirectionalLight>());
+    return lights;
+}
+
+static std::vector<const Light*> GetLightPointers(const std::vector<std::shared_ptr<Light>>& lights)
+{
+    std::vector<const Light*> pointers;
+    for (const std::shared_ptr<Light>& light : lights)
+    {
+        pointers.push_back(light.get());
+    }
+    return pointers;
+}
+
+static Camera CreateCamera()
+{
+    Camera camera;
+    camera.SetViewMatrix(glm::vec3(5.0f, 3.0f, 40.0f), glm::vec3(0.0f));
+    camera.SetPerspectiveProjectionMatrix(1.0f, 16.0f / 9.0f, 0.5f, 100.0f);
+    return camera;
+}
+
+static std::vector<uint32_t> GetClusterLights(const LightClusterGrid& grid, unsigned int clusterIndex)
+{
+    const LightClusterGrid::Cluster& cluster = grid.GetClusters()[clusterIndex];
+    std::span<const uint32_t> indices = grid.GetLightIndices().subspan(cluster.offset, cluster.count);
+    return std::vector<uint32_t>(indices.begin(), indices.end());
+}
+
+// Every light that reaches a point of the view must be in the cluster of the point, like the shader looks it up
+TEST(LightClusterGridContainsLights)
+{
+    std::mt19937 random(21);
+    Camera camera = CreateCamera();
+    const glm::mat4& viewMatrix = camera.GetViewMatrix();
+    const glm::mat4& projMatrix = camera.GetProjectionMatrix();
+    glm::mat4 invViewProjMatrix = glm::inverse(camera.GetViewProjectionMatrix());
+
+    for (unsigned int pointLightCount : { 10u, 100u, 1000u })
+    {
+        std::vector<std::shared_ptr<Light>> lights = CreateLights(pointLightCount, random);
+        std::vector<const Light*> lightPointers = GetLightPointers(lights);
+        unsigned int directionalLightIndex = pointLightCount;
+
+        LightClusterGrid grid;
+        grid.Build(lightPointers, viewMatrix, projMatrix);
+        const glm::uvec3& gridSize = grid.GetGridSize();
+        CHECK(grid.GetClusters().size() == grid.GetClusterCount());
+
+        std::uniform_real_distribution<float> ndc(-0.999f, 0.999f);
+        std::uniform_real_distribution<float> depth(0.5f, 100.0f);
+        unsigned int litPointCount = 0;
+        for (unsigned int sample = 0; sample < 2000; ++sample)
+        {
+            // Point in the frustum, with the view depth of the slice computed from it
+            glm::vec2 ndcPosition(ndc(random), ndc(random));
+            float viewDepth = depth(random);
+            glm::vec4 nearPoint = invViewProjMatrix * glm::vec4(ndcPosition, -1.0f, 1.0f);
+            glm::vec4 farPoint = invViewProjMatrix * glm::vec4(ndcPosition, 1.0f, 1.0f);
+            glm::vec3 nearPosition = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 farPosition = glm::vec3(farPoint) / farPoint.w;
+            glm::vec3 position = glm::mix(nearPosition, farPosition, (viewDepth - 0.5f) / (100.0f - 0.5f));
+
+            unsigned int tileX = static_cast<unsigned int>((ndcPosition.x * 0.5f + 0.5f) * gridSize.x);
+            unsigned int tileY = static_cast<unsigned int>((ndcPosition.y * 0.5f + 0.5f) * gridSize.y);
+            float pointDepth = -(viewMatrix * glm::vec4(position, 1.0f)).z;
+            unsigned int clusterIndex = grid.GetClusterIndex(tileX, tileY, grid.GetSlice(pointDepth));
+            std::vector<uint32_t> clusterLights = GetClusterLights(grid, clusterIndex);
+
+            CHECK(std::find(clusterLights.begin(), clusterLights.end(), directionalLightIndex) != clusterLights.end());
+            for (uint32_t lightIndex = 0; lightIndex < pointLightCount; ++lightIndex)
+            {
+                const Light& light = *lights[lightIndex];
+                if (glm::distance(light.GetPosition(), position) < light.GetAttenuation().y)
+                {
+                    CHECK(std::find(clusterLights.begin(), clusterLights.end(), lightIndex) != clusterLights.end());
+                    ++litPointCount;
+                }
+            }
+        }
+        CHECK(litPointCount > 0);
+    }
+}
+
+TEST(LightClusterGridSkipsLightsOutside)
+{
+    Camera camera = CreateCamera();
+    std::vector<std::shared_ptr<Light>> lights;
+    for (glm::vec3 position : { glm::vec3(0.0f), glm::vec3(5.0f, 3.0f, 60.0f), glm::vec3(0.0f, 0.0f, -200.0f) })
+    {
+        std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
+        light->SetPosition(position);
+        light->SetDistanceAttenuation(glm::vec2(0.0f, 5.0f));
+        lights.push_back(light);
+    }
+
+    // Only the light at the origin, in front of the camera, reaches some clusters. The others are behind it and past the far plane
+    LightClusterGrid grid(4, 4, 8);
+    grid.Build(GetLightPointers(lights), camera.GetViewMatrix(), camera.GetProjectionMatrix());
+    unsigned int litClusterCount = 0;
+    for (unsigned int clusterIndex = 0; clusterIndex < grid.GetClusterCount(); ++clusterIndex)
+    {
+        std::vector<uint32_t> clusterLights = GetClusterLights(grid, clusterIndex);
+        CHECK(clusterLights.empty() || clusterLights == std::vector<uint32_t>{ 0 });
+        litClusterCount += !clusterLights.empty();
+    }
+    CHECK(litClusterCount > 0 && litClusterCount < grid.GetClusterCount());
+    CHECK(grid.GetLightIndices().size() == litClusterCount);
+}
+
+TEST(LightClusterGridSameWithThreads)
+{
+    std::mt19937 random(21);
+    Camera camera = CreateCamera();
+    std::vector<std::shared_ptr<Light>> lights = CreateLights(2000, random);
+    std::vector<const Light*> lightPointers = GetLightPointers(lights);
+
+    WorkerPool workerPool;
+    LightClusterGrid grid, threadedGrid;
+    threadedGrid.SetWorkerPool(&workerPool);
+    threadedGrid.SetThreadCount(4);
+    grid.Build(lightPointers, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+    threadedGrid.Build(lightPointers, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+
+    // The threads are created by the first build that needs them, and reused by the next ones
+    CHECK(workerPool.GetWorkerCount() == 3);
+    threadedGrid.Build(lightPointers, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+    CHECK(workerPool.GetWorkerCount() == 3);
+
+    CHECK(std::ranges::equal(grid.GetLightIndices(), threadedGrid.GetLightIndices()));
+    for (unsigned int clusterIndex = 0; clusterIndex < grid.GetClusterCount(); ++clusterIndex)
+    {
+        CHECK(grid.GetClusters()[clusterIndex].offset == threadedGrid.GetClusters()[clusterIndex].offset);
+        CHECK(grid.GetClusters()[clusterIndex].count == threadedGrid.GetClusters()[clusterIndex].count);
+    }
+}
+
+// Build time of the grid, done once per view and frame
+BENCHMARK(LightClusterGridBuild)
+{
+    std::mt19937 random(21);
+    Camera camera = CreateCamera();
+    for (unsigned int pointLightCount : { 10u, 100u, 1000u })
+    {
+        std::vector<std::shared_ptr<Light>> lights = CreateLights(pointLightCount, random);
+        std::vector<const Light*> lightPointers = GetLightPointers(lights);
+        LightClusterGrid grid;
+        double buildTime = MeasureMilliseconds([&]()
+            {
+                grid.Build(lightPointers, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+                DoNotOptimize(grid.GetLightIndices().size());
+            });
+        ReportTiming("LightClusterGrid::Build", pointLightCount, buildTime);
+    }
+}
+
+// Program with the uniforms of the default light binder, and the cluster uniforms if it reads the lights from the clusters
+static std::shared_ptr<ShaderProgram> CreateLitShaderProgram(Renderer& renderer, bool clustered)
+{
+    std::vector<GLStubUniform> uniforms = { { "LightIndirect", GL_INT }, { "LightColor", GL_FLOAT_VEC3 }, { "LightPosition", GL_FLOAT_VEC3 },
+        { "LightDirection", GL_FLOAT_VEC3 }, { "LightAttenuation", GL_FLOAT_VEC4 } };
+    if (clustered)
+    {
+        uniforms.insert(uniforms.end(), { { "ClusterGridSize", GL_UNSIGNED_INT_VEC3 }, { "ClusterDepthScaleBias", GL_FLOAT_VEC2 },
+            { "ClusterDepthPlane", GL_FLOAT_VEC4 }, { "ClusterViewProjMatrix", GL_FLOAT_MAT4 } });
+    }
+    SetGLStubUniforms(uniforms);
+    std::shared_ptr<ShaderProgram> shaderProgram = std::make_shared<ShaderProgram>();
+    renderer.RegisterShaderProgram(shaderProgram, nullptr, renderer.GetDefaultUpdateLightsFunction(*shaderProgram));
+    SetGLStubUniforms({});
+    return shaderProgram;
+}
+
+// Frame of a forward pass with 1000 objects, drawing once per light that reaches each object against once with the clusters
+BENCHMARK(ClusteredForwardFrame)
+{
+    std::mt19937 random(21);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    const unsigned int objectCount = 1000;
+    std::vector<glm::mat4> worldMatrices;
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        worldMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random))));
+    }
+
+    for (unsigned int pointLightCount : { 10u, 100u, 1000u })
+    {
+        std::vector<std::shared_ptr<Light>> lights = CreateLights(pointLightCount, random);
+        for (bool clustered : { false, true })
+        {
+            TestRenderer test;
+            test.renderer.AddRenderPass(std::make_unique<ForwardRenderPass>());
+            std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateLitShaderProgram(test.renderer, clustered)));
+            if (clustered)
+            {
+                SetGLStubVersion(4, 3);
+                test.device.UpdateVersion();
+            }
+
+            auto renderFrame = [&]()
+                {
+                    test.renderer.SetCurrentCamera(test.camera);
+                    for (const glm::mat4& worldMatrix : worldMatrices)
+                    {
+                        test.renderer.AddModel(*model, worldMatrix);
+                    }
+                    for (const std::shared_ptr<Light>& light : lights)
+                    {
+                        test.renderer.AddLight(*light);
+                    }
+                    test.renderer.Render();
+                };
+            renderFrame();
+            unsigned int drawCount = GetGLStubDrawCount();
+            renderFrame();
+            drawCount = GetGLStubDrawCount() - drawCount;
+            SetGLStubVersion(0, 0);
+
+            double frameTime = MeasureMilliseconds(renderFrame);
+            ReportTiming(clustered ? "frame, clustered" : "frame, pass per light", pointLightCount, frameTime);
+            ReportCount(clustered ? "draws, clustered" : "draws, pass per light", pointLightCount, drawCount);
+        }
+    }
+}
@@ -0,0 +1,195 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/scene/RendererSceneVisitor.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Model with LODs for screen sizes below 0.5, 0.25 and 0.1
+static std::shared_ptr<Model> CreateLodModel(std::shared_ptr<Material> material)
+{
+    std::shared_ptr<Model> model = CreateTriangleModel(material);
+    model->AddLod(CreateTriangleMesh(), 0.5f);
+    model->AddLod(CreateTriangleMesh(), 0.25f);
+    model->AddLod(CreateTriangleMesh(), 0.1f);
+    return model;
+}
+
+TEST(ModelLods)
+{
+    // Meshes bind their buffers through the device
+    GLStubsInstaller stubs;
+    DeviceGL device;
+    std::shared_ptr<Model> model = CreateLodModel(nullptr);
+    CHECK(model->GetLodCount() == 4);
+    CHECK(&model->GetLodMesh(0) == &model->GetMesh());
+    CHECK(&model->GetLodMesh(1) != &model->GetMesh());
+    CHECK(model->GetLodScreenSize(0) == std::numeric_limits<float>::infinity());
+    CHECK(model->GetLodScreenSize(2) == 0.25f);
+
+    model->ClearLods();
+    CHECK(model->GetLodCount() == 1);
+    CHECK(model->SelectLod(0.0f) == 0);
+}
+
+TEST(ModelSelectLod)
+{
+    // Meshes bind their buffers through the device
+    GLStubsInstaller stubs;
+    DeviceGL device;
+    std::shared_ptr<Model> model = CreateLodModel(nullptr);
+    CHECK(model->SelectLod(std::numeric_limits<float>::infinity()) == 0);
+    CHECK(model->SelectLod(1.0f) == 0);
+    CHECK(model->SelectLod(0.5f) == 0);
+    CHECK(model->SelectLod(0.4f) == 1);
+    CHECK(model->SelectLod(0.2f) == 2);
+    CHECK(model->SelectLod(0.05f) == 3);
+    CHECK(model->SelectLod(0.0f) == 3);
+
+    // With 10% hysteresis, the model at LOD 1 needs more than 0.55 to go to LOD 0, and less than 0.225 to go to LOD 2
+    CHECK(model->SelectLod(0.52f, 1, 0.1f) == 1);
+    CHECK(model->SelectLod(0.56f, 1, 0.1f) == 0);
+    CHECK(model->SelectLod(0.24f, 1, 0.1f) == 1);
+    CHECK(model->SelectLod(0.22f, 1, 0.1f) == 2);
+
+    // And the model at LOD 0 stays there until the size is below 0.45
+    CHECK(model->SelectLod(0.47f, 0, 0.1f) == 0);
+    CHECK(model->SelectLod(0.44f, 0, 0.1f) == 1);
+
+    // Sizes that jitter around a threshold change the LOD every frame, unless the jitter is smaller than the hysteresis
+    for (float hysteresis : { 0.0f, 0.1f })
+    {
+        unsigned int lod = 0, switchCount = 0;
+        for (unsigned int frame = 0; frame < 100; ++frame)
+        {
+            float screenSize = 0.25f * (frame % 2 ? 1.03f : 0.97f);
+            unsigned int newLod = model->SelectLod(screenSize, lod, hysteresis);
+            switchCount += newLod != lod;
+            lod = newLod;
+        }
+        CHECK(hysteresis == 0.0f ? switchCount == 100 : switchCount == 1);
+    }
+}
+
+TEST(RendererLodDrawcalls)
+{
+    TestRenderer test;
+    std::shared_ptr<Model> model = CreateLodModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+
+    // The drawcalls use the mesh of the LOD, and the stats count each object once
+    test.renderer.AddView(test.camera);
+    const unsigned int lods[] = { 0, 2, 2, 3, 1, 2 };
+    for (unsigned int lod : lods)
+    {
+        test.renderer.AddModel(*model, glm::mat4(1.0f), Renderer::AllViews, lod);
+    }
+    std::span<const Renderer::DrawcallInfo> drawcalls = test.renderer.GetDrawcalls(0);
+    CHECK(drawcalls.size() == std::size(lods));
+    for (unsigned int i = 0; i < drawcalls.size(); ++i)
+    {
+        CHECK(&drawcalls[i].GetVAO() == &model->GetLodMesh(lods[i]).GetSubmeshVertexArray(0));
+    }
+    test.renderer.Render();
+
+    const Renderer::LodStats& lodStats = test.renderer.GetLodStats();
+    const unsigned int expectedCounts[Model::MaxLodCount] = { 1, 1, 3, 1 };
+    for (unsigned int lod = 0; lod < Model::MaxLodCount; ++lod)
+    {
+        CHECK(lodStats.objectCounts[lod] == expectedCounts[lod]);
+        CHECK(lodStats.triangleCounts[lod] == expectedCounts[lod]);
+    }
+}
+
+TEST(DrawcallTriangleCount)
+{
+    CHECK(Drawcall(Drawcall::Primitive::Triangles, 9).GetTriangleCount() == 3);
+    CHECK(Drawcall(Drawcall::Primitive::TriangleStrip, 6).GetTriangleCount() == 4);
+    CHECK(Drawcall(Drawcall::Primitive::TriangleFan, 5).GetTriangleCount() == 3);
+    CHECK(Drawcall(Drawcall::Primitive::TriangleStrip, 2).GetTriangleCount() == 0);
+    CHECK(Drawcall(Drawcall::Primitive::Lines, 8).GetTriangleCount() == 0);
+}
+
+// Scene with a camera looking at the origin from z = 10, and models with LODs along the view direction
+struct LodScene
+{
+    Scene scene;
+    std::shared_ptr<Model> model;
+    std::vector<std::shared_ptr<SceneModel>> sceneModels;
+
+    LodScene(Renderer& renderer, const Camera& camera, const std::vector<glm::vec3>& positions)
+        : model(CreateLodModel(std::make_shared<Material>(CreateShaderProgram(renderer, false))))
+    {
+        scene.AddSceneNode(std::make_shared<SceneCamera>("camera", std::make_shared<Camera>(camera)));
+        for (unsigned int i = 0; i < positions.size(); ++i)
+        {
+            std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+            transform->SetTranslation(positions[i]);
+            sceneModels.push_back(std::make_shared<SceneModel>("model" + std::to_string(i), model, transform));
+            scene.AddSceneNode(sceneModels.back());
+        }
+    }
+};
+
+TEST(RendererSceneVisitorLodSelection)
+{
+    TestRenderer test;
+    // Near the camera, far from it, and with the camera inside its bounds
+    LodScene lodScene(test.renderer, test.camera, { glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, -80.0f), glm::vec3(0.0f, 0.0f, 9.5f) });
+
+    RendererSceneVisitor visitor(test.renderer);
+    lodScene.scene.AcceptVisitor(visitor);
+    test.renderer.Render();
+    CHECK(lodScene.sceneModels[0]->GetLod() == 0);
+    CHECK(lodScene.sceneModels[1]->GetLod() == 3);
+    CHECK(lodScene.sceneModels[2]->GetLod() == 0);
+    CHECK(test.renderer.GetLodStats().objectCounts[0] == 2);
+    CHECK(test.renderer.GetLodStats().objectCounts[3] == 1);
+
+    // Without LOD selection, all the models use LOD 0
+    visitor.SetLodSelection(false);
+    lodScene.scene.AcceptVisitor(visitor);
+    test.renderer.Render();
+    CHECK(lodScene.sceneModels[1]->GetLod() == 0);
+    CHECK(test.renderer.GetLodStats().objectCounts[0] == 3);
+}
+
+// Cost of the LOD selection in the scene visit, with models spread in front of the camera
+BENCHMARK(RendererSceneVisitorLodSelectionCost)
+{
+    std::mt19937 random(19);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> depth(-90.0f, 0.0f);
+    for (unsigned int count : { 1000u, 10000u, 50000u })
+    {
+        TestRenderer test;
+        std::vector<glm::vec3> positions;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            positions.emplace_back(position(random), position(random), depth(random));
+        }
+        LodScene lodScene(test.renderer, test.camera, positions);
+
+        RendererSceneVisitor visitor(test.renderer);
+        auto visitScene = [&]()
+            {
+                lodScene.scene.AcceptVisitor(visitor);
+                DoNotOptimize(test.renderer.GetDrawcalls(0).size());
+                test.renderer.Render();
+            };
+        double withSelectionTime = MeasureMilliseconds(visitScene);
+        visitor.SetLodSelection(false);
+        double withoutSelectionTime = MeasureMilliseconds(visitScene);
+
+        ReportTiming("visit with LOD selection", count, withSelectionTime);
+        ReportTiming("visit without LOD selection", count, withoutSelectionTime);
+    }
+}
@@ -0,0 +1,303 @@
+#include "Test.h"
+
+#include <ituGL/renderer/ObjectLightAssignment.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/lighting/SpotLight.h>
+#include <ituGL/lighting/DirectionalLight.h>
+#include <ituGL/core/WorkerPool.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+
+static std::shared_ptr<PointLight> CreatePointLight(const glm::vec3& position, float range, float intensity = 1.0f)
+{
+    std::shared_ptr<PointLight> light = std::make_shared<PointLight>();
+    light->SetPosition(position);
+    light->SetDistanceAttenuation(glm::vec2(0.0f, range));
+    light->SetIntensity(intensity);
+    return light;
+}
+
+// The light shines along the direction, like the angular attenuation of the shaders computes it
+static std::shared_ptr<SpotLight> CreateSpotLight(const glm::vec3& position, const glm::vec3& shineDirection, float range, float angle)
+{
+    std::shared_ptr<SpotLight> light = std::make_shared<SpotLight>();
+    light->SetPosition(position);
+    light->SetDirection(-shineDirection);
+    light->SetDistanceAttenuation(glm::vec2(0.0f, range));
+    light->SetAngleAttenuation(glm::vec2(0.0f, angle));
+    return light;
+}
+
+static std::vector<const Light*> GetLightPointers(const std::vector<std::shared_ptr<Light>>& lights)
+{
+    std::vector<const Light*> pointers;
+    for (const std::shared_ptr<Light>& light : lights)
+    {
+        pointers.push_back(light.get());
+    }
+    return pointers;
+}
+
+static std::vector<const Light*> GetObjectLights(const ObjectLightAssignment& assignment, unsigned int objectIndex)
+{
+    std::span<const Light* const> lights = assignment.GetObjectLights(objectIndex);
+    return std::vector<const Light*>(lights.begin(), lights.end());
+}
+
+// Boxes of the objects, given by their centers and half sizes
+struct ObjectBounds
+{
+    std::vector<glm::vec3> min;
+    std::vector<glm::vec3> max;
+
+    void Add(const glm::vec3& center, const glm::vec3& extents)
+    {
+        min.push_back(center - extents);
+        max.push_back(center + extents);
+    }
+};
+
+// Light reaching a point, computed the way the shaders do
+static bool IsPointLit(const Light& light, const glm::vec3& point)
+{
+    glm::vec4 attenuation = light.GetAttenuation();
+    if (attenuation.y <= 0.0f)
+    {
+        return true;
+    }
+
+    glm::vec3 offset = point - light.GetPosition();
+    float distance = glm::length(offset);
+    if (distance >= attenuation.y)
+    {
+        return false;
+    }
+    if (light.GetType() == Light::Type::Spot && attenuation.w > 0.0f && distance > 0.0f)
+    {
+        return glm::dot(offset / distance, -light.GetDirection()) > std::cos(attenuation.w);
+    }
+    return true;
+}
+
+TEST(ObjectLightAssignmentRejectsSpheres)
+{
+    std::vector<std::shared_ptr<Light>> lights = { CreatePointLight(glm::vec3(0.0f), 5.0f) };
+
+    // Inside the sphere, past the sphere only at the corner of the box, and far away
+    ObjectBounds bounds;
+    bounds.Add(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+    bounds.Add(glm::vec3(4.5f, 4.5f, 4.5f), glm::vec3(0.5f));
+    bounds.Add(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(1.0f));
+
+    ObjectLightAssignment assignment;
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(assignment.GetObjectCount() == 3);
+    CHECK(GetObjectLights(assignment, 0) == std::vector<const Light*>{ lights[0].get() });
+    CHECK(assignment.GetObjectLights(1).empty());
+    CHECK(assignment.GetObjectLights(2).empty());
+    CHECK(assignment.GetAffectingLights().size() == 1);
+}
+
+TEST(ObjectLightAssignmentRejectsCones)
+{
+    // Narrow spot light shining along -Z
+    std::vector<std::shared_ptr<Light>> lights = { CreateSpotLight(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 10.0f, 0.3f) };
+
+    // On the axis, inside the bounding sphere of the cone but out of the cone, and behind the light
+    ObjectBounds bounds;
+    bounds.Add(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.5f));
+    bounds.Add(glm::vec3(4.0f, 0.0f, -2.0f), glm::vec3(0.5f));
+    bounds.Add(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.5f));
+
+    ObjectLightAssignment assignment;
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(GetObjectLights(assignment, 0) == std::vector<const Light*>{ lights[0].get() });
+    CHECK(assignment.GetObjectLights(1).empty());
+    CHECK(assignment.GetObjectLights(2).empty());
+
+    // Objects without bounds can't be tested with the cone, so they keep the light
+    bounds.min.push_back(glm::vec3(-std::numeric_limits<float>::infinity()));
+    bounds.max.push_back(glm::vec3(std::numeric_limits<float>::infinity()));
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(GetObjectLights(assignment, 3) == std::vector<const Light*>{ lights[0].get() });
+}
+
+TEST(ObjectLightAssignmentLightsWithoutRange)
+{
+    // A directional light and a point light without range reach all the objects, the other point light only the first one
+    std::vector<std::shared_ptr<Light>> lights = { CreatePointLight(glm::vec3(0.0f), 2.0f), std::make_shared<DirectionalLight>(),
+        CreatePointLight(glm::vec3(0.0f), 0.0f) };
+
+    ObjectBounds bounds;
+    bounds.Add(glm::vec3(0.0f), glm::vec3(1.0f));
+    bounds.Add(glm::vec3(1000.0f), glm::vec3(1.0f));
+
+    ObjectLightAssignment assignment;
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+
+    // Lights without range go first, in the order they were passed
+    CHECK((GetObjectLights(assignment, 0) == std::vector<const Light*>{ lights[1].get(), lights[2].get(), lights[0].get() }));
+    CHECK((GetObjectLights(assignment, 1) == std::vector<const Light*>{ lights[1].get(), lights[2].get() }));
+    CHECK(assignment.GetAffectingLights().size() == 3);
+}
+
+TEST(ObjectLightAssignmentMaxLightCount)
+{
+    // All the lights reach the object. The bright one is far, the dim one is close
+    std::vector<std::shared_ptr<Light>> lights = { CreatePointLight(glm::vec3(0.0f, 0.0f, 5.0f), 10.0f, 1.0f),
+        CreatePointLight(glm::vec3(0.0f, 0.0f, 8.0f), 10.0f, 100.0f), std::make_shared<DirectionalLight>(),
+        CreatePointLight(glm::vec3(0.0f, 0.0f, 1.5f), 10.0f, 0.5f), CreatePointLight(glm::vec3(0.0f, 0.0f, 9.0f), 10.0f, 0.1f) };
+
+    ObjectBounds bounds;
+    bounds.Add(glm::vec3(0.0f), glm::vec3(1.0f));
+
+    ObjectLightAssignment assignment;
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(assignment.GetObjectLights(0).size() == 5);
+
+    // The light without range is kept first, then the highest brightness over squared distance, in their original order
+    assignment.SetMaxLightCount(3);
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK((GetObjectLights(assignment, 0) == std::vector<const Light*>{ lights[2].get(), lights[1].get(), lights[3].get() }));
+    CHECK(assignment.GetAffectingLights().size() == 3);
+
+    assignment.SetMaxLightCount(1);
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(GetObjectLights(assignment, 0) == std::vector<const Light*>{ lights[2].get() });
+
+    assignment.SetMaxLightCount(0);
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+    CHECK(assignment.GetObjectLights(0).empty());
+    CHECK(assignment.GetAffectingLights().empty());
+}
+
+// Random point and spot lights, and a directional light at the end
+static std::vector<std::shared_ptr<Light>> CreateRandomLights(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> range(1.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(0.1f, 1.5f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::vector<std::shared_ptr<Light>> lights;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        glm::vec3 lightPosition(position(random), position(random), position(random));
+        if (i % 2)
+        {
+            glm::vec3 shineDirection(direction(random), direction(random), direction(random));
+            lights.push_back(CreateSpotLight(lightPosition, glm::normalize(shineDirection + glm::vec3(0.0f, 0.0f, 0.01f)), range(random), angle(random)));
+        }
+        else
+        {
+            lights.push_back(CreatePointLight(lightPosition, range(random)));
+        }
+    }
+    lights.push_back(std::make_shared<DirectionalLight>());
+    return lights;
+}
+
+static ObjectBounds CreateRandomBounds(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    ObjectBounds bounds;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        bounds.Add(glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)));
+    }
+    return bounds;
+}
+
+// Every light that reaches a point of an object must be in the list of the object
+TEST(ObjectLightAssignmentContainsLights)
+{
+    std::mt19937 random(23);
+    std::vector<std::shared_ptr<Light>> lights = CreateRandomLights(200, random);
+    ObjectBounds bounds = CreateRandomBounds(500, random);
+
+    ObjectLightAssignment assignment;
+    assignment.Build(GetLightPointers(lights), bounds.min, bounds.max);
+
+    std::uniform_real_distribution<float> blend(0.0f, 1.0f);
+    unsigned int litPointCount = 0;
+    for (unsigned int objectIndex = 0; objectIndex < assignment.GetObjectCount(); ++objectIndex)
+    {
+        std::vector<const Light*> objectLights = GetObjectLights(assignment, objectIndex);
+        for (unsigned int sample = 0; sample < 20; ++sample)
+        {
+            glm::vec3 point = glm::mix(bounds.min[objectIndex], bounds.max[objectIndex], glm::vec3(blend(random), blend(random), blend(random)));
+            for (const std::shared_ptr<Light>& light : lights)
+            {
+                if (IsPointLit(*light, point))
+                {
+                    CHECK(std::find(objectLights.begin(), objectLights.end(), light.get()) != objectLights.end());
+                    litPointCount += light->GetType() != Light::Type::Directional;
+                }
+            }
+        }
+    }
+    CHECK(litPointCount > 0);
+
+    // The lists are not all the lights either, the tests reject most of them
+    CHECK(assignment.GetObjectLights(0).size() < lights.size() / 2);
+}
+
+TEST(ObjectLightAssignmentSameWithThreads)
+{
+    std::mt19937 random(23);
+    std::vector<std::shared_ptr<Light>> lights = CreateRandomLights(200, random);
+    std::vector<const Light*> lightPointers = GetLightPointers(lights);
+    ObjectBounds bounds = CreateRandomBounds(2000, random);
+
+    WorkerPool workerPool;
+    ObjectLightAssignment assignment, threadedAssignment;
+    threadedAssignment.SetWorkerPool(&workerPool);
+    threadedAssignment.SetThreadCount(4);
+    assignment.Build(lightPointers, bounds.min, bounds.max);
+    threadedAssignment.Build(lightPointers, bounds.min, bounds.max);
+    CHECK(workerPool.GetWorkerCount() == 3);
+
+    // The lists of the threads are merged in object order, so the offsets of all the objects follow each other
+    const Light* const* listEnd = threadedAssignment.GetObjectLights(0).data();
+    for (unsigned int objectIndex = 0; objectIndex < assignment.GetObjectCount(); ++objectIndex)
+    {
+        std::span<const Light* const> threadedLights = threadedAssignment.GetObjectLights(objectIndex);
+        CHECK(threadedLights.data() == listEnd);
+        CHECK(std::ranges::equal(assignment.GetObjectLights(objectIndex), threadedLights));
+        listEnd = threadedLights.data() + threadedLights.size();
+    }
+    CHECK(std::ranges::equal(assignment.GetAffectingLights(), threadedAssignment.GetAffectingLights()));
+}
+
+// Build time of the lists, done once per frame, in the calling thread and in the worker threads
+BENCHMARK(ObjectLightAssignmentBuild)
+{
+    std::mt19937 random(23);
+    ObjectBounds bounds = CreateRandomBounds(10000, random);
+    WorkerPool workerPool;
+    for (unsigned int lightCount : { 10u, 100u, 1000u })
+    {
+        std::vector<std::shared_ptr<Light>> lights = CreateRandomLights(lightCount, random);
+        std::vector<const Light*> lightPointers = GetLightPointers(lights);
+
+        ObjectLightAssignment assignment, threadedAssignment;
+        threadedAssignment.SetWorkerPool(&workerPool);
+        double buildTime = MeasureMilliseconds([&]()
+            {
+                assignment.Build(lightPointers, bounds.min, bounds.max);
+                DoNotOptimize(assignment.GetAffectingLights().size());
+            });
+        double threadedBuildTime = MeasureMilliseconds([&]()
+            {
+                threadedAssignment.Build(lightPointers, bounds.min, bounds.max);
+                DoNotOptimize(threadedAssignment.GetAffectingLights().size());
+            });
+        ReportTiming("10000 objects, calling thread", lightCount, buildTime);
+        ReportTiming("10000 objects, worker pool", lightCount, threadedBuildTime);
+    }
+}
@@ -0,0 +1,177 @@
+#include "Test.h"
+
+#include <ituGL/scene/OcclusionCuller.h>
+#include <ituGL/core/WorkerPool.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <random>
+
+// Orthographic view along -Z, with one pixel per world unit. World x and y map to the pixels x + 128 and y + 64
+static glm::mat4 GetPixelViewProjMatrix()
+{
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::ortho(-128.0f, 128.0f, -64.0f, 64.0f, 0.1f, 100.0f) * viewMatrix;
+}
+
+static AabbBounds CreateBounds(const glm::vec3& min, const glm::vec3& max)
+{
+    return AabbBounds(0.5f * (min + max), 0.5f * (max - min));
+}
+
+TEST(OcclusionCullerHidesOccludees)
+{
+    // Wall in front of the origin, seen with a perspective camera
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projMatrix = glm::perspective(1.0f, 2.0f, 0.5f, 100.0f);
+    OccluderMesh wall = OccluderMesh::CreateBox(glm::vec3(-5.0f, -5.0f, -0.5f), glm::vec3(5.0f, 5.0f, 0.5f));
+
+    OcclusionCuller culler;
+    culler.BeginFrame(projMatrix * viewMatrix);
+    culler.AddOccluder(wall, glm::mat4(1.0f));
+    culler.RenderOccluders();
+    CHECK(culler.GetStats().occluderCount == 1);
+    CHECK(culler.GetStats().triangleCount > 0);
+
+    // Behind the wall, in front of it, behind it but out of its silhouette, and crossing the near plane
+    std::vector<AabbBounds> bounds = {
+        CreateBounds(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -9.0f)),
+        CreateBounds(glm::vec3(-1.0f, -1.0f, 4.0f), glm::vec3(1.0f, 1.0f, 6.0f)),
+        CreateBounds(glm::vec3(14.0f, -1.0f, -11.0f), glm::vec3(16.0f, 1.0f, -9.0f)),
+        CreateBounds(glm::vec3(-1.0f, -1.0f, 19.0f), glm::vec3(1.0f, 1.0f, 21.0f)),
+    };
+    std::vector<unsigned int> visibleIndices;
+    culler.Cull(bounds, visibleIndices);
+    CHECK((visibleIndices == std::vector<unsigned int>{ 1, 2, 3 }));
+    CHECK(culler.GetStats().testedCount == 4);
+    CHECK(culler.GetStats().culledCount == 1);
+
+    // Partly behind the wall and partly out of it
+    CHECK(culler.IsVisible(CreateBounds(glm::vec3(3.0f, -1.0f, -11.0f), glm::vec3(9.0f, 1.0f, -9.0f))));
+}
+
+// Pixels that are only partly covered by the occluders must not hide what is behind them
+TEST(OcclusionCullerIsConservative)
+{
+    // Two walls with a gap in the pixel 128, between 128.6 and 128.9, that doesn't contain the pixel center
+    OccluderMesh leftWall = OccluderMesh::CreateBox(glm::vec3(-50.0f, -20.0f, -0.5f), glm::vec3(0.6f, 20.0f, 0.5f));
+    OccluderMesh rightWall = OccluderMesh::CreateBox(glm::vec3(0.9f, -20.0f, -0.5f), glm::vec3(50.0f, 20.0f, 0.5f));
+
+    OcclusionCuller culler;
+    culler.BeginFrame(GetPixelViewProjMatrix());
+    culler.AddOccluder(leftWall, glm::mat4(1.0f));
+    culler.AddOccluder(rightWall, glm::mat4(1.0f));
+    culler.RenderOccluders();
+
+    // The pixel of the gap keeps the far depth, the pixels fully covered by a wall get the depth of the wall
+    CHECK(culler.GetDepth(128, 64) == 1.0f);
+    CHECK(culler.GetDepth(120, 64) < 1.0f);
+    CHECK(culler.GetDepth(135, 64) < 1.0f);
+
+    // Seen through the gap
+    CHECK(culler.IsVisible(CreateBounds(glm::vec3(0.65f, -1.0f, -6.0f), glm::vec3(0.85f, 1.0f, -4.0f))));
+    // Fully behind the walls
+    CHECK(!culler.IsVisible(CreateBounds(glm::vec3(-10.0f, -1.0f, -6.0f), glm::vec3(-5.0f, 1.0f, -4.0f))));
+    CHECK(!culler.IsVisible(CreateBounds(glm::vec3(5.0f, -1.0f, -6.0f), glm::vec3(10.0f, 1.0f, -4.0f))));
+    // Behind the walls, but also over their top edge
+    CHECK(culler.IsVisible(CreateBounds(glm::vec3(-10.0f, 19.0f, -6.0f), glm::vec3(-5.0f, 21.0f, -4.0f))));
+}
+
+// Random boxes in front of the camera, in the area that the pixel view sees
+static std::vector<glm::mat4> CreateOccluderMatrices(unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> positionX(-120.0f, 120.0f);
+    std::uniform_real_distribution<float> positionY(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> positionZ(-20.0f, 0.0f);
+    std::uniform_real_distribution<float> scale(1.0f, 20.0f);
+    std::vector<glm::mat4> worldMatrices;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        glm::mat4 worldMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(positionX(random), positionY(random), positionZ(random)));
+        worldMatrices.push_back(glm::scale(worldMatrix, glm::vec3(scale(random), scale(random), 1.0f)));
+    }
+    return worldMatrices;
+}
+
+TEST(OcclusionCullerSameWithThreads)
+{
+    std::mt19937 random(12);
+    OccluderMesh box = OccluderMesh::CreateBox(glm::vec3(-0.5f), glm::vec3(0.5f));
+    std::vector<glm::mat4> worldMatrices = CreateOccluderMatrices(50, random);
+
+    WorkerPool workerPool;
+    OcclusionCuller culler, threadedCuller;
+    threadedCuller.SetWorkerPool(&workerPool);
+    threadedCuller.SetThreadCount(4);
+    for (OcclusionCuller* currentCuller : { &culler, &threadedCuller })
+    {
+        currentCuller->BeginFrame(GetPixelViewProjMatrix());
+        for (const glm::mat4& worldMatrix : worldMatrices)
+        {
+            currentCuller->AddOccluder(box, worldMatrix);
+        }
+        currentCuller->RenderOccluders();
+    }
+    CHECK(workerPool.GetWorkerCount() == 3);
+
+    bool sameDepth = true;
+    unsigned int coveredCount = 0;
+    for (int y = 0; y < culler.GetHeight(); ++y)
+    {
+        for (int x = 0; x < culler.GetWidth(); ++x)
+        {
+            sameDepth &= culler.GetDepth(x, y) == threadedCuller.GetDepth(x, y);
+            coveredCount += culler.GetDepth(x, y) < 1.0f;
+        }
+    }
+    CHECK(sameDepth);
+    CHECK(coveredCount > 0);
+}
+
+// Time of each step of the culling, for 10000 occludees behind an increasing number of occluders
+BENCHMARK(OcclusionCullerFrame)
+{
+    std::mt19937 random(12);
+    OccluderMesh box = OccluderMesh::CreateBox(glm::vec3(-0.5f), glm::vec3(0.5f));
+    std::uniform_real_distribution<float> positionX(-128.0f, 128.0f);
+    std::uniform_real_distribution<float> positionY(-64.0f, 64.0f);
+    std::uniform_real_distribution<float> positionZ(-80.0f, -20.0f);
+    std::vector<AabbBounds> occludeeBounds;
+    for (unsigned int i = 0; i < 10000; ++i)
+    {
+        occludeeBounds.emplace_back(glm::vec3(positionX(random), positionY(random), positionZ(random)), glm::vec3(1.0f));
+    }
+
+    WorkerPool workerPool;
+    for (unsigned int occluderCount : { 10u, 100u, 1000u })
+    {
+        std::vector<glm::mat4> worldMatrices = CreateOccluderMatrices(occluderCount, random);
+        for (WorkerPool* currentPool : { static_cast<WorkerPool*>(nullptr), &workerPool })
+        {
+            OcclusionCuller culler;
+            culler.SetWorkerPool(currentPool);
+            std::vector<unsigned int> visibleIndices;
+            double rasterizeTime = MeasureMilliseconds([&]()
+                {
+                    culler.BeginFrame(GetPixelViewProjMatrix());
+                    for (const glm::mat4& worldMatrix : worldMatrices)
+                    {
+                        culler.AddOccluder(box, worldMatrix);
+                    }
+                    culler.RenderOccluders();
+                });
+            double cullTime = MeasureMilliseconds([&]()
+                {
+                    visibleIndices.clear();
+                    culler.Cull(occludeeBounds, visibleIndices);
+                    DoNotOptimize(visibleIndices.size());
+                });
+            ReportTiming(currentPool ? "render occluders, worker pool" : "render occluders, calling thread", occluderCount, rasterizeTime);
+            if (!currentPool)
+            {
+                ReportTiming("cull 10000 bounds", occluderCount, cullTime);
+                ReportCount("culled bounds", occluderCount, occludeeBounds.size() - visibleIndices.size());
+            }
+        }
+    }
+}
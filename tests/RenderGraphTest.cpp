@@ -0,0 +1,235 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/renderer/RenderGraph.h>
+#include <ituGL/texture/Texture2DObject.h>
+
+#include <string>
+
+// Pass that adds its name to a list every time it renders
+class RecordRenderPass : public RenderPass
+{
+public:
+    RecordRenderPass(const char* name, std::vector<std::string>& renderedPasses) : m_name(name), m_renderedPasses(renderedPasses) {}
+
+    void Render() override { m_renderedPasses.push_back(m_name); }
+
+private:
+    std::string m_name;
+    std::vector<std::string>& m_renderedPasses;
+};
+
+static const RenderGraph::TextureDesc ColorDesc = { 64, 64, TextureObject::FormatRGBA, TextureObject::InternalFormatRGBA8 };
+static const RenderGraph::TextureDesc HdrDesc = { 64, 64, TextureObject::FormatRGBA, TextureObject::InternalFormatRGBA16F };
+
+TEST(RenderGraphCullPasses)
+{
+    TestRenderer test;
+    std::vector<std::string> renderedPasses;
+    RenderGraph graph;
+    RenderGraph::ResourceId scene = graph.CreateTexture("Scene", ColorDesc);
+    RenderGraph::ResourceId unused = graph.CreateTexture("Unused", ColorDesc);
+    RenderGraph::ResourceId overwritten = graph.CreateTexture("Overwritten", ColorDesc);
+
+    auto addPass = [&](const char* name) { return graph.AddPass(std::make_unique<RecordRenderPass>(name, renderedPasses)); };
+
+    // The draw keeps the contents of the clear, so both are needed by the output
+    unsigned int clearPass = addPass("clear");
+    graph.AddWrite(clearPass, scene, FramebufferObject::Attachment::Color0);
+    unsigned int drawPass = addPass("draw");
+    graph.AddWrite(drawPass, scene, FramebufferObject::Attachment::Color0, true);
+
+    // Nothing reads this texture
+    unsigned int unusedPass = addPass("unused");
+    graph.AddRead(unusedPass, scene);
+    graph.AddWrite(unusedPass, unused, FramebufferObject::Attachment::Color0);
+
+    // The second write discards the contents of the first one
+    unsigned int firstWritePass = addPass("first write");
+    graph.AddWrite(firstWritePass, overwritten, FramebufferObject::Attachment::Color0);
+    unsigned int secondWritePass = addPass("second write");
+    graph.AddWrite(secondWritePass, overwritten, FramebufferObject::Attachment::Color0);
+
+    // The output writes outside of the graph, so it is always kept
+    unsigned int outputPass = addPass("output");
+    graph.AddRead(outputPass, scene);
+    graph.AddRead(outputPass, overwritten);
+
+    graph.Compile(test.renderer);
+    CHECK(graph.GetStats().passCount == 6);
+    CHECK(graph.GetStats().culledPassCount == 2);
+    CHECK(graph.GetTexture(scene) != nullptr);
+    CHECK(graph.GetTexture(unused) == nullptr);
+    CHECK(graph.GetStats().textureCount == 2);
+
+    test.renderer.AddView(test.camera);
+    test.renderer.Render();
+    CHECK((renderedPasses == std::vector<std::string>{ "clear", "draw", "second write", "output" }));
+}
+
+TEST(RenderGraphLifetimes)
+{
+    TestRenderer test;
+    std::vector<std::string> renderedPasses;
+    RenderGraph graph;
+    RenderGraph::ResourceId first = graph.CreateTexture("First", HdrDesc);
+    RenderGraph::ResourceId second = graph.CreateTexture("Second", HdrDesc);
+    RenderGraph::ResourceId third = graph.CreateTexture("Third", HdrDesc);
+    RenderGraph::ResourceId color = graph.CreateTexture("Color", ColorDesc);
+    RenderGraph::ResourceId culled = graph.CreateTexture("Culled", HdrDesc);
+    RenderGraph::ResourceId fourth = graph.CreateTexture("Fourth", HdrDesc);
+
+    auto addPass = [&](const char* name) { return graph.AddPass(std::make_unique<RecordRenderPass>(name, renderedPasses)); };
+
+    // Pass 0 writes the first texture, pass 1 reads it and writes the second one, so they overlap in pass 1
+    unsigned int pass0 = addPass("0");
+    graph.AddWrite(pass0, first, FramebufferObject::Attachment::Color0);
+    unsigned int pass1 = addPass("1");
+    graph.AddRead(pass1, first);
+    graph.AddWrite(pass1, second, FramebufferObject::Attachment::Color0);
+
+    // The first texture is not used after pass 1, so the third one can take its texture object, but not the color texture
+    unsigned int pass2 = addPass("2");
+    graph.AddRead(pass2, second);
+    graph.AddWrite(pass2, third, FramebufferObject::Attachment::Color0);
+    graph.AddWrite(pass2, color, FramebufferObject::Attachment::Color1);
+
+    // A culled pass that reads the third texture doesn't extend its lifetime
+    unsigned int culledPass = addPass("culled");
+    graph.AddRead(culledPass, third);
+    graph.AddWrite(culledPass, culled, FramebufferObject::Attachment::Color0);
+
+    // The second texture is free after pass 2
+    unsigned int pass4 = addPass("4");
+    graph.AddRead(pass4, third);
+    graph.AddWrite(pass4, fourth, FramebufferObject::Attachment::Color0);
+
+    unsigned int outputPass = addPass("output");
+    graph.AddRead(outputPass, fourth);
+    graph.AddRead(outputPass, color);
+
+    graph.Compile(test.renderer);
+    CHECK(graph.GetTexture(first) != graph.GetTexture(second));
+    CHECK(graph.GetTexture(third) == graph.GetTexture(first));
+    CHECK(graph.GetTexture(fourth) == graph.GetTexture(second));
+    CHECK(graph.GetTexture(color) != nullptr && graph.GetTexture(color) != graph.GetTexture(first));
+    CHECK(graph.GetTexture(culled) == nullptr);
+
+    // Four HDR textures in two texture objects, and the color texture in its own
+    const RenderGraph::Stats& stats = graph.GetStats();
+    CHECK(stats.textureCount == 5);
+    CHECK(stats.physicalTextureCount == 3);
+    CHECK(stats.unaliasedMemory == 4 * RenderGraph::GetMemorySize(HdrDesc) + RenderGraph::GetMemorySize(ColorDesc));
+    CHECK(stats.aliasedMemory == 2 * RenderGraph::GetMemorySize(HdrDesc) + RenderGraph::GetMemorySize(ColorDesc));
+}
+
+// Textures with the same description are only reused when the lifetimes are disjoint, not just different
+TEST(RenderGraphAssignPhysicalTextures)
+{
+    TestRenderer test;
+    std::vector<std::string> renderedPasses;
+    RenderGraph graph;
+    std::vector<RenderGraph::ResourceId> textures;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        textures.push_back(graph.CreateTexture("Texture", HdrDesc));
+    }
+
+    // Texture i is written in pass i and read in pass i + 2, so three of them are alive at the same time
+    std::vector<unsigned int> passes;
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        passes.push_back(graph.AddPass(std::make_unique<RecordRenderPass>("pass", renderedPasses)));
+    }
+    for (unsigned int i = 0; i < textures.size(); ++i)
+    {
+        graph.AddWrite(passes[i], textures[i], FramebufferObject::Attachment::Color0);
+        graph.AddRead(passes[i + 2], textures[i]);
+    }
+    // The last pass has no writes, so it keeps all the others through their reads
+    graph.AddRead(passes[5], textures[3]);
+    graph.AddRead(passes[5], textures[2]);
+
+    graph.Compile(test.renderer);
+    CHECK(graph.GetStats().culledPassCount == 0);
+    CHECK(graph.GetStats().physicalTextureCount == 3);
+    CHECK(graph.GetTexture(textures[3]) == graph.GetTexture(textures[0]));
+    for (unsigned int i = 1; i < textures.size(); ++i)
+    {
+        CHECK(graph.GetTexture(textures[i]) != graph.GetTexture(textures[i - 1]));
+    }
+}
+
+// Render target memory of the deferred and post-processing graph of exercise 09 at 4K, for several blur iterations
+BENCHMARK(RenderGraphPostProcessingMemory)
+{
+    const int width = 3840, height = 2160;
+    RenderGraph::TextureDesc depthDesc = { width, height, TextureObject::FormatDepthStencil, TextureObject::InternalFormatDepth24Stencil8 };
+    RenderGraph::TextureDesc colorDesc = { width, height, TextureObject::FormatRGBA, TextureObject::InternalFormatSRGBA8 };
+    RenderGraph::TextureDesc normalDesc = { width, height, TextureObject::FormatRG, TextureObject::InternalFormatRG16F };
+    RenderGraph::TextureDesc hdrDesc = { width, height, TextureObject::FormatRGBA, TextureObject::InternalFormatRGBA16F, GL_LINEAR };
+    RenderGraph::TextureDesc coverageDesc = { width, height, TextureObject::FormatR, TextureObject::InternalFormatR8 };
+
+    for (unsigned int blurIterations : { 1u, 2u, 4u })
+    {
+        TestRenderer test;
+        std::vector<std::string> renderedPasses;
+        RenderGraph graph;
+        auto addPass = [&](const char* name) { return graph.AddPass(std::make_unique<RecordRenderPass>(name, renderedPasses)); };
+
+        RenderGraph::ResourceId depth = graph.CreateTexture("Depth", depthDesc);
+        RenderGraph::ResourceId albedo = graph.CreateTexture("Albedo", colorDesc);
+        RenderGraph::ResourceId normal = graph.CreateTexture("Normal", normalDesc);
+        RenderGraph::ResourceId others = graph.CreateTexture("Others", colorDesc);
+        RenderGraph::ResourceId scene = graph.CreateTexture("Scene", hdrDesc);
+        RenderGraph::ResourceId bloom = graph.CreateTexture("Bloom", hdrDesc);
+        RenderGraph::ResourceId accumulation = graph.CreateTexture("Accumulation", hdrDesc);
+        RenderGraph::ResourceId coverage = graph.CreateTexture("Coverage", coverageDesc);
+
+        unsigned int gbufferPass = addPass("gbuffer");
+        graph.AddWrite(gbufferPass, depth, FramebufferObject::Attachment::DepthStencil);
+        graph.AddWrite(gbufferPass, albedo, FramebufferObject::Attachment::Color0);
+        graph.AddWrite(gbufferPass, normal, FramebufferObject::Attachment::Color1);
+        graph.AddWrite(gbufferPass, others, FramebufferObject::Attachment::Color2);
+        unsigned int deferredPass = addPass("deferred");
+        for (RenderGraph::ResourceId texture : { depth, albedo, normal, others })
+        {
+            graph.AddRead(deferredPass, texture);
+        }
+        graph.AddWrite(deferredPass, scene, FramebufferObject::Attachment::Color0);
+        graph.AddWrite(deferredPass, depth, FramebufferObject::Attachment::DepthStencil, true);
+        unsigned int skyboxPass = addPass("skybox");
+        graph.AddWrite(skyboxPass, depth, FramebufferObject::Attachment::DepthStencil, true);
+        graph.AddWrite(skyboxPass, scene, FramebufferObject::Attachment::Color0, true);
+        unsigned int transparentPass = addPass("transparent");
+        graph.AddWrite(transparentPass, accumulation, FramebufferObject::Attachment::Color0);
+        graph.AddWrite(transparentPass, coverage, FramebufferObject::Attachment::Color1);
+        graph.AddWrite(transparentPass, depth, FramebufferObject::Attachment::DepthStencil, true);
+        unsigned int compositePass = addPass("composite");
+        graph.AddRead(compositePass, accumulation);
+        graph.AddRead(compositePass, coverage);
+        graph.AddWrite(compositePass, scene, FramebufferObject::Attachment::Color0, true);
+        unsigned int bloomPass = addPass("bloom");
+        graph.AddRead(bloomPass, scene);
+        graph.AddWrite(bloomPass, bloom, FramebufferObject::Attachment::Color0);
+
+        RenderGraph::ResourceId blur = bloom;
+        for (unsigned int i = 0; i < 2 * blurIterations; ++i)
+        {
+            RenderGraph::ResourceId target = graph.CreateTexture("Blur", hdrDesc);
+            unsigned int blurPass = addPass("blur");
+            graph.AddRead(blurPass, blur);
+            graph.AddWrite(blurPass, target, FramebufferObject::Attachment::Color0);
+            blur = target;
+        }
+        unsigned int composePass = addPass("compose");
+        graph.AddRead(composePass, scene);
+        graph.AddRead(composePass, blur);
+
+        graph.Compile(test.renderer);
+        const RenderGraph::Stats& stats = graph.GetStats();
+        ReportCount("texture objects", blurIterations, stats.physicalTextureCount);
+        ReportCount("memory without aliasing, MB", blurIterations, stats.unaliasedMemory >> 20);
+        ReportCount("memory with aliasing, MB", blurIterations, stats.aliasedMemory >> 20);
+    }
+}
@@ -0,0 +1,132 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Models with two LODs and one of two materials, and the data of each object added to the renderer
+struct AddModelsScene
+{
+    std::shared_ptr<Material> materials[2];
+    std::vector<std::shared_ptr<Model>> modelStorage;
+    std::vector<const Model*> models;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<Renderer::ViewMask> viewMasks;
+    std::vector<unsigned int> lods;
+
+    AddModelsScene(Renderer& renderer, unsigned int objectCount)
+    {
+        for (std::shared_ptr<Material>& material : materials)
+        {
+            material = std::make_shared<Material>(CreateShaderProgram(renderer, false));
+        }
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            std::shared_ptr<Model> model = CreateTriangleModel(materials[i % 2]);
+            model->AddLod(CreateTriangleMesh(), 0.5f);
+            modelStorage.push_back(model);
+        }
+
+        std::mt19937 random(6);
+        for (unsigned int i = 0; i < objectCount; ++i)
+        {
+            models.push_back(modelStorage[random() % modelStorage.size()].get());
+            worldMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f)));
+            viewMasks.push_back(1 + random() % 3);
+            lods.push_back(random() % 2);
+        }
+    }
+};
+
+// Collections of the two views, one of them only with the first material
+static void AddCollections(TestRenderer& test, const Camera& secondCamera, const Material& material)
+{
+    test.renderer.AddView(test.camera);
+    test.renderer.AddView(secondCamera);
+    test.renderer.AddDrawcallCollection([&material](const Renderer::DrawcallInfo& drawcallInfo) { return &drawcallInfo.GetMaterial() == &material; }, 0);
+    test.renderer.AddDrawcallCollection(nullptr, 1);
+}
+
+// Drawcalls of all the collections as (material, VAO, world matrix index)
+using DrawcallList = std::vector<std::tuple<const Material*, const VertexArrayObject*, unsigned int>>;
+static std::vector<DrawcallList> GetDrawcallLists(const Renderer& renderer, unsigned int collectionCount)
+{
+    std::vector<DrawcallList> lists(collectionCount);
+    for (unsigned int i = 0; i < collectionCount; ++i)
+    {
+        for (const Renderer::DrawcallInfo& drawcallInfo : renderer.GetDrawcalls(i))
+        {
+            lists[i].emplace_back(&drawcallInfo.GetMaterial(), &drawcallInfo.GetVAO(), drawcallInfo.GetWorldMatrixIndex());
+        }
+    }
+    return lists;
+}
+
+TEST(RendererAddModelsSameAsAddModel)
+{
+    TestRenderer test;
+    Camera secondCamera;
+    const unsigned int objectCount = 5000;
+    AddModelsScene scene(test.renderer, objectCount);
+
+    // One frame adding the models one by one, then one frame adding them in a batch split in 4 threads
+    AddCollections(test, secondCamera, *scene.materials[0]);
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        test.renderer.AddModel(*scene.models[i], scene.worldMatrices[i], scene.viewMasks[i], scene.lods[i]);
+    }
+    std::vector<DrawcallList> expected = GetDrawcallLists(test.renderer, 3);
+    test.renderer.Render();
+    Renderer::LodStats expectedLodStats = test.renderer.GetLodStats();
+
+    test.renderer.SetWorkerThreadCount(4);
+    test.renderer.AddView(test.camera);
+    test.renderer.AddView(secondCamera);
+    test.renderer.AddModels(scene.models, scene.worldMatrices, scene.viewMasks, scene.lods);
+    std::vector<DrawcallList> found = GetDrawcallLists(test.renderer, 3);
+    test.renderer.Render();
+
+    CHECK(!expected[1].empty() && expected[1].size() < expected[0].size());
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        CHECK(found[i] == expected[i]);
+    }
+    CHECK(test.renderer.GetLodStats().objectCounts == expectedLodStats.objectCounts);
+    CHECK(test.renderer.GetLodStats().triangleCounts == expectedLodStats.triangleCounts);
+}
+
+// Adding the models one by one against adding them in a batch, with all the hardware threads
+BENCHMARK(RendererAddModels)
+{
+    for (unsigned int objectCount : { 1000u, 10000u, 100000u })
+    {
+        TestRenderer test;
+        AddModelsScene scene(test.renderer, objectCount);
+
+        double addModelTime = MeasureMilliseconds([&]()
+            {
+                test.renderer.SetCurrentCamera(test.camera);
+                for (unsigned int i = 0; i < objectCount; ++i)
+                {
+                    test.renderer.AddModel(*scene.models[i], scene.worldMatrices[i]);
+                }
+                DoNotOptimize(test.renderer.GetDrawcalls(0).size());
+                test.renderer.Render();
+            });
+        double addModelsTime = MeasureMilliseconds([&]()
+            {
+                test.renderer.SetCurrentCamera(test.camera);
+                test.renderer.AddModels(scene.models, scene.worldMatrices);
+                DoNotOptimize(test.renderer.GetDrawcalls(0).size());
+                test.renderer.Render();
+            });
+
+        ReportTiming("AddModel", objectCount, addModelTime);
+        ReportTiming("AddModels", objectCount, addModelsTime);
+    }
+}
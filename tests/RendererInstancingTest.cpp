@@ -0,0 +1,350 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/renderer/GBufferRenderPass.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Add the models in order, one unit apart, and render the main view with a pass that captures the drawcalls
+static std::vector<CapturedDrawcall> RenderModels(TestRenderer& test, const std::vector<const Model*>& models)
+{
+    std::vector<CapturedDrawcall> drawcalls;
+    Renderer& renderer = test.renderer;
+    renderer.AddRenderPass(std::make_unique<CaptureRenderPass>(0, drawcalls));
+
+    renderer.SetCurrentCamera(test.camera);
+    for (unsigned int i = 0; i < models.size(); ++i)
+    {
+        renderer.AddModel(*models[i], glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f)));
+    }
+    renderer.Render();
+    return drawcalls;
+}
+
+TEST(RendererInstancingMerge)
+{
+    TestRenderer test;
+    std::shared_ptr<Model> modelA = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    std::shared_ptr<Model> modelB = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+
+    // Repeated models are merged with their first drawcall, wherever they are
+    std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { modelA.get(), modelB.get(), modelA.get(), modelA.get(), modelB.get() });
+    CHECK(drawcalls.size() == 2);
+    if (drawcalls.size() == 2)
+    {
+        CHECK(drawcalls[0].material == &modelA->GetMaterial(0) && drawcalls[0].instanced && drawcalls[0].instanceCount == 3);
+        CHECK(drawcalls[1].material == &modelB->GetMaterial(0) && drawcalls[1].instanced && drawcalls[1].instanceCount == 2);
+
+        // Each batch has its own range of instances
+        CHECK(drawcalls[0].firstInstance + 3 <= drawcalls[1].firstInstance || drawcalls[1].firstInstance + 2 <= drawcalls[0].firstInstance);
+    }
+}
+
+TEST(RendererInstancingUnsupported)
+{
+    // Shaders without the instance attributes get one drawcall per model
+    TestRenderer test;
+    std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+    std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { model.get(), model.get(), model.get() });
+    CHECK(drawcalls.size() == 3);
+    for (unsigned int i = 0; i < drawcalls.size(); ++i)
+    {
+        CHECK(!drawcalls[i].instanced && drawcalls[i].instanceCount == 1 && drawcalls[i].worldMatrixIndex == i);
+    }
+}
+
+TEST(RendererInstancingDisabled)
+{
+    // Instanced shaders still read the instance attributes, so each drawcall is its own batch of one
+    TestRenderer test;
+    test.renderer.SetInstancingEnabled(false);
+    std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { model.get(), model.get(), model.get() });
+    CHECK(drawcalls.size() == 3);
+    for (const CapturedDrawcall& drawcall : drawcalls)
+    {
+        CHECK(drawcall.instanced && drawcall.instanceCount == 1);
+    }
+}
+
+TEST(RendererInstancingBlended)
+{
+    // Blended drawcalls keep their order, so they are only merged with the previous drawcall
+    TestRenderer test;
+    std::shared_ptr<Material> materialA = std::make_shared<Material>(CreateShaderProgram(test.renderer, true));
+    std::shared_ptr<Material> materialB = std::make_shared<Material>(CreateShaderProgram(test.renderer, true));
+    materialA->SetBlendEquation(Material::BlendEquation::Add);
+    materialB->SetBlendEquation(Material::BlendEquation::Add);
+    std::shared_ptr<Model> modelA = CreateTriangleModel(materialA);
+    std::shared_ptr<Model> modelB = CreateTriangleModel(materialB);
+
+    std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { modelA.get(), modelA.get(), modelB.get(), modelA.get() });
+    CHECK(drawcalls.size() == 3);
+    if (drawcalls.size() == 3)
+    {
+        CHECK(drawcalls[0].material == materialA.get() && drawcalls[0].instanceCount == 2);
+        CHECK(drawcalls[1].material == materialB.get() && drawcalls[1].instanceCount == 1);
+        CHECK(drawcalls[2].material == materialA.get() && drawcalls[2].instanceCount == 1);
+    }
+}
+
+// Pass that keeps the indirect buckets of a collection
+class IndirectBucketsRenderPass : public RenderPass
+{
+public:
+    IndirectBucketsRenderPass(unsigned int drawcallCollectionIndex, std::vector<unsigned int>& commandCounts)
+        : m_drawcallCollectionIndex(drawcallCollectionIndex), m_commandCounts(commandCounts), m_firstDrawcallIndices(nullptr) {}
+    IndirectBucketsRenderPass(unsigned int drawcallCollectionIndex, std::vector<unsigned int>& commandCounts, std::vector<unsigned int>& firstDrawcallIndices)
+        : m_drawcallCollectionIndex(drawcallCollectionIndex), m_commandCounts(commandCounts), m_firstDrawcallIndices(&firstDrawcallIndices) {}
+
+    void Render() override
+    {
+        m_commandCounts.clear();
+        for (const Renderer::IndirectBucket& bucket : GetRenderer().BuildIndirectBuckets(m_drawcallCollectionIndex))
+        {
+            m_commandCounts.push_back(bucket.GetCommandCount());
+            if (m_firstDrawcallIndices)
+            {
+                m_firstDrawcallIndices->push_back(bucket.GetFirstDrawcallIndex());
+            }
+        }
+    }
+
+private:
+    unsigned int m_drawcallCollectionIndex;
+    std::vector<unsigned int>& m_commandCounts;
+    std::vector<unsigned int>* m_firstDrawcallIndices;
+};
+
+// Model with two submeshes of the triangle mesh, that share its VAO and the material
+static std::shared_ptr<Model> CreateTwoSubmeshModel(std::shared_ptr<Material> material)
+{
+    std::shared_ptr<Mesh> mesh = CreateTriangleMesh();
+    mesh->AddSubmesh(0, Drawcall::Primitive::Triangles, 0, 1, Data::Type::None);
+    std::shared_ptr<Model> model = std::make_shared<Model>(mesh);
+    model->AddMaterial(material);
+    model->AddMaterial(material);
+    return model;
+}
+
+TEST(RendererIndirectBuckets)
+{
+    TestRenderer test;
+    std::vector<unsigned int> commandCounts, firstDrawcallIndices;
+    test.renderer.AddRenderPass(std::make_unique<IndirectBucketsRenderPass>(0, commandCounts, firstDrawcallIndices));
+
+    std::shared_ptr<Model> modelA = CreateTwoSubmeshModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    std::shared_ptr<Model> modelB = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    std::shared_ptr<Model> modelC = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+
+    // The submeshes of A are different drawcalls, but they share the state, so they go in the same bucket
+    // Drawcalls without instancing support are not in any bucket
+    std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { modelC.get(), modelB.get(), modelA.get(), modelB.get(), modelA.get() });
+    CHECK(drawcalls.size() == 4);
+    CHECK(commandCounts == std::vector<unsigned int>({ 1, 2 }));
+    CHECK(firstDrawcallIndices == std::vector<unsigned int>({ 1, 2 }));
+}
+
+TEST(RendererIndirectSortOrder)
+{
+    TestRenderer test;
+    SetGLStubVersion(4, 3);
+    test.device.UpdateVersion();
+
+    std::vector<CapturedDrawcall> drawcalls;
+    test.renderer.AddRenderPass(std::make_unique<CaptureRenderPass>(0, drawcalls));
+    std::unique_ptr<GBufferRenderPass> gbufferRenderPass = std::make_unique<GBufferRenderPass>(nullptr);
+    gbufferRenderPass->SetSubmissionMode(RenderPass::SubmissionMode::Indirect);
+    test.renderer.AddRenderPass(std::move(gbufferRenderPass));
+
+    std::shared_ptr<ShaderProgram> programA = CreateShaderProgram(test.renderer, true);
+    std::shared_ptr<ShaderProgram> programB = CreateShaderProgram(test.renderer, false);
+    std::shared_ptr<ShaderProgram> programC = CreateShaderProgram(test.renderer, true);
+    std::shared_ptr<Model> modelA = CreateTwoSubmeshModel(std::make_shared<Material>(programA));
+    std::shared_ptr<Model> modelB = CreateTriangleModel(std::make_shared<Material>(programB));
+    std::shared_ptr<Model> modelC = CreateTriangleModel(std::make_shared<Material>(programC));
+
+    // Each bucket is drawn in place of its first drawcall, between the direct ones
+    test.renderer.SetCurrentCamera(test.camera);
+    const Model* models[] = { modelA.get(), modelB.get(), modelC.get(), modelB.get(), modelA.get() };
+    for (const Model* model : models)
+    {
+        test.renderer.AddModel(*model, glm::mat4(1.0f));
+    }
+    size_t firstDraw = GetGLStubDraws().size();
+    test.renderer.Render();
+    std::span<const GLStubDraw> draws = GetGLStubDraws().subspan(firstDraw);
+    SetGLStubVersion(0, 0);
+
+    // A (two submeshes in one bucket), B, C, B
+    std::vector<GLuint> expectedPrograms;
+    for (const ShaderProgram* shaderProgram : { programA.get(), programB.get(), programC.get(), programB.get() })
+    {
+        expectedPrograms.push_back(shaderProgram->GetHandle());
+    }
+    CHECK(drawcalls.size() == 5);
+    CHECK(draws.size() == expectedPrograms.size());
+    if (draws.size() == expectedPrograms.size())
+    {
+        for (unsigned int i = 0; i < draws.size(); ++i)
+        {
+            CHECK(draws[i].program == expectedPrograms[i]);
+            CHECK(draws[i].indirect == (i == 0 || i == 2));
+        }
+    }
+}
+
+TEST(RendererInstancingOrderIndependent)
+{
+    // Blended drawcalls of order independent collections are merged like opaque ones, and grouped in indirect buckets
+    for (bool orderIndependent : { false, true })
+    {
+        TestRenderer test;
+        test.renderer.SetDrawcallCollectionOrderIndependent(0, orderIndependent);
+        std::vector<unsigned int> commandCounts;
+        test.renderer.AddRenderPass(std::make_unique<IndirectBucketsRenderPass>(0, commandCounts));
+
+        std::shared_ptr<Material> materialA = std::make_shared<Material>(CreateShaderProgram(test.renderer, true));
+        std::shared_ptr<Material> materialB = std::make_shared<Material>(CreateShaderProgram(test.renderer, true));
+        materialA->SetBlendEquation(Material::BlendEquation::Add);
+        materialB->SetBlendEquation(Material::BlendEquation::Add);
+        std::shared_ptr<Model> modelA = CreateTriangleModel(materialA);
+        std::shared_ptr<Model> modelB = CreateTriangleModel(materialB);
+
+        std::vector<CapturedDrawcall> drawcalls = RenderModels(test, { modelA.get(), modelB.get(), modelA.get(), modelA.get(), modelB.get() });
+        if (orderIndependent)
+        {
+            CHECK(drawcalls.size() == 2);
+            CHECK(commandCounts == std::vector<unsigned int>({ 1, 1 }));
+            if (drawcalls.size() == 2)
+            {
+                CHECK(drawcalls[0].material == materialA.get() && drawcalls[0].instanceCount == 3);
+                CHECK(drawcalls[1].material == materialB.get() && drawcalls[1].instanceCount == 2);
+            }
+        }
+        else
+        {
+            CHECK(drawcalls.size() == 4);
+            CHECK(commandCounts.empty());
+        }
+    }
+}
+
+// State of the instance attributes after preparing a drawcall
+struct PreparedInstanceAttributes
+{
+    bool instanced;
+    bool enabled;
+    unsigned int pointerCount;
+};
+
+// Pass that prepares each drawcall of a collection twice, and keeps the state of the instance attributes of its VAO
+class PrepareDrawcallsRenderPass : public RenderPass
+{
+public:
+    PrepareDrawcallsRenderPass(std::vector<PreparedInstanceAttributes>& prepared) : m_prepared(prepared) {}
+
+    void Render() override
+    {
+        Renderer& renderer = GetRenderer();
+        for (const Renderer::DrawcallInfo& drawcallInfo : renderer.GetDrawcalls(0))
+        {
+            for (unsigned int i = 0; i < 2; ++i)
+            {
+                unsigned int pointerCount = GetGLStubAttributePointerCount();
+                renderer.PrepareDrawcall(drawcallInfo);
+                bool enabled = IsGLStubAttributeEnabled(drawcallInfo.GetVAO().GetHandle(), Renderer::InstanceWorldMatrixLocation);
+                m_prepared.push_back({ drawcallInfo.IsInstanced(), enabled, GetGLStubAttributePointerCount() - pointerCount });
+            }
+        }
+    }
+
+private:
+    std::vector<PreparedInstanceAttributes>& m_prepared;
+};
+
+// Instanced and not instanced drawcalls of the same mesh share its VAO
+TEST(RendererInstancingSharedVAO)
+{
+    TestRenderer test;
+    std::vector<PreparedInstanceAttributes> prepared;
+    test.renderer.AddRenderPass(std::make_unique<PrepareDrawcallsRenderPass>(prepared));
+
+    std::shared_ptr<Mesh> mesh = CreateTriangleMesh();
+    std::shared_ptr<Model> models[3] = { std::make_shared<Model>(mesh), std::make_shared<Model>(mesh), std::make_shared<Model>(mesh) };
+    models[0]->AddMaterial(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    models[1]->AddMaterial(std::make_shared<Material>(CreateShaderProgram(test.renderer, true)));
+    models[2]->AddMaterial(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+
+    // Drawcalls: first batch, not instanced, second batch, not instanced
+    RenderModels(test, { models[0].get(), models[2].get(), models[0].get(), models[1].get(), models[2].get(), models[1].get() });
+    CHECK(prepared.size() == 8);
+    if (prepared.size() == 8)
+    {
+        for (unsigned int i = 0; i < prepared.size(); i += 2)
+        {
+            bool instanced = i / 2 % 2 == 0;
+            CHECK(prepared[i].instanced == instanced && prepared[i + 1].instanced == instanced);
+
+            // The attributes are set for each batch, but not again for the same batch, and disabled for the drawcalls that are not instanced
+            CHECK(prepared[i].enabled == instanced && prepared[i + 1].enabled == instanced);
+            CHECK(prepared[i].pointerCount == (instanced ? 4 : 0));
+            CHECK(prepared[i + 1].pointerCount == 0);
+        }
+    }
+
+    // Nothing stays enabled after the pass
+    CHECK(!IsGLStubAttributeEnabled(mesh->GetSubmeshVertexArray(0).GetHandle(), Renderer::InstanceWorldMatrixLocation));
+}
+
+// Transparent particles with a few materials, sorted back to front against the unsorted order independent collection
+BENCHMARK(RendererInstancingTransparentParticles)
+{
+    std::mt19937 random(25);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    const unsigned int count = 10000, materialCount = 8;
+    std::vector<glm::mat4> worldMatrices;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        worldMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random) - 50.0f)));
+    }
+
+    for (bool orderIndependent : { false, true })
+    {
+        TestRenderer test;
+        test.renderer.SetDrawcallCollectionOrderIndependent(0, orderIndependent);
+        std::vector<CapturedDrawcall> drawcalls;
+        test.renderer.AddRenderPass(std::make_unique<CaptureRenderPass>(0, drawcalls));
+
+        std::vector<std::shared_ptr<Model>> models;
+        for (unsigned int i = 0; i < materialCount; ++i)
+        {
+            std::shared_ptr<Material> material = std::make_shared<Material>(CreateShaderProgram(test.renderer, true));
+            material->SetBlendEquation(Material::BlendEquation::Add);
+            models.push_back(CreateTriangleModel(material));
+        }
+
+        double frameTime = MeasureMilliseconds([&]()
+            {
+                test.renderer.AddView(test.camera);
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    test.renderer.AddModel(*models[i % materialCount], worldMatrices[i]);
+                }
+                if (!orderIndependent)
+                {
+                    test.renderer.SortDrawcallCollection(0, Renderer::DrawcallSortMode::BackToFront);
+                }
+                test.renderer.Render();
+                DoNotOptimize(drawcalls.size());
+            });
+        ReportTiming(orderIndependent ? "order independent, unsorted" : "sorted back to front", count, frameTime);
+        // Sorted particles alternate materials, so only the order independent collection merges them by material
+        CHECK(orderIndependent ? drawcalls.size() == materialCount : drawcalls.size() > count / 2);
+    }
+}
@@ -0,0 +1,154 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <functional>
+#include <random>
+
+// Pass that calls a function with the renderer, after the transforms of its view were computed
+class FunctionRenderPass : public RenderPass
+{
+public:
+    FunctionRenderPass(std::function<void(Renderer&)> function) : m_function(std::move(function)) {}
+
+    void Render() override { m_function(GetRenderer()); }
+
+private:
+    std::function<void(Renderer&)> m_function;
+};
+
+static std::vector<glm::mat4> CreateRandomWorldMatrices(unsigned int count)
+{
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    std::vector<glm::mat4> worldMatrices;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        glm::mat4 worldMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+        worldMatrix = glm::rotate(worldMatrix, angle(random), glm::normalize(glm::vec3(position(random), position(random), position(random))));
+        worldMatrix = glm::scale(worldMatrix, glm::vec3(scale(random), scale(random), scale(random)));
+        worldMatrices.push_back(worldMatrix);
+    }
+    return worldMatrices;
+}
+
+template<typename TMatrix>
+static bool IsNear(const TMatrix& a, const TMatrix& b)
+{
+    for (int column = 0; column < TMatrix::length(); ++column)
+    {
+        for (int row = 0; row < TMatrix::col_type::length(); ++row)
+        {
+            float tolerance = 1e-4f * std::max(1.0f, std::abs(b[column][row]));
+            if (std::abs(a[column][row] - b[column][row]) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(RendererPrecomputedTransforms)
+{
+    TestRenderer test;
+    test.renderer.SetWorkerThreadCount(3);
+
+    // The binder keeps the last transforms it received
+    glm::mat4 worldMatrix(0.0f), worldViewMatrix(0.0f), worldViewProjMatrix(0.0f);
+    glm::mat3 normalMatrix(0.0f);
+    std::shared_ptr<ShaderProgram> shaderProgram = std::make_shared<ShaderProgram>();
+    test.renderer.RegisterShaderProgram(shaderProgram,
+        [&](const ShaderProgram&, const Renderer::ObjectTransforms& transforms, const Camera&, bool)
+        {
+            worldMatrix = transforms.worldMatrix;
+            worldViewMatrix = transforms.worldViewMatrix;
+            worldViewProjMatrix = transforms.worldViewProjMatrix;
+            normalMatrix = transforms.normalMatrix;
+        }, nullptr);
+    std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(shaderProgram));
+
+    // Enough objects to split the batch in threads. Some of them are only in a second view, and don't get precomputed transforms
+    const unsigned int objectCount = 20000;
+    std::vector<glm::mat4> worldMatrices = CreateRandomWorldMatrices(objectCount);
+    std::vector<const Model*> models(objectCount, model.get());
+    std::vector<Renderer::ViewMask> viewMasks(objectCount, 1);
+    for (unsigned int i = 0; i < objectCount; i += 7)
+    {
+        viewMasks[i] = 2;
+    }
+
+    unsigned int checkedCount = 0;
+    test.renderer.AddRenderPass(std::make_unique<FunctionRenderPass>([&](Renderer& renderer)
+        {
+            const Camera& camera = renderer.GetCurrentCamera();
+            for (unsigned int i = 0; i < objectCount; ++i)
+            {
+                renderer.UpdateTransforms(shaderProgram, i);
+
+                glm::mat4 expectedWorldViewMatrix = camera.GetViewMatrix() * worldMatrices[i];
+                glm::mat4 expectedWorldViewProjMatrix = camera.GetViewProjectionMatrix() * worldMatrices[i];
+                glm::mat3 expectedNormalMatrix = glm::transpose(glm::inverse(glm::mat3(expectedWorldViewMatrix)));
+                CHECK(worldMatrix == worldMatrices[i]);
+                CHECK(IsNear(worldViewMatrix, expectedWorldViewMatrix));
+                CHECK(IsNear(worldViewProjMatrix, expectedWorldViewProjMatrix));
+                CHECK(IsNear(normalMatrix, expectedNormalMatrix));
+                ++checkedCount;
+            }
+        }));
+
+    Camera secondCamera;
+    test.renderer.AddView(test.camera);
+    test.renderer.AddView(secondCamera);
+    test.renderer.AddModels(models, worldMatrices, viewMasks);
+    test.renderer.Render();
+    CHECK(checkedCount == objectCount);
+}
+
+// Cost of the precomputed transforms: a frame where a pass needs them, against a frame without passes,
+// and against computing the same products with glm, one object at a time
+BENCHMARK(RendererPrecomputeTransforms)
+{
+    for (unsigned int objectCount : { 1000u, 10000u, 100000u })
+    {
+        TestRenderer test;
+        std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+        std::vector<glm::mat4> worldMatrices = CreateRandomWorldMatrices(objectCount);
+        std::vector<const Model*> models(objectCount, model.get());
+
+        auto renderFrame = [&]()
+            {
+                test.renderer.SetCurrentCamera(test.camera);
+                test.renderer.AddModels(models, worldMatrices);
+                test.renderer.Render();
+            };
+        double withoutTransformsTime = MeasureMilliseconds(renderFrame);
+        test.renderer.AddRenderPass(std::make_unique<FunctionRenderPass>([](Renderer&) {}));
+        double withTransformsTime = MeasureMilliseconds(renderFrame);
+
+        std::vector<glm::mat4> worldViewMatrices(objectCount), worldViewProjMatrices(objectCount);
+        std::vector<glm::mat3> normalMatrices(objectCount);
+        double glmTime = MeasureMilliseconds([&]()
+            {
+                const glm::mat4& viewMatrix = test.camera.GetViewMatrix();
+                glm::mat4 viewProjMatrix = test.camera.GetViewProjectionMatrix();
+                for (unsigned int i = 0; i < objectCount; ++i)
+                {
+                    worldViewMatrices[i] = viewMatrix * worldMatrices[i];
+                    worldViewProjMatrices[i] = viewProjMatrix * worldMatrices[i];
+                    normalMatrices[i] = glm::transpose(glm::inverse(glm::mat3(worldViewMatrices[i])));
+                }
+                DoNotOptimize(static_cast<unsigned long long>(normalMatrices.back()[0][0] * 1000.0f));
+            });
+
+        ReportTiming("frame without transforms", objectCount, withoutTransformsTime);
+        ReportTiming("frame with transforms", objectCount, withTransformsTime);
+        ReportTiming("glm, one object at a time", objectCount, glmTime);
+    }
+}
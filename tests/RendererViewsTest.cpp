@@ -0,0 +1,310 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/geometry/VertexFormat.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/scene/RendererSceneVisitor.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Pass of a view that keeps the camera that was current while it rendered
+class ViewCameraRenderPass : public RenderPass
+{
+public:
+    ViewCameraRenderPass(unsigned int viewIndex, const Camera*& camera) : m_camera(camera) { SetViewIndex(viewIndex); }
+
+    void Render() override { m_camera = &GetRenderer().GetCurrentCamera(); }
+
+private:
+    const Camera*& m_camera;
+};
+
+// World matrix indices of the drawcalls in the collection
+static std::vector<unsigned int> GetWorldMatrixIndices(const Renderer& renderer, unsigned int collectionIndex)
+{
+    std::vector<unsigned int> indices;
+    for (const Renderer::DrawcallInfo& drawcallInfo : renderer.GetDrawcalls(collectionIndex))
+    {
+        indices.push_back(drawcallInfo.GetWorldMatrixIndex());
+    }
+    return indices;
+}
+
+TEST(RendererViewCollections)
+{
+    TestRenderer test;
+    Camera cameras[2];
+    std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+
+    // One collection per view, the first one is the default collection of the main view. And a pass per view
+    const Camera* passCameras[3] = {};
+    for (unsigned int view = 0; view < 3; ++view)
+    {
+        if (view > 0)
+        {
+            CHECK(test.renderer.AddDrawcallCollection(nullptr, view) == view);
+        }
+        test.renderer.AddRenderPass(std::make_unique<ViewCameraRenderPass>(view, passCameras[view]));
+    }
+
+    CHECK(test.renderer.AddView(test.camera) == 0);
+    CHECK(test.renderer.AddView(cameras[0]) == 1);
+    CHECK(test.renderer.AddView(cameras[1], Renderer::ViewObjects::Static) == 2);
+    CHECK(test.renderer.GetViewCount() == 3);
+    CHECK(&test.renderer.GetViewCamera(1) == &cameras[0]);
+    CHECK(test.renderer.GetStaticViewMask() == Renderer::AllViews);
+    CHECK(test.renderer.GetDynamicViewMask() == (Renderer::AllViews & ~4u));
+
+    // Each object is added once, and its world matrix is shared by the drawcalls of all its views
+    std::mt19937 random(18);
+    std::vector<Renderer::ViewMask> viewMasks;
+    for (unsigned int i = 0; i < 500; ++i)
+    {
+        viewMasks.push_back(random() % 8);
+        test.renderer.AddModel(*model, glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i), 0.0f, 0.0f)), viewMasks.back());
+    }
+
+    for (unsigned int view = 0; view < 3; ++view)
+    {
+        std::vector<unsigned int> expected;
+        for (unsigned int i = 0; i < viewMasks.size(); ++i)
+        {
+            if ((viewMasks[i] >> view) & 1)
+            {
+                expected.push_back(i);
+            }
+        }
+        CHECK(GetWorldMatrixIndices(test.renderer, view) == expected);
+    }
+
+    // Each pass renders with the camera of its view
+    test.renderer.Render();
+    CHECK(passCameras[0] == &test.camera);
+    CHECK(passCameras[1] == &cameras[0]);
+    CHECK(passCameras[2] == &cameras[1]);
+
+    // Views are cleared after the frame
+    CHECK(test.renderer.GetViewCount() == 0);
+    CHECK(test.renderer.GetDynamicViewMask() == Renderer::AllViews);
+}
+
+// A single visit of a scene with two cameras adds each model once, with the mask of the camera frustums where it is
+TEST(RendererSceneVisitorViews)
+{
+    TestRenderer test;
+    std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+    // The default collection is for the main view
+    test.renderer.AddDrawcallCollection(nullptr, 1);
+
+    Scene scene;
+    std::shared_ptr<Camera> cameras[2] = { std::make_shared<Camera>(), std::make_shared<Camera>() };
+    cameras[0]->SetViewMatrix(glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(0.0f));
+    cameras[1]->SetViewMatrix(glm::vec3(50.0f, 0.0f, 0.0f), glm::vec3(0.0f));
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        cameras[i]->SetPerspectiveProjectionMatrix(0.5f, 1.0f, 0.1f, 60.0f);
+        scene.AddSceneNode(std::make_shared<SceneCamera>("camera" + std::to_string(i), cameras[i]));
+    }
+
+    std::mt19937 random(18);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::vector<AabbBounds> bounds;
+    for (unsigned int i = 0; i < 300; ++i)
+    {
+        std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+        transform->SetTranslation(glm::vec3(position(random), position(random), position(random)));
+        std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>("model" + std::to_string(i), model, transform);
+        scene.AddSceneNode(sceneModel);
+        bounds.push_back(sceneModel->GetAabbBounds());
+    }
+
+    RendererSceneVisitor visitor(test.renderer);
+    scene.AcceptVisitor(visitor);
+    CHECK(test.renderer.GetViewCount() == 2);
+
+    // The drawcalls are in visit order, so the world matrices are found in the order of the visible models
+    FrustumBounds frustums[2] = { FrustumBounds(cameras[0]->GetViewProjectionMatrix()), FrustumBounds(cameras[1]->GetViewProjectionMatrix()) };
+    unsigned int expectedCulledCount = 0;
+    std::vector<unsigned int> expected[2];
+    unsigned int worldMatrixIndex = 0;
+    for (const AabbBounds& modelBounds : bounds)
+    {
+        bool visible[2] = { Bounds::Intersects(frustums[0], modelBounds), Bounds::Intersects(frustums[1], modelBounds) };
+        if (!visible[0] && !visible[1])
+        {
+            ++expectedCulledCount;
+            continue;
+        }
+        for (unsigned int view = 0; view < 2; ++view)
+        {
+            if (visible[view])
+            {
+                expected[view].push_back(worldMatrixIndex);
+            }
+        }
+        ++worldMatrixIndex;
+    }
+
+    CHECK(visitor.GetCulledModelCount() == expectedCulledCount);
+    CHECK(expectedCulledCount > 0 && !expected[0].empty() && !expected[1].empty());
+    CHECK(expected[0] != expected[1]);
+    CHECK(GetWorldMatrixIndices(test.renderer, 0) == expected[0]);
+    CHECK(GetWorldMatrixIndices(test.renderer, 1) == expected[1]);
+    test.renderer.Render();
+}
+
+// Materials of the drawcalls in the collection, sorted, to compare visits that add the models in different orders
+static std::vector<const Material*> GetSortedMaterials(const Renderer& renderer, unsigned int collectionIndex)
+{
+    std::vector<const Material*> materials;
+    for (const Renderer::DrawcallInfo& drawcallInfo : renderer.GetDrawcalls(collectionIndex))
+    {
+        materials.push_back(&drawcallInfo.GetMaterial());
+    }
+    std::sort(materials.begin(), materials.end());
+    return materials;
+}
+
+// Models without mesh bounds are not culled, but they still only go to the views of their kind of objects
+TEST(RendererSceneVisitorUnboundedViews)
+{
+    TestRenderer test;
+    Camera staticCamera;
+    test.renderer.AddDrawcallCollection(nullptr, 1);
+    CHECK(test.renderer.AddView(test.camera) == 0);
+    CHECK(test.renderer.AddView(staticCamera, Renderer::ViewObjects::Static) == 1);
+
+    // Triangle mesh without bounds
+    VertexFormat vertexFormat;
+    vertexFormat.AddVertexAttribute<float>(3, VertexAttribute::Semantic::Position);
+    std::vector<glm::vec3> vertices = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->AddSubmesh<glm::vec3, VertexFormat::LayoutIterator>(Drawcall::Primitive::Triangles, vertices, vertexFormat.LayoutBegin(3, false), vertexFormat.LayoutEnd());
+
+    Scene scene;
+    std::shared_ptr<ShaderProgram> shaderProgram = CreateShaderProgram(test.renderer, false);
+    std::shared_ptr<Model> models[2];
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        models[i] = std::make_shared<Model>(mesh);
+        models[i]->AddMaterial(std::make_shared<Material>(shaderProgram));
+        std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>("model" + std::to_string(i), models[i]);
+        sceneModel->SetStatic(i == 0);
+        scene.AddSceneNode(sceneModel);
+    }
+
+    RendererSceneVisitor visitor(test.renderer);
+    visitor.VisitScene(scene);
+    std::vector<const Material*> mainMaterials = GetSortedMaterials(test.renderer, 0);
+    std::vector<const Material*> expectedMainMaterials = { &models[0]->GetMaterial(0), &models[1]->GetMaterial(0) };
+    std::sort(expectedMainMaterials.begin(), expectedMainMaterials.end());
+    CHECK(mainMaterials == expectedMainMaterials);
+    CHECK(GetSortedMaterials(test.renderer, 1) == std::vector<const Material*>({ &models[0]->GetMaterial(0) }));
+    test.renderer.Render();
+}
+
+// Visiting the scene with its hierarchy and grid adds the same models to each view as culling all of them
+TEST(RendererSceneVisitorSceneQuery)
+{
+    TestRenderer test;
+    std::shared_ptr<ShaderProgram> shaderProgram = CreateShaderProgram(test.renderer, false);
+    test.renderer.AddDrawcallCollection(nullptr, 1);
+
+    Scene scene;
+    std::shared_ptr<Camera> cameras[2] = { std::make_shared<Camera>(), std::make_shared<Camera>() };
+    cameras[0]->SetViewMatrix(glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(0.0f));
+    cameras[1]->SetViewMatrix(glm::vec3(50.0f, 0.0f, 0.0f), glm::vec3(0.0f));
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        cameras[i]->SetPerspectiveProjectionMatrix(0.5f, 1.0f, 0.1f, 60.0f);
+        scene.AddSceneNode(std::make_shared<SceneCamera>("camera" + std::to_string(i), cameras[i]));
+    }
+
+    // Each model has its own material, to find it in the drawcalls. Half of them are static, in the hierarchy
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::vector<std::shared_ptr<Transform>> dynamicTransforms;
+    for (unsigned int i = 0; i < 400; ++i)
+    {
+        std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+        transform->SetTranslation(glm::vec3(position(random), position(random), position(random)));
+        std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(shaderProgram));
+        std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>("model" + std::to_string(i), model, transform);
+        sceneModel->SetStatic(i % 2 == 0);
+        scene.AddSceneNode(sceneModel);
+        if (i % 2 != 0)
+        {
+            dynamicTransforms.push_back(transform);
+        }
+    }
+
+    // Move the dynamic models, so the grid needs the new bounds
+    for (std::shared_ptr<Transform>& transform : dynamicTransforms)
+    {
+        transform->SetTranslation(glm::vec3(position(random), position(random), position(random)));
+    }
+    scene.UpdateBounds();
+
+    RendererSceneVisitor visitor(test.renderer);
+    scene.AcceptVisitor(visitor);
+    std::vector<const Material*> expected[2] = { GetSortedMaterials(test.renderer, 0), GetSortedMaterials(test.renderer, 1) };
+    unsigned int expectedCulledCount = visitor.GetCulledModelCount();
+    test.renderer.Render();
+
+    visitor.VisitScene(scene);
+    CHECK(test.renderer.GetViewCount() == 2);
+    CHECK(GetSortedMaterials(test.renderer, 0) == expected[0]);
+    CHECK(GetSortedMaterials(test.renderer, 1) == expected[1]);
+    CHECK(visitor.GetCulledModelCount() == expectedCulledCount);
+    CHECK(expectedCulledCount > 0 && !expected[0].empty() && !expected[1].empty());
+    test.renderer.Render();
+}
+
+// Visit of a static scene seen by a narrow camera, culling every model against the views or querying the hierarchy of the scene
+BENCHMARK(RendererSceneVisitorSceneQueryCost)
+{
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    for (unsigned int count : { 10000u, 100000u })
+    {
+        TestRenderer test;
+        std::shared_ptr<Model> model = CreateTriangleModel(std::make_shared<Material>(CreateShaderProgram(test.renderer, false)));
+        Scene scene;
+        std::shared_ptr<Camera> camera = std::make_shared<Camera>();
+        camera->SetViewMatrix(glm::vec3(0.0f, 0.0f, 500.0f), glm::vec3(0.0f));
+        camera->SetPerspectiveProjectionMatrix(0.3f, 1.0f, 0.1f, 1000.0f);
+        scene.AddSceneNode(std::make_shared<SceneCamera>("camera", camera));
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+            transform->SetTranslation(glm::vec3(position(random), position(random), position(random)));
+            std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>("model" + std::to_string(i), model, transform);
+            sceneModel->SetStatic(true);
+            scene.AddSceneNode(sceneModel);
+        }
+        scene.UpdateBounds();
+
+        RendererSceneVisitor visitor(test.renderer);
+        double visitTime = MeasureMilliseconds([&]()
+            {
+                scene.AcceptVisitor(visitor);
+                test.renderer.Render();
+            });
+        double queryTime = MeasureMilliseconds([&]()
+            {
+                visitor.VisitScene(scene);
+                test.renderer.Render();
+            });
+        ReportTiming("visit all, cull models", count, visitTime);
+        ReportTiming("visit scene query", count, queryTime);
+        ReportCount("visible models", count, count - visitor.GetCulledModelCount());
+    }
+}
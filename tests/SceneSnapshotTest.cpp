@@ -0,0 +1,293 @@
+#include "Test.h"
+#include "GLStubs.h"
+
+#include <ituGL/scene/SceneSnapshot.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/SceneLight.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/lighting/PointLight.h>
+#include <ituGL/lighting/SpotLight.h>
+#include <ituGL/camera/Camera.h>
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+
+static std::string GetSnapshotPath()
+{
+    return (std::filesystem::temp_directory_path() / "itugl-tests-snapshot.bin").string();
+}
+
+static std::shared_ptr<Model> CreateModel()
+{
+    SetGLStubUniforms({ { "Color", GL_FLOAT_VEC3 }, { "Mode", GL_INT }, { "Layers", GL_UNSIGNED_INT } });
+    // The mesh has no data or bounds, nodes use the transform scale as their size
+    std::shared_ptr<Model> model = std::make_shared<Model>(std::make_shared<Mesh>());
+    std::shared_ptr<Material> material = std::make_shared<Material>(std::make_shared<ShaderProgram>());
+    material->SetUniformValue("Color", glm::vec3(0.25f, 0.5f, 1.0f));
+    material->SetUniformValue("Mode", 3);
+    material->SetUniformValue("Layers", 5u);
+    model->AddMaterial(material);
+    SetGLStubUniforms({});
+    return model;
+}
+
+// Add a node with the transform values, and the parent transform if any
+template<typename TNode, typename... TArgs>
+static std::shared_ptr<TNode> AddNode(Scene& scene, const char* name, const glm::vec3& translation, std::shared_ptr<Transform> parent, bool isStatic, TArgs&&... args)
+{
+    std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+    transform->SetTranslation(translation);
+    transform->SetRotation(glm::vec3(0.1f, 0.2f, 0.3f));
+    // Cameras can't be scaled
+    if constexpr (!std::is_same_v<TNode, SceneCamera>)
+    {
+        transform->SetScale(glm::vec3(2.0f));
+    }
+    transform->SetParent(parent);
+    std::shared_ptr<TNode> node = std::make_shared<TNode>(name, std::forward<TArgs>(args)..., transform);
+    node->SetStatic(isStatic);
+    scene.AddSceneNode(node);
+    return node;
+}
+
+static void CheckSameTransform(const SceneNode& node, const SceneNode& loadedNode)
+{
+    std::shared_ptr<const Transform> transform = node.GetTransform();
+    std::shared_ptr<const Transform> loadedTransform = loadedNode.GetTransform();
+    CHECK(loadedTransform);
+    if (transform && loadedTransform)
+    {
+        CHECK(loadedTransform->GetTranslation() == transform->GetTranslation());
+        CHECK(loadedTransform->GetRotation() == transform->GetRotation());
+        CHECK(loadedTransform->GetScale() == transform->GetScale());
+    }
+    CHECK(loadedNode.IsStatic() == node.IsStatic());
+}
+
+TEST(SceneSnapshotRoundTrip)
+{
+    InstallGLStubs();
+    std::string path = GetSnapshotPath();
+
+    std::shared_ptr<Model> model = CreateModel();
+    glm::mat4 viewMatrix(1.0f), projectionMatrix(1.0f);
+    {
+        Scene scene;
+        std::shared_ptr<SceneNode> root = AddNode<SceneNode>(scene, "root", glm::vec3(1.0f, 2.0f, 3.0f), nullptr, true);
+        AddNode<SceneModel>(scene, "model0", glm::vec3(4.0f, 0.0f, 0.0f), root->GetTransform(), true, model);
+        AddNode<SceneModel>(scene, "model1", glm::vec3(-4.0f, 0.0f, 0.0f), root->GetTransform(), false, model);
+
+        std::shared_ptr<PointLight> pointLight = std::make_shared<PointLight>();
+        pointLight->SetColor(glm::vec3(1.0f, 0.5f, 0.25f));
+        pointLight->SetIntensity(3.0f);
+        pointLight->SetDistanceAttenuation(glm::vec2(2.0f, 8.0f));
+        AddNode<SceneLight>(scene, "point", glm::vec3(0.0f, 5.0f, 0.0f), nullptr, false, pointLight);
+
+        std::shared_ptr<SpotLight> spotLight = std::make_shared<SpotLight>();
+        spotLight->SetAngle(0.5f);
+        spotLight->SetAngleAttenuation(glm::vec2(0.3f, 0.4f));
+        AddNode<SceneLight>(scene, "spot", glm::vec3(0.0f, 5.0f, 5.0f), nullptr, false, spotLight);
+
+        std::shared_ptr<Camera> camera = std::make_shared<Camera>();
+        AddNode<SceneCamera>(scene, "camera", glm::vec3(0.0f, 1.0f, 10.0f), nullptr, false, camera);
+        camera->SetPerspectiveProjectionMatrix(1.0f, 1.5f, 0.1f, 100.0f);
+        viewMatrix = camera->GetViewMatrix();
+        projectionMatrix = camera->GetProjectionMatrix();
+
+        CHECK(SceneSnapshot::Save(scene, path.c_str(), [&](const Model& savedModel) { return &savedModel == model.get() ? "model" : ""; }));
+
+        // Change the values, so the loaded ones must come from the file
+        Material& material = model->GetMaterial(0);
+        material.SetUniformValue("Color", glm::vec3(0.0f));
+        material.SetUniformValue("Mode", 0);
+        material.SetUniformValue("Layers", 0u);
+
+        SceneSnapshot snapshot;
+        CHECK(snapshot.Load(path.c_str()));
+        CHECK(snapshot.GetNodes().size() == 6);
+        CHECK(snapshot.GetModels().size() == 1);
+        CHECK(snapshot.GetLights().size() == 2);
+        CHECK(snapshot.GetCameras().size() == 1);
+
+        unsigned int modelRequestCount = 0;
+        Scene loadedScene;
+        snapshot.Instantiate(loadedScene, [&](std::string_view name) { ++modelRequestCount; return name == "model" ? model : nullptr; });
+        CHECK(modelRequestCount == 1);
+
+        for (const char* name : { "root", "model0", "model1", "point", "spot", "camera" })
+        {
+            std::shared_ptr<SceneNode> node = scene.GetSceneNode(name);
+            std::shared_ptr<SceneNode> loadedNode = loadedScene.GetSceneNode(name);
+            CHECK(loadedNode);
+            if (loadedNode)
+            {
+                CheckSameTransform(*node, *loadedNode);
+            }
+        }
+
+        // Parents are restored as the transforms of the loaded nodes
+        std::shared_ptr<SceneNode> loadedRoot = loadedScene.GetSceneNode("root");
+        CHECK(loadedScene.GetSceneNode("model0")->GetTransform()->GetParent() == loadedRoot->GetTransform());
+        CHECK(loadedScene.GetSceneNode("model1")->GetTransform()->GetParent() == loadedRoot->GetTransform());
+        CHECK(!loadedScene.GetSceneNode("point")->GetTransform()->GetParent());
+
+        auto loadedModel = std::dynamic_pointer_cast<SceneModel>(loadedScene.GetSceneNode("model1"));
+        CHECK(loadedModel && loadedModel->GetModel() == model);
+        CHECK(material.GetAllDataValues<float>().size() == 3 && material.GetAllDataValues<float>()[1] == 0.5f);
+        CHECK(material.GetAllDataValues<int>().size() == 1 && material.GetAllDataValues<int>()[0] == 3);
+        CHECK(material.GetAllDataValues<unsigned int>().size() == 1 && material.GetAllDataValues<unsigned int>()[0] == 5u);
+
+        auto loadedPoint = std::dynamic_pointer_cast<SceneLight>(loadedScene.GetSceneNode("point"));
+        CHECK(loadedPoint && loadedPoint->GetLight()->GetType() == Light::Type::Point);
+        if (loadedPoint)
+        {
+            const PointLight& light = static_cast<const PointLight&>(*loadedPoint->GetLight());
+            CHECK(light.GetColor() == pointLight->GetColor());
+            CHECK(light.GetIntensity() == pointLight->GetIntensity());
+            CHECK(light.GetDistanceAttenuation() == pointLight->GetDistanceAttenuation());
+        }
+
+        auto loadedSpot = std::dynamic_pointer_cast<SceneLight>(loadedScene.GetSceneNode("spot"));
+        CHECK(loadedSpot && loadedSpot->GetLight()->GetType() == Light::Type::Spot);
+        if (loadedSpot)
+        {
+            const SpotLight& light = static_cast<const SpotLight&>(*loadedSpot->GetLight());
+            CHECK(light.GetAngle() == spotLight->GetAngle());
+            CHECK(light.GetAngleAttenuation() == spotLight->GetAngleAttenuation());
+        }
+
+        auto loadedCamera = std::dynamic_pointer_cast<SceneCamera>(loadedScene.GetSceneNode("camera"));
+        CHECK(loadedCamera);
+        if (loadedCamera)
+        {
+            CHECK(loadedCamera->GetCamera()->GetViewMatrix() == viewMatrix);
+            CHECK(loadedCamera->GetCamera()->GetProjectionMatrix() == projectionMatrix);
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+// Models that the application doesn't provide become plain nodes
+TEST(SceneSnapshotMissingModel)
+{
+    InstallGLStubs();
+    std::string path = GetSnapshotPath();
+    {
+        Scene scene;
+        AddNode<SceneModel>(scene, "model", glm::vec3(1.0f), nullptr, false, CreateModel());
+        CHECK(SceneSnapshot::Save(scene, path.c_str(), [](const Model&) { return "model"; }));
+
+        SceneSnapshot snapshot;
+        CHECK(snapshot.Load(path.c_str()));
+
+        Scene loadedScene;
+        snapshot.Instantiate(loadedScene, [](std::string_view) { return nullptr; });
+        std::shared_ptr<SceneNode> loadedNode = loadedScene.GetSceneNode("model");
+        CHECK(loadedNode && !std::dynamic_pointer_cast<SceneModel>(loadedNode));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(SceneSnapshotInvalidFile)
+{
+    std::string path = GetSnapshotPath();
+    SceneSnapshot snapshot;
+    std::filesystem::remove(path);
+    CHECK(!snapshot.Load(path.c_str()));
+
+    // Right magic, but a different version
+    {
+        SceneSnapshot::Header header{};
+        std::memcpy(header.magic, "ISCN", 4);
+        header.version = SceneSnapshot::Version + 1;
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    CHECK(!snapshot.Load(path.c_str()));
+
+    // Arrays outside the file
+    {
+        SceneSnapshot::Header header{};
+        std::memcpy(header.magic, "ISCN", 4);
+        header.version = SceneSnapshot::Version;
+        header.nodes = { 0, 1000 };
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    CHECK(!snapshot.Load(path.c_str()));
+    CHECK(!snapshot.IsLoaded());
+
+    std::filesystem::remove(path);
+}
+
+// Add the models in groups of 100, each group under the transform of its first model
+static void AddGroupedModels(Scene& scene, unsigned int count, const std::shared_ptr<Model>& model)
+{
+    std::shared_ptr<Transform> groupTransform;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+        transform->SetTranslation(glm::vec3(static_cast<float>(i % 100), static_cast<float>(i / 100), 0.0f));
+        transform->SetParent(i % 100 != 0 ? groupTransform : nullptr);
+        if (i % 100 == 0)
+        {
+            groupTransform = transform;
+        }
+        scene.AddSceneNode(std::make_shared<SceneModel>("model" + std::to_string(i), model, transform));
+    }
+}
+
+// Load time of a scene with 100k models: built again node by node, mapped from a snapshot, and mapped and instantiated
+// The scene is destroyed inside the measure in both cases
+BENCHMARK(SceneSnapshotLoad)
+{
+    InstallGLStubs();
+    std::string path = GetSnapshotPath();
+    std::shared_ptr<Model> model = CreateModel();
+    const unsigned int count = 100000;
+    {
+        Scene scene;
+        AddGroupedModels(scene, count, model);
+        SceneSnapshot::Save(scene, path.c_str(), [](const Model&) { return "model"; });
+    }
+    ReportCount("file size, bytes", count, std::filesystem::file_size(path));
+
+    double rebuildTime = MeasureMilliseconds([&]()
+        {
+            Scene scene;
+            AddGroupedModels(scene, count, model);
+            DoNotOptimize(scene.GetNodeVersion());
+        });
+    double mapTime = MeasureMilliseconds([&]()
+        {
+            // Read all the nodes, so the pages of the file are loaded
+            SceneSnapshot snapshot;
+            snapshot.Load(path.c_str());
+            float sum = 0.0f;
+            for (const SceneSnapshot::NodeRecord& node : snapshot.GetNodes())
+            {
+                sum += node.translation.x;
+            }
+            DoNotOptimize(static_cast<unsigned long long>(sum));
+        });
+    double instantiateTime = MeasureMilliseconds([&]()
+        {
+            SceneSnapshot snapshot;
+            snapshot.Load(path.c_str());
+            Scene scene;
+            snapshot.Instantiate(scene, [&](std::string_view) { return model; });
+            DoNotOptimize(scene.GetNodeVersion());
+        });
+    ReportTiming("rebuild node by node", count, rebuildTime);
+    ReportTiming("map snapshot and read nodes", count, mapTime);
+    ReportTiming("map snapshot and instantiate", count, instantiateTime);
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "GLStubs.h"
+
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/camera/Camera.h>
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+// The renderer registrations are private, so this reproduces the two ways of finding and calling the transform binder
+// of each drawcall: the maps keyed by shared_ptr with std::function of the previous renderer,
+// and the vector indexed by registration id with a function pointer instantiated for the binder type
+
+using UpdateTransformsFunction = std::function<void(const ShaderProgram&, const glm::mat4&, const Camera&, bool)>;
+
+struct Registration
+{
+    using UpdateTransformsCall = void(*)(const void*, const ShaderProgram&, const glm::mat4&, const Camera&, bool);
+
+    std::shared_ptr<const ShaderProgram> shaderProgram;
+    std::shared_ptr<const void> transformBinder;
+    UpdateTransformsCall updateTransforms = nullptr;
+
+    template<typename TBinder>
+    void SetTransformBinder(TBinder binder)
+    {
+        transformBinder = std::make_shared<const TBinder>(std::move(binder));
+        updateTransforms = [](const void* binder, const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera& camera, bool cameraChanged)
+        {
+            (*static_cast<const TBinder*>(binder))(shaderProgram, worldMatrix, camera, cameraChanged);
+        };
+    }
+};
+
+BENCHMARK(ShaderProgramBinderDispatch)
+{
+    InstallGLStubs();
+
+    const unsigned int shaderProgramCount = 16;
+    const unsigned int drawcallCount = 100000;
+
+    Camera camera;
+    glm::mat4 worldMatrix(1.0f);
+
+    // Stands for the uniform updates, so the call can't be removed
+    unsigned long long checksum = 0;
+    auto binder = [&checksum](const ShaderProgram& shaderProgram, const glm::mat4& worldMatrix, const Camera&, bool cameraChanged)
+    {
+        checksum += shaderProgram.GetHandle() + static_cast<unsigned long long>(worldMatrix[3][3]) + cameraChanged;
+    };
+
+    std::vector<std::shared_ptr<const ShaderProgram>> shaderPrograms;
+    std::unordered_map<std::shared_ptr<const ShaderProgram>, UpdateTransformsFunction> updateTransformsFunctions;
+    std::vector<Registration> registrations;
+    for (unsigned int i = 0; i < shaderProgramCount; ++i)
+    {
+        std::shared_ptr<const ShaderProgram> shaderProgram = std::make_shared<ShaderProgram>();
+        shaderPrograms.push_back(shaderProgram);
+        updateTransformsFunctions[shaderProgram] = binder;
+        registrations.emplace_back().shaderProgram = shaderProgram;
+        registrations.back().SetTransformBinder(binder);
+    }
+
+    // Each drawcall uses a random program, the registration id is its position
+    std::mt19937 random(7);
+    std::vector<unsigned int> drawcallPrograms(drawcallCount);
+    for (unsigned int& index : drawcallPrograms)
+    {
+        index = random() % shaderProgramCount;
+    }
+
+    double mapTime = MeasureMilliseconds([&]()
+        {
+            for (unsigned int index : drawcallPrograms)
+            {
+                const std::shared_ptr<const ShaderProgram>& shaderProgram = shaderPrograms[index];
+                auto itFind = updateTransformsFunctions.find(shaderProgram);
+                if (itFind != updateTransformsFunctions.end())
+                    itFind->second(*shaderProgram, worldMatrix, camera, false);
+            }
+        });
+
+    double registrationTime = MeasureMilliseconds([&]()
+        {
+            for (unsigned int index : drawcallPrograms)
+            {
+                const ShaderProgram& shaderProgram = *shaderPrograms[index];
+                if (index < registrations.size())
+                {
+                    const Registration& registration = registrations[index];
+                    if (registration.shaderProgram.get() == &shaderProgram && registration.updateTransforms)
+                        registration.updateTransforms(registration.transformBinder.get(), shaderProgram, worldMatrix, camera, false);
+                }
+            }
+        });
+
+    DoNotOptimize(checksum);
+    ReportTiming("shared_ptr map + std::function", drawcallCount, mapTime);
+    ReportTiming("registration id + function pointer", drawcallCount, registrationTime);
+}
@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "TestRenderer.h"
+
+#include <ituGL/renderer/ShadowRenderPass.h>
+#include <ituGL/geometry/Model.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+#include <ituGL/lighting/SpotLight.h>
+#include <ituGL/lighting/DirectionalLight.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneCamera.h>
+#include <ituGL/scene/SceneLight.h>
+#include <ituGL/scene/SceneModel.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/scene/RendererSceneVisitor.h>
+
+// Scene with a camera, a spot light over the origin, and a static and a dynamic model under the light
+struct ShadowTestScene
+{
+    TestRenderer test;
+    ShadowRenderPass* shadowRenderPass;
+    RendererSceneVisitor visitor;
+    Scene scene;
+    std::shared_ptr<Camera> camera;
+    std::shared_ptr<SpotLight> spotLight;
+    std::shared_ptr<Transform> staticTransform;
+    std::shared_ptr<Transform> dynamicTransform;
+
+    ShadowTestScene() : visitor(test.renderer)
+    {
+        std::unique_ptr<ShadowRenderPass> pass = std::make_unique<ShadowRenderPass>(2048);
+        shadowRenderPass = pass.get();
+        test.renderer.AddRenderPass(std::move(pass));
+        visitor.SetShadowRenderPass(shadowRenderPass);
+
+        camera = std::make_shared<Camera>();
+        camera->SetViewMatrix(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f));
+        camera->SetPerspectiveProjectionMatrix(1.0f, 1.0f, 0.1f, 500.0f);
+        scene.AddSceneNode(std::make_shared<SceneCamera>("camera", camera));
+
+        spotLight = std::make_shared<SpotLight>();
+        spotLight->SetPosition(glm::vec3(0.0f, 10.0f, 0.0f));
+        spotLight->SetDirection(glm::vec3(0.0f, 1.0f, 0.0f));
+        spotLight->SetAngle(0.6f);
+        spotLight->SetDistanceAttenuation(glm::vec2(5.0f, 30.0f));
+        scene.AddSceneNode(std::make_shared<SceneLight>("spot", spotLight));
+
+        std::shared_ptr<ShaderProgram> shaderProgram = CreateShaderProgram(test.renderer, false);
+        staticTransform = AddModel("static", shaderProgram, true);
+        dynamicTransform = AddModel("dynamic", shaderProgram, false);
+    }
+
+    std::shared_ptr<Transform> AddModel(const char* name, std::shared_ptr<ShaderProgram> shaderProgram, bool isStatic)
+    {
+        std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+        std::shared_ptr<SceneModel> sceneModel = std::make_shared<SceneModel>(name, CreateTriangleModel(std::make_shared<Material>(shaderProgram)), transform);
+        sceneModel->SetStatic(isStatic);
+        scene.AddSceneNode(sceneModel);
+        return transform;
+    }
+
+    const ShadowRenderPass::Stats& RenderFrame()
+    {
+        scene.UpdateBounds();
+        visitor.VisitScene(scene);
+        test.renderer.Render();
+        return shadowRenderPass->GetStats();
+    }
+};
+
+TEST(ShadowRenderPassStaticCache)
+{
+    ShadowTestScene shadowScene;
+
+    // The first frame renders the static depth, the next ones reuse it
+    const ShadowRenderPass::Stats& stats = shadowScene.RenderFrame();
+    CHECK(stats.tileCount == 1);
+    CHECK(stats.staticRenderedTileCount == 1 && stats.staticCachedTileCount == 0);
+    CHECK(stats.staticDrawcallCount == 1 && stats.dynamicDrawcallCount == 1);
+    shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 0 && stats.staticCachedTileCount == 1);
+    CHECK(stats.staticDrawcallCount == 0 && stats.dynamicDrawcallCount == 1);
+    CHECK(stats.savedDrawcallCount == 1);
+
+    // Moving the dynamic model keeps the cache
+    shadowScene.dynamicTransform->SetTranslation(glm::vec3(1.0f, 0.0f, 0.0f));
+    shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 0 && stats.staticCachedTileCount == 1);
+    CHECK(stats.dynamicDrawcallCount == 1);
+}
+
+TEST(ShadowRenderPassStaticNodeMove)
+{
+    ShadowTestScene shadowScene;
+    shadowScene.RenderFrame();
+    shadowScene.RenderFrame();
+
+    // Moving the static model renders its tile again, once
+    shadowScene.staticTransform->SetTranslation(glm::vec3(-1.0f, 0.0f, 0.0f));
+    const ShadowRenderPass::Stats& stats = shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 1 && stats.staticCachedTileCount == 0);
+    CHECK(stats.staticDrawcallCount == 1);
+    shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 0 && stats.staticCachedTileCount == 1);
+}
+
+TEST(ShadowRenderPassLightMove)
+{
+    ShadowTestScene shadowScene;
+    shadowScene.RenderFrame();
+    shadowScene.RenderFrame();
+
+    // A new position of the light changes the projection of its tile
+    shadowScene.spotLight->SetPosition(glm::vec3(1.0f, 10.0f, 0.0f));
+    const ShadowRenderPass::Stats& stats = shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 1 && stats.staticCachedTileCount == 0);
+    shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 0 && stats.staticCachedTileCount == 1);
+}
+
+TEST(ShadowRenderPassAtlasReallocation)
+{
+    ShadowTestScene shadowScene;
+    shadowScene.RenderFrame();
+    shadowScene.RenderFrame();
+    glm::vec4 rect = shadowScene.shadowRenderPass->GetLightShadow(*shadowScene.spotLight)->rects[0];
+
+    // Far from the camera, the light covers less of the screen, and its tile gets a smaller place in the atlas
+    shadowScene.camera->SetViewMatrix(glm::vec3(0.0f, 5.0f, 200.0f), glm::vec3(0.0f));
+    const ShadowRenderPass::Stats& stats = shadowScene.RenderFrame();
+    const ShadowRenderPass::LightShadow* lightShadow = shadowScene.shadowRenderPass->GetLightShadow(*shadowScene.spotLight);
+    CHECK(lightShadow && lightShadow->rects[0].z < rect.z);
+    CHECK(stats.staticRenderedTileCount == 1 && stats.staticCachedTileCount == 0);
+    shadowScene.RenderFrame();
+    CHECK(stats.staticRenderedTileCount == 0 && stats.staticCachedTileCount == 1);
+}
+
+TEST(ShadowRenderPassNewTilesKeepCache)
+{
+    ShadowTestScene shadowScene;
+    shadowScene.RenderFrame();
+    shadowScene.RenderFrame();
+    glm::vec4 rect = shadowScene.shadowRenderPass->GetLightShadow(*shadowScene.spotLight)->rects[0];
+
+    // The cascades of a new directional light are packed around the spot light tile, that keeps its place and its cache
+    std::shared_ptr<DirectionalLight> directionalLight = std::make_shared<DirectionalLight>();
+    directionalLight->SetDirection(glm::vec3(0.0f, -1.0f, -0.5f));
+    shadowScene.scene.AddSceneNode(std::make_shared<SceneLight>("directional", directionalLight));
+
+    const ShadowRenderPass::Stats& stats = shadowScene.RenderFrame();
+    const ShadowRenderPass::LightShadow* lightShadow = shadowScene.shadowRenderPass->GetLightShadow(*shadowScene.spotLight);
+    CHECK(lightShadow && lightShadow->rects[0] == rect);
+    CHECK(stats.tileCount == 1 + ShadowRenderPass::MaxCascadeCount);
+    CHECK(stats.staticRenderedTileCount == ShadowRenderPass::MaxCascadeCount && stats.staticCachedTileCount == 1);
+}
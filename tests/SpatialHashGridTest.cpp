@@ -0,0 +1,259 @@
+#include "Test.h"
+
+#include <ituGL/scene/SpatialHashGrid.h>
+#include <ituGL/camera/Camera.h>
+#include <ituGL/core/WorkerPool.h>
+
+#include <optional>
+#include <random>
+
+static AabbBounds CreateRandomBounds(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.5f);
+    return AabbBounds(glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)));
+}
+
+// The grid and the bounds of its items, indexed by handle. Removed items have no bounds
+struct GridItems
+{
+    SpatialHashGrid grid;
+    std::vector<std::optional<AabbBounds>> bounds;
+
+    void Insert(const AabbBounds& itemBounds)
+    {
+        SpatialHashGrid::Handle handle = grid.Insert(itemBounds);
+        if (handle >= bounds.size())
+        {
+            bounds.resize(handle + 1);
+        }
+        CHECK(!bounds[handle]);
+        bounds[handle] = itemBounds;
+    }
+};
+
+template<typename TQuery>
+static void CheckQuery(const GridItems& items, const TQuery& query)
+{
+    std::vector<SpatialHashGrid::Handle> found;
+    items.grid.Query(query, [&](SpatialHashGrid::Handle handle) { found.push_back(handle); });
+    std::sort(found.begin(), found.end());
+
+    std::vector<SpatialHashGrid::Handle> expected;
+    for (SpatialHashGrid::Handle handle = 0; handle < items.bounds.size(); ++handle)
+    {
+        const std::optional<AabbBounds>& itemBounds = items.bounds[handle];
+        if (itemBounds && query.IntersectsBox(itemBounds->GetMin(), itemBounds->GetMax()))
+        {
+            expected.push_back(handle);
+        }
+    }
+    CHECK(found == expected);
+}
+
+static void CheckRayCast(const GridItems& items, const glm::vec3& origin, const glm::vec3& direction)
+{
+    const float maxDistance = 500.0f;
+
+    // Cells are not visited in order, so the closest hit is the last one reported
+    float closest = -1.0f;
+    items.grid.RayCast(origin, direction, maxDistance, [&](SpatialHashGrid::Handle, float distance) { closest = distance; return distance; });
+
+    float expected = -1.0f;
+    for (const std::optional<AabbBounds>& itemBounds : items.bounds)
+    {
+        float distance = itemBounds ? AabbBounds::RayIntersection(origin, 1.0f / direction, maxDistance, itemBounds->GetMin(), itemBounds->GetMax()) : -1.0f;
+        if (distance >= 0.0f && (expected < 0.0f || distance < expected))
+        {
+            expected = distance;
+        }
+    }
+    CHECK(closest == expected);
+}
+
+static void CheckQueries(const GridItems& items, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(1.0f, 30.0f);
+    for (unsigned int i = 0; i < 20; ++i)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        CheckQuery(items, AabbBounds(center, glm::vec3(size(random), size(random), size(random))));
+        CheckQuery(items, SphereBounds(center, size(random)));
+
+        Camera camera;
+        camera.SetViewMatrix(center, glm::vec3(position(random), position(random), position(random)));
+        camera.SetPerspectiveProjectionMatrix(1.0f, 1.5f, 0.1f, size(random) * 5.0f);
+        CheckQuery(items, FrustumBounds(camera.GetViewProjectionMatrix()));
+
+        glm::vec3 direction = glm::normalize(glm::vec3(position(random), position(random), position(random)));
+        CheckRayCast(items, center, direction);
+    }
+}
+
+TEST(SpatialHashGridQueries)
+{
+    std::mt19937 random(14);
+    GridItems items;
+    for (unsigned int i = 0; i < 2000; ++i)
+    {
+        items.Insert(CreateRandomBounds(random));
+    }
+    CHECK(items.grid.GetItemCount() == 2000);
+    CheckQueries(items, random);
+}
+
+TEST(SpatialHashGridMoveAndRemove)
+{
+    std::mt19937 random(15);
+    GridItems items;
+    for (unsigned int i = 0; i < 2000; ++i)
+    {
+        items.Insert(CreateRandomBounds(random));
+    }
+
+    // Move some items one by one, and the rest in a batch, most of them to other cells
+    std::vector<SpatialHashGrid::Handle> handles;
+    std::vector<AabbBounds> bounds;
+    for (SpatialHashGrid::Handle handle = 0; handle < items.bounds.size(); ++handle)
+    {
+        AabbBounds itemBounds = CreateRandomBounds(random);
+        if (handle % 4 == 0)
+        {
+            items.grid.Move(handle, itemBounds);
+        }
+        else
+        {
+            handles.push_back(handle);
+            bounds.push_back(itemBounds);
+        }
+        items.bounds[handle] = itemBounds;
+    }
+    items.grid.Move(handles, bounds);
+    CheckQueries(items, random);
+
+    // Remove a third of the items, then insert new ones in the free handles
+    for (SpatialHashGrid::Handle handle = 0; handle < items.bounds.size(); handle += 3)
+    {
+        items.grid.Remove(handle);
+        items.bounds[handle].reset();
+    }
+    CHECK(items.grid.GetItemCount() == 2000 - 667);
+    CheckQueries(items, random);
+
+    for (unsigned int i = 0; i < 667; ++i)
+    {
+        items.Insert(CreateRandomBounds(random));
+    }
+    CHECK(items.bounds.size() == 2000);
+    CheckQueries(items, random);
+
+    items.grid.Clear();
+    CHECK(items.grid.GetItemCount() == 0);
+    CHECK(items.grid.GetCellCount() == 0);
+}
+
+TEST(SpatialHashGridSameWithThreads)
+{
+    std::mt19937 random(14);
+    WorkerPool workerPool;
+    GridItems items, threadedItems;
+    threadedItems.grid.SetWorkerPool(&workerPool);
+    threadedItems.grid.SetThreadCount(4);
+
+    // Same items in both grids, enough for all the threads, all of them moved in a batch
+    std::vector<SpatialHashGrid::Handle> handles;
+    std::vector<AabbBounds> bounds;
+    for (unsigned int i = 0; i < 40000; ++i)
+    {
+        AabbBounds itemBounds = CreateRandomBounds(random);
+        items.Insert(itemBounds);
+        threadedItems.Insert(itemBounds);
+        handles.push_back(i);
+        bounds.push_back(CreateRandomBounds(random));
+    }
+    items.grid.Move(handles, bounds);
+    threadedItems.grid.Move(handles, bounds);
+    CHECK(workerPool.GetWorkerCount() == 3);
+
+    for (SpatialHashGrid::Handle handle : handles)
+    {
+        items.bounds[handle] = bounds[handle];
+        threadedItems.bounds[handle] = bounds[handle];
+    }
+    CHECK(threadedItems.grid.GetCellCount() == items.grid.GetCellCount());
+    std::mt19937 threadedRandom = random;
+    CheckQueries(items, random);
+    CheckQueries(threadedItems, threadedRandom);
+}
+
+// Moving all the items every frame, one by one and in a batch, against testing all of them in the queries
+BENCHMARK(SpatialHashGridMove)
+{
+    std::mt19937 random(14);
+    WorkerPool workerPool;
+    for (unsigned int count : { 1000u, 10000u, 100000u })
+    {
+        SpatialHashGrid grid;
+        std::vector<SpatialHashGrid::Handle> handles;
+        std::vector<AabbBounds> bounds;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            bounds.push_back(CreateRandomBounds(random));
+            handles.push_back(grid.Insert(bounds.back()));
+        }
+
+        // Small steps, so some items change cell
+        std::vector<AabbBounds> movedBounds;
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        for (const AabbBounds& itemBounds : bounds)
+        {
+            movedBounds.emplace_back(itemBounds.GetCenter() + glm::vec3(offset(random), offset(random), offset(random)), itemBounds.GetSize());
+        }
+
+        bool moved = false;
+        double moveTime = MeasureMilliseconds([&]()
+            {
+                const std::vector<AabbBounds>& targetBounds = moved ? bounds : movedBounds;
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    grid.Move(handles[i], targetBounds[i]);
+                }
+                moved = !moved;
+            });
+        double batchMoveTime = MeasureMilliseconds([&]()
+            {
+                grid.Move(handles, moved ? bounds : movedBounds);
+                moved = !moved;
+            });
+        grid.SetWorkerPool(&workerPool);
+        double pooledMoveTime = MeasureMilliseconds([&]()
+            {
+                grid.Move(handles, moved ? bounds : movedBounds);
+                moved = !moved;
+            });
+
+        AabbBounds query(glm::vec3(0.0f), glm::vec3(10.0f));
+        unsigned long long found = 0;
+        double queryTime = MeasureMilliseconds([&]()
+            {
+                grid.Query(query, [&](SpatialHashGrid::Handle handle) { found += handle; });
+            });
+        double bruteForceTime = MeasureMilliseconds([&]()
+            {
+                const std::vector<AabbBounds>& currentBounds = moved ? movedBounds : bounds;
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    if (query.IntersectsBox(currentBounds[i].GetMin(), currentBounds[i].GetMax()))
+                        found += i;
+                }
+            });
+        DoNotOptimize(found);
+
+        ReportTiming("move", count, moveTime);
+        ReportTiming("batched move", count, batchMoveTime);
+        ReportTiming("batched move, worker pool", count, pooledMoveTime);
+        ReportTiming("grid query", count, queryTime);
+        ReportTiming("brute force query", count, bruteForceTime);
+    }
+}
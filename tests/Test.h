@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// Minimal test runner, so the library can be checked without other dependencies
+// Tests run with ctest. Benchmarks only run with --benchmark, and print their timings
+struct TestCase
+{
+    const char* name;
+    void (*function)();
+    bool benchmark;
+};
+
+std::vector<TestCase>& GetTestCases();
+
+// Report a failed check. The test keeps running, and the runner returns an error at the end
+void ReportFailure(const char* file, int line, const char* condition);
+
+// Print a benchmark result in a common format
+void ReportTiming(const char* name, unsigned int count, double milliseconds);
+// Print a quantity measured by a benchmark, like a number of drawcalls, in the same format
+void ReportCount(const char* name, unsigned int count, unsigned long long value);
+
+struct TestRegistration
+{
+    TestRegistration(const char* name, void (*function)(), bool benchmark)
+    {
+        GetTestCases().push_back({ name, function, benchmark });
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name, false); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name, true); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ReportFailure(__FILE__, __LINE__, #condition); } } while (false)
+
+// Best time of several runs, in milliseconds. The best one is the least affected by the rest of the system
+template<typename TFunction>
+double MeasureMilliseconds(TFunction function, unsigned int runs = 5)
+{
+    double best = 0.0;
+    for (unsigned int run = 0; run < runs; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        best = run == 0 ? duration.count() : std::min(best, duration.count());
+    }
+    return best;
+}
+
+// Keep the compiler from removing a computation whose result is not used. Defined in another file, so it can't be inlined
+void DoNotOptimize(unsigned long long value);
@@ -0,0 +1,59 @@
+#include "TestRenderer.h"
+
+#include <ituGL/geometry/Model.h>
+#include <ituGL/geometry/Mesh.h>
+#include <ituGL/geometry/VertexFormat.h>
+#include <ituGL/shader/Material.h>
+#include <ituGL/shader/ShaderProgram.h>
+
+TestRenderer::TestRenderer() : renderer(device)
+{
+    camera.SetViewMatrix(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f));
+    camera.SetPerspectiveProjectionMatrix(1.0f, 1.0f, 0.1f, 100.0f);
+}
+
+CaptureRenderPass::CaptureRenderPass(unsigned int drawcallCollectionIndex, std::vector<CapturedDrawcall>& drawcalls)
+    : m_drawcallCollectionIndex(drawcallCollectionIndex), m_drawcalls(drawcalls)
+{
+}
+
+void CaptureRenderPass::Render()
+{
+    m_drawcalls.clear();
+    for (const Renderer::DrawcallInfo& drawcallInfo : GetRenderer().GetDrawcalls(m_drawcallCollectionIndex))
+    {
+        m_drawcalls.push_back({ &drawcallInfo.GetMaterial(), &drawcallInfo.GetVAO(), drawcallInfo.GetWorldMatrixIndex(),
+            drawcallInfo.IsInstanced(), drawcallInfo.GetFirstInstance(), drawcallInfo.GetDrawcall().GetInstanceCount() });
+    }
+}
+
+std::shared_ptr<ShaderProgram> CreateShaderProgram(Renderer& renderer, bool instanced)
+{
+    std::shared_ptr<ShaderProgram> shaderProgram = std::make_shared<ShaderProgram>();
+    if (instanced)
+    {
+        SetGLStubAttributes({ { "InstanceWorldMatrix", static_cast<GLint>(Renderer::InstanceWorldMatrixLocation) } });
+    }
+    renderer.RegisterShaderProgram(shaderProgram, nullptr, nullptr);
+    SetGLStubAttributes({});
+    return shaderProgram;
+}
+
+std::shared_ptr<Mesh> CreateTriangleMesh()
+{
+    VertexFormat vertexFormat;
+    vertexFormat.AddVertexAttribute<float>(3, VertexAttribute::Semantic::Position);
+
+    std::vector<glm::vec3> vertices = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->AddSubmesh<glm::vec3, VertexFormat::LayoutIterator>(Drawcall::Primitive::Triangles, vertices, vertexFormat.LayoutBegin(3, false), vertexFormat.LayoutEnd());
+    mesh->AddBounds(glm::vec3(-1.0f), glm::vec3(1.0f));
+    return mesh;
+}
+
+std::shared_ptr<Model> CreateTriangleModel(std::shared_ptr<Material> material)
+{
+    std::shared_ptr<Model> model = std::make_shared<Model>(CreateTriangleMesh());
+    model->AddMaterial(material);
+    return model;
+}
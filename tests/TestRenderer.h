@@ -0,0 +1,66 @@
+#pragma once
+
+#include "GLStubs.h"
+
+#include <ituGL/core/DeviceGL.h>
+#include <ituGL/renderer/Renderer.h>
+#include <ituGL/renderer/RenderPass.h>
+#include <ituGL/camera/Camera.h>
+
+#include <memory>
+#include <vector>
+
+class Model;
+class Mesh;
+class Material;
+class ShaderProgram;
+
+// Installs the GL stubs before the device and the renderer are created
+struct GLStubsInstaller
+{
+    GLStubsInstaller() { InstallGLStubs(); }
+};
+
+// Renderer without an OpenGL context, with a camera looking at the origin as main view
+struct TestRenderer
+{
+    GLStubsInstaller stubs;
+    DeviceGL device;
+    Renderer renderer;
+    Camera camera;
+
+    TestRenderer();
+};
+
+// Copy of a drawcall as the passes see it, after the renderer built the instances
+struct CapturedDrawcall
+{
+    const Material* material;
+    const VertexArrayObject* vao;
+    unsigned int worldMatrixIndex;
+    bool instanced;
+    unsigned int firstInstance;
+    GLsizei instanceCount;
+};
+
+// Pass that keeps the drawcalls of a collection every time it renders
+class CaptureRenderPass : public RenderPass
+{
+public:
+    CaptureRenderPass(unsigned int drawcallCollectionIndex, std::vector<CapturedDrawcall>& drawcalls);
+
+    void Render() override;
+
+private:
+    unsigned int m_drawcallCollectionIndex;
+    std::vector<CapturedDrawcall>& m_drawcalls;
+};
+
+// Shader program registered in the renderer. Instanced programs declare the instance world matrix attribute
+std::shared_ptr<ShaderProgram> CreateShaderProgram(Renderer& renderer, bool instanced);
+
+// Mesh with a single triangle, and bounds of the unit cube
+std::shared_ptr<Mesh> CreateTriangleMesh();
+
+// Model with the triangle mesh
+std::shared_ptr<Model> CreateTriangleModel(std::shared_ptr<Material> material);
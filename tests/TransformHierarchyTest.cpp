@@ -0,0 +1,250 @@
+#include "Test.h"
+
+#include <ituGL/scene/TransformHierarchy.h>
+#include <ituGL/scene/Transform.h>
+#include <ituGL/scene/Scene.h>
+#include <ituGL/scene/SceneNode.h>
+#include <ituGL/core/WorkerPool.h>
+
+#include <glm/gtc/epsilon.hpp>
+
+#include <random>
+
+// World matrix computed with a recursive walk up the parents, without the cached matrices of the hierarchy
+static glm::mat4 ComputeReferenceWorldMatrix(const TransformHierarchy& hierarchy, TransformHierarchy::Id id)
+{
+    glm::mat4 localMatrix = TransformHierarchy::ComputeLocalMatrix(hierarchy.GetTranslation(id), hierarchy.GetRotation(id), hierarchy.GetScale(id));
+    TransformHierarchy::Id parentId = hierarchy.GetParent(id);
+    return parentId != TransformHierarchy::InvalidId ? ComputeReferenceWorldMatrix(hierarchy, parentId) * localMatrix : localMatrix;
+}
+
+static bool IsSameMatrix(const glm::mat4& a, const glm::mat4& b)
+{
+    for (int column = 0; column < 4; ++column)
+    {
+        if (!glm::all(glm::epsilonEqual(a[column], b[column], 1e-3f)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool HasReferenceWorldMatrices(TransformHierarchy& hierarchy, const std::vector<TransformHierarchy::Id>& ids)
+{
+    bool same = true;
+    for (TransformHierarchy::Id id : ids)
+    {
+        same &= IsSameMatrix(hierarchy.GetWorldMatrix(id), ComputeReferenceWorldMatrix(hierarchy, id));
+    }
+    return same;
+}
+
+// Transforms with random values, each one with a random earlier transform as parent, or without parent
+static std::vector<TransformHierarchy::Id> CreateRandomTransforms(TransformHierarchy& hierarchy, unsigned int count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.9f, 1.1f);
+    std::vector<TransformHierarchy::Id> ids;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        TransformHierarchy::Id id = hierarchy.Create();
+        hierarchy.SetTranslation(id, glm::vec3(value(random), value(random), value(random)));
+        hierarchy.SetRotation(id, glm::vec3(value(random), value(random), value(random)));
+        hierarchy.SetScale(id, glm::vec3(scale(random), scale(random), scale(random)));
+        if (i > 0 && random() % 8 != 0)
+        {
+            hierarchy.SetParent(id, ids[random() % ids.size()]);
+        }
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+// True if the parent is the transform or one of its descendants
+static bool IsDescendant(const TransformHierarchy& hierarchy, TransformHierarchy::Id id, TransformHierarchy::Id parentId)
+{
+    for (TransformHierarchy::Id ancestorId = parentId; ancestorId != TransformHierarchy::InvalidId; ancestorId = hierarchy.GetParent(ancestorId))
+    {
+        if (ancestorId == id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(TransformHierarchyReparentFastPath)
+{
+    TransformHierarchy hierarchy;
+
+    // Each child added right after the subtree of its parent keeps the depth-first order
+    TransformHierarchy::Id root = hierarchy.Create();
+    TransformHierarchy::Id child = hierarchy.Create();
+    hierarchy.SetParent(child, root);
+    TransformHierarchy::Id grandchild = hierarchy.Create();
+    hierarchy.SetParent(grandchild, child);
+    TransformHierarchy::Id secondChild = hierarchy.Create();
+    hierarchy.SetParent(secondChild, root);
+    CHECK(!hierarchy.IsOrderChanged());
+
+    hierarchy.SetTranslation(root, glm::vec3(1.0f, 2.0f, 3.0f));
+    hierarchy.SetRotation(child, glm::vec3(0.5f, 0.0f, 0.0f));
+    hierarchy.SetScale(grandchild, glm::vec3(2.0f));
+    CHECK(hierarchy.IsDirty(grandchild));
+    CHECK(HasReferenceWorldMatrices(hierarchy, { root, child, grandchild, secondChild }));
+    CHECK(!hierarchy.IsDirty(grandchild));
+
+    // A root that is not after the subtree of the new parent needs a sort
+    TransformHierarchy::Id otherRoot = hierarchy.Create();
+    hierarchy.SetParent(root, otherRoot);
+    CHECK(hierarchy.IsOrderChanged());
+    hierarchy.SetTranslation(otherRoot, glm::vec3(-5.0f, 0.0f, 0.0f));
+    CHECK(HasReferenceWorldMatrices(hierarchy, { root, child, grandchild, secondChild, otherRoot }));
+    CHECK(!hierarchy.IsOrderChanged());
+}
+
+TEST(TransformHierarchySortDepthFirst)
+{
+    std::mt19937 random(15);
+    TransformHierarchy hierarchy;
+    std::vector<TransformHierarchy::Id> ids = CreateRandomTransforms(hierarchy, 2000, random);
+    CHECK(HasReferenceWorldMatrices(hierarchy, ids));
+
+    // Move subtrees around, each change followed by an update or not, so the sort sees several changes at once
+    for (unsigned int change = 0; change < 500; ++change)
+    {
+        TransformHierarchy::Id id = ids[random() % ids.size()];
+        TransformHierarchy::Id parentId = random() % 8 != 0 ? ids[random() % ids.size()] : TransformHierarchy::InvalidId;
+        if (!IsDescendant(hierarchy, id, parentId))
+        {
+            hierarchy.SetParent(id, parentId);
+        }
+        if (change % 16 == 0)
+        {
+            CHECK(HasReferenceWorldMatrices(hierarchy, ids));
+        }
+    }
+    CHECK(HasReferenceWorldMatrices(hierarchy, ids));
+
+    // Destroy most of the leaves, so the sort also compacts the free slots
+    std::vector<TransformHierarchy::Id> keptIds;
+    std::vector<bool> hasChildren(ids.size(), false);
+    for (TransformHierarchy::Id id : ids)
+    {
+        TransformHierarchy::Id parentId = hierarchy.GetParent(id);
+        if (parentId != TransformHierarchy::InvalidId)
+        {
+            hasChildren[parentId] = true;
+        }
+    }
+    for (TransformHierarchy::Id id : ids)
+    {
+        if (!hasChildren[id] && random() % 4 != 0)
+        {
+            hierarchy.Destroy(id);
+        }
+        else
+        {
+            keptIds.push_back(id);
+        }
+    }
+    CHECK(hierarchy.GetTransformCount() == keptIds.size());
+    hierarchy.SetTranslation(keptIds[0], glm::vec3(3.0f));
+    CHECK(HasReferenceWorldMatrices(hierarchy, keptIds));
+}
+
+TEST(TransformHierarchySameWithThreads)
+{
+    std::mt19937 random(15);
+    TransformHierarchy hierarchy, threadedHierarchy;
+    WorkerPool workerPool;
+    threadedHierarchy.SetWorkerPool(&workerPool);
+    threadedHierarchy.SetThreadCount(4);
+
+    // Same transforms in both hierarchies, enough for all the threads
+    std::mt19937 threadedRandom = random;
+    std::vector<TransformHierarchy::Id> ids = CreateRandomTransforms(hierarchy, 40000, random);
+    std::vector<TransformHierarchy::Id> threadedIds = CreateRandomTransforms(threadedHierarchy, 40000, threadedRandom);
+    hierarchy.UpdateWorldMatrices();
+    threadedHierarchy.UpdateWorldMatrices();
+    CHECK(workerPool.GetWorkerCount() == 3);
+
+    bool sameMatrices = true;
+    for (unsigned int i = 0; i < ids.size(); ++i)
+    {
+        sameMatrices &= hierarchy.GetWorldMatrix(ids[i]) == threadedHierarchy.GetWorldMatrix(threadedIds[i]);
+    }
+    CHECK(sameMatrices);
+    CHECK(HasReferenceWorldMatrices(threadedHierarchy, threadedIds));
+}
+
+TEST(TransformHierarchyPerScene)
+{
+    Scene scene, otherScene;
+    CHECK(scene.GetTransformHierarchy() != otherScene.GetTransformHierarchy());
+
+    // Transforms built outside the scene move to it with their whole tree
+    std::shared_ptr<Transform> parent = std::make_shared<Transform>();
+    std::shared_ptr<Transform> child = std::make_shared<Transform>();
+    parent->SetTranslation(glm::vec3(1.0f, 0.0f, 0.0f));
+    child->SetTranslation(glm::vec3(0.0f, 2.0f, 0.0f));
+    child->SetParent(parent);
+    CHECK(child->GetHierarchy() == parent->GetHierarchy());
+
+    std::shared_ptr<SceneNode> childNode = std::make_shared<SceneNode>("child", child);
+    scene.AddSceneNode(childNode);
+    CHECK(child->GetHierarchy() == scene.GetTransformHierarchy());
+    CHECK(parent->GetHierarchy() == scene.GetTransformHierarchy());
+    CHECK(child->GetParent() == parent);
+    CHECK(child->GetTransformMatrix()[3] == glm::vec4(1.0f, 2.0f, 0.0f, 1.0f));
+
+    // Nodes of the other scene don't share the transforms of this one
+    std::shared_ptr<SceneNode> otherNode = std::make_shared<SceneNode>("other");
+    otherScene.AddSceneNode(otherNode);
+    CHECK(otherNode->GetTransform()->GetHierarchy() == otherScene.GetTransformHierarchy());
+    CHECK(scene.GetTransformHierarchy()->GetTransformCount() == 2);
+    CHECK(otherScene.GetTransformHierarchy()->GetTransformCount() == 1);
+}
+
+// The transforms keep the hierarchy of a scene alive after the scene is destroyed
+TEST(TransformHierarchyOutlivesScene)
+{
+    std::shared_ptr<SceneNode> node = std::make_shared<SceneNode>("node");
+    {
+        Scene scene;
+        scene.AddSceneNode(node);
+        node->GetTransform()->SetTranslation(glm::vec3(4.0f));
+    }
+    CHECK(node->GetTransform()->GetTransformMatrix()[3] == glm::vec4(4.0f, 4.0f, 4.0f, 1.0f));
+}
+
+// Update time of the world matrices when all the transforms move, in the calling thread and in the worker threads
+BENCHMARK(TransformHierarchyUpdate)
+{
+    std::mt19937 random(15);
+    WorkerPool workerPool;
+    for (unsigned int count : { 10000u, 100000u })
+    {
+        TransformHierarchy hierarchy, threadedHierarchy;
+        threadedHierarchy.SetWorkerPool(&workerPool);
+        std::mt19937 threadedRandom = random;
+        std::vector<TransformHierarchy::Id> ids = CreateRandomTransforms(hierarchy, count, random);
+        std::vector<TransformHierarchy::Id> threadedIds = CreateRandomTransforms(threadedHierarchy, count, threadedRandom);
+
+        for (TransformHierarchy* currentHierarchy : { &hierarchy, &threadedHierarchy })
+        {
+            const std::vector<TransformHierarchy::Id>& currentIds = currentHierarchy == &hierarchy ? ids : threadedIds;
+            double updateTime = MeasureMilliseconds([&]()
+                {
+                    for (TransformHierarchy::Id id : currentIds)
+                    {
+                        currentHierarchy->SetTranslation(id, currentHierarchy->GetTranslation(id));
+                    }
+                    currentHierarchy->UpdateWorldMatrices();
+                    DoNotOptimize(static_cast<unsigned long long>(currentHierarchy->GetWorldMatrix(currentIds[0])[3][0]));
+                });
+            ReportTiming(currentHierarchy == &hierarchy ? "move all, calling thread" : "move all, worker pool", count, updateTime);
+        }
+    }
+}
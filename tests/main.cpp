@@ -0,0 +1,85 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+static unsigned int s_failureCount = 0;
+// Written by DoNotOptimize. Volatile, so the writes can't be removed
+static volatile unsigned long long s_doNotOptimizeValue = 0;
+
+std::vector<TestCase>& GetTestCases()
+{
+    // Function static, so it exists before the registrations of the other files
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void ReportFailure(const char* file, int line, const char* condition)
+{
+    std::printf("  %s(%d): CHECK(%s) failed\n", file, line, condition);
+    ++s_failureCount;
+}
+
+void ReportTiming(const char* name, unsigned int count, double milliseconds)
+{
+    std::printf("  %-40s %8u %10.3f ms\n", name, count, milliseconds);
+}
+
+void ReportCount(const char* name, unsigned int count, unsigned long long value)
+{
+    std::printf("  %-40s %8u %10llu\n", name, count, value);
+}
+
+void DoNotOptimize(unsigned long long value)
+{
+    s_doNotOptimizeValue = value;
+}
+
+// itugl-tests [--benchmark] [name]
+// Runs the tests, or the benchmarks, whose name contains the filter
+int main(int argc, char* argv[])
+{
+    bool benchmark = false;
+    const char* filter = "";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--benchmark") == 0)
+        {
+            benchmark = true;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+#ifndef NDEBUG
+    // Debug builds have no optimizations, and their timings don't say much about the real cost
+    if (benchmark)
+    {
+        std::printf("warning: benchmarks built without NDEBUG, configure with -DCMAKE_BUILD_TYPE=Release\n");
+    }
+#endif
+
+    unsigned int failedCount = 0;
+    for (const TestCase& testCase : GetTestCases())
+    {
+        if (testCase.benchmark != benchmark || !std::strstr(testCase.name, filter))
+        {
+            continue;
+        }
+
+        // Flushed before running, so a crash still shows the name
+        std::printf("%s\n", testCase.name);
+        std::fflush(stdout);
+        unsigned int previousFailureCount = s_failureCount;
+        testCase.function();
+        if (s_failureCount != previousFailureCount)
+        {
+            ++failedCount;
+        }
+    }
+
+    std::printf("%u failed\n", failedCount);
+    return failedCount == 0 ? 0 : 1;
+}